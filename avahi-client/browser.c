@@ -103,6 +103,15 @@ static void defer_timeout_callback(AvahiTimeout *t, void *userdata) {
     avahi_domain_browser_free(db);
 }
 
+static void domain_browser_created(void *object, int error) {
+    AvahiDomainBrowser *db = object;
+
+    assert(db);
+
+    if (error < 0)
+        db->callback(db, db->interface, db->protocol, AVAHI_BROWSER_FAILURE, NULL, 0, db->userdata);
+}
+
 AvahiDomainBrowser* avahi_domain_browser_new(
     AvahiClient *client,
     AvahiIfIndex interface,
@@ -114,17 +123,13 @@ AvahiDomainBrowser* avahi_domain_browser_new(
     void *userdata) {
 
     AvahiDomainBrowser *db = NULL;
-    DBusMessage *message = NULL, *reply = NULL;
-    DBusError error;
-    char *path;
+    DBusMessage *message = NULL;
     int32_t i_interface, i_protocol, bt;
     uint32_t u_flags;
 
     assert(client);
     assert(callback);
 
-    dbus_error_init (&error);
-
     if (!avahi_client_is_connected(client)) {
         avahi_client_set_errno(client, AVAHI_ERR_BAD_STATE);
         goto fail;
@@ -179,26 +184,8 @@ AvahiDomainBrowser* avahi_domain_browser_new(
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block (client->bus, message, -1, &error)) ||
-        dbus_error_is_set(&error)) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
-
-    if (!dbus_message_get_args (reply, &error, DBUS_TYPE_OBJECT_PATH, &path, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set(&error) ||
-        !path) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
-
-    if (!(db->path = avahi_strdup(path))) {
-
-        /* FIXME: We don't remove the object on the server side */
-
-        avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+    if (avahi_client_create_object(client, message, db, &db->path, AVAHI_DBUS_INTERFACE_DOMAIN_BROWSER, domain_browser_created) < 0)
         goto fail;
-    }
 
     if (db->static_browse_domains && btype == AVAHI_DOMAIN_BROWSER_BROWSE) {
         struct timeval tv = { 0, 0 };
@@ -210,26 +197,17 @@ AvahiDomainBrowser* avahi_domain_browser_new(
     }
 
     dbus_message_unref(message);
-    dbus_message_unref(reply);
 
     return db;
 
 fail:
 
-    if (dbus_error_is_set(&error)) {
-        avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
-    }
-
     if (db)
         avahi_domain_browser_free(db);
 
     if (message)
         dbus_message_unref(message);
 
-    if (reply)
-        dbus_message_unref(reply);
-
     return NULL;
 }
 
@@ -250,8 +228,7 @@ int avahi_domain_browser_free (AvahiDomainBrowser *b) {
 
     client = b->client;
 
-    if (b->path && avahi_client_is_connected(b->client))
-        r = avahi_client_simple_method_call(client, b->path, AVAHI_DBUS_INTERFACE_DOMAIN_BROWSER, "Free");
+    r = avahi_client_free_object(client, b, b->path, AVAHI_DBUS_INTERFACE_DOMAIN_BROWSER);
 
     AVAHI_LLIST_REMOVE(AvahiDomainBrowser, domain_browsers, client->domain_browsers, b);
 
@@ -282,11 +259,7 @@ DBusHandlerResult avahi_domain_browser_event (AvahiClient *client, AvahiBrowserE
     if (!(path = dbus_message_get_path(message)))
         goto fail;
 
-    for (db = client->domain_browsers; db; db = db->domain_browsers_next)
-        if (strcmp (db->path, path) == 0)
-            break;
-
-    if (!db)
+    if (!(db = avahi_client_find_object(client, path, AVAHI_DBUS_INTERFACE_DOMAIN_BROWSER)))
         goto fail;
 
     interface = db->interface;
@@ -349,6 +322,15 @@ fail:
 
 /* AvahiServiceTypeBrowser */
 
+static void service_type_browser_created(void *object, int error) {
+    AvahiServiceTypeBrowser *b = object;
+
+    assert(b);
+
+    if (error < 0)
+        b->callback(b, b->interface, b->protocol, AVAHI_BROWSER_FAILURE, NULL, b->domain, 0, b->userdata);
+}
+
 AvahiServiceTypeBrowser* avahi_service_type_browser_new(
     AvahiClient *client,
     AvahiIfIndex interface,
@@ -359,17 +341,13 @@ AvahiServiceTypeBrowser* avahi_service_type_browser_new(
     void *userdata) {
 
     AvahiServiceTypeBrowser *b = NULL;
-    DBusMessage *message = NULL, *reply = NULL;
-    DBusError error;
-    char *path;
+    DBusMessage *message = NULL;
     int32_t i_interface, i_protocol;
     uint32_t u_flags;
 
     assert(client);
     assert(callback);
 
-    dbus_error_init(&error);
-
     if (!avahi_client_is_connected(client)) {
         avahi_client_set_errno(client, AVAHI_ERR_BAD_STATE);
         goto fail;
@@ -419,48 +397,21 @@ AvahiServiceTypeBrowser* avahi_service_type_browser_new(
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block (client->bus, message, -1, &error)) ||
-        dbus_error_is_set(&error)) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
-
-    if (!dbus_message_get_args (reply, &error, DBUS_TYPE_OBJECT_PATH, &path, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set(&error) ||
-        !path) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
-
-    if (!(b->path = avahi_strdup(path))) {
-
-        /* FIXME: We don't remove the object on the server side */
-
-        avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+    if (avahi_client_create_object(client, message, b, &b->path, AVAHI_DBUS_INTERFACE_SERVICE_TYPE_BROWSER, service_type_browser_created) < 0)
         goto fail;
-    }
 
     dbus_message_unref(message);
-    dbus_message_unref(reply);
 
     return b;
 
 fail:
 
-    if (dbus_error_is_set(&error)) {
-        avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
-    }
-
     if (b)
         avahi_service_type_browser_free(b);
 
     if (message)
         dbus_message_unref(message);
 
-    if (reply)
-        dbus_message_unref(reply);
-
     return NULL;
 }
 
@@ -476,8 +427,7 @@ int avahi_service_type_browser_free (AvahiServiceTypeBrowser *b) {
     assert(b);
     client = b->client;
 
-    if (b->path && avahi_client_is_connected(b->client))
-        r = avahi_client_simple_method_call(client, b->path, AVAHI_DBUS_INTERFACE_SERVICE_TYPE_BROWSER, "Free");
+    r = avahi_client_free_object(client, b, b->path, AVAHI_DBUS_INTERFACE_SERVICE_TYPE_BROWSER);
 
     AVAHI_LLIST_REMOVE(AvahiServiceTypeBrowser, service_type_browsers, b->client->service_type_browsers, b);
 
@@ -503,11 +453,7 @@ DBusHandlerResult avahi_service_type_browser_event (AvahiClient *client, AvahiBr
     if (!(path = dbus_message_get_path(message)))
         goto fail;
 
-    for (b = client->service_type_browsers; b; b = b->service_type_browsers_next)
-        if (strcmp (b->path, path) == 0)
-            break;
-
-    if (!b)
+    if (!(b = avahi_client_find_object(client, path, AVAHI_DBUS_INTERFACE_SERVICE_TYPE_BROWSER)))
         goto fail;
 
     domain = b->domain;
@@ -563,6 +509,38 @@ fail:
 
 /* AvahiServiceBrowser */
 
+static void enable_batching(AvahiServiceBrowser *b) {
+    DBusMessage *message;
+
+    assert(b);
+    assert(b->path);
+
+    if (b->client->api_version < AVAHI_CLIENT_DBUS_API_BATCHING)
+        return;
+
+    /* Ask the server to collect events in ItemsChanged signals. The
+     * server starts browsing only after a short delay, hence there's
+     * no need to wait for the reply. If this fails we simply get the
+     * events one by one. */
+
+    if ((message = dbus_message_new_method_call(AVAHI_DBUS_NAME, b->path, AVAHI_DBUS_INTERFACE_SERVICE_BROWSER, "EnableBatching"))) {
+        dbus_message_set_no_reply(message, TRUE);
+        dbus_connection_send(b->client->bus, message, NULL);
+        dbus_message_unref(message);
+    }
+}
+
+static void service_browser_created(void *object, int error) {
+    AvahiServiceBrowser *b = object;
+
+    assert(b);
+
+    if (error < 0)
+        b->callback(b, b->interface, b->protocol, AVAHI_BROWSER_FAILURE, NULL, b->type, b->domain, 0, b->userdata);
+    else
+        enable_batching(b);
+}
+
 AvahiServiceBrowser* avahi_service_browser_new(
     AvahiClient *client,
     AvahiIfIndex interface,
@@ -574,9 +552,7 @@ AvahiServiceBrowser* avahi_service_browser_new(
     void *userdata) {
 
     AvahiServiceBrowser *b = NULL;
-    DBusMessage *message = NULL, *reply = NULL;
-    DBusError error;
-    char *path;
+    DBusMessage *message = NULL;
     int32_t i_protocol, i_interface;
     uint32_t u_flags;
 
@@ -584,8 +560,6 @@ AvahiServiceBrowser* avahi_service_browser_new(
     assert(type);
     assert(callback);
 
-    dbus_error_init(&error);
-
     if (!avahi_client_is_connected(client)) {
         avahi_client_set_errno(client, AVAHI_ERR_BAD_STATE);
         goto fail;
@@ -641,47 +615,24 @@ AvahiServiceBrowser* avahi_service_browser_new(
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block (client->bus, message, -1, &error)) ||
-        dbus_error_is_set(&error)) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
-
-    if (!dbus_message_get_args (reply, &error, DBUS_TYPE_OBJECT_PATH, &path, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set(&error) ||
-        !path) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
-
-    if (!(b->path = avahi_strdup(path))) {
-
-        /* FIXME: We don't remove the object on the server side */
-
-        avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+    if (avahi_client_create_object(client, message, b, &b->path, AVAHI_DBUS_INTERFACE_SERVICE_BROWSER, service_browser_created) < 0)
         goto fail;
-    }
 
     dbus_message_unref(message);
-    dbus_message_unref(reply);
+
+    /* Otherwise this is done once the server object exists */
+    if (b->path)
+        enable_batching(b);
 
     return b;
 
 fail:
-    if (dbus_error_is_set(&error)) {
-        avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
-    }
-
     if (b)
         avahi_service_browser_free(b);
 
     if (message)
         dbus_message_unref(message);
 
-    if (reply)
-        dbus_message_unref(reply);
-
     return NULL;
 }
 
@@ -697,8 +648,7 @@ int avahi_service_browser_free (AvahiServiceBrowser *b) {
     assert(b);
     client = b->client;
 
-    if (b->path && avahi_client_is_connected(b->client))
-        r = avahi_client_simple_method_call(client, b->path, AVAHI_DBUS_INTERFACE_SERVICE_BROWSER, "Free");
+    r = avahi_client_free_object(client, b, b->path, AVAHI_DBUS_INTERFACE_SERVICE_BROWSER);
 
     AVAHI_LLIST_REMOVE(AvahiServiceBrowser, service_browsers, b->client->service_browsers, b);
 
@@ -709,6 +659,13 @@ int avahi_service_browser_free (AvahiServiceBrowser *b) {
     return r;
 }
 
+static AvahiServiceBrowser *find_service_browser(AvahiClient *client, const char *path) {
+    assert(client);
+    assert(path);
+
+    return avahi_client_find_object(client, path, AVAHI_DBUS_INTERFACE_SERVICE_BROWSER);
+}
+
 DBusHandlerResult avahi_service_browser_event(AvahiClient *client, AvahiBrowserEvent event, DBusMessage *message) {
     AvahiServiceBrowser *b = NULL;
     DBusError error;
@@ -722,11 +679,7 @@ DBusHandlerResult avahi_service_browser_event(AvahiClient *client, AvahiBrowserE
     if (!(path = dbus_message_get_path(message)))
         goto fail;
 
-    for (b = client->service_browsers; b; b = b->service_browsers_next)
-        if (strcmp (b->path, path) == 0)
-            break;
-
-    if (!b)
+    if (!(b = find_service_browser(client, path)))
         goto fail;
 
     type = b->type;
@@ -774,6 +727,9 @@ DBusHandlerResult avahi_service_browser_event(AvahiClient *client, AvahiBrowserE
         }
     }
 
+    if (event == AVAHI_BROWSER_REMOVE && client->cache)
+        avahi_client_cache_remove_service(client->cache, (AvahiIfIndex) interface, (AvahiProtocol) protocol, name, type, domain);
+
     b->callback(b, (AvahiIfIndex) interface, (AvahiProtocol) protocol, event, name, type, domain, (AvahiLookupResultFlags) flags, b->userdata);
 
     return DBUS_HANDLER_RESULT_HANDLED;
@@ -783,8 +739,192 @@ fail:
     return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
+int avahi_service_browser_snapshot(
+    AvahiClient *client,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *type,
+    const char *domain,
+    AvahiLookupFlags flags,
+    int refresh,
+    AvahiServiceSnapshotCallback callback,
+    void *userdata) {
+
+    DBusMessage *message = NULL, *reply = NULL;
+    DBusMessageIter iter, sub;
+    DBusError error;
+    int32_t i_interface, i_protocol;
+    uint32_t u_flags;
+    dbus_bool_t b_refresh;
+    int n = 0;
+
+    assert(client);
+    assert(type);
+    assert(callback);
+
+    dbus_error_init(&error);
+
+    if (!avahi_client_is_connected(client))
+        return avahi_client_set_errno(client, AVAHI_ERR_BAD_STATE);
+
+    if (client->api_version < AVAHI_CLIENT_DBUS_API_SNAPSHOT)
+        return avahi_client_set_errno(client, AVAHI_ERR_NOT_SUPPORTED);
+
+    if (!domain)
+        domain = "";
+
+    if (!(message = dbus_message_new_method_call(AVAHI_DBUS_NAME, AVAHI_DBUS_PATH_SERVER, AVAHI_DBUS_INTERFACE_SERVER2, "GetServices"))) {
+        avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+        goto fail;
+    }
+
+    i_interface = (int32_t) interface;
+    i_protocol = (int32_t) protocol;
+    u_flags = (uint32_t) flags;
+    b_refresh = !!refresh;
+
+    if (!dbus_message_append_args(
+            message,
+            DBUS_TYPE_INT32, &i_interface,
+            DBUS_TYPE_INT32, &i_protocol,
+            DBUS_TYPE_STRING, &type,
+            DBUS_TYPE_STRING, &domain,
+            DBUS_TYPE_UINT32, &u_flags,
+            DBUS_TYPE_BOOLEAN, &b_refresh,
+            DBUS_TYPE_INVALID)) {
+        avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+        goto fail;
+    }
+
+    if (!(reply = avahi_client_send_with_reply_and_block(client, message, &error)) ||
+        dbus_error_is_set(&error)) {
+        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+        goto fail;
+    }
+
+    if (!dbus_message_iter_init(reply, &iter) ||
+        dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY ||
+        dbus_message_iter_get_element_type(&iter) != DBUS_TYPE_STRUCT) {
+        avahi_client_set_errno(client, AVAHI_ERR_INVALID_OBJECT);
+        goto fail;
+    }
+
+    dbus_message_iter_recurse(&iter, &sub);
+
+    while (dbus_message_iter_get_arg_type(&sub) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter item;
+        char *name, *t, *d;
+
+        dbus_message_iter_recurse(&sub, &item);
+
+        if (avahi_client_iter_get_basic(&item, DBUS_TYPE_INT32, &i_interface) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_INT32, &i_protocol) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_STRING, &name) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_STRING, &t) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_STRING, &d) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_UINT32, &u_flags) < 0) {
+            avahi_client_set_errno(client, AVAHI_ERR_INVALID_OBJECT);
+            goto fail;
+        }
+
+        callback(client, (AvahiIfIndex) i_interface, (AvahiProtocol) i_protocol, name, t, d, (AvahiLookupResultFlags) u_flags, userdata);
+        n++;
+
+        dbus_message_iter_next(&sub);
+    }
+
+    dbus_message_unref(message);
+    dbus_message_unref(reply);
+
+    return n;
+
+fail:
+    if (dbus_error_is_set(&error)) {
+        avahi_client_set_dbus_error(client, &error);
+        dbus_error_free(&error);
+    }
+
+    if (message)
+        dbus_message_unref(message);
+
+    if (reply)
+        dbus_message_unref(reply);
+
+    return avahi_client_errno(client);
+}
+
+DBusHandlerResult avahi_service_browser_event_batch(AvahiClient *client, DBusMessage *message) {
+    DBusMessageIter iter, sub;
+    const char *path;
+
+    assert(client);
+    assert(message);
+
+    if (!(path = dbus_message_get_path(message)))
+        goto fail;
+
+    if (!find_service_browser(client, path))
+        goto fail;
+
+    if (!dbus_message_iter_init(message, &iter) ||
+        dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY ||
+        dbus_message_iter_get_element_type(&iter) != DBUS_TYPE_STRUCT) {
+        fprintf(stderr, "Failed to parse browser event.\n");
+        goto fail;
+    }
+
+    dbus_message_iter_recurse(&iter, &sub);
+
+    while (dbus_message_iter_get_arg_type(&sub) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter item;
+        AvahiServiceBrowser *b;
+        int32_t event, interface, protocol;
+        char *name, *type, *domain;
+        uint32_t flags;
+
+        dbus_message_iter_recurse(&sub, &item);
+
+        if (avahi_client_iter_get_basic(&item, DBUS_TYPE_INT32, &event) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_INT32, &interface) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_INT32, &protocol) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_STRING, &name) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_STRING, &type) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_STRING, &domain) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_UINT32, &flags) < 0 ||
+            (event != AVAHI_BROWSER_NEW && event != AVAHI_BROWSER_REMOVE)) {
+            fprintf(stderr, "Failed to parse browser event.\n");
+            break;
+        }
+
+        /* The previous callback might have freed the browser */
+        if (!(b = find_service_browser(client, path)))
+            break;
+
+        if (event == AVAHI_BROWSER_REMOVE && client->cache)
+            avahi_client_cache_remove_service(client->cache, (AvahiIfIndex) interface, (AvahiProtocol) protocol, name, type, domain);
+
+        b->callback(b, (AvahiIfIndex) interface, (AvahiProtocol) protocol, (AvahiBrowserEvent) event, name, type, domain, (AvahiLookupResultFlags) flags, b->userdata);
+
+        dbus_message_iter_next(&sub);
+    }
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+
+fail:
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
 /* AvahiRecordBrowser */
 
+static void record_browser_created(void *object, int error) {
+    AvahiRecordBrowser *b = object;
+
+    assert(b);
+
+    if (error < 0)
+        b->callback(b, b->interface, b->protocol, AVAHI_BROWSER_FAILURE, b->name, b->clazz, b->type, NULL, 0, 0, b->userdata);
+}
+
 AvahiRecordBrowser* avahi_record_browser_new(
     AvahiClient *client,
     AvahiIfIndex interface,
@@ -797,9 +937,7 @@ AvahiRecordBrowser* avahi_record_browser_new(
     void *userdata) {
 
     AvahiRecordBrowser *b = NULL;
-    DBusMessage *message = NULL, *reply = NULL;
-    DBusError error;
-    char *path;
+    DBusMessage *message = NULL;
     int32_t i_protocol, i_interface;
     uint32_t u_flags;
 
@@ -807,8 +945,6 @@ AvahiRecordBrowser* avahi_record_browser_new(
     assert(name);
     assert(callback);
 
-    dbus_error_init(&error);
-
     if (!avahi_client_is_connected(client)) {
         avahi_client_set_errno(client, AVAHI_ERR_BAD_STATE);
         goto fail;
@@ -858,47 +994,20 @@ AvahiRecordBrowser* avahi_record_browser_new(
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block (client->bus, message, -1, &error)) ||
-        dbus_error_is_set(&error)) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
-
-    if (!dbus_message_get_args (reply, &error, DBUS_TYPE_OBJECT_PATH, &path, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set(&error) ||
-        !path) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+    if (avahi_client_create_object(client, message, b, &b->path, AVAHI_DBUS_INTERFACE_RECORD_BROWSER, record_browser_created) < 0)
         goto fail;
-    }
-
-    if (!(b->path = avahi_strdup(path))) {
-
-        /* FIXME: We don't remove the object on the server side */
-
-        avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
-        goto fail;
-    }
 
     dbus_message_unref(message);
-    dbus_message_unref(reply);
 
     return b;
 
 fail:
-    if (dbus_error_is_set(&error)) {
-        avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
-    }
-
     if (b)
         avahi_record_browser_free(b);
 
     if (message)
         dbus_message_unref(message);
 
-    if (reply)
-        dbus_message_unref(reply);
-
     return NULL;
 }
 
@@ -914,8 +1023,7 @@ int avahi_record_browser_free (AvahiRecordBrowser *b) {
     assert(b);
     client = b->client;
 
-    if (b->path && avahi_client_is_connected(b->client))
-        r = avahi_client_simple_method_call(client, b->path, AVAHI_DBUS_INTERFACE_RECORD_BROWSER, "Free");
+    r = avahi_client_free_object(client, b, b->path, AVAHI_DBUS_INTERFACE_RECORD_BROWSER);
 
     AVAHI_LLIST_REMOVE(AvahiRecordBrowser, record_browsers, b->client->record_browsers, b);
 
@@ -941,11 +1049,7 @@ DBusHandlerResult avahi_record_browser_event(AvahiClient *client, AvahiBrowserEv
     if (!(path = dbus_message_get_path(message)))
         goto fail;
 
-    for (b = client->record_browsers; b; b = b->record_browsers_next)
-        if (strcmp (b->path, path) == 0)
-            break;
-
-    if (!b)
+    if (!(b = avahi_client_find_object(client, path, AVAHI_DBUS_INTERFACE_RECORD_BROWSER)))
         goto fail;
 
     interface = b->interface;
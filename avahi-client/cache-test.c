@@ -0,0 +1,146 @@
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include <avahi-common/gccmacro.h>
+#include <avahi-common/malloc.h>
+
+#include "cache.h"
+
+static void make_service(AvahiCachedService *s, const char *name, const char *host_name, uint16_t port) {
+    memset(s, 0, sizeof(*s));
+
+    s->interface = 2;
+    s->protocol = AVAHI_PROTO_INET;
+    s->name = (char*) name;
+    s->type = (char*) "_ipp._tcp";
+    s->domain = (char*) "local";
+    s->host_name = (char*) host_name;
+    s->has_address = !!avahi_address_parse("192.168.50.1", AVAHI_PROTO_INET, &s->address);
+    s->port = port;
+    s->txt = avahi_string_list_new("rp=printers/a", NULL);
+}
+
+int main(AVAHI_GCC_UNUSED int argc, AVAHI_GCC_UNUSED char *argv[]) {
+    AvahiClientCache *c;
+    AvahiCachedService s;
+    AvahiCachedHostName h;
+    const AvahiCachedService *fs;
+    const AvahiCachedHostName *fh;
+    char t[32];
+    int i;
+
+    c = avahi_client_cache_new(AVAHI_CLIENT_CACHE_TTL_MSEC);
+    assert(c);
+
+    assert(!avahi_client_cache_find_service(c, -1, -1, "Printer A", "_ipp._tcp", NULL, -1, 0));
+
+    make_service(&s, "Printer A", "a.local", 631);
+    avahi_client_cache_add_service(c, -1, -1, "Printer A", "_ipp._tcp", NULL, -1, 0, &s);
+    avahi_string_list_free(s.txt);
+
+    /* A NULL domain is the same as "" */
+    fs = avahi_client_cache_find_service(c, -1, -1, "Printer A", "_ipp._tcp", "", -1, 0);
+    assert(fs);
+    assert(fs->port == 631);
+    assert(fs->interface == 2);
+    assert(strcmp(fs->host_name, "a.local") == 0);
+    assert(avahi_string_list_find(fs->txt, "rp"));
+
+    /* Other arguments are other lookups */
+    assert(!avahi_client_cache_find_service(c, 2, -1, "Printer A", "_ipp._tcp", NULL, -1, 0));
+    assert(!avahi_client_cache_find_service(c, -1, -1, "Printer A", "_ipp._tcp", NULL, -1, AVAHI_LOOKUP_NO_TXT));
+
+    /* Newer results replace older ones */
+    make_service(&s, "Printer A", "a.local", 632);
+    avahi_client_cache_add_service(c, -1, -1, "Printer A", "_ipp._tcp", NULL, -1, 0, &s);
+    avahi_string_list_free(s.txt);
+    fs = avahi_client_cache_find_service(c, -1, -1, "Printer A", "_ipp._tcp", NULL, -1, 0);
+    assert(fs && fs->port == 632);
+
+    make_service(&s, "Printer B", "b.local", 631);
+    avahi_client_cache_add_service(c, -1, -1, "Printer B", "_ipp._tcp", NULL, -1, 0, &s);
+    avahi_string_list_free(s.txt);
+
+    memset(&h, 0, sizeof(h));
+    h.interface = 2;
+    h.protocol = AVAHI_PROTO_INET;
+    h.name = (char*) "a.local";
+    avahi_address_parse("192.168.50.1", AVAHI_PROTO_INET, &h.address);
+    avahi_client_cache_add_host_name(c, -1, -1, "a.local", -1, 0, &h);
+    h.name = (char*) "b.local";
+    avahi_client_cache_add_host_name(c, -1, -1, "b.local", -1, 0, &h);
+
+    fh = avahi_client_cache_find_host_name(c, -1, -1, "a.local", -1, 0);
+    assert(fh && strcmp(fh->name, "a.local") == 0);
+
+    /* Removals only match the interface and protocol it was found on,
+     * names are compared like DNS does */
+    avahi_client_cache_remove_service(c, 3, AVAHI_PROTO_INET, "Printer A", "_ipp._tcp", "local");
+    assert(avahi_client_cache_find_service(c, -1, -1, "Printer A", "_ipp._tcp", NULL, -1, 0));
+
+    avahi_client_cache_remove_service(c, 2, AVAHI_PROTO_INET, "printer a", "_IPP._tcp", "local.");
+    assert(!avahi_client_cache_find_service(c, -1, -1, "Printer A", "_ipp._tcp", NULL, -1, 0));
+    assert(!avahi_client_cache_find_host_name(c, -1, -1, "a.local", -1, 0));
+
+    assert(avahi_client_cache_find_service(c, -1, -1, "Printer B", "_ipp._tcp", NULL, -1, 0));
+    assert(avahi_client_cache_find_host_name(c, -1, -1, "b.local", -1, 0));
+
+    /* Only so many entries are kept, the oldest go first */
+    for (i = 0; i < AVAHI_CLIENT_CACHE_ENTRIES_MAX; i++) {
+        snprintf(t, sizeof(t), "Printer %i", i);
+        make_service(&s, t, "c.local", 631);
+        avahi_client_cache_add_service(c, -1, -1, t, "_ipp._tcp", NULL, -1, 0, &s);
+        avahi_string_list_free(s.txt);
+    }
+
+    assert(!avahi_client_cache_find_service(c, -1, -1, "Printer B", "_ipp._tcp", NULL, -1, 0));
+    assert(avahi_client_cache_find_service(c, -1, -1, "Printer 0", "_ipp._tcp", NULL, -1, 0));
+
+    avahi_client_cache_flush(c);
+    assert(!avahi_client_cache_find_service(c, -1, -1, "Printer 0", "_ipp._tcp", NULL, -1, 0));
+    assert(!avahi_client_cache_find_host_name(c, -1, -1, "b.local", -1, 0));
+
+    avahi_client_cache_free(c);
+
+    /* Results expire */
+    c = avahi_client_cache_new(10);
+    assert(c);
+
+    make_service(&s, "Printer A", "a.local", 631);
+    avahi_client_cache_add_service(c, -1, -1, "Printer A", "_ipp._tcp", NULL, -1, 0, &s);
+    avahi_string_list_free(s.txt);
+    assert(avahi_client_cache_find_service(c, -1, -1, "Printer A", "_ipp._tcp", NULL, -1, 0));
+
+    usleep(20000);
+    assert(!avahi_client_cache_find_service(c, -1, -1, "Printer A", "_ipp._tcp", NULL, -1, 0));
+
+    avahi_client_cache_free(c);
+
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,467 @@
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <assert.h>
+#include <sys/time.h>
+
+#include <avahi-common/llist.h>
+#include <avahi-common/malloc.h>
+#include <avahi-common/domain.h>
+#include <avahi-common/timeval.h>
+
+#include "cache.h"
+
+typedef struct ServiceEntry ServiceEntry;
+typedef struct HostNameEntry HostNameEntry;
+
+struct ServiceEntry {
+    /* The lookup, name and domain are "" if not specified */
+    AvahiIfIndex interface;
+    AvahiProtocol protocol;
+    char *name, *type, *domain;
+    AvahiProtocol aprotocol;
+    AvahiLookupFlags flags;
+
+    AvahiCachedService result;
+
+    /* Of the result, for matching removals */
+    char service_name[AVAHI_DOMAIN_NAME_MAX];
+
+    struct timeval expiry;
+    AVAHI_LLIST_FIELDS(ServiceEntry, entries);
+};
+
+struct HostNameEntry {
+    AvahiIfIndex interface;
+    AvahiProtocol protocol;
+    char *name;
+    AvahiProtocol aprotocol;
+    AvahiLookupFlags flags;
+
+    AvahiCachedHostName result;
+
+    struct timeval expiry;
+    AVAHI_LLIST_FIELDS(HostNameEntry, entries);
+};
+
+struct AvahiClientCache {
+    unsigned ttl_msec;
+
+    /* Newest first */
+    AVAHI_LLIST_HEAD(ServiceEntry, services);
+    AVAHI_LLIST_HEAD(HostNameEntry, host_names);
+    unsigned n_services, n_host_names;
+};
+
+static void service_entry_free(AvahiClientCache *c, ServiceEntry *e) {
+    assert(c);
+    assert(e);
+
+    AVAHI_LLIST_REMOVE(ServiceEntry, entries, c->services, e);
+    assert(c->n_services > 0);
+    c->n_services--;
+
+    avahi_free(e->name);
+    avahi_free(e->type);
+    avahi_free(e->domain);
+    avahi_free(e->result.name);
+    avahi_free(e->result.type);
+    avahi_free(e->result.domain);
+    avahi_free(e->result.host_name);
+    avahi_string_list_free(e->result.txt);
+    avahi_free(e);
+}
+
+static void host_name_entry_free(AvahiClientCache *c, HostNameEntry *e) {
+    assert(c);
+    assert(e);
+
+    AVAHI_LLIST_REMOVE(HostNameEntry, entries, c->host_names, e);
+    assert(c->n_host_names > 0);
+    c->n_host_names--;
+
+    avahi_free(e->name);
+    avahi_free(e->result.name);
+    avahi_free(e);
+}
+
+AvahiCachedService *avahi_cached_service_copy(const AvahiCachedService *s) {
+    AvahiCachedService *c;
+
+    assert(s);
+
+    if (!(c = avahi_new(AvahiCachedService, 1)))
+        return NULL;
+
+    *c = *s;
+    c->type = c->domain = c->host_name = NULL;
+    c->txt = NULL;
+
+    if (!(c->name = avahi_strdup(s->name)) ||
+        !(c->type = avahi_strdup(s->type)) ||
+        !(c->domain = avahi_strdup(s->domain)) ||
+        !(c->host_name = avahi_strdup(s->host_name)) ||
+        (s->txt && !(c->txt = avahi_string_list_copy(s->txt)))) {
+        avahi_cached_service_free(c);
+        return NULL;
+    }
+
+    return c;
+}
+
+void avahi_cached_service_free(AvahiCachedService *s) {
+    assert(s);
+
+    avahi_free(s->name);
+    avahi_free(s->type);
+    avahi_free(s->domain);
+    avahi_free(s->host_name);
+    avahi_string_list_free(s->txt);
+    avahi_free(s);
+}
+
+AvahiCachedHostName *avahi_cached_host_name_copy(const AvahiCachedHostName *h) {
+    AvahiCachedHostName *c;
+
+    assert(h);
+
+    if (!(c = avahi_new(AvahiCachedHostName, 1)))
+        return NULL;
+
+    *c = *h;
+
+    if (!(c->name = avahi_strdup(h->name))) {
+        avahi_free(c);
+        return NULL;
+    }
+
+    return c;
+}
+
+void avahi_cached_host_name_free(AvahiCachedHostName *h) {
+    assert(h);
+
+    avahi_free(h->name);
+    avahi_free(h);
+}
+
+AvahiClientCache *avahi_client_cache_new(unsigned ttl_msec) {
+    AvahiClientCache *c;
+
+    if (!(c = avahi_new(AvahiClientCache, 1)))
+        return NULL;
+
+    c->ttl_msec = ttl_msec;
+    AVAHI_LLIST_HEAD_INIT(ServiceEntry, c->services);
+    AVAHI_LLIST_HEAD_INIT(HostNameEntry, c->host_names);
+    c->n_services = c->n_host_names = 0;
+
+    return c;
+}
+
+void avahi_client_cache_free(AvahiClientCache *c) {
+    assert(c);
+
+    avahi_client_cache_flush(c);
+    avahi_free(c);
+}
+
+void avahi_client_cache_flush(AvahiClientCache *c) {
+    assert(c);
+
+    while (c->services)
+        service_entry_free(c, c->services);
+
+    while (c->host_names)
+        host_name_entry_free(c, c->host_names);
+}
+
+static int service_entry_is(
+    ServiceEntry *e,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name,
+    const char *type,
+    const char *domain,
+    AvahiProtocol aprotocol,
+    AvahiLookupFlags flags) {
+
+    return
+        e->interface == interface &&
+        e->protocol == protocol &&
+        e->aprotocol == aprotocol &&
+        e->flags == flags &&
+        strcmp(e->name, name) == 0 &&
+        strcmp(e->type, type) == 0 &&
+        strcmp(e->domain, domain) == 0;
+}
+
+static int host_name_entry_is(
+    HostNameEntry *e,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name,
+    AvahiProtocol aprotocol,
+    AvahiLookupFlags flags) {
+
+    return
+        e->interface == interface &&
+        e->protocol == protocol &&
+        e->aprotocol == aprotocol &&
+        e->flags == flags &&
+        strcmp(e->name, name) == 0;
+}
+
+static int expired(const struct timeval *expiry) {
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return avahi_timeval_compare(expiry, &now) <= 0;
+}
+
+const AvahiCachedService *avahi_client_cache_find_service(
+    AvahiClientCache *c,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name,
+    const char *type,
+    const char *domain,
+    AvahiProtocol aprotocol,
+    AvahiLookupFlags flags) {
+
+    ServiceEntry *e;
+
+    assert(c);
+    assert(type);
+
+    if (!name)
+        name = "";
+
+    if (!domain)
+        domain = "";
+
+    for (e = c->services; e; e = e->entries_next)
+        if (service_entry_is(e, interface, protocol, name, type, domain, aprotocol, flags)) {
+
+            if (expired(&e->expiry)) {
+                service_entry_free(c, e);
+                return NULL;
+            }
+
+            return &e->result;
+        }
+
+    return NULL;
+}
+
+void avahi_client_cache_add_service(
+    AvahiClientCache *c,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name,
+    const char *type,
+    const char *domain,
+    AvahiProtocol aprotocol,
+    AvahiLookupFlags flags,
+    const AvahiCachedService *result) {
+
+    ServiceEntry *e, *old;
+
+    assert(c);
+    assert(type);
+    assert(result);
+    assert(result->name);
+    assert(result->type);
+    assert(result->domain);
+    assert(result->host_name);
+
+    if (!name)
+        name = "";
+
+    if (!domain)
+        domain = "";
+
+    if (!(e = avahi_new0(ServiceEntry, 1)))
+        return;
+
+    AVAHI_LLIST_PREPEND(ServiceEntry, entries, c->services, e);
+    c->n_services++;
+
+    e->interface = interface;
+    e->protocol = protocol;
+    e->aprotocol = aprotocol;
+    e->flags = flags;
+    e->result = *result;
+    e->result.name = e->result.type = e->result.domain = e->result.host_name = NULL;
+    e->result.txt = NULL;
+
+    if (!(e->name = avahi_strdup(name)) ||
+        !(e->type = avahi_strdup(type)) ||
+        !(e->domain = avahi_strdup(domain)) ||
+        !(e->result.name = avahi_strdup(result->name)) ||
+        !(e->result.type = avahi_strdup(result->type)) ||
+        !(e->result.domain = avahi_strdup(result->domain)) ||
+        !(e->result.host_name = avahi_strdup(result->host_name)) ||
+        (result->txt && !(e->result.txt = avahi_string_list_copy(result->txt))) ||
+        avahi_service_name_join(e->service_name, sizeof(e->service_name), result->name, result->type, result->domain) < 0) {
+        service_entry_free(c, e);
+        return;
+    }
+
+    avahi_elapse_time(&e->expiry, c->ttl_msec, 0);
+
+    /* Replace the previous result of the same lookup */
+    for (old = e->entries_next; old; old = old->entries_next)
+        if (service_entry_is(old, interface, protocol, name, type, domain, aprotocol, flags)) {
+            service_entry_free(c, old);
+            break;
+        }
+
+    if (c->n_services > AVAHI_CLIENT_CACHE_ENTRIES_MAX) {
+        for (old = e; old->entries_next; old = old->entries_next)
+            ;
+
+        service_entry_free(c, old);
+    }
+}
+
+void avahi_client_cache_remove_service(
+    AvahiClientCache *c,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name,
+    const char *type,
+    const char *domain) {
+
+    char sn[AVAHI_DOMAIN_NAME_MAX];
+    ServiceEntry *e, *next;
+
+    assert(c);
+    assert(name);
+    assert(type);
+    assert(domain);
+
+    if (avahi_service_name_join(sn, sizeof(sn), name, type, domain) < 0)
+        return;
+
+    for (e = c->services; e; e = next) {
+        HostNameEntry *h, *hnext;
+
+        next = e->entries_next;
+
+        if (e->result.interface != interface ||
+            e->result.protocol != protocol ||
+            !avahi_domain_equal(e->service_name, sn))
+            continue;
+
+        /* The host is likely to have gone as well, and the other
+         * services on it will have their own removals */
+        for (h = c->host_names; h; h = hnext) {
+            hnext = h->entries_next;
+
+            if (avahi_domain_equal(h->result.name, e->result.host_name))
+                host_name_entry_free(c, h);
+        }
+
+        service_entry_free(c, e);
+    }
+}
+
+const AvahiCachedHostName *avahi_client_cache_find_host_name(
+    AvahiClientCache *c,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name,
+    AvahiProtocol aprotocol,
+    AvahiLookupFlags flags) {
+
+    HostNameEntry *e;
+
+    assert(c);
+    assert(name);
+
+    for (e = c->host_names; e; e = e->entries_next)
+        if (host_name_entry_is(e, interface, protocol, name, aprotocol, flags)) {
+
+            if (expired(&e->expiry)) {
+                host_name_entry_free(c, e);
+                return NULL;
+            }
+
+            return &e->result;
+        }
+
+    return NULL;
+}
+
+void avahi_client_cache_add_host_name(
+    AvahiClientCache *c,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name,
+    AvahiProtocol aprotocol,
+    AvahiLookupFlags flags,
+    const AvahiCachedHostName *result) {
+
+    HostNameEntry *e, *old;
+
+    assert(c);
+    assert(name);
+    assert(result);
+    assert(result->name);
+
+    if (!(e = avahi_new0(HostNameEntry, 1)))
+        return;
+
+    AVAHI_LLIST_PREPEND(HostNameEntry, entries, c->host_names, e);
+    c->n_host_names++;
+
+    e->interface = interface;
+    e->protocol = protocol;
+    e->aprotocol = aprotocol;
+    e->flags = flags;
+    e->result = *result;
+    e->result.name = NULL;
+
+    if (!(e->name = avahi_strdup(name)) ||
+        !(e->result.name = avahi_strdup(result->name))) {
+        host_name_entry_free(c, e);
+        return;
+    }
+
+    avahi_elapse_time(&e->expiry, c->ttl_msec, 0);
+
+    for (old = e->entries_next; old; old = old->entries_next)
+        if (host_name_entry_is(old, interface, protocol, name, aprotocol, flags)) {
+            host_name_entry_free(c, old);
+            break;
+        }
+
+    if (c->n_host_names > AVAHI_CLIENT_CACHE_ENTRIES_MAX) {
+        for (old = e; old->entries_next; old = old->entries_next)
+            ;
+
+        host_name_entry_free(c, old);
+    }
+}
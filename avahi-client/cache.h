@@ -0,0 +1,127 @@
+#ifndef fooclientcachehfoo
+#define fooclientcachehfoo
+
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <avahi-common/address.h>
+#include <avahi-common/strlst.h>
+#include <avahi-common/defs.h>
+
+/* Results of service and host name resolvers, used by clients created
+ * with AVAHI_CLIENT_CACHE_RESULTS. Lookups are keyed by the arguments
+ * the resolver was created with, entries expire after a fixed time
+ * and are dropped earlier when a service browser reports the service
+ * as removed. */
+
+/* As long as the address records of a host live in the daemon's
+ * cache by default */
+#define AVAHI_CLIENT_CACHE_TTL_MSEC (120*1000)
+
+/* Oldest entries are dropped first once there are more of a kind */
+#define AVAHI_CLIENT_CACHE_ENTRIES_MAX 256
+
+typedef struct AvahiClientCache AvahiClientCache;
+
+typedef struct AvahiCachedService {
+    AvahiIfIndex interface;
+    AvahiProtocol protocol;
+    char *name, *type, *domain, *host_name;
+    AvahiAddress address;
+    int has_address;
+    uint16_t port;
+    AvahiStringList *txt;
+    AvahiLookupResultFlags flags;
+} AvahiCachedService;
+
+typedef struct AvahiCachedHostName {
+    AvahiIfIndex interface;
+    AvahiProtocol protocol;
+    char *name;
+    AvahiAddress address;
+    AvahiLookupResultFlags flags;
+} AvahiCachedHostName;
+
+/* Results found in the cache point into it, callers that can't tell
+ * what happens to the cache while they use the result need a copy */
+AvahiCachedService *avahi_cached_service_copy(const AvahiCachedService *s);
+void avahi_cached_service_free(AvahiCachedService *s);
+AvahiCachedHostName *avahi_cached_host_name_copy(const AvahiCachedHostName *h);
+void avahi_cached_host_name_free(AvahiCachedHostName *h);
+
+AvahiClientCache *avahi_client_cache_new(unsigned ttl_msec);
+void avahi_client_cache_free(AvahiClientCache *c);
+
+/* Drop everything */
+void avahi_client_cache_flush(AvahiClientCache *c);
+
+/* name and domain may be NULL. The result is valid until the cache is
+ * modified, NULL if there's nothing or nothing recent enough. */
+const AvahiCachedService *avahi_client_cache_find_service(
+    AvahiClientCache *c,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name,
+    const char *type,
+    const char *domain,
+    AvahiProtocol aprotocol,
+    AvahiLookupFlags flags);
+
+/* Store what a resolver created with the arguments before result
+ * found, replacing an older result for the same lookup. Fails
+ * silently when out of memory. */
+void avahi_client_cache_add_service(
+    AvahiClientCache *c,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name,
+    const char *type,
+    const char *domain,
+    AvahiProtocol aprotocol,
+    AvahiLookupFlags flags,
+    const AvahiCachedService *result);
+
+/* A service browser reported a service as gone: drop all results for
+ * it, and those for its host */
+void avahi_client_cache_remove_service(
+    AvahiClientCache *c,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name,
+    const char *type,
+    const char *domain);
+
+const AvahiCachedHostName *avahi_client_cache_find_host_name(
+    AvahiClientCache *c,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name,
+    AvahiProtocol aprotocol,
+    AvahiLookupFlags flags);
+
+void avahi_client_cache_add_host_name(
+    AvahiClientCache *c,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name,
+    AvahiProtocol aprotocol,
+    AvahiLookupFlags flags,
+    const AvahiCachedHostName *result);
+
+#endif
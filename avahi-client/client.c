@@ -41,6 +41,17 @@
 #define AVAHI_CLIENT_DBUS_API_SUPPORTED ((uint32_t) 0x0201)
 
 static int init_server(AvahiClient *client, int *ret_error);
+static void call_free(AvahiClientCall *call);
+static void free_timeout_callback(AvahiTimeout *t, void *userdata);
+
+/* A thread waiting for a reply on a threaded client, see
+ * avahi_client_new_threaded(). While it waits, the client isn't freed,
+ * and neither is object when the client is. object is reset to NULL
+ * if it is freed by itself in the meantime. */
+struct AvahiClientWaiter {
+    void *object;
+    AVAHI_LLIST_FIELDS(AvahiClientWaiter, waiters);
+};
 
 int avahi_client_set_errno (AvahiClient *client, int error) {
     assert(client);
@@ -55,6 +66,131 @@ int avahi_client_set_dbus_error(AvahiClient *client, DBusError *error) {
     return avahi_client_set_errno(client, avahi_error_dbus_to_number(error->name));
 }
 
+static void waiter_add(AvahiClient *client, AvahiClientWaiter *w, void *object) {
+    assert(client);
+    assert(w);
+
+    w->object = object;
+    AVAHI_LLIST_PREPEND(AvahiClientWaiter, waiters, client->waiters, w);
+}
+
+static void waiter_remove(AvahiClient *client, AvahiClientWaiter *w) {
+    assert(client);
+    assert(w);
+
+    AVAHI_LLIST_REMOVE(AvahiClientWaiter, waiters, client->waiters, w);
+
+    /* Our caller may still look at the client until it lets go of
+     * the lock, so leave freeing it to the helper thread */
+    if (client->dead && !client->waiters) {
+        struct timeval tv = { 0, 0 };
+
+        client->poll_api->timeout_update(client->free_timeout, &tv);
+    }
+}
+
+static int is_waited_for(AvahiClient *client, void *object) {
+    AvahiClientWaiter *w;
+
+    assert(client);
+    assert(object);
+
+    for (w = client->waiters; w; w = w->waiters_next)
+        if (w->object == object)
+            return 1;
+
+    return 0;
+}
+
+static void wait_notify(AVAHI_GCC_UNUSED DBusPendingCall *pending, void *userdata) {
+    AvahiThreadedPoll *threaded_poll = userdata;
+
+    avahi_threaded_poll_signal(threaded_poll);
+}
+
+static DBusMessage* send_and_wait(AvahiClient *client, DBusMessage *message, void *object, DBusError *error) {
+    AvahiClientWaiter w;
+    DBusConnection *bus;
+    DBusPendingCall *pending;
+    DBusMessage *reply;
+
+    assert(client);
+    assert(message);
+    assert(error);
+
+    if (!client->threaded_poll)
+        return dbus_connection_send_with_reply_and_block(client->bus, message, -1, error);
+
+    if (!(bus = client->bus)) {
+        dbus_set_error_const(error, DBUS_ERROR_DISCONNECTED, "Connection is closed");
+        return NULL;
+    }
+
+    if (!dbus_connection_send_with_reply(bus, message, &pending, -1)) {
+        dbus_set_error_const(error, DBUS_ERROR_NO_MEMORY, "Out of memory");
+        return NULL;
+    }
+
+    if (!pending) {
+        dbus_set_error_const(error, DBUS_ERROR_DISCONNECTED, "Connection is closed");
+        return NULL;
+    }
+
+    if (!dbus_pending_call_set_notify(pending, wait_notify, client->threaded_poll, NULL)) {
+        dbus_pending_call_cancel(pending);
+        dbus_pending_call_unref(pending);
+        dbus_set_error_const(error, DBUS_ERROR_NO_MEMORY, "Out of memory");
+        return NULL;
+    }
+
+    /* The helper thread reads the reply while other threads may use
+     * the client. If there's no helper thread to wake us up, read it
+     * ourselves. The connection is closed when the client fails or is
+     * freed. */
+    waiter_add(client, &w, object);
+
+    while (!dbus_pending_call_get_completed(pending) && client->bus == bus)
+        if (avahi_threaded_poll_wait(client->threaded_poll) < 0)
+            dbus_pending_call_block(pending);
+
+    waiter_remove(client, &w);
+
+    if (!dbus_pending_call_get_completed(pending) ||
+        !(reply = dbus_pending_call_steal_reply(pending))) {
+        reply = NULL;
+        dbus_pending_call_cancel(pending);
+        dbus_set_error_const(error, DBUS_ERROR_DISCONNECTED, "Connection is closed");
+    } else if (object && !w.object) {
+        dbus_message_unref(reply);
+        reply = NULL;
+        dbus_set_error_const(error, AVAHI_DBUS_ERR_INVALID_OBJECT, "Object has been freed");
+    } else if (dbus_set_error_from_message(error, reply)) {
+        dbus_message_unref(reply);
+        reply = NULL;
+    }
+
+    dbus_pending_call_unref(pending);
+
+    return reply;
+}
+
+DBusMessage* avahi_client_send_with_reply_and_block(AvahiClient *client, DBusMessage *message, DBusError *error) {
+    return send_and_wait(client, message, NULL, error);
+}
+
+static void connection_close(AvahiClient *client) {
+    assert(client);
+    assert(client->bus);
+
+#ifdef HAVE_DBUS_CONNECTION_CLOSE
+    dbus_connection_close(client->bus);
+#else
+    dbus_connection_disconnect(client->bus);
+#endif
+    dbus_connection_unref(client->bus);
+    client->bus = NULL;
+}
+
 static void client_set_state(AvahiClient *client, AvahiClientState state) {
     assert(client);
 
@@ -65,15 +201,12 @@ static void client_set_state(AvahiClient *client, AvahiClientState state) {
 
     switch (client->state) {
         case AVAHI_CLIENT_FAILURE:
-            if (client->bus) {
-#ifdef HAVE_DBUS_CONNECTION_CLOSE
-                dbus_connection_close(client->bus);
-#else
-                dbus_connection_disconnect(client->bus);
-#endif
-                dbus_connection_unref(client->bus);
-                client->bus = NULL;
-            }
+            if (client->bus)
+                connection_close(client);
+
+            /* Threads waiting for a reply won't get one anymore */
+            if (client->threaded_poll)
+                avahi_threaded_poll_signal(client->threaded_poll);
 
             /* Fall through */
 
@@ -88,6 +221,10 @@ static void client_set_state(AvahiClient *client, AvahiClientState state) {
             client->host_name =  NULL;
             client->host_name_fqdn = NULL;
             client->domain_name = NULL;
+
+            /* Whatever we found might have been lost on the way */
+            if (client->cache)
+                avahi_client_cache_flush(client->cache);
             break;
 
         case AVAHI_CLIENT_S_RUNNING:
@@ -192,11 +329,7 @@ static DBusHandlerResult filter_func(DBusConnection *bus, DBusMessage *message,
         AvahiEntryGroup *g;
         path = dbus_message_get_path(message);
 
-        for (g = client->groups; g; g = g->groups_next)
-            if (strcmp(g->path, path) == 0)
-                break;
-
-        if (g) {
+        if ((g = avahi_client_find_object(client, path, AVAHI_DBUS_INTERFACE_ENTRY_GROUP))) {
             int32_t state;
             char *e;
             int c;
@@ -251,12 +384,20 @@ static DBusHandlerResult filter_func(DBusConnection *bus, DBusMessage *message,
         return avahi_service_browser_event (client, AVAHI_BROWSER_ALL_FOR_NOW, message);
     else if (dbus_message_is_signal(message, AVAHI_DBUS_INTERFACE_SERVICE_BROWSER, "Failure"))
         return avahi_service_browser_event (client, AVAHI_BROWSER_FAILURE, message);
+    else if (dbus_message_is_signal(message, AVAHI_DBUS_INTERFACE_SERVICE_BROWSER, "ItemsChanged"))
+        return avahi_service_browser_event_batch (client, message);
 
     else if (dbus_message_is_signal(message, AVAHI_DBUS_INTERFACE_SERVICE_RESOLVER, "Found"))
         return avahi_service_resolver_event (client, AVAHI_RESOLVER_FOUND, message);
     else if (dbus_message_is_signal(message, AVAHI_DBUS_INTERFACE_SERVICE_RESOLVER, "Failure"))
         return avahi_service_resolver_event (client, AVAHI_RESOLVER_FAILURE, message);
 
+    else if (dbus_message_is_signal(message, AVAHI_DBUS_INTERFACE_SERVICE_BATCH_RESOLVER, "ItemsResolved"))
+        return avahi_service_batch_resolver_event (client, message);
+    else if (dbus_message_is_signal(message, AVAHI_DBUS_INTERFACE_SERVICE_BATCH_RESOLVER, "Done"))
+        /* Every service has been reported by ItemsResolved already */
+        return DBUS_HANDLER_RESULT_HANDLED;
+
     else if (dbus_message_is_signal(message, AVAHI_DBUS_INTERFACE_HOST_NAME_RESOLVER, "Found"))
         return avahi_host_name_resolver_event (client, AVAHI_RESOLVER_FOUND, message);
     else if (dbus_message_is_signal(message, AVAHI_DBUS_INTERFACE_HOST_NAME_RESOLVER, "Failure"))
@@ -302,6 +443,18 @@ fail:
     return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
+static int set_api_version(AvahiClient *client, uint32_t version) {
+    assert(client);
+
+    client->api_version = version;
+
+    if ((version & 0xFF00) != (AVAHI_CLIENT_DBUS_API_SUPPORTED & 0xFF00) ||
+        (version & 0x00FF) < (AVAHI_CLIENT_DBUS_API_SUPPORTED & 0x00FF))
+        return AVAHI_ERR_VERSION_MISMATCH;
+
+    return AVAHI_OK;
+}
+
 static int get_server_state(AvahiClient *client, int *ret_error) {
     DBusMessage *message = NULL, *reply = NULL;
     DBusError error;
@@ -315,7 +468,7 @@ static int get_server_state(AvahiClient *client, int *ret_error) {
     if (!(message = dbus_message_new_method_call(AVAHI_DBUS_NAME, AVAHI_DBUS_PATH_SERVER, AVAHI_DBUS_INTERFACE_SERVER, "GetState")))
         goto fail;
 
-    reply = dbus_connection_send_with_reply_and_block (client->bus, message, -1, &error);
+    reply = avahi_client_send_with_reply_and_block(client, message, &error);
 
     if (!reply || dbus_error_is_set (&error))
         goto fail;
@@ -361,7 +514,7 @@ static int check_version(AvahiClient *client, int *ret_error) {
     if (!(message = dbus_message_new_method_call(AVAHI_DBUS_NAME, AVAHI_DBUS_PATH_SERVER, AVAHI_DBUS_INTERFACE_SERVER, "GetAPIVersion")))
         goto fail;
 
-    reply = dbus_connection_send_with_reply_and_block (client->bus, message, -1, &error);
+    reply = avahi_client_send_with_reply_and_block(client, message, &error);
 
     if (!reply || dbus_error_is_set (&error)) {
         char *version_str;
@@ -380,7 +533,7 @@ static int check_version(AvahiClient *client, int *ret_error) {
         if (!(message = dbus_message_new_method_call(AVAHI_DBUS_NAME, AVAHI_DBUS_PATH_SERVER, AVAHI_DBUS_INTERFACE_SERVER, "GetVersionString")))
             goto fail;
 
-        reply = dbus_connection_send_with_reply_and_block (client->bus, message, -1, &error);
+        reply = avahi_client_send_with_reply_and_block(client, message, &error);
 
         if (!reply || dbus_error_is_set (&error))
             goto fail;
@@ -400,11 +553,8 @@ static int check_version(AvahiClient *client, int *ret_error) {
 
     /*fprintf(stderr, "API Version 0x%04x\n", version);*/
 
-    if ((version & 0xFF00) != (AVAHI_CLIENT_DBUS_API_SUPPORTED & 0xFF00) ||
-        (version & 0x00FF) < (AVAHI_CLIENT_DBUS_API_SUPPORTED & 0x00FF)) {
-        e = AVAHI_ERR_VERSION_MISMATCH;
+    if ((e = set_api_version(client, version)) < 0)
         goto fail;
-    }
 
     dbus_message_unref(message);
     dbus_message_unref(reply);
@@ -428,16 +578,108 @@ fail:
     return e;
 }
 
+/* Asks for everything check_version() and get_server_state() ask
+ * for, and what the getters would ask for later on, in a single round
+ * trip. If the call itself fails AVAHI_ERR_DBUS_ERROR is returned and
+ * error is left set. */
+static int get_server_info(AvahiClient *client, DBusError *error) {
+    DBusMessage *message = NULL, *reply = NULL;
+    uint32_t version, cookie;
+    int32_t state;
+    const char *version_string, *host_name, *host_name_fqdn, *domain_name;
+    int r = AVAHI_ERR_NO_MEMORY;
+
+    assert(client);
+    assert(error);
+
+    if (!(message = dbus_message_new_method_call(AVAHI_DBUS_NAME, AVAHI_DBUS_PATH_SERVER, AVAHI_DBUS_INTERFACE_SERVER2, "GetServerInfo")))
+        goto finish;
+
+    reply = avahi_client_send_with_reply_and_block(client, message, error);
+
+    if (!reply || dbus_error_is_set(error)) {
+        r = AVAHI_ERR_DBUS_ERROR;
+        goto finish;
+    }
+
+    if (!dbus_message_get_args(
+            reply, error,
+            DBUS_TYPE_UINT32, &version,
+            DBUS_TYPE_STRING, &version_string,
+            DBUS_TYPE_INT32, &state,
+            DBUS_TYPE_STRING, &host_name,
+            DBUS_TYPE_STRING, &host_name_fqdn,
+            DBUS_TYPE_STRING, &domain_name,
+            DBUS_TYPE_UINT32, &cookie,
+            DBUS_TYPE_INVALID) ||
+        dbus_error_is_set(error)) {
+        r = avahi_error_dbus_to_number(error->name);
+        dbus_error_free(error);
+        goto finish;
+    }
+
+    if ((r = set_api_version(client, version)) < 0)
+        goto finish;
+
+    avahi_free(client->version_string);
+    avahi_free(client->host_name);
+    avahi_free(client->host_name_fqdn);
+    avahi_free(client->domain_name);
+
+    client->version_string = avahi_strdup(version_string);
+    client->host_name = avahi_strdup(host_name);
+    client->host_name_fqdn = avahi_strdup(host_name_fqdn);
+    client->domain_name = avahi_strdup(domain_name);
+
+    client->local_service_cookie = cookie;
+    client->local_service_cookie_valid = 1;
+
+    /* This drops the names again unless the server is running */
+    client_set_state(client, (AvahiClientState) state);
+
+    r = AVAHI_OK;
+
+finish:
+    if (message)
+        dbus_message_unref(message);
+    if (reply)
+        dbus_message_unref(reply);
+
+    return r;
+}
+
+/* Returns AVAHI_ERR_NO_DAEMON if the server couldn't be reached at all */
 static int init_server(AvahiClient *client, int *ret_error) {
+    DBusError error;
     int r;
 
-    if ((r = check_version(client, ret_error)) < 0)
-        return r;
+    assert(client);
 
-    if ((r = get_server_state(client, ret_error)) < 0)
-        return r;
+    dbus_error_init(&error);
 
-    return AVAHI_OK;
+    if ((r = get_server_info(client, &error)) == AVAHI_ERR_DBUS_ERROR) {
+
+        if (dbus_error_has_name(&error, DBUS_ERROR_UNKNOWN_METHOD)) {
+            dbus_error_free(&error);
+
+            /* Servers older than 0.9 need to be asked one thing at a
+             * time */
+
+            if ((r = check_version(client, ret_error)) < 0)
+                return r;
+
+            return get_server_state(client, ret_error);
+        }
+
+        r = AVAHI_ERR_NO_DAEMON;
+    }
+
+    dbus_error_free(&error);
+
+    if (r < 0 && ret_error)
+        *ret_error = r;
+
+    return r;
 }
 
 /* This function acts like dbus_bus_get but creates a private
@@ -475,10 +717,36 @@ static DBusConnection* avahi_dbus_bus_get(DBusError *error) {
     return c;
 }
 
+/* Connects to the socket the daemon may be listening on besides the
+ * bus. Returns NULL if it isn't. */
+static DBusConnection* avahi_dbus_socket_get(void) {
+    DBusConnection *c;
+
+    if (!(c = dbus_connection_open_private("unix:path=" AVAHI_DBUS_SOCKET, NULL)))
+        return NULL;
+
+    dbus_connection_set_exit_on_disconnect(c, FALSE);
+
+    return c;
+}
+
+static int connection_setup(AvahiClient *client) {
+    assert(client);
+    assert(client->bus);
+
+    if (avahi_dbus_connection_glue(client->bus, client->poll_api) < 0)
+        return AVAHI_ERR_NO_MEMORY; /* Not optimal */
+
+    if (!dbus_connection_add_filter(client->bus, filter_func, client, NULL))
+        return AVAHI_ERR_NO_MEMORY;
+
+    return AVAHI_OK;
+}
+
 AvahiClient *avahi_client_new(const AvahiPoll *poll_api, AvahiClientFlags flags, AvahiClientCallback callback, void *userdata, int *ret_error) {
     AvahiClient *client = NULL;
     DBusError error;
-    DBusMessage *message = NULL, *reply = NULL;
+    int r, e;
 
     avahi_init_i18n();
 
@@ -491,90 +759,106 @@ AvahiClient *avahi_client_new(const AvahiPoll *poll_api, AvahiClientFlags flags,
     }
 
     client->poll_api = poll_api;
+    client->threaded_poll = NULL;
+    AVAHI_LLIST_HEAD_INIT(AvahiClientWaiter, client->waiters);
+    client->free_timeout = NULL;
+    client->dead = 0;
     client->error = AVAHI_OK;
     client->callback = callback;
     client->userdata = userdata;
     client->state = (AvahiClientState) -1;
     client->flags = flags;
+    client->bus = NULL;
 
     client->host_name = NULL;
     client->host_name_fqdn = NULL;
     client->domain_name = NULL;
     client->version_string = NULL;
     client->local_service_cookie_valid = 0;
+    client->api_version = 0;
 
     AVAHI_LLIST_HEAD_INIT(AvahiEntryGroup, client->groups);
     AVAHI_LLIST_HEAD_INIT(AvahiDomainBrowser, client->domain_browsers);
     AVAHI_LLIST_HEAD_INIT(AvahiServiceBrowser, client->service_browsers);
     AVAHI_LLIST_HEAD_INIT(AvahiServiceTypeBrowser, client->service_type_browsers);
     AVAHI_LLIST_HEAD_INIT(AvahiServiceResolver, client->service_resolvers);
+    AVAHI_LLIST_HEAD_INIT(AvahiServiceBatchResolver, client->service_batch_resolvers);
     AVAHI_LLIST_HEAD_INIT(AvahiHostNameResolver, client->host_name_resolvers);
     AVAHI_LLIST_HEAD_INIT(AvahiAddressResolver, client->address_resolvers);
     AVAHI_LLIST_HEAD_INIT(AvahiRecordBrowser, client->record_browsers);
-
-    if (!(client->bus = avahi_dbus_bus_get(&error)) || dbus_error_is_set(&error)) {
+    AVAHI_LLIST_HEAD_INIT(AvahiClientCall, client->calls);
+    client->object_buckets = NULL;
+    client->n_objects = client->n_object_buckets = 0;
+    client->calls_tail = NULL;
+    client->n_calls_pending = client->n_calls_ready = client->n_calls_waiting = 0;
+    client->cache = NULL;
+
+    if ((flags & AVAHI_CLIENT_CACHE_RESULTS) && !(client->cache = avahi_client_cache_new(AVAHI_CLIENT_CACHE_TTL_MSEC))) {
         if (ret_error)
-            *ret_error = AVAHI_ERR_DBUS_ERROR;
+            *ret_error = AVAHI_ERR_NO_MEMORY;
         goto fail;
     }
 
-    if (avahi_dbus_connection_glue(client->bus, poll_api) < 0) {
+    /* Talking to the daemon directly saves the bus from passing on
+     * each message. Use the bus if the daemon doesn't listen on a
+     * socket of its own, or doesn't answer there. */
+    if ((client->bus = avahi_dbus_socket_get())) {
+        if ((r = connection_setup(client)) < 0) {
+            if (ret_error)
+                *ret_error = r;
+            goto fail;
+        }
+
+        if (init_server(client, NULL) >= 0)
+            return client;
+
+        connection_close(client);
+        client->error = AVAHI_OK;
+    }
+
+    if (!(client->bus = avahi_dbus_bus_get(&error)) || dbus_error_is_set(&error)) {
         if (ret_error)
-            *ret_error = AVAHI_ERR_NO_MEMORY; /* Not optimal */
+            *ret_error = AVAHI_ERR_DBUS_ERROR;
         goto fail;
     }
 
-    if (!dbus_connection_add_filter(client->bus, filter_func, client, NULL)) {
+    if ((r = connection_setup(client)) < 0) {
         if (ret_error)
-            *ret_error = AVAHI_ERR_NO_MEMORY;
+            *ret_error = r;
         goto fail;
     }
 
+    /* The bus handles our messages in order, hence there's no need to
+     * wait for the replies to AddMatch: the rules are in place by the
+     * time it forwards GetServerInfo to the server. Signals from
+     * DBUS_INTERFACE_LOCAL don't need a rule, they never go through
+     * the bus. */
     dbus_bus_add_match(
         client->bus,
         "type='signal', "
         "interface='" AVAHI_DBUS_INTERFACE_SERVER "', "
         "sender='" AVAHI_DBUS_NAME "', "
         "path='" AVAHI_DBUS_PATH_SERVER "'",
-        &error);
-
-    if (dbus_error_is_set(&error))
-        goto fail;
+        NULL);
 
-    dbus_bus_add_match (
+    /* Only the owner changes of our server name, not those of every
+     * client on the bus */
+    dbus_bus_add_match(
         client->bus,
         "type='signal', "
         "interface='" DBUS_INTERFACE_DBUS "', "
         "sender='" DBUS_SERVICE_DBUS "', "
-        "path='" DBUS_PATH_DBUS "'",
-        &error);
-
-    if (dbus_error_is_set(&error))
-        goto fail;
-
-    dbus_bus_add_match(
-        client->bus,
-        "type='signal', "
-        "interface='" DBUS_INTERFACE_LOCAL "'",
-        &error);
-
-    if (dbus_error_is_set(&error))
-        goto fail;
-
-    if (!(message = dbus_message_new_method_call(AVAHI_DBUS_NAME, AVAHI_DBUS_PATH_SERVER, "org.freedesktop.DBus.Peer", "Ping")))
-        goto fail;
-
-    reply = dbus_connection_send_with_reply_and_block (client->bus, message, -1, &error);
+        "path='" DBUS_PATH_DBUS "', "
+        "member='NameOwnerChanged', "
+        "arg0='" AVAHI_DBUS_NAME "'",
+        NULL);
 
-    if (!reply || dbus_error_is_set (&error)) {
-        /* We free the error so its not set, that way the fail target
-         * will return the NO_DAEMON error rather than a DBUS error */
-        dbus_error_free(&error);
+    if ((r = init_server(client, &e)) < 0) {
 
-        if (!(flags & AVAHI_CLIENT_NO_FAIL)) {
+        if (r != AVAHI_ERR_NO_DAEMON || !(flags & AVAHI_CLIENT_NO_FAIL)) {
 
             if (ret_error)
-                *ret_error = AVAHI_ERR_NO_DAEMON;
+                *ret_error = e;
 
             goto fail;
         }
@@ -582,27 +866,12 @@ AvahiClient *avahi_client_new(const AvahiPoll *poll_api, AvahiClientFlags flags,
         /* The user doesn't want this call to fail if the daemon is not
          * available, so let's return successfully */
         client_set_state(client, AVAHI_CLIENT_CONNECTING);
-
-    } else {
-
-        if (init_server(client, ret_error) < 0)
-            goto fail;
     }
 
-    dbus_message_unref(message);
-
-    if (reply)
-        dbus_message_unref(reply);
-
     return client;
 
 fail:
 
-    if (message)
-        dbus_message_unref(message);
-    if (reply)
-        dbus_message_unref(reply);
-
     if (client)
         avahi_client_free(client);
 
@@ -622,53 +891,147 @@ fail:
     return NULL;
 }
 
-void avahi_client_free(AvahiClient *client) {
-    assert(client);
+AvahiClient *avahi_client_new_threaded(AvahiThreadedPoll *threaded_poll, AvahiClientFlags flags, AvahiClientCallback callback, void *userdata, int *ret_error) {
+    AvahiClient *client;
 
-    if (client->bus)
-        /* Disconnect in advance, so that the free() functions won't
-         * issue needless server calls */
-#ifdef HAVE_DBUS_CONNECTION_CLOSE
-        dbus_connection_close(client->bus);
-#else
-        dbus_connection_disconnect(client->bus);
-#endif
+    assert(threaded_poll);
+
+    /* Older versions of libdbus aren't thread safe unless asked to */
+    if (!dbus_threads_init_default()) {
+        if (ret_error)
+            *ret_error = AVAHI_ERR_NO_MEMORY;
+        return NULL;
+    }
+
+    /* Nobody else knows the client yet, so it's fine to wait for the
+     * daemon with the lock held until it is returned */
+    if (!(client = avahi_client_new(avahi_threaded_poll_get(threaded_poll), flags, callback, userdata, ret_error)))
+        return NULL;
+
+    /* Created now, so that freeing the client later can't fail */
+    if (!(client->free_timeout = client->poll_api->timeout_new(client->poll_api, NULL, free_timeout_callback, client))) {
+        avahi_client_free(client);
+
+        if (ret_error)
+            *ret_error = AVAHI_ERR_NO_MEMORY;
+        return NULL;
+    }
 
-    while (client->groups)
-        avahi_entry_group_free(client->groups);
+    client->threaded_poll = threaded_poll;
 
-    while (client->domain_browsers)
-        avahi_domain_browser_free(client->domain_browsers);
+    return client;
+}
 
-    while (client->service_browsers)
-        avahi_service_browser_free(client->service_browsers);
+/* Free the objects of client, except for those other threads are
+ * waiting for a reply about. Start over after each one, domain
+ * browsers are only gone when their last reference is. */
+#define FREE_OBJECTS(type, list, free_function)                 \
+    do {                                                        \
+        type *o = client->list;                                 \
+        while (o) {                                             \
+            if (is_waited_for(client, o))                       \
+                o = o->list##_next;                             \
+            else {                                              \
+                free_function(o);                               \
+                o = client->list;                               \
+            }                                                   \
+        }                                                       \
+    } while (0)
+
+static void free_objects(AvahiClient *client) {
+    assert(client);
 
-    while (client->service_type_browsers)
-        avahi_service_type_browser_free(client->service_type_browsers);
+    FREE_OBJECTS(AvahiEntryGroup, groups, avahi_entry_group_free);
+    FREE_OBJECTS(AvahiDomainBrowser, domain_browsers, avahi_domain_browser_free);
+    FREE_OBJECTS(AvahiServiceBrowser, service_browsers, avahi_service_browser_free);
+    FREE_OBJECTS(AvahiServiceTypeBrowser, service_type_browsers, avahi_service_type_browser_free);
+    FREE_OBJECTS(AvahiServiceResolver, service_resolvers, avahi_service_resolver_free);
+    FREE_OBJECTS(AvahiServiceBatchResolver, service_batch_resolvers, avahi_service_batch_resolver_free);
+    FREE_OBJECTS(AvahiHostNameResolver, host_name_resolvers, avahi_host_name_resolver_free);
+    FREE_OBJECTS(AvahiAddressResolver, address_resolvers, avahi_address_resolver_free);
+    FREE_OBJECTS(AvahiRecordBrowser, record_browsers, avahi_record_browser_free);
+
+    /* Objects freed while they were still being created */
+    while (client->calls)
+        call_free(client->calls);
+}
 
-    while (client->service_resolvers)
-        avahi_service_resolver_free(client->service_resolvers);
+#undef FREE_OBJECTS
 
-    while (client->host_name_resolvers)
-        avahi_host_name_resolver_free(client->host_name_resolvers);
+static void client_free(AvahiClient *client) {
+    assert(client);
+    assert(!client->waiters);
 
-    while (client->address_resolvers)
-        avahi_address_resolver_free(client->address_resolvers);
+    free_objects(client);
 
-    while (client->record_browsers)
-        avahi_record_browser_free(client->record_browsers);
+    /* All objects have been removed from the index by now */
+    assert(client->n_objects == 0);
+    avahi_free(client->object_buckets);
 
     if (client->bus)
         dbus_connection_unref(client->bus);
 
+    if (client->free_timeout)
+        client->poll_api->timeout_free(client->free_timeout);
+
     avahi_free(client->version_string);
     avahi_free(client->host_name);
     avahi_free(client->host_name_fqdn);
     avahi_free(client->domain_name);
 
+    if (client->cache)
+        avahi_client_cache_free(client->cache);
+
     avahi_free(client);
 }
 
+static void free_timeout_callback(AvahiTimeout *t, void *userdata) {
+    AvahiClient *client = userdata;
+
+    assert(t);
+    assert(client);
+    assert(client->dead);
+
+    /* Somebody might have started waiting before we got the lock */
+    if (!client->waiters)
+        client_free(client);
+}
+
+void avahi_client_free(AvahiClient *client) {
+    assert(client);
+
+    if (client->bus)
+        /* Disconnect in advance, so that the free() functions won't
+         * issue needless server calls */
+#ifdef HAVE_DBUS_CONNECTION_CLOSE
+        dbus_connection_close(client->bus);
+#else
+        dbus_connection_disconnect(client->bus);
+#endif
+
+    if (client->waiters) {
+        /* Other threads wait for replies, with the lock released. Let
+         * them return with an error, and free what they still use
+         * once they are gone. */
+        assert(!client->dead);
+
+        client->dead = 1;
+        client->callback = NULL;
+
+        if (client->bus) {
+            dbus_connection_unref(client->bus);
+            client->bus = NULL;
+        }
+
+        avahi_threaded_poll_signal(client->threaded_poll);
+
+        free_objects(client);
+        return;
+    }
+
+    client_free(client);
+}
+
 static char* avahi_client_get_string_reply_and_block (AvahiClient *client, const char *method, const char *param) {
     DBusMessage *message = NULL, *reply = NULL;
     DBusError error;
@@ -691,7 +1054,7 @@ static char* avahi_client_get_string_reply_and_block (AvahiClient *client, const
         }
     }
 
-    reply = dbus_connection_send_with_reply_and_block (client->bus, message, -1, &error);
+    reply = avahi_client_send_with_reply_and_block(client, message, &error);
 
     if (!reply || dbus_error_is_set (&error))
         goto fail;
@@ -794,7 +1157,20 @@ int avahi_client_errno(AvahiClient *client) {
 }
 
 /* Just for internal use */
-int avahi_client_simple_method_call(AvahiClient *client, const char *path, const char *interface, const char *method) {
+int avahi_client_iter_get_basic(DBusMessageIter *iter, int type, void *value) {
+    assert(iter);
+    assert(value);
+
+    if (dbus_message_iter_get_arg_type(iter) != type)
+        return -1;
+
+    dbus_message_iter_get_basic(iter, value);
+    dbus_message_iter_next(iter);
+    return 0;
+}
+
+/* Just for internal use */
+int avahi_client_simple_method_call(AvahiClient *client, const char *path, const char *interface, const char *method, void *object) {
     DBusMessage *message = NULL, *reply = NULL;
     DBusError error;
     int r = AVAHI_OK;
@@ -811,7 +1187,7 @@ int avahi_client_simple_method_call(AvahiClient *client, const char *path, const
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block(client->bus, message, -1, &error)) ||
+    if (!(reply = send_and_wait(client, message, object, &error)) ||
         dbus_error_is_set (&error)) {
         r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
         goto fail;
@@ -843,6 +1219,635 @@ fail:
     return r;
 }
 
+struct AvahiClientObject {
+    void *object;
+    const char *path;           /* Owned by the object */
+    const char *interface;
+    unsigned hash;
+    AvahiClientObject *next;
+};
+
+static unsigned path_hash(const char *p) {
+    unsigned hash = 0;
+
+    assert(p);
+
+    for (; *p; p++)
+        hash = 31 * hash + (unsigned char) *p;
+
+    return hash;
+}
+
+static int object_index_grow(AvahiClient *client) {
+    AvahiClientObject **buckets;
+    unsigned n, j;
+
+    assert(client);
+
+    n = client->n_object_buckets ? client->n_object_buckets * 2 : 64;
+
+    if (!(buckets = avahi_new0(AvahiClientObject*, n)))
+        return -1;
+
+    for (j = 0; j < client->n_object_buckets; j++) {
+        AvahiClientObject *o, *next;
+
+        for (o = client->object_buckets[j]; o; o = next) {
+            next = o->next;
+            o->next = buckets[o->hash % n];
+            buckets[o->hash % n] = o;
+        }
+    }
+
+    avahi_free(client->object_buckets);
+    client->object_buckets = buckets;
+    client->n_object_buckets = n;
+
+    return 0;
+}
+
+static int object_index_add(AvahiClient *client, void *object, const char *path, const char *interface) {
+    AvahiClientObject *o;
+    unsigned idx;
+
+    assert(client);
+    assert(object);
+    assert(path);
+    assert(interface);
+
+    /* Keep the chains short */
+    if (client->n_objects >= client->n_object_buckets)
+        if (object_index_grow(client) < 0)
+            return -1;
+
+    if (!(o = avahi_new(AvahiClientObject, 1)))
+        return -1;
+
+    o->object = object;
+    o->path = path;
+    o->interface = interface;
+    o->hash = path_hash(path);
+
+    idx = o->hash % client->n_object_buckets;
+    o->next = client->object_buckets[idx];
+    client->object_buckets[idx] = o;
+    client->n_objects++;
+
+    return 0;
+}
+
+static void object_index_remove(AvahiClient *client, void *object, const char *path) {
+    AvahiClientObject **o;
+
+    assert(client);
+    assert(object);
+    assert(path);
+
+    if (!client->n_object_buckets)
+        return;
+
+    for (o = &client->object_buckets[path_hash(path) % client->n_object_buckets]; *o; o = &(*o)->next)
+        if ((*o)->object == object) {
+            AvahiClientObject *t = *o;
+
+            *o = t->next;
+            avahi_free(t);
+
+            assert(client->n_objects > 0);
+            client->n_objects--;
+            return;
+        }
+}
+
+void *avahi_client_find_object(AvahiClient *client, const char *path, const char *interface) {
+    AvahiClientObject *o;
+    unsigned hash;
+
+    assert(client);
+    assert(path);
+    assert(interface);
+
+    if (!client->n_object_buckets)
+        return NULL;
+
+    hash = path_hash(path);
+
+    for (o = client->object_buckets[hash % client->n_object_buckets]; o; o = o->next)
+        if (o->hash == hash && strcmp(o->path, path) == 0)
+            return strcmp(o->interface, interface) == 0 ? o->object : NULL;
+
+    return NULL;
+}
+
+struct AvahiClientCall {
+    AvahiClient *client;
+
+    /* NULL once the object has been freed while it was still being
+     * created. It is then freed on the server when the reply arrives. */
+    void *object;
+    AvahiClientCallCallback callback;
+
+    /* Where the path of the object is stored. Calls creating the
+     * object fill it in from the reply. */
+    char **path;
+
+    /* The interface of the new object, only for calls creating one */
+    const char *interface;
+
+    /* The message until it is sent. Calls on objects which are still
+     * being created aren't ready to be sent yet. */
+    DBusMessage *message;
+    int ready;
+
+    DBusPendingCall *pending;
+
+    /* Only for calls a thread of a threaded client waits for, instead
+     * of calling callback. Positive until the call has finished, then
+     * AVAHI_OK or an error code. */
+    int *result;
+
+    AVAHI_LLIST_FIELDS(AvahiClientCall, calls);
+};
+
+static void call_free(AvahiClientCall *call) {
+    AvahiClient *client;
+
+    assert(call);
+
+    client = call->client;
+
+    if (call->pending) {
+        dbus_pending_call_cancel(call->pending);
+        dbus_pending_call_unref(call->pending);
+
+        assert(client->n_calls_pending > 0);
+        client->n_calls_pending--;
+    }
+
+    if (call->message) {
+        dbus_message_unref(call->message);
+
+        if (call->ready) {
+            assert(client->n_calls_ready > 0);
+            client->n_calls_ready--;
+        } else {
+            assert(client->n_calls_waiting > 0);
+            client->n_calls_waiting--;
+        }
+    }
+
+    if (client->calls_tail == call)
+        client->calls_tail = call->calls_prev;
+
+    AVAHI_LLIST_REMOVE(AvahiClientCall, calls, client->calls, call);
+
+    if (call->result && *call->result > 0) {
+        *call->result = AVAHI_ERR_DISCONNECTED;
+        avahi_threaded_poll_signal(client->threaded_poll);
+    }
+
+    avahi_free(call);
+}
+
+static AvahiClientCall *call_new(AvahiClient *client, DBusMessage *message, void *object, char **path, const char *interface, AvahiClientCallCallback callback) {
+    AvahiClientCall *call;
+
+    assert(client);
+    assert(message);
+    assert(object);
+    assert(path);
+
+    if (!(call = avahi_new0(AvahiClientCall, 1)))
+        return NULL;
+
+    call->client = client;
+    call->object = object;
+    call->callback = callback;
+    call->path = path;
+    call->interface = interface;
+    call->message = dbus_message_ref(message);
+
+    if ((call->ready = interface || *path))
+        client->n_calls_ready++;
+    else
+        client->n_calls_waiting++;
+
+    AVAHI_LLIST_PREPEND(AvahiClientCall, calls, client->calls, call);
+
+    if (!client->calls_tail)
+        client->calls_tail = call;
+
+    return call;
+}
+
+static void call_notify(DBusPendingCall *pending, void *userdata);
+
+static int call_send(AvahiClientCall *call) {
+    AvahiClient *client;
+    DBusPendingCall *pending;
+
+    assert(call);
+    assert(call->message);
+    assert(call->ready);
+    assert(!call->pending);
+
+    client = call->client;
+
+    if (!client->bus)
+        return AVAHI_ERR_DISCONNECTED;
+
+    /* Queued before the path of the object was known */
+    if (!call->interface && strcmp(dbus_message_get_path(call->message), *call->path))
+        if (!dbus_message_set_path(call->message, *call->path))
+            return AVAHI_ERR_NO_MEMORY;
+
+    if (!dbus_connection_send_with_reply(client->bus, call->message, &pending, -1))
+        return AVAHI_ERR_NO_MEMORY;
+
+    /* The connection has been closed already */
+    if (!pending)
+        return AVAHI_ERR_DISCONNECTED;
+
+    call->pending = pending;
+
+    if (!dbus_pending_call_set_notify(pending, call_notify, call, NULL)) {
+        dbus_pending_call_cancel(pending);
+        dbus_pending_call_unref(pending);
+        call->pending = NULL;
+        return AVAHI_ERR_NO_MEMORY;
+    }
+
+    client->n_calls_pending++;
+
+    dbus_message_unref(call->message);
+    call->message = NULL;
+    client->n_calls_ready--;
+
+    return AVAHI_OK;
+}
+
+/* Send the calls that are ready, oldest first, as far as the limit of
+ * calls in flight allows */
+static void send_calls(AvahiClient *client) {
+    AvahiClientCall *call, *prev;
+
+    assert(client);
+
+    for (call = client->calls_tail; call; call = prev) {
+        prev = call->calls_prev;
+
+        if (!client->n_calls_ready || client->n_calls_pending >= AVAHI_CLIENT_CALLS_PENDING_MAX)
+            break;
+
+        if (!call->message || !call->ready)
+            continue;
+
+        /* Leave the rest queued, this is tried again whenever a reply
+         * arrives. If the connection is gone the client is about to
+         * enter AVAHI_CLIENT_FAILURE anyway. */
+        if (call_send(call) < 0)
+            break;
+    }
+}
+
+static void send_free(AvahiClient *client, const char *path, const char *interface) {
+    DBusMessage *message;
+
+    assert(client);
+    assert(path);
+    assert(interface);
+
+    if (!client->bus)
+        return;
+
+    /* Nobody is interested in the reply */
+    if (!(message = dbus_message_new_method_call(AVAHI_DBUS_NAME, path, interface, "Free")))
+        return;
+
+    dbus_message_set_no_reply(message, TRUE);
+    dbus_connection_send(client->bus, message, NULL);
+    dbus_message_unref(message);
+}
+
+/* Called when an object has been created or creating it failed */
+static void object_created(AvahiClient *client, void *object, int success) {
+    AvahiClientCall *call, *next;
+
+    assert(client);
+    assert(object);
+
+    for (call = client->calls; call && client->n_calls_waiting; call = next) {
+        next = call->calls_next;
+
+        if (call->object != object || !call->message)
+            continue;
+
+        assert(!call->ready);
+
+        if (success) {
+            call->ready = 1;
+            client->n_calls_ready++;
+            client->n_calls_waiting--;
+        } else
+            /* The callback reports the failure for all of them */
+            call_free(call);
+    }
+}
+
+static void call_notify(DBusPendingCall *pending, void *userdata) {
+    AvahiClientCall *call = userdata;
+    AvahiClient *client;
+    AvahiClientCallCallback callback;
+    DBusMessage *reply;
+    DBusError error;
+    char *path = NULL, **object_path = NULL;
+    void *object;
+    int r = AVAHI_OK, *result;
+
+    assert(pending);
+    assert(call);
+    assert(call->pending == pending);
+
+    client = call->client;
+    object = call->object;
+    callback = call->callback;
+    result = call->result;
+
+    if (call->interface)
+        object_path = call->path;
+
+    dbus_error_init(&error);
+
+    if (!(reply = dbus_pending_call_steal_reply(pending)))
+        r = AVAHI_ERR_DBUS_ERROR;
+    else if (dbus_set_error_from_message(&error, reply))
+        r = avahi_error_dbus_to_number(error.name);
+    else if (object_path &&
+             (!dbus_message_get_args(reply, &error, DBUS_TYPE_OBJECT_PATH, &path, DBUS_TYPE_INVALID) || !path))
+        r = AVAHI_ERR_DBUS_ERROR;
+
+    if (object_path && !object) {
+        /* The object has been freed in the meantime */
+        if (r >= 0)
+            send_free(client, path, call->interface);
+
+        call_free(call);
+        send_calls(client);
+        goto finish;
+    }
+
+    if (object_path && r >= 0 &&
+        (!(*object_path = avahi_strdup(path)) ||
+         object_index_add(client, object, *object_path, call->interface) < 0)) {
+        send_free(client, path, call->interface);
+        avahi_free(*object_path);
+        *object_path = NULL;
+        r = AVAHI_ERR_NO_MEMORY;
+    }
+
+    call->result = NULL;
+    call_free(call);
+
+    if (object_path)
+        object_created(client, object, r >= 0);
+
+    send_calls(client);
+
+    if (r < 0)
+        avahi_client_set_errno(client, r);
+
+    if (result) {
+        *result = r;
+        avahi_threaded_poll_signal(client->threaded_poll);
+    } else if (callback)
+        /* This may free the object, or even the client */
+        callback(object, r);
+
+finish:
+    dbus_error_free(&error);
+
+    if (reply)
+        dbus_message_unref(reply);
+}
+
+/* Queue an asynchronous call, sending it right away if nothing is
+ * waiting in front of it */
+static int call_start(AvahiClient *client, DBusMessage *message, void *object, char **path, const char *interface, AvahiClientCallCallback callback) {
+    AvahiClientCall *call;
+    int r;
+
+    assert(client);
+
+    if (!(call = call_new(client, message, object, path, interface, callback)))
+        return avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+
+    if (!call->ready || client->n_calls_ready > 1 || client->n_calls_pending >= AVAHI_CLIENT_CALLS_PENDING_MAX)
+        return AVAHI_OK;
+
+    if ((r = call_send(call)) < 0) {
+        call_free(call);
+        return avahi_client_set_errno(client, r);
+    }
+
+    return AVAHI_OK;
+}
+
+/* Send a call right away and wait for it to finish, for threaded
+ * clients. Leaving the reply to call_notify() in the helper thread
+ * makes sure the object is known before any of its signals are
+ * dispatched. */
+static int call_wait(AvahiClient *client, DBusMessage *message, void *object, char **path, const char *interface) {
+    AvahiClientWaiter w;
+    AvahiClientCall *call;
+    DBusPendingCall *pending;
+    int result = 1, r;
+
+    assert(client);
+    assert(client->threaded_poll);
+
+    if (!(call = call_new(client, message, object, path, interface, NULL)))
+        return avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+
+    /* Not queued, if this is the helper thread it would wait for
+     * calls in front of it forever */
+    if ((r = call_send(call)) < 0) {
+        call_free(call);
+        return avahi_client_set_errno(client, r);
+    }
+
+    call->result = &result;
+    pending = dbus_pending_call_ref(call->pending);
+
+    /* Callbacks may see and free the object once it has been created,
+     * before we get to return it. That's for the caller to handle. */
+    waiter_add(client, &w, object);
+
+    while (result > 0 && client->bus)
+        if (avahi_threaded_poll_wait(client->threaded_poll) < 0)
+            dbus_pending_call_block(pending);
+
+    waiter_remove(client, &w);
+    dbus_pending_call_unref(pending);
+
+    /* The client failed before the reply arrived */
+    if (result > 0)
+        call_free(call);
+
+    return result < 0 ? avahi_client_set_errno(client, result) : AVAHI_OK;
+}
+
+int avahi_client_create_object(AvahiClient *client, DBusMessage *message, void *object, char **path, const char *interface, AvahiClientCallCallback callback) {
+    DBusMessage *reply = NULL;
+    DBusError error;
+    char *p;
+    int r;
+
+    assert(client);
+    assert(message);
+    assert(object);
+    assert(path);
+    assert(!*path);
+    assert(interface);
+
+    if (client->flags & AVAHI_CLIENT_ASYNC_CALLS)
+        return call_start(client, message, object, path, interface, callback);
+
+    if (client->threaded_poll)
+        return call_wait(client, message, object, path, interface);
+
+    dbus_error_init(&error);
+
+    if (!(reply = avahi_client_send_with_reply_and_block(client, message, &error)) ||
+        dbus_error_is_set(&error)) {
+        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+        goto fail;
+    }
+
+    if (!dbus_message_get_args(reply, &error, DBUS_TYPE_OBJECT_PATH, &p, DBUS_TYPE_INVALID) ||
+        dbus_error_is_set(&error) ||
+        !p) {
+        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+        goto fail;
+    }
+
+    if (!(*path = avahi_strdup(p)) ||
+        object_index_add(client, object, *path, interface) < 0) {
+
+        /* FIXME: We don't remove the object on the server side */
+
+        avahi_free(*path);
+        *path = NULL;
+
+        r = avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+        goto fail;
+    }
+
+    dbus_message_unref(reply);
+
+    return AVAHI_OK;
+
+fail:
+
+    if (dbus_error_is_set(&error)) {
+        r = avahi_client_set_dbus_error(client, &error);
+        dbus_error_free(&error);
+    }
+
+    if (reply)
+        dbus_message_unref(reply);
+
+    return r;
+}
+
+int avahi_client_object_call(AvahiClient *client, DBusMessage *message, void *object, char **path, AvahiClientCallCallback callback) {
+    DBusMessage *reply = NULL;
+    DBusError error;
+    int r;
+
+    assert(client);
+    assert(message);
+    assert(object);
+    assert(path);
+
+    if (client->flags & AVAHI_CLIENT_ASYNC_CALLS)
+        return call_start(client, message, object, path, NULL, callback);
+
+    assert(*path);
+
+    dbus_error_init(&error);
+
+    if (!(reply = send_and_wait(client, message, object, &error)) ||
+        dbus_error_is_set(&error)) {
+        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+        goto fail;
+    }
+
+    if (!dbus_message_get_args(reply, &error, DBUS_TYPE_INVALID) ||
+        dbus_error_is_set(&error)) {
+        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+        goto fail;
+    }
+
+    dbus_message_unref(reply);
+
+    return AVAHI_OK;
+
+fail:
+
+    if (dbus_error_is_set(&error)) {
+        r = avahi_client_set_dbus_error(client, &error);
+        dbus_error_free(&error);
+    }
+
+    if (reply)
+        dbus_message_unref(reply);
+
+    return r;
+}
+
+int avahi_client_free_object(AvahiClient *client, void *object, const char *path, const char *interface) {
+    AvahiClientCall *call, *next;
+    AvahiClientWaiter *w;
+
+    assert(client);
+    assert(object);
+
+    for (w = client->waiters; w; w = w->waiters_next)
+        if (w->object == object)
+            w->object = NULL;
+
+    if (path)
+        object_index_remove(client, object, path);
+
+    for (call = client->calls; call; call = next) {
+        next = call->calls_next;
+
+        if (call->object != object)
+            continue;
+
+        if (call->interface && call->pending)
+            /* Still being created, free it when we know its path */
+            call->object = NULL;
+        else
+            call_free(call);
+    }
+
+    if (client->flags & AVAHI_CLIENT_ASYNC_CALLS)
+        send_calls(client);
+
+    if (!path || !avahi_client_is_connected(client))
+        return AVAHI_OK;
+
+    assert(interface);
+
+    if (client->flags & AVAHI_CLIENT_ASYNC_CALLS) {
+        send_free(client, path, interface);
+        return AVAHI_OK;
+    }
+
+    return avahi_client_simple_method_call(client, path, interface, "Free", object);
+}
+
 uint32_t avahi_client_get_local_service_cookie(AvahiClient *client) {
     DBusMessage *message = NULL, *reply = NULL;
     DBusError error;
@@ -863,7 +1868,7 @@ uint32_t avahi_client_get_local_service_cookie(AvahiClient *client) {
         goto fail;
     }
 
-    reply = dbus_connection_send_with_reply_and_block (client->bus, message, -1, &error);
+    reply = avahi_client_send_with_reply_and_block(client, message, &error);
 
     if (!reply || dbus_error_is_set (&error))
         goto fail;
@@ -923,7 +1928,7 @@ int avahi_client_set_host_name(AvahiClient* client, const char *name) {
         goto fail;
     }
 
-    reply = dbus_connection_send_with_reply_and_block(client->bus, message, -1, &error);
+    reply = avahi_client_send_with_reply_and_block(client, message, &error);
 
     if (!reply || dbus_error_is_set (&error))
         goto fail;
@@ -27,6 +27,7 @@
 #include <avahi-common/strlst.h>
 #include <avahi-common/defs.h>
 #include <avahi-common/watch.h>
+#include <avahi-common/thread-watch.h>
 #include <avahi-common/gccmacro.h>
 
 /** \file client.h Definitions and functions for the client API over D-Bus */
@@ -47,7 +48,9 @@ typedef enum {
 
 typedef enum {
     AVAHI_CLIENT_IGNORE_USER_CONFIG = 1, /**< Don't read user configuration */
-    AVAHI_CLIENT_NO_FAIL = 2        /**< Don't fail if the daemon is not available when avahi_client_new() is called, instead enter AVAHI_CLIENT_CONNECTING state and wait for the daemon to appear */
+    AVAHI_CLIENT_NO_FAIL = 2,       /**< Don't fail if the daemon is not available when avahi_client_new() is called, instead enter AVAHI_CLIENT_CONNECTING state and wait for the daemon to appear */
+    AVAHI_CLIENT_ASYNC_CALLS = 4,   /**< Don't wait for the daemon when creating browsers, resolvers and entry groups, when adding entries to an entry group, committing, resetting or freeing it. The functions return as soon as the request has been queued and many requests can be in flight at the same time. Errors reported by the daemon are passed to the callback of the object as AVAHI_BROWSER_FAILURE, AVAHI_RESOLVER_FAILURE or AVAHI_ENTRY_GROUP_FAILURE, use avahi_client_errno() to find out why. Entries may be added to an entry group right after avahi_entry_group_new(). \since 0.9 */
+    AVAHI_CLIENT_CACHE_RESULTS = 8  /**< Remember what service and host name resolvers found for a while, and answer resolvers created with the same arguments from this cache without asking the daemon. Cached results are passed to the callback from the main loop with AVAHI_LOOKUP_RESULT_CACHED set, once, and the resolver doesn't report later changes. A result is forgotten as soon as a service browser of this client reports the service as removed, so browse for the services you resolve to keep the cache accurate. \since 0.9 */
 } AvahiClientFlags;
 
 /** The function prototype for the callback of an AvahiClient */
@@ -66,6 +69,33 @@ AvahiClient* avahi_client_new (
     void *userdata /**< Some arbitrary user data pointer that will be passed to the callback function */,
     int *error /**< If creation of the client fails, this integer will contain the error cause. May be NULL if you aren't interested in the reason why avahi_client_new() failed. */);
 
+/** Creates a new client instance that is shared by several threads
+ * and runs on the event loop of threaded_poll. Like with any client
+ * on an AvahiThreadedPoll, other threads need to hold the lock of
+ * threaded_poll while they call into the client, and while they look
+ * at avahi_client_errno() afterwards. Unlike other clients it lets go
+ * of the lock while it waits for the daemon to reply to a call, so
+ * that other threads can use the client in the meantime, and leaves
+ * reading the reply to the helper thread of threaded_poll. This
+ * thread needs to be running for that.
+ *
+ * This means that callbacks may run in the helper thread while
+ * another thread is in the middle of a call. A callback may see, and
+ * free, a browser or resolver before the call creating it has
+ * returned it. If a callback frees an object another thread is making
+ * a call on, that call fails with AVAHI_ERR_INVALID_OBJECT. If a
+ * callback frees the client, calls in progress fail, and the client
+ * is actually freed by the helper thread once they have returned. In
+ * all of these cases the other thread must not use the object or the
+ * client afterwards.
+ * \since 0.9 */
+AvahiClient* avahi_client_new_threaded (
+    AvahiThreadedPoll *threaded_poll /**< The event loop to use */,
+    AvahiClientFlags flags /**< Same as for avahi_client_new() */,
+    AvahiClientCallback callback /**< Same as for avahi_client_new() */,
+    void *userdata /**< Some arbitrary user data pointer that will be passed to the callback function */,
+    int *error /**< Same as for avahi_client_new() */);
+
 /** Free a client instance. This will automatically free all
  * associated browser, resolve and entry group objects. All pointers
  * to such objects become invalid! */
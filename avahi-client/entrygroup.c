@@ -66,7 +66,7 @@ static int retrieve_state(AvahiEntryGroup *group) {
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block(client->bus, message, -1, &error)) ||
+    if (!(reply = avahi_client_send_with_reply_and_block(client, message, &error)) ||
         dbus_error_is_set (&error)) {
         r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
         goto fail;
@@ -98,17 +98,33 @@ fail:
     return r;
 }
 
+static void entry_group_created(void *object, int error) {
+    AvahiEntryGroup *group = object;
+
+    assert(group);
+
+    group->creating = 0;
+
+    if (error < 0)
+        avahi_entry_group_set_state(group, AVAHI_ENTRY_GROUP_FAILURE);
+}
+
+static void entry_group_call_callback(void *object, int error) {
+    AvahiEntryGroup *group = object;
+
+    assert(group);
+
+    if (error < 0)
+        avahi_entry_group_set_state(group, AVAHI_ENTRY_GROUP_FAILURE);
+}
+
 AvahiEntryGroup* avahi_entry_group_new (AvahiClient *client, AvahiEntryGroupCallback callback, void *userdata) {
     AvahiEntryGroup *group = NULL;
-    DBusMessage *message = NULL, *reply = NULL;
-    DBusError error;
-    char *path;
+    DBusMessage *message = NULL;
     int state;
 
     assert(client);
 
-    dbus_error_init (&error);
-
     if (!avahi_client_is_connected(client)) {
         avahi_client_set_errno(client, AVAHI_ERR_BAD_STATE);
         goto fail;
@@ -124,6 +140,7 @@ AvahiEntryGroup* avahi_entry_group_new (AvahiClient *client, AvahiEntryGroupCall
     group->userdata = userdata;
     group->state_valid = 0;
     group->path = NULL;
+    group->creating = 0;
     AVAHI_LLIST_PREPEND(AvahiEntryGroup, groups, client->groups, group);
 
     if (!(message = dbus_message_new_method_call(
@@ -135,27 +152,14 @@ AvahiEntryGroup* avahi_entry_group_new (AvahiClient *client, AvahiEntryGroupCall
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block (client->bus, message, -1, &error)) ||
-        dbus_error_is_set (&error)) {
-        avahi_client_set_errno (client, AVAHI_ERR_DBUS_ERROR);
+    if (avahi_client_create_object(client, message, group, &group->path, AVAHI_DBUS_INTERFACE_ENTRY_GROUP, entry_group_created) < 0)
         goto fail;
-    }
 
-    if (!dbus_message_get_args(reply, &error, DBUS_TYPE_OBJECT_PATH, &path, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set (&error)) {
-        avahi_client_set_errno (client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
-
-    if (!(group->path = avahi_strdup (path))) {
-
-        /* FIXME: We don't remove the object on the server side */
-
-        avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
-        goto fail;
-    }
-
-    if ((state = retrieve_state(group)) < 0) {
+    if (client->flags & AVAHI_CLIENT_ASYNC_CALLS) {
+        /* New groups on the server are always empty */
+        group->creating = 1;
+        state = AVAHI_ENTRY_GROUP_UNCOMMITED;
+    } else if ((state = retrieve_state(group)) < 0) {
         avahi_client_set_errno(client, state);
         goto fail;
     }
@@ -163,84 +167,50 @@ AvahiEntryGroup* avahi_entry_group_new (AvahiClient *client, AvahiEntryGroupCall
     avahi_entry_group_set_state(group, (AvahiEntryGroupState) state);
 
     dbus_message_unref(message);
-    dbus_message_unref(reply);
 
     return group;
 
 fail:
-    if (dbus_error_is_set(&error)) {
-        avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
-    }
-
     if (group)
         avahi_entry_group_free(group);
 
     if (message)
         dbus_message_unref(message);
 
-    if (reply)
-        dbus_message_unref(reply);
-
     return NULL;
 }
 
-static int entry_group_simple_method_call(AvahiEntryGroup *group, const char *method) {
-    DBusMessage *message = NULL, *reply = NULL;
-    DBusError error;
-    int r = AVAHI_OK;
-    AvahiClient *client;
-
-    dbus_error_init(&error);
-
+/* Calls made while the group is still being created get their path
+ * when they are actually sent */
+static DBusMessage *new_method_call(AvahiEntryGroup *group, const char *method) {
     assert(group);
-    client = group->client;
-
-    if (!(message = dbus_message_new_method_call(AVAHI_DBUS_NAME, group->path, AVAHI_DBUS_INTERFACE_ENTRY_GROUP, method))) {
-        r = avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
-        goto fail;
-    }
+    assert(method);
 
-    if (!(reply = dbus_connection_send_with_reply_and_block(client->bus, message, -1, &error)) ||
-        dbus_error_is_set (&error)) {
-        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
-
-    if (!dbus_message_get_args(reply, &error, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set (&error)) {
-        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
-
-    dbus_message_unref(message);
-    dbus_message_unref(reply);
+    return dbus_message_new_method_call(AVAHI_DBUS_NAME, group->path ? group->path : AVAHI_DBUS_PATH_SERVER, AVAHI_DBUS_INTERFACE_ENTRY_GROUP, method);
+}
 
-    return AVAHI_OK;
+static int entry_group_simple_method_call(AvahiEntryGroup *group, const char *method) {
+    DBusMessage *message;
+    int r;
 
-fail:
-    if (dbus_error_is_set(&error)) {
-        r = avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
-    }
+    assert(group);
 
-    if (message)
-        dbus_message_unref(message);
+    if (!(message = new_method_call(group, method)))
+        return avahi_client_set_errno(group->client, AVAHI_ERR_NO_MEMORY);
 
-    if (reply)
-        dbus_message_unref(reply);
+    r = avahi_client_object_call(group->client, message, group, &group->path, entry_group_call_callback);
+    dbus_message_unref(message);
 
     return r;
 }
 
 int avahi_entry_group_free(AvahiEntryGroup *group) {
     AvahiClient *client = group->client;
-    int r = AVAHI_OK;
+    int r;
 
     assert(group);
 
-    if (group->path && avahi_client_is_connected(client))
-        r = entry_group_simple_method_call(group, "Free");
+    r = avahi_client_free_object(client, group, group->path, AVAHI_DBUS_INTERFACE_ENTRY_GROUP);
 
     AVAHI_LLIST_REMOVE(AvahiEntryGroup, groups, client->groups, group);
 
@@ -254,7 +224,7 @@ int avahi_entry_group_commit(AvahiEntryGroup *group) {
     int ret;
     assert(group);
 
-    if (!group->path || !avahi_client_is_connected(group->client))
+    if ((!group->path && !group->creating) || !avahi_client_is_connected(group->client))
         return avahi_client_set_errno(group->client, AVAHI_ERR_BAD_STATE);
 
     if ((ret = entry_group_simple_method_call(group, "Commit")) < 0)
@@ -268,7 +238,7 @@ int avahi_entry_group_reset(AvahiEntryGroup *group) {
     int ret;
     assert(group);
 
-    if (!group->path || !avahi_client_is_connected(group->client))
+    if ((!group->path && !group->creating) || !avahi_client_is_connected(group->client))
         return avahi_client_set_errno(group->client, AVAHI_ERR_BAD_STATE);
 
     if ((ret = entry_group_simple_method_call(group, "Reset")) < 0)
@@ -281,7 +251,9 @@ int avahi_entry_group_reset(AvahiEntryGroup *group) {
 int avahi_entry_group_get_state (AvahiEntryGroup *group) {
     assert (group);
 
-    if (group->state_valid)
+    /* Without a path the group is still being created, or creating it
+     * failed. Either way its state is known. */
+    if (group->state_valid || !group->path)
         return group->state;
 
     return retrieve_state(group);
@@ -313,7 +285,7 @@ int avahi_entry_group_is_empty (AvahiEntryGroup *group) {
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block(client->bus, message, -1, &error)) ||
+    if (!(reply = avahi_client_send_with_reply_and_block(client, message, &error)) ||
         dbus_error_is_set (&error)) {
         r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
         goto fail;
@@ -360,19 +332,17 @@ static int append_rdata(DBusMessage *message, const void *rdata, size_t size) {
     return 0;
 }
 
-static int append_string_list(DBusMessage *message, AvahiStringList *txt) {
-    DBusMessageIter iter, sub;
+static int append_string_list_iter(DBusMessageIter *iter, AvahiStringList *txt) {
+    DBusMessageIter sub;
     int r = -1;
     AvahiStringList *p;
 
-    assert(message);
-
-    dbus_message_iter_init_append(message, &iter);
+    assert(iter);
 
     /* Reverse the string list, so that we can pass it in-order to the server */
     txt = avahi_string_list_reverse(txt);
 
-    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "ay", &sub))
+    if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "ay", &sub))
         goto fail;
 
     /* Assemble the AvahiStringList into an Array of Array of Bytes to send over dbus */
@@ -386,7 +356,7 @@ static int append_string_list(DBusMessage *message, AvahiStringList *txt) {
             goto fail;
     }
 
-    if (!dbus_message_iter_close_container(&iter, &sub))
+    if (!dbus_message_iter_close_container(iter, &sub))
         goto fail;
 
     r = 0;
@@ -399,6 +369,15 @@ fail:
     return r;
 }
 
+static int append_string_list(DBusMessage *message, AvahiStringList *txt) {
+    DBusMessageIter iter;
+
+    assert(message);
+
+    dbus_message_iter_init_append(message, &iter);
+    return append_string_list_iter(&iter, txt);
+}
+
 int avahi_entry_group_add_service_strlst(
     AvahiEntryGroup *group,
     AvahiIfIndex interface,
@@ -411,9 +390,8 @@ int avahi_entry_group_add_service_strlst(
     uint16_t port,
     AvahiStringList *txt) {
 
-    DBusMessage *message = NULL, *reply = NULL;
+    DBusMessage *message = NULL;
     int r = AVAHI_OK;
-    DBusError error;
     AvahiClient *client;
     int32_t i_interface, i_protocol;
     uint32_t u_flags;
@@ -424,7 +402,7 @@ int avahi_entry_group_add_service_strlst(
 
     client = group->client;
 
-    if (!group->path || !avahi_client_is_connected(group->client))
+    if ((!group->path && !group->creating) || !avahi_client_is_connected(group->client))
         return avahi_client_set_errno(group->client, AVAHI_ERR_BAD_STATE);
 
     if (!domain)
@@ -433,9 +411,7 @@ int avahi_entry_group_add_service_strlst(
     if (!host)
         host = "";
 
-    dbus_error_init(&error);
-
-    if (!(message = dbus_message_new_method_call (AVAHI_DBUS_NAME, group->path, AVAHI_DBUS_INTERFACE_ENTRY_GROUP, "AddService"))) {
+    if (!(message = new_method_call(group, "AddService"))) {
         r = avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
         goto fail;
     }
@@ -460,35 +436,18 @@ int avahi_entry_group_add_service_strlst(
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block(client->bus, message, -1, &error)) ||
-        dbus_error_is_set (&error)) {
-        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+    if ((r = avahi_client_object_call(client, message, group, &group->path, entry_group_call_callback)) < 0)
         goto fail;
-    }
-
-    if (!dbus_message_get_args(reply, &error, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set (&error)) {
-        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
 
     dbus_message_unref(message);
-    dbus_message_unref(reply);
 
     return AVAHI_OK;
 
 fail:
 
-    if (dbus_error_is_set(&error)) {
-        r = avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
-    }
-
     if (message)
         dbus_message_unref(message);
 
-    if (reply)
-        dbus_message_unref(reply);
 
     return r;
 }
@@ -529,9 +488,8 @@ int avahi_entry_group_add_service_subtype(
     const char *domain,
     const char *subtype) {
 
-    DBusMessage *message = NULL, *reply = NULL;
+    DBusMessage *message = NULL;
     int r = AVAHI_OK;
-    DBusError error;
     AvahiClient *client;
     int32_t i_interface, i_protocol;
     uint32_t u_flags;
@@ -543,15 +501,13 @@ int avahi_entry_group_add_service_subtype(
 
     client = group->client;
 
-    if (!group->path || !avahi_client_is_connected(group->client))
+    if ((!group->path && !group->creating) || !avahi_client_is_connected(group->client))
         return avahi_client_set_errno(group->client, AVAHI_ERR_BAD_STATE);
 
     if (!domain)
         domain = "";
 
-    dbus_error_init(&error);
-
-    if (!(message = dbus_message_new_method_call (AVAHI_DBUS_NAME, group->path, AVAHI_DBUS_INTERFACE_ENTRY_GROUP, "AddServiceSubtype"))) {
+    if (!(message = new_method_call(group, "AddServiceSubtype"))) {
         r = avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
         goto fail;
     }
@@ -574,38 +530,157 @@ int avahi_entry_group_add_service_subtype(
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block(client->bus, message, -1, &error)) ||
-        dbus_error_is_set (&error)) {
-        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+    if ((r = avahi_client_object_call(client, message, group, &group->path, entry_group_call_callback)) < 0)
         goto fail;
+
+    dbus_message_unref(message);
+
+    return AVAHI_OK;
+
+fail:
+
+    if (message)
+        dbus_message_unref(message);
+
+
+    return r;
+
+}
+
+static int add_services_one_by_one(AvahiEntryGroup *group, const AvahiEntryGroupService *services, unsigned n_services) {
+    unsigned j;
+
+    for (j = 0; j < n_services; j++) {
+        const AvahiEntryGroupService *s = services + j;
+        AvahiStringList *l;
+        int r;
+
+        if ((r = avahi_entry_group_add_service_strlst(group, s->interface, s->protocol, s->flags, s->name, s->type, s->domain, s->host, s->port, s->txt)) < 0)
+            return r;
+
+        for (l = s->subtypes; l; l = l->next)
+            if ((r = avahi_entry_group_add_service_subtype(group, s->interface, s->protocol, s->flags & (AVAHI_PUBLISH_USE_WIDE_AREA|AVAHI_PUBLISH_USE_MULTICAST), s->name, s->type, s->domain, (const char*) l->text)) < 0)
+                return r;
     }
 
-    if (!dbus_message_get_args(reply, &error, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set (&error)) {
-        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+    return AVAHI_OK;
+}
+
+static int append_service(DBusMessageIter *iter, const AvahiEntryGroupService *s) {
+    DBusMessageIter sub, array;
+    int32_t i_interface, i_protocol;
+    uint32_t u_flags;
+    const char *domain, *host;
+    AvahiStringList *l;
+
+    assert(iter);
+    assert(s);
+    assert(s->name);
+    assert(s->type);
+
+    i_interface = (int32_t) s->interface;
+    i_protocol = (int32_t) s->protocol;
+    u_flags = (uint32_t) s->flags;
+    domain = s->domain ? s->domain : "";
+    host = s->host ? s->host : "";
+
+    if (!dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL, &sub))
+        return -1;
+
+    if (!dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &i_interface) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &i_protocol) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT32, &u_flags) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &s->name) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &s->type) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &domain) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &host) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT16, &s->port) ||
+        append_string_list_iter(&sub, s->txt) < 0)
         goto fail;
+
+    if (!dbus_message_iter_open_container(&sub, DBUS_TYPE_ARRAY, DBUS_TYPE_STRING_AS_STRING, &array))
+        goto fail;
+
+    for (l = s->subtypes; l; l = l->next) {
+        const char *subtype = (const char*) l->text;
+
+        if (!dbus_message_iter_append_basic(&array, DBUS_TYPE_STRING, &subtype)) {
+            dbus_message_iter_close_container(&sub, &array);
+            goto fail;
+        }
     }
 
-    dbus_message_unref(message);
-    dbus_message_unref(reply);
+    if (!dbus_message_iter_close_container(&sub, &array))
+        goto fail;
 
-    return AVAHI_OK;
+    return dbus_message_iter_close_container(iter, &sub) ? 0 : -1;
 
 fail:
+    /* libdbus leaks the signature of containers left open */
+    dbus_message_iter_close_container(iter, &sub);
+    return -1;
+}
 
-    if (dbus_error_is_set(&error)) {
-        r = avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
+int avahi_entry_group_add_services(
+    AvahiEntryGroup *group,
+    const AvahiEntryGroupService *services,
+    unsigned n_services) {
+
+    DBusMessage *message = NULL;
+    DBusMessageIter iter, array;
+    int r = AVAHI_OK;
+    AvahiClient *client;
+    unsigned j;
+
+    assert(group);
+    assert(services || n_services == 0);
+
+    client = group->client;
+
+    if ((!group->path && !group->creating) || !avahi_client_is_connected(group->client))
+        return avahi_client_set_errno(group->client, AVAHI_ERR_BAD_STATE);
+
+    if (client->api_version < AVAHI_CLIENT_DBUS_API_ADD_SERVICES)
+        return add_services_one_by_one(group, services, n_services);
+
+    if (!(message = new_method_call(group, "AddServices"))) {
+        r = avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+        goto fail;
+    }
+
+    dbus_message_iter_init_append(message, &iter);
+
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(iiussssqaayas)", &array)) {
+        r = avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+        goto fail;
+    }
+
+    for (j = 0; j < n_services; j++)
+        if (append_service(&array, services + j) < 0) {
+            dbus_message_iter_close_container(&iter, &array);
+            r = avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+            goto fail;
+        }
+
+    if (!dbus_message_iter_close_container(&iter, &array)) {
+        r = avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+        goto fail;
     }
 
+    if ((r = avahi_client_object_call(client, message, group, &group->path, entry_group_call_callback)) < 0)
+        goto fail;
+
+    dbus_message_unref(message);
+
+    return AVAHI_OK;
+
+fail:
+
     if (message)
         dbus_message_unref(message);
 
-    if (reply)
-        dbus_message_unref(reply);
 
     return r;
-
 }
 
 int avahi_entry_group_update_service_txt(
@@ -640,9 +715,8 @@ int avahi_entry_group_update_service_txt_strlst(
     const char *domain,
     AvahiStringList *txt) {
 
-    DBusMessage *message = NULL, *reply = NULL;
+    DBusMessage *message = NULL;
     int r = AVAHI_OK;
-    DBusError error;
     AvahiClient *client;
     int32_t i_interface, i_protocol;
     uint32_t u_flags;
@@ -653,15 +727,13 @@ int avahi_entry_group_update_service_txt_strlst(
 
     client = group->client;
 
-    if (!group->path || !avahi_client_is_connected(group->client))
+    if ((!group->path && !group->creating) || !avahi_client_is_connected(group->client))
         return avahi_client_set_errno(group->client, AVAHI_ERR_BAD_STATE);
 
     if (!domain)
         domain = "";
 
-    dbus_error_init(&error);
-
-    if (!(message = dbus_message_new_method_call (AVAHI_DBUS_NAME, group->path, AVAHI_DBUS_INTERFACE_ENTRY_GROUP, "UpdateServiceTxt"))) {
+    if (!(message = new_method_call(group, "UpdateServiceTxt"))) {
         r = avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
         goto fail;
     }
@@ -684,35 +756,18 @@ int avahi_entry_group_update_service_txt_strlst(
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block(client->bus, message, -1, &error)) ||
-        dbus_error_is_set (&error)) {
-        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+    if ((r = avahi_client_object_call(client, message, group, &group->path, entry_group_call_callback)) < 0)
         goto fail;
-    }
-
-    if (!dbus_message_get_args(reply, &error, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set (&error)) {
-        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
 
     dbus_message_unref(message);
-    dbus_message_unref(reply);
 
     return AVAHI_OK;
 
 fail:
 
-    if (dbus_error_is_set(&error)) {
-        r = avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
-    }
-
     if (message)
         dbus_message_unref(message);
 
-    if (reply)
-        dbus_message_unref(reply);
 
     return r;
 }
@@ -726,9 +781,8 @@ int avahi_entry_group_add_address(
     const char *name,
     const AvahiAddress *a) {
 
-    DBusMessage *message = NULL, *reply = NULL;
+    DBusMessage *message = NULL;
     int r = AVAHI_OK;
-    DBusError error;
     AvahiClient *client;
     int32_t i_interface, i_protocol;
     uint32_t u_flags;
@@ -739,12 +793,10 @@ int avahi_entry_group_add_address(
 
     client = group->client;
 
-    if (!group->path || !avahi_client_is_connected(group->client))
+    if ((!group->path && !group->creating) || !avahi_client_is_connected(group->client))
         return avahi_client_set_errno(group->client, AVAHI_ERR_BAD_STATE);
 
-    dbus_error_init(&error);
-
-    if (!(message = dbus_message_new_method_call (AVAHI_DBUS_NAME, group->path, AVAHI_DBUS_INTERFACE_ENTRY_GROUP, "AddAddress"))) {
+    if (!(message = new_method_call(group, "AddAddress"))) {
         r = avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
         goto fail;
     }
@@ -771,35 +823,18 @@ int avahi_entry_group_add_address(
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block(client->bus, message, -1, &error)) ||
-        dbus_error_is_set (&error)) {
-        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+    if ((r = avahi_client_object_call(client, message, group, &group->path, entry_group_call_callback)) < 0)
         goto fail;
-    }
-
-    if (!dbus_message_get_args(reply, &error, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set (&error)) {
-        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
 
     dbus_message_unref(message);
-    dbus_message_unref(reply);
 
     return AVAHI_OK;
 
 fail:
 
-    if (dbus_error_is_set(&error)) {
-        r = avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
-    }
-
     if (message)
         dbus_message_unref(message);
 
-    if (reply)
-        dbus_message_unref(reply);
 
     return r;
 }
@@ -817,9 +852,8 @@ int avahi_entry_group_add_record(
     const void *rdata,
     size_t size) {
 
-    DBusMessage *message = NULL, *reply = NULL;
+    DBusMessage *message = NULL;
     int r = AVAHI_OK;
-    DBusError error;
     AvahiClient *client;
     int32_t i_interface, i_protocol;
     uint32_t u_flags;
@@ -828,12 +862,10 @@ int avahi_entry_group_add_record(
 
     client = group->client;
 
-    if (!group->path || !avahi_client_is_connected(group->client))
+    if ((!group->path && !group->creating) || !avahi_client_is_connected(group->client))
         return avahi_client_set_errno(group->client, AVAHI_ERR_BAD_STATE);
 
-    dbus_error_init(&error);
-
-    if (!(message = dbus_message_new_method_call (AVAHI_DBUS_NAME, group->path, AVAHI_DBUS_INTERFACE_ENTRY_GROUP, "AddRecord"))) {
+    if (!(message = new_method_call(group, "AddRecord"))) {
         r = avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
         goto fail;
     }
@@ -856,35 +888,18 @@ int avahi_entry_group_add_record(
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block(client->bus, message, -1, &error)) ||
-        dbus_error_is_set (&error)) {
-        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
-
-    if (!dbus_message_get_args(reply, &error, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set (&error)) {
-        r = avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+    if ((r = avahi_client_object_call(client, message, group, &group->path, entry_group_call_callback)) < 0)
         goto fail;
-    }
 
     dbus_message_unref(message);
-    dbus_message_unref(reply);
 
     return AVAHI_OK;
 
 fail:
 
-    if (dbus_error_is_set(&error)) {
-        r = avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
-    }
-
     if (message)
         dbus_message_unref(message);
 
-    if (reply)
-        dbus_message_unref(reply);
 
     return r;
 }
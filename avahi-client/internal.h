@@ -25,9 +25,46 @@
 #include "client.h"
 #include "lookup.h"
 #include "publish.h"
+#include "cache.h"
+
+/* First D-Bus API version with ServiceBrowser.EnableBatching() */
+#define AVAHI_CLIENT_DBUS_API_BATCHING ((uint32_t) 0x0205)
+
+/* First D-Bus API version with Server2.GetServices() */
+#define AVAHI_CLIENT_DBUS_API_SNAPSHOT ((uint32_t) 0x0205)
+
+/* First D-Bus API version with Server2.ServiceBatchResolverNew() */
+#define AVAHI_CLIENT_DBUS_API_BATCH_RESOLVER ((uint32_t) 0x0205)
+
+/* First D-Bus API version with EntryGroup.AddServices() */
+#define AVAHI_CLIENT_DBUS_API_ADD_SERVICES ((uint32_t) 0x0205)
+
+/* The system bus doesn't allow more than 128 calls per connection
+ * waiting for a reply by default, further ones are queued */
+#define AVAHI_CLIENT_CALLS_PENDING_MAX 64
+
+typedef struct AvahiClientCall AvahiClientCall;
+typedef struct AvahiClientObject AvahiClientObject;
+typedef struct AvahiClientWaiter AvahiClientWaiter;
+
+/* Called when a method call sent with AVAHI_CLIENT_ASYNC_CALLS has
+ * finished. error is AVAHI_OK or an AVAHI_ERR_xxx code, which is
+ * then also the client error. */
+typedef void (*AvahiClientCallCallback)(void *object, int error);
 
 struct AvahiClient {
     const AvahiPoll *poll_api;
+
+    /* Only for clients created with avahi_client_new_threaded() */
+    AvahiThreadedPoll *threaded_poll;
+
+    /* Threads of a threaded client waiting for a reply. If the client
+     * is freed while there are any, it is only marked dead and the
+     * helper thread frees it from free_timeout once they are gone. */
+    AVAHI_LLIST_HEAD(AvahiClientWaiter, waiters);
+    AvahiTimeout *free_timeout;
+    int dead;
+
     DBusConnection *bus;
     int error;
     AvahiClientState state;
@@ -38,6 +75,9 @@ struct AvahiClient {
     uint32_t local_service_cookie;
     int local_service_cookie_valid;
 
+    /* The D-Bus API version implemented by the server */
+    uint32_t api_version;
+
     AvahiClientCallback callback;
     void *userdata;
 
@@ -49,10 +89,28 @@ struct AvahiClient {
     AVAHI_LLIST_HEAD(AvahiHostNameResolver, host_name_resolvers);
     AVAHI_LLIST_HEAD(AvahiAddressResolver, address_resolvers);
     AVAHI_LLIST_HEAD(AvahiRecordBrowser, record_browsers);
+    AVAHI_LLIST_HEAD(AvahiServiceBatchResolver, service_batch_resolvers);
+
+    /* Asynchronous method calls, newest first. Unsent calls are
+     * either waiting for the object they are made on to be created,
+     * or ready and waiting for one of the
+     * AVAHI_CLIENT_CALLS_PENDING_MAX slots. */
+    AVAHI_LLIST_HEAD(AvahiClientCall, calls);
+    AvahiClientCall *calls_tail;
+    unsigned n_calls_pending, n_calls_ready, n_calls_waiting;
+
+    /* Browsers, resolvers and entry groups by object path, for
+     * dispatching signals */
+    AvahiClientObject **object_buckets;
+    unsigned n_objects, n_object_buckets;
+
+    /* Only with AVAHI_CLIENT_CACHE_RESULTS */
+    AvahiClientCache *cache;
 };
 
 struct AvahiEntryGroup {
     char *path;
+    int creating;
     AvahiEntryGroupState state;
     int state_valid;
     AvahiClient *client;
@@ -112,6 +170,24 @@ struct AvahiServiceResolver {
     char *name, *type, *domain;
     AvahiIfIndex interface;
     AvahiProtocol protocol;
+    AvahiProtocol aprotocol;
+    AvahiLookupFlags flags;
+
+    /* Delivers a cached result instead of a server side resolver */
+    AvahiTimeout *cached_timeout;
+};
+
+struct AvahiServiceBatchResolver {
+    char *path;
+    AvahiClient *client;
+    AvahiServiceBatchResolverCallback callback;
+    void *userdata;
+    AVAHI_LLIST_FIELDS(AvahiServiceBatchResolver, service_batch_resolvers);
+
+    /* A copy of the services while the server object is being created
+     * asynchronously, for reporting them as failed */
+    AvahiServiceBatchResolverItem *items;
+    unsigned n_items;
 };
 
 struct AvahiHostNameResolver {
@@ -124,6 +200,10 @@ struct AvahiHostNameResolver {
     char *host_name;
     AvahiIfIndex interface;
     AvahiProtocol protocol;
+    AvahiProtocol aprotocol;
+    AvahiLookupFlags flags;
+
+    AvahiTimeout *cached_timeout;
 };
 
 struct AvahiAddressResolver {
@@ -159,13 +239,50 @@ void avahi_entry_group_set_state(AvahiEntryGroup *group, AvahiEntryGroupState st
 DBusHandlerResult avahi_domain_browser_event (AvahiClient *client, AvahiBrowserEvent event, DBusMessage *message);
 DBusHandlerResult avahi_service_type_browser_event (AvahiClient *client, AvahiBrowserEvent event, DBusMessage *message);
 DBusHandlerResult avahi_service_browser_event (AvahiClient *client, AvahiBrowserEvent event, DBusMessage *message);
+DBusHandlerResult avahi_service_browser_event_batch (AvahiClient *client, DBusMessage *message);
 DBusHandlerResult avahi_record_browser_event(AvahiClient *client, AvahiBrowserEvent event, DBusMessage *message);
 
 DBusHandlerResult avahi_service_resolver_event (AvahiClient *client, AvahiResolverEvent event, DBusMessage *message);
+DBusHandlerResult avahi_service_batch_resolver_event (AvahiClient *client, DBusMessage *message);
 DBusHandlerResult avahi_host_name_resolver_event (AvahiClient *client, AvahiResolverEvent event, DBusMessage *message);
 DBusHandlerResult avahi_address_resolver_event (AvahiClient *client, AvahiResolverEvent event, DBusMessage *message);
 
-int avahi_client_simple_method_call(AvahiClient *client, const char *path, const char *interface, const char *method);
+/* Call method on the server side object at path. object is the
+ * client side object, if any, see avahi_client_object_call(). */
+int avahi_client_simple_method_call(AvahiClient *client, const char *path, const char *interface, const char *method, void *object);
+
+/* Like dbus_connection_send_with_reply_and_block(), but clients
+ * created with avahi_client_new_threaded() let other threads use them
+ * while waiting. An error reply is returned as error. */
+DBusMessage* avahi_client_send_with_reply_and_block(AvahiClient *client, DBusMessage *message, DBusError *error);
+
+/* Send a method call that creates a server side object and store the
+ * path of the new object in *path. Waits for the reply unless the
+ * client was created with AVAHI_CLIENT_ASYNC_CALLS, in which case
+ * callback is called once the object exists or creating it failed.
+ * interface is the D-Bus interface of the new object. */
+int avahi_client_create_object(AvahiClient *client, DBusMessage *message, void *object, char **path, const char *interface, AvahiClientCallCallback callback);
+
+/* Send a method call without return values to object. With
+ * AVAHI_CLIENT_ASYNC_CALLS the call is queued while the object is
+ * still being created, i.e. *path is NULL, and the path of the message
+ * is filled in before it is sent. callback is only called for
+ * asynchronous calls. On a threaded client another thread may free
+ * object while this waits for the reply, the call then fails with
+ * AVAHI_ERR_INVALID_OBJECT and object must not be touched anymore. */
+int avahi_client_object_call(AvahiClient *client, DBusMessage *message, void *object, char **path, AvahiClientCallCallback callback);
+
+/* Look up an object created with avahi_client_create_object() by its
+ * path, NULL if there's no such object of the given interface */
+void *avahi_client_find_object(AvahiClient *client, const char *path, const char *interface);
+
+/* Free the server side object at path, which may be NULL if it hasn't
+ * been created yet, and cancel all calls made on it. Threads waiting
+ * for a reply to a call on object are told that it is gone. */
+int avahi_client_free_object(AvahiClient *client, void *object, const char *path, const char *interface);
+
+/* Read a basic value from iter and advance it, returns -1 if the type doesn't match */
+int avahi_client_iter_get_basic(DBusMessageIter *iter, int type, void *value);
 
 int avahi_client_is_connected(AvahiClient *client);
 
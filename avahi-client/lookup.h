@@ -116,6 +116,36 @@ AvahiClient* avahi_service_browser_get_client (AvahiServiceBrowser *);
 /** Cleans up and frees an AvahiServiceBrowser object */
 int avahi_service_browser_free (AvahiServiceBrowser *);
 
+/** The function prototype for the callback of
+ * avahi_service_browser_snapshot() \since 0.9 */
+typedef void (*AvahiServiceSnapshotCallback) (
+    AvahiClient *client,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name,
+    const char *type,
+    const char *domain,
+    AvahiLookupResultFlags flags,
+    void *userdata);
+
+/** Synchronously ask the server for all services of a type it
+ * currently knows about, without creating a browser object. The
+ * callback is called once for each service before this function
+ * returns. If refresh is non-zero the server sends a query for the
+ * type, so that services it hasn't seen yet are returned by later
+ * calls. Only multicast DNS is supported. Returns the number of
+ * services found or a negative error code. \since 0.9 */
+int avahi_service_browser_snapshot (
+    AvahiClient *client,
+    AvahiIfIndex interface,     /**< In most cases pass AVAHI_IF_UNSPEC here */
+    AvahiProtocol protocol,     /**< In most cases pass AVAHI_PROTO_UNSPEC here */
+    const char *type,           /**< A service type such as "_http._tcp" */
+    const char *domain,         /**< A domain to browse in. In most cases you want to pass NULL here for the default domain (usually ".local") */
+    AvahiLookupFlags flags,
+    int refresh,
+    AvahiServiceSnapshotCallback callback,
+    void *userdata);
+
 /** @} */
 
 /** \cond fulldocs */
@@ -214,6 +244,62 @@ AvahiClient* avahi_service_resolver_get_client (AvahiServiceResolver *);
 /** Free a service resolver object */
 int avahi_service_resolver_free(AvahiServiceResolver *r);
 
+/** A batch service resolver object \since 0.9 */
+typedef struct AvahiServiceBatchResolver AvahiServiceBatchResolver;
+
+/** A service to resolve with avahi_service_batch_resolver_new() \since 0.9 */
+typedef struct AvahiServiceBatchResolverItem {
+    AvahiIfIndex interface;   /**< The interface argument you received in AvahiServiceBrowserCallback */
+    AvahiProtocol protocol;   /**< The protocol argument you received in AvahiServiceBrowserCallback */
+    const char *name;         /**< The name argument you received in AvahiServiceBrowserCallback */
+    const char *type;         /**< The type argument you received in AvahiServiceBrowserCallback */
+    const char *domain;       /**< The domain argument you received in AvahiServiceBrowserCallback */
+} AvahiServiceBatchResolverItem;
+
+/** The function prototype for the callback of an
+ * AvahiServiceBatchResolver. idx is the position of the service in
+ * the array passed to avahi_service_batch_resolver_new(), the other
+ * arguments are the same as for AvahiServiceResolverCallback. \since 0.9 */
+typedef void (*AvahiServiceBatchResolverCallback) (
+    AvahiServiceBatchResolver *r,
+    unsigned idx,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    AvahiResolverEvent event,
+    const char *name,
+    const char *type,
+    const char *domain,
+    const char *host_name,
+    const AvahiAddress *a,
+    uint16_t port,
+    AvahiStringList *txt,
+    AvahiLookupResultFlags flags,
+    void *userdata);
+
+/** Resolve many services with a single server object and a single
+ * round trip, instead of creating one AvahiServiceResolver for each
+ * of them. The callback is called exactly once for every service,
+ * with either AVAHI_RESOLVER_FOUND or AVAHI_RESOLVER_FAILURE, in no
+ * particular order. The server resolves a limited number of services
+ * at the same time, services it has in its cache are reported
+ * almost immediately. Fails with AVAHI_ERR_NOT_SUPPORTED if the server
+ * is too old. \since 0.9 */
+AvahiServiceBatchResolver * avahi_service_batch_resolver_new(
+    AvahiClient *client,
+    const AvahiServiceBatchResolverItem *items,
+    unsigned n_items,
+    AvahiProtocol aprotocol,  /**< The desired address family of the service addresses. AVAHI_PROTO_UNSPEC if your application can deal with both IPv4 and IPv6 */
+    AvahiLookupFlags flags,
+    AvahiServiceBatchResolverCallback callback,
+    void *userdata);
+
+/** Get the parent client of an AvahiServiceBatchResolver object \since 0.9 */
+AvahiClient* avahi_service_batch_resolver_get_client (AvahiServiceBatchResolver *);
+
+/** Free a batch service resolver object. Services not reported yet
+ * are not resolved any further. \since 0.9 */
+int avahi_service_batch_resolver_free(AvahiServiceBatchResolver *r);
+
 /** @} */
 
 /** \cond fulldocs */
@@ -108,6 +108,33 @@ int avahi_entry_group_add_service_strlst(
     uint16_t port,
     AvahiStringList *txt /**< The TXT data for this service. You may free this object after calling this function, it is not referenced any further */);
 
+/** A service for avahi_entry_group_add_services(). The fields have the
+ * same meaning as the arguments of avahi_entry_group_add_service().
+ * \since 0.9 */
+typedef struct AvahiEntryGroupService {
+    AvahiIfIndex interface;
+    AvahiProtocol protocol;
+    AvahiPublishFlags flags;
+    const char *name;           /**< May not be NULL */
+    const char *type;           /**< May not be NULL */
+    const char *domain;         /**< May be NULL */
+    const char *host;           /**< May be NULL */
+    uint16_t port;
+    AvahiStringList *txt;       /**< The TXT data, may be NULL */
+    AvahiStringList *subtypes;  /**< Subtypes to register the service for, as with avahi_entry_group_add_service_subtype(). May be NULL. */
+} AvahiEntryGroupService;
+
+/** Add many services and their subtypes with a single call, which is
+ * much faster than adding them one by one. All services are checked
+ * before the first one is added. If adding one of them fails
+ * nonetheless, e.g. because of a local name collision, the services
+ * before it remain in the group. Each service and each subtype counts
+ * against the daemon's entries-per-entry-group-max limit. \since 0.9 */
+int avahi_entry_group_add_services(
+    AvahiEntryGroup *group,
+    const AvahiEntryGroupService *services,
+    unsigned n_services);
+
 /** Add a subtype for a service. The service should already be existent in the entry group. You may add as many subtypes for a service as you wish. */
 int avahi_entry_group_add_service_subtype(
     AvahiEntryGroup *group,
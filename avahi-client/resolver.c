@@ -52,11 +52,7 @@ DBusHandlerResult avahi_service_resolver_event (AvahiClient *client, AvahiResolv
     if (!(path = dbus_message_get_path(message)))
         goto fail;
 
-    for (r = client->service_resolvers; r; r = r->service_resolvers_next)
-        if (strcmp (r->path, path) == 0)
-            break;
-
-    if (!r)
+    if (!(r = avahi_client_find_object(client, path, AVAHI_DBUS_INTERFACE_SERVICE_RESOLVER)))
         goto fail;
 
     switch (event) {
@@ -143,6 +139,24 @@ DBusHandlerResult avahi_service_resolver_event (AvahiClient *client, AvahiResolv
 	    else
             	avahi_address_parse(address, (AvahiProtocol) aprotocol, &a);
 
+            if (client->cache) {
+                AvahiCachedService c;
+
+                c.interface = (AvahiIfIndex) interface;
+                c.protocol = (AvahiProtocol) protocol;
+                c.name = name;
+                c.type = type;
+                c.domain = domain;
+                c.host_name = host;
+                if ((c.has_address = !!address))
+                    c.address = a;
+                c.port = port;
+                c.txt = strlst;
+                c.flags = (AvahiLookupResultFlags) flags;
+
+                avahi_client_cache_add_service(client->cache, r->interface, r->protocol, r->name, r->type, r->domain, r->aprotocol, r->flags, &c);
+            }
+
             r->callback(r, (AvahiIfIndex) interface, (AvahiProtocol) protocol, AVAHI_RESOLVER_FOUND, name, type, domain, host, address ? &a : NULL, port, strlst, (AvahiLookupResultFlags) flags, r->userdata);
 
             avahi_string_list_free(strlst);
@@ -176,6 +190,90 @@ fail:
     return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
+static void service_resolver_created(void *object, int error) {
+    AvahiServiceResolver *r = object;
+
+    assert(r);
+
+    if (error < 0)
+        r->callback(r, r->interface, r->protocol, AVAHI_RESOLVER_FAILURE, r->name, r->type, r->domain, NULL, NULL, 0, NULL, 0, r->userdata);
+}
+
+static int service_resolver_start(AvahiServiceResolver *r) {
+    AvahiClient *client;
+    DBusMessage *message;
+    int32_t i_interface, i_protocol, i_aprotocol;
+    uint32_t u_flags;
+    const char *name, *domain;
+    int ret;
+
+    assert(r);
+
+    client = r->client;
+
+    if (!(message = dbus_message_new_method_call(AVAHI_DBUS_NAME, AVAHI_DBUS_PATH_SERVER, AVAHI_DBUS_INTERFACE_SERVER, "ServiceResolverNew")))
+        return avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+
+    i_interface = (int32_t) r->interface;
+    i_protocol = (int32_t) r->protocol;
+    i_aprotocol = (int32_t) r->aprotocol;
+    u_flags = (uint32_t) r->flags;
+    name = r->name ? r->name : "";
+    domain = r->domain ? r->domain : "";
+
+    if (!(dbus_message_append_args(
+              message,
+              DBUS_TYPE_INT32, &i_interface,
+              DBUS_TYPE_INT32, &i_protocol,
+              DBUS_TYPE_STRING, &name,
+              DBUS_TYPE_STRING, &r->type,
+              DBUS_TYPE_STRING, &domain,
+              DBUS_TYPE_INT32, &i_aprotocol,
+              DBUS_TYPE_UINT32, &u_flags,
+              DBUS_TYPE_INVALID))) {
+        dbus_message_unref(message);
+        return avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+    }
+
+    ret = avahi_client_create_object(client, message, r, &r->path, AVAHI_DBUS_INTERFACE_SERVICE_RESOLVER, service_resolver_created);
+    dbus_message_unref(message);
+
+    return ret;
+}
+
+static void service_resolver_cached(AvahiTimeout *t, void *userdata) {
+    AvahiServiceResolver *r = userdata;
+    const AvahiCachedService *c;
+    AvahiCachedService *copy;
+
+    assert(t);
+    assert(r);
+
+    r->client->poll_api->timeout_free(r->cached_timeout);
+    r->cached_timeout = NULL;
+
+    /* A browser might have reported the service as removed since the
+     * resolver was created, then ask the server after all */
+    if (!(c = avahi_client_cache_find_service(r->client->cache, r->interface, r->protocol, r->name, r->type, r->domain, r->aprotocol, r->flags))) {
+
+        if (service_resolver_start(r) < 0)
+            r->callback(r, r->interface, r->protocol, AVAHI_RESOLVER_FAILURE, r->name, r->type, r->domain, NULL, NULL, 0, NULL, 0, r->userdata);
+
+        return;
+    }
+
+    /* The callback might create resolvers or free the client */
+    if (!(copy = avahi_cached_service_copy(c))) {
+        avahi_client_set_errno(r->client, AVAHI_ERR_NO_MEMORY);
+        r->callback(r, r->interface, r->protocol, AVAHI_RESOLVER_FAILURE, r->name, r->type, r->domain, NULL, NULL, 0, NULL, 0, r->userdata);
+        return;
+    }
+
+    r->callback(r, copy->interface, copy->protocol, AVAHI_RESOLVER_FOUND, copy->name, copy->type, copy->domain, copy->host_name, copy->has_address ? &copy->address : NULL, copy->port, copy->txt, copy->flags | AVAHI_LOOKUP_RESULT_CACHED, r->userdata);
+
+    avahi_cached_service_free(copy);
+}
+
 AvahiServiceResolver * avahi_service_resolver_new(
     AvahiClient *client,
     AvahiIfIndex interface,
@@ -188,12 +286,7 @@ AvahiServiceResolver * avahi_service_resolver_new(
     AvahiServiceResolverCallback callback,
     void *userdata) {
 
-    DBusError error;
     AvahiServiceResolver *r = NULL;
-    DBusMessage *message = NULL, *reply = NULL;
-    int32_t i_interface, i_protocol, i_aprotocol;
-    uint32_t u_flags;
-    char *path;
 
     assert(client);
     assert(type);
@@ -204,8 +297,6 @@ AvahiServiceResolver * avahi_service_resolver_new(
     if (!name)
         name = "";
 
-    dbus_error_init (&error);
-
     if (!avahi_client_is_connected(client)) {
         avahi_client_set_errno(client, AVAHI_ERR_BAD_STATE);
         goto fail;
@@ -223,6 +314,9 @@ AvahiServiceResolver * avahi_service_resolver_new(
     r->name = r->type = r->domain = NULL;
     r->interface = interface;
     r->protocol = protocol;
+    r->aprotocol = aprotocol;
+    r->flags = flags;
+    r->cached_timeout = NULL;
 
     AVAHI_LLIST_PREPEND(AvahiServiceResolver, service_resolvers, client->service_resolvers, r);
 
@@ -243,100 +337,388 @@ AvahiServiceResolver * avahi_service_resolver_new(
             goto fail;
         }
 
+    if (client->cache && avahi_client_cache_find_service(client->cache, interface, protocol, name, type, domain, aprotocol, flags)) {
+        struct timeval tv = { 0, 0 };
+
+        if (!(r->cached_timeout = client->poll_api->timeout_new(client->poll_api, &tv, service_resolver_cached, r))) {
+            avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+            goto fail;
+        }
+
+        return r;
+    }
+
+    if (service_resolver_start(r) < 0)
+        goto fail;
+
+    return r;
+
+fail:
+
+    if (r)
+        avahi_service_resolver_free(r);
+
+    return NULL;
+
+}
+
+AvahiClient* avahi_service_resolver_get_client (AvahiServiceResolver *r) {
+    assert (r);
+
+    return r->client;
+}
+
+int avahi_service_resolver_free(AvahiServiceResolver *r) {
+    AvahiClient *client;
+    int ret = AVAHI_OK;
+
+    assert(r);
+    client = r->client;
+
+    ret = avahi_client_free_object(client, r, r->path, AVAHI_DBUS_INTERFACE_SERVICE_RESOLVER);
+
+    AVAHI_LLIST_REMOVE(AvahiServiceResolver, service_resolvers, client->service_resolvers, r);
+
+    if (r->cached_timeout)
+        client->poll_api->timeout_free(r->cached_timeout);
+
+    avahi_free(r->path);
+    avahi_free(r->name);
+    avahi_free(r->type);
+    avahi_free(r->domain);
+    avahi_free(r);
+
+    return ret;
+}
+
+/* AvahiServiceBatchResolver implementation */
+
+static AvahiServiceBatchResolver *find_service_batch_resolver(AvahiClient *client, const char *path) {
+    return avahi_client_find_object(client, path, AVAHI_DBUS_INTERFACE_SERVICE_BATCH_RESOLVER);
+}
+
+static int get_string_list(DBusMessageIter *iter, AvahiStringList **ret) {
+    DBusMessageIter sub;
+    AvahiStringList *strlst = NULL;
+
+    if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY ||
+        dbus_message_iter_get_element_type(iter) != DBUS_TYPE_ARRAY)
+        return -1;
+
+    dbus_message_iter_recurse(iter, &sub);
+
+    while (dbus_message_iter_get_arg_type(&sub) == DBUS_TYPE_ARRAY) {
+        DBusMessageIter sub2;
+        const uint8_t *k;
+        int n;
+
+        if (dbus_message_iter_get_element_type(&sub) != DBUS_TYPE_BYTE) {
+            avahi_string_list_free(strlst);
+            return -1;
+        }
+
+        dbus_message_iter_recurse(&sub, &sub2);
+
+        k = NULL; n = 0;
+        dbus_message_iter_get_fixed_array(&sub2, &k, &n);
+        if (k && n > 0)
+            strlst = avahi_string_list_add_arbitrary(strlst, k, n);
+
+        dbus_message_iter_next(&sub);
+    }
+
+    dbus_message_iter_next(iter);
+
+    *ret = strlst;
+    return 0;
+}
+
+DBusHandlerResult avahi_service_batch_resolver_event(AvahiClient *client, DBusMessage *message) {
+    DBusMessageIter iter, sub;
+    const char *path;
+
+    assert(client);
+    assert(message);
+
+    if (!(path = dbus_message_get_path(message)))
+        goto fail;
+
+    if (!find_service_batch_resolver(client, path))
+        goto fail;
+
+    if (!dbus_message_iter_init(message, &iter) ||
+        dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY ||
+        dbus_message_iter_get_element_type(&iter) != DBUS_TYPE_STRUCT) {
+        fprintf(stderr, "Failed to parse resolver event.\n");
+        goto fail;
+    }
+
+    dbus_message_iter_recurse(&iter, &sub);
+
+    while (dbus_message_iter_get_arg_type(&sub) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter item;
+        AvahiServiceBatchResolver *r;
+        uint32_t idx, flags;
+        int32_t event, interface, protocol, aprotocol;
+        char *name, *type, *domain, *host, *address, *etxt;
+        uint16_t port;
+        AvahiStringList *strlst = NULL;
+        AvahiAddress a;
+
+        dbus_message_iter_recurse(&sub, &item);
+
+        if (avahi_client_iter_get_basic(&item, DBUS_TYPE_UINT32, &idx) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_INT32, &event) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_INT32, &interface) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_INT32, &protocol) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_STRING, &name) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_STRING, &type) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_STRING, &domain) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_STRING, &host) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_INT32, &aprotocol) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_STRING, &address) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_UINT16, &port) < 0 ||
+            get_string_list(&item, &strlst) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_UINT32, &flags) < 0 ||
+            avahi_client_iter_get_basic(&item, DBUS_TYPE_STRING, &etxt) < 0 ||
+            (event != AVAHI_RESOLVER_FOUND && event != AVAHI_RESOLVER_FAILURE)) {
+            fprintf(stderr, "Failed to parse resolver event.\n");
+            avahi_string_list_free(strlst);
+            break;
+        }
+
+        /* The previous callback might have freed the resolver */
+        if (!(r = find_service_batch_resolver(client, path))) {
+            avahi_string_list_free(strlst);
+            break;
+        }
+
+        if (event == AVAHI_RESOLVER_FOUND) {
+            if (address[0] == 0 || !avahi_address_parse(address, (AvahiProtocol) aprotocol, &a))
+                address = NULL;
+
+            r->callback(r, idx, (AvahiIfIndex) interface, (AvahiProtocol) protocol, AVAHI_RESOLVER_FOUND, name, type, domain, host, address ? &a : NULL, port, strlst, (AvahiLookupResultFlags) flags, r->userdata);
+        } else {
+            avahi_client_set_errno(client, avahi_error_dbus_to_number(etxt));
+            r->callback(r, idx, (AvahiIfIndex) interface, (AvahiProtocol) protocol, AVAHI_RESOLVER_FAILURE, name[0] ? name : NULL, type, domain[0] ? domain : NULL, NULL, NULL, 0, NULL, 0, r->userdata);
+        }
+
+        avahi_string_list_free(strlst);
+        dbus_message_iter_next(&sub);
+    }
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+
+fail:
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static void batch_items_free(AvahiServiceBatchResolver *r) {
+    unsigned j;
+
+    assert(r);
+
+    for (j = 0; j < r->n_items; j++) {
+        avahi_free((char*) r->items[j].name);
+        avahi_free((char*) r->items[j].type);
+        avahi_free((char*) r->items[j].domain);
+    }
+
+    avahi_free(r->items);
+    r->items = NULL;
+    r->n_items = 0;
+}
+
+static int batch_items_copy(AvahiServiceBatchResolver *r, const AvahiServiceBatchResolverItem *items, unsigned n_items) {
+    assert(r);
+    assert(!r->items);
+
+    if (!(r->items = avahi_new0(AvahiServiceBatchResolverItem, n_items)))
+        return -1;
+
+    for (r->n_items = 0; r->n_items < n_items; r->n_items++) {
+        const AvahiServiceBatchResolverItem *i = &items[r->n_items];
+        AvahiServiceBatchResolverItem *c = &r->items[r->n_items];
+
+        c->interface = i->interface;
+        c->protocol = i->protocol;
+
+        if ((i->name && !(c->name = avahi_strdup(i->name))) ||
+            !(c->type = avahi_strdup(i->type)) ||
+            (i->domain && !(c->domain = avahi_strdup(i->domain)))) {
+            r->n_items++;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void service_batch_resolver_created(void *object, int error) {
+    AvahiServiceBatchResolver *r = object;
+    AvahiClient *client;
+    unsigned j;
+
+    assert(r);
+
+    client = r->client;
+
+    if (error < 0)
+        for (j = 0; j < r->n_items; j++) {
+            const AvahiServiceBatchResolverItem *i = &r->items[j];
+
+            r->callback(r, j, i->interface, i->protocol, AVAHI_RESOLVER_FAILURE, i->name, i->type, i->domain, NULL, NULL, 0, NULL, 0, r->userdata);
+
+            /* The callback might have freed the resolver */
+            for (r = client->service_batch_resolvers; r; r = r->service_batch_resolvers_next)
+                if (r == object)
+                    break;
 
-    if (!(message = dbus_message_new_method_call(AVAHI_DBUS_NAME, AVAHI_DBUS_PATH_SERVER, AVAHI_DBUS_INTERFACE_SERVER, "ServiceResolverNew"))) {
+            if (!r)
+                return;
+        }
+
+    batch_items_free(r);
+}
+
+AvahiServiceBatchResolver * avahi_service_batch_resolver_new(
+    AvahiClient *client,
+    const AvahiServiceBatchResolverItem *items,
+    unsigned n_items,
+    AvahiProtocol aprotocol,
+    AvahiLookupFlags flags,
+    AvahiServiceBatchResolverCallback callback,
+    void *userdata) {
+
+    AvahiServiceBatchResolver *r = NULL;
+    DBusMessage *message = NULL;
+    DBusMessageIter iter, array;
+    int32_t i_aprotocol;
+    uint32_t u_flags;
+    unsigned j;
+
+    assert(client);
+    assert(items);
+    assert(n_items > 0);
+    assert(callback);
+
+    if (!avahi_client_is_connected(client)) {
+        avahi_client_set_errno(client, AVAHI_ERR_BAD_STATE);
+        goto fail;
+    }
+
+    if (client->api_version < AVAHI_CLIENT_DBUS_API_BATCH_RESOLVER) {
+        avahi_client_set_errno(client, AVAHI_ERR_NOT_SUPPORTED);
+        goto fail;
+    }
+
+    if (!(r = avahi_new(AvahiServiceBatchResolver, 1))) {
         avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
         goto fail;
     }
 
-    i_interface = (int32_t) interface;
-    i_protocol = (int32_t) protocol;
-    i_aprotocol = (int32_t) aprotocol;
-    u_flags = (uint32_t) flags;
+    r->client = client;
+    r->callback = callback;
+    r->userdata = userdata;
+    r->path = NULL;
+    r->items = NULL;
+    r->n_items = 0;
 
-    if (!(dbus_message_append_args(
-              message,
-              DBUS_TYPE_INT32, &i_interface,
-              DBUS_TYPE_INT32, &i_protocol,
-              DBUS_TYPE_STRING, &name,
-              DBUS_TYPE_STRING, &type,
-              DBUS_TYPE_STRING, &domain,
-              DBUS_TYPE_INT32, &i_aprotocol,
-              DBUS_TYPE_UINT32, &u_flags,
-              DBUS_TYPE_INVALID))) {
+    AVAHI_LLIST_PREPEND(AvahiServiceBatchResolver, service_batch_resolvers, client->service_batch_resolvers, r);
+
+    if ((client->flags & AVAHI_CLIENT_ASYNC_CALLS) && batch_items_copy(r, items, n_items) < 0) {
         avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block(client->bus, message, -1, &error)) ||
-        dbus_error_is_set(&error)) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+    if (!(message = dbus_message_new_method_call(AVAHI_DBUS_NAME, AVAHI_DBUS_PATH_SERVER, AVAHI_DBUS_INTERFACE_SERVER2, "ServiceBatchResolverNew"))) {
+        avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
         goto fail;
     }
 
-    if (!dbus_message_get_args (reply, &error, DBUS_TYPE_OBJECT_PATH, &path, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set(&error) ||
-        !path) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+    dbus_message_iter_init_append(message, &iter);
+
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(iisss)", &array)) {
+        avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
         goto fail;
     }
 
-    if (!(r->path = avahi_strdup(path))) {
+    for (j = 0; j < n_items; j++) {
+        DBusMessageIter sub;
+        int32_t i_interface, i_protocol;
+        const char *name, *domain;
+
+        assert(items[j].type);
+
+        i_interface = (int32_t) items[j].interface;
+        i_protocol = (int32_t) items[j].protocol;
+        name = items[j].name ? items[j].name : "";
+        domain = items[j].domain ? items[j].domain : "";
+
+        if (!dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT, NULL, &sub) ||
+            !dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &i_interface) ||
+            !dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &i_protocol) ||
+            !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &name) ||
+            !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &items[j].type) ||
+            !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &domain) ||
+            !dbus_message_iter_close_container(&array, &sub)) {
+            /* libdbus leaks the signature of containers left open */
+            dbus_message_iter_close_container(&iter, &array);
+            avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+            goto fail;
+        }
+    }
 
-        /* FIXME: We don't remove the object on the server side */
+    i_aprotocol = (int32_t) aprotocol;
+    u_flags = (uint32_t) flags;
 
+    if (!dbus_message_iter_close_container(&iter, &array) ||
+        !dbus_message_append_args(
+            message,
+            DBUS_TYPE_INT32, &i_aprotocol,
+            DBUS_TYPE_UINT32, &u_flags,
+            DBUS_TYPE_INVALID)) {
         avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
         goto fail;
     }
 
+    if (avahi_client_create_object(client, message, r, &r->path, AVAHI_DBUS_INTERFACE_SERVICE_BATCH_RESOLVER, service_batch_resolver_created) < 0)
+        goto fail;
 
     dbus_message_unref(message);
-    dbus_message_unref(reply);
 
     return r;
 
 fail:
 
-    if (dbus_error_is_set(&error)) {
-        avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
-    }
-
     if (r)
-        avahi_service_resolver_free(r);
+        avahi_service_batch_resolver_free(r);
 
     if (message)
         dbus_message_unref(message);
 
-    if (reply)
-        dbus_message_unref(reply);
-
     return NULL;
-
 }
 
-AvahiClient* avahi_service_resolver_get_client (AvahiServiceResolver *r) {
+AvahiClient* avahi_service_batch_resolver_get_client (AvahiServiceBatchResolver *r) {
     assert (r);
 
     return r->client;
 }
 
-int avahi_service_resolver_free(AvahiServiceResolver *r) {
+int avahi_service_batch_resolver_free(AvahiServiceBatchResolver *r) {
     AvahiClient *client;
     int ret = AVAHI_OK;
 
     assert(r);
     client = r->client;
 
-    if (r->path && avahi_client_is_connected(client))
-        ret = avahi_client_simple_method_call(client, r->path, AVAHI_DBUS_INTERFACE_SERVICE_RESOLVER, "Free");
+    ret = avahi_client_free_object(client, r, r->path, AVAHI_DBUS_INTERFACE_SERVICE_BATCH_RESOLVER);
 
-    AVAHI_LLIST_REMOVE(AvahiServiceResolver, service_resolvers, client->service_resolvers, r);
+    AVAHI_LLIST_REMOVE(AvahiServiceBatchResolver, service_batch_resolvers, client->service_batch_resolvers, r);
 
+    batch_items_free(r);
     avahi_free(r->path);
-    avahi_free(r->name);
-    avahi_free(r->type);
-    avahi_free(r->domain);
     avahi_free(r);
 
     return ret;
@@ -357,11 +739,7 @@ DBusHandlerResult avahi_host_name_resolver_event (AvahiClient *client, AvahiReso
     if (!(path = dbus_message_get_path(message)))
         goto fail;
 
-    for (r = client->host_name_resolvers; r; r = r->host_name_resolvers_next)
-        if (strcmp (r->path, path) == 0)
-            break;
-
-    if (!r)
+    if (!(r = avahi_client_find_object(client, path, AVAHI_DBUS_INTERFACE_HOST_NAME_RESOLVER)))
         goto fail;
 
     switch (event) {
@@ -391,6 +769,18 @@ DBusHandlerResult avahi_host_name_resolver_event (AvahiClient *client, AvahiReso
                 goto fail;
             }
 
+            if (client->cache) {
+                AvahiCachedHostName c;
+
+                c.interface = (AvahiIfIndex) interface;
+                c.protocol = (AvahiProtocol) protocol;
+                c.name = name;
+                c.address = a;
+                c.flags = (AvahiLookupResultFlags) flags;
+
+                avahi_client_cache_add_host_name(client->cache, r->interface, r->protocol, r->host_name, r->aprotocol, r->flags, &c);
+            }
+
             r->callback(r, (AvahiIfIndex) interface, (AvahiProtocol) protocol, AVAHI_RESOLVER_FOUND, name, &a, (AvahiLookupResultFlags) flags, r->userdata);
             break;
         }
@@ -421,6 +811,82 @@ fail:
 }
 
 
+static void host_name_resolver_created(void *object, int error) {
+    AvahiHostNameResolver *r = object;
+
+    assert(r);
+
+    if (error < 0)
+        r->callback(r, r->interface, r->protocol, AVAHI_RESOLVER_FAILURE, r->host_name, NULL, 0, r->userdata);
+}
+
+static int host_name_resolver_start(AvahiHostNameResolver *r) {
+    AvahiClient *client;
+    DBusMessage *message;
+    int32_t i_interface, i_protocol, i_aprotocol;
+    uint32_t u_flags;
+    int ret;
+
+    assert(r);
+
+    client = r->client;
+
+    if (!(message = dbus_message_new_method_call(AVAHI_DBUS_NAME, AVAHI_DBUS_PATH_SERVER, AVAHI_DBUS_INTERFACE_SERVER, "HostNameResolverNew")))
+        return avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+
+    i_interface = (int32_t) r->interface;
+    i_protocol = (int32_t) r->protocol;
+    i_aprotocol = (int32_t) r->aprotocol;
+    u_flags = (uint32_t) r->flags;
+
+    if (!(dbus_message_append_args(
+              message,
+              DBUS_TYPE_INT32, &i_interface,
+              DBUS_TYPE_INT32, &i_protocol,
+              DBUS_TYPE_STRING, &r->host_name,
+              DBUS_TYPE_INT32, &i_aprotocol,
+              DBUS_TYPE_UINT32, &u_flags,
+              DBUS_TYPE_INVALID))) {
+        dbus_message_unref(message);
+        return avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+    }
+
+    ret = avahi_client_create_object(client, message, r, &r->path, AVAHI_DBUS_INTERFACE_HOST_NAME_RESOLVER, host_name_resolver_created);
+    dbus_message_unref(message);
+
+    return ret;
+}
+
+static void host_name_resolver_cached(AvahiTimeout *t, void *userdata) {
+    AvahiHostNameResolver *r = userdata;
+    const AvahiCachedHostName *c;
+    AvahiCachedHostName *copy;
+
+    assert(t);
+    assert(r);
+
+    r->client->poll_api->timeout_free(r->cached_timeout);
+    r->cached_timeout = NULL;
+
+    if (!(c = avahi_client_cache_find_host_name(r->client->cache, r->interface, r->protocol, r->host_name, r->aprotocol, r->flags))) {
+
+        if (host_name_resolver_start(r) < 0)
+            r->callback(r, r->interface, r->protocol, AVAHI_RESOLVER_FAILURE, r->host_name, NULL, 0, r->userdata);
+
+        return;
+    }
+
+    if (!(copy = avahi_cached_host_name_copy(c))) {
+        avahi_client_set_errno(r->client, AVAHI_ERR_NO_MEMORY);
+        r->callback(r, r->interface, r->protocol, AVAHI_RESOLVER_FAILURE, r->host_name, NULL, 0, r->userdata);
+        return;
+    }
+
+    r->callback(r, copy->interface, copy->protocol, AVAHI_RESOLVER_FOUND, copy->name, &copy->address, copy->flags | AVAHI_LOOKUP_RESULT_CACHED, r->userdata);
+
+    avahi_cached_host_name_free(copy);
+}
+
 AvahiHostNameResolver * avahi_host_name_resolver_new(
     AvahiClient *client,
     AvahiIfIndex interface,
@@ -431,18 +897,11 @@ AvahiHostNameResolver * avahi_host_name_resolver_new(
     AvahiHostNameResolverCallback callback,
     void *userdata) {
 
-    DBusError error;
     AvahiHostNameResolver *r = NULL;
-    DBusMessage *message = NULL, *reply = NULL;
-    int32_t i_interface, i_protocol, i_aprotocol;
-    uint32_t u_flags;
-    char *path;
 
     assert(client);
     assert(name);
 
-    dbus_error_init (&error);
-
     if (!avahi_client_is_connected(client)) {
         avahi_client_set_errno(client, AVAHI_ERR_BAD_STATE);
         goto fail;
@@ -459,7 +918,10 @@ AvahiHostNameResolver * avahi_host_name_resolver_new(
     r->path = NULL;
     r->interface = interface;
     r->protocol = protocol;
+    r->aprotocol = aprotocol;
+    r->flags = flags;
     r->host_name = NULL;
+    r->cached_timeout = NULL;
 
     AVAHI_LLIST_PREPEND(AvahiHostNameResolver, host_name_resolvers, client->host_name_resolvers, r);
 
@@ -468,70 +930,27 @@ AvahiHostNameResolver * avahi_host_name_resolver_new(
         goto fail;
     }
 
-    if (!(message = dbus_message_new_method_call(AVAHI_DBUS_NAME, AVAHI_DBUS_PATH_SERVER, AVAHI_DBUS_INTERFACE_SERVER, "HostNameResolverNew"))) {
-        avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
-        goto fail;
-    }
-
-    i_interface = (int32_t) interface;
-    i_protocol = (int32_t) protocol;
-    i_aprotocol = (int32_t) aprotocol;
-    u_flags = (uint32_t) flags;
-
-    if (!(dbus_message_append_args(
-              message,
-              DBUS_TYPE_INT32, &i_interface,
-              DBUS_TYPE_INT32, &i_protocol,
-              DBUS_TYPE_STRING, &name,
-              DBUS_TYPE_INT32, &i_aprotocol,
-              DBUS_TYPE_UINT32, &u_flags,
-              DBUS_TYPE_INVALID))) {
-        avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
-        goto fail;
-    }
+    if (client->cache && avahi_client_cache_find_host_name(client->cache, interface, protocol, name, aprotocol, flags)) {
+        struct timeval tv = { 0, 0 };
 
-    if (!(reply = dbus_connection_send_with_reply_and_block(client->bus, message, -1, &error)) ||
-        dbus_error_is_set(&error)) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
+        if (!(r->cached_timeout = client->poll_api->timeout_new(client->poll_api, &tv, host_name_resolver_cached, r))) {
+            avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+            goto fail;
+        }
 
-    if (!dbus_message_get_args (reply, &error, DBUS_TYPE_OBJECT_PATH, &path, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set(&error) ||
-        !path) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
+        return r;
     }
 
-    if (!(r->path = avahi_strdup(path))) {
-
-        /* FIXME: We don't remove the object on the server side */
-
-        avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
+    if (host_name_resolver_start(r) < 0)
         goto fail;
-    }
-
-    dbus_message_unref(message);
-    dbus_message_unref(reply);
 
     return r;
 
 fail:
 
-    if (dbus_error_is_set(&error)) {
-        avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
-    }
-
     if (r)
         avahi_host_name_resolver_free(r);
 
-    if (message)
-        dbus_message_unref(message);
-
-    if (reply)
-        dbus_message_unref(reply);
-
     return NULL;
 
 }
@@ -543,11 +962,13 @@ int avahi_host_name_resolver_free(AvahiHostNameResolver *r) {
     assert(r);
     client = r->client;
 
-    if (r->path && avahi_client_is_connected(client))
-        ret = avahi_client_simple_method_call(client, r->path, AVAHI_DBUS_INTERFACE_HOST_NAME_RESOLVER, "Free");
+    ret = avahi_client_free_object(client, r, r->path, AVAHI_DBUS_INTERFACE_HOST_NAME_RESOLVER);
 
     AVAHI_LLIST_REMOVE(AvahiHostNameResolver, host_name_resolvers, client->host_name_resolvers, r);
 
+    if (r->cached_timeout)
+        client->poll_api->timeout_free(r->cached_timeout);
+
     avahi_free(r->path);
     avahi_free(r->host_name);
     avahi_free(r);
@@ -576,11 +997,7 @@ DBusHandlerResult avahi_address_resolver_event (AvahiClient *client, AvahiResolv
     if (!(path = dbus_message_get_path(message)))
         goto fail;
 
-    for (r = client->address_resolvers; r; r = r->address_resolvers_next)
-        if (strcmp (r->path, path) == 0)
-            break;
-
-    if (!r)
+    if (!(r = avahi_client_find_object(client, path, AVAHI_DBUS_INTERFACE_ADDRESS_RESOLVER)))
         goto fail;
 
     switch (event) {
@@ -639,6 +1056,15 @@ fail:
     return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
+static void address_resolver_created(void *object, int error) {
+    AvahiAddressResolver *r = object;
+
+    assert(r);
+
+    if (error < 0)
+        r->callback(r, r->interface, r->protocol, AVAHI_RESOLVER_FAILURE, &r->address, NULL, 0, r->userdata);
+}
+
 AvahiAddressResolver * avahi_address_resolver_new(
     AvahiClient *client,
     AvahiIfIndex interface,
@@ -648,19 +1074,15 @@ AvahiAddressResolver * avahi_address_resolver_new(
     AvahiAddressResolverCallback callback,
     void *userdata) {
 
-    DBusError error;
     AvahiAddressResolver *r = NULL;
-    DBusMessage *message = NULL, *reply = NULL;
+    DBusMessage *message = NULL;
     int32_t i_interface, i_protocol;
     uint32_t u_flags;
-    char *path;
     char addr[AVAHI_ADDRESS_STR_MAX], *address = addr;
 
     assert(client);
     assert(a);
 
-    dbus_error_init (&error);
-
     if (!avahi_address_snprint (addr, sizeof(addr), a)) {
         avahi_client_set_errno(client, AVAHI_ERR_INVALID_ADDRESS);
         return NULL;
@@ -706,48 +1128,21 @@ AvahiAddressResolver * avahi_address_resolver_new(
         goto fail;
     }
 
-    if (!(reply = dbus_connection_send_with_reply_and_block(client->bus, message, -1, &error)) ||
-        dbus_error_is_set(&error)) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
-        goto fail;
-    }
-
-    if (!dbus_message_get_args (reply, &error, DBUS_TYPE_OBJECT_PATH, &path, DBUS_TYPE_INVALID) ||
-        dbus_error_is_set(&error) ||
-        !path) {
-        avahi_client_set_errno(client, AVAHI_ERR_DBUS_ERROR);
+    if (avahi_client_create_object(client, message, r, &r->path, AVAHI_DBUS_INTERFACE_ADDRESS_RESOLVER, address_resolver_created) < 0)
         goto fail;
-    }
-
-    if (!(r->path = avahi_strdup(path))) {
-
-        /* FIXME: We don't remove the object on the server side */
-
-        avahi_client_set_errno(client, AVAHI_ERR_NO_MEMORY);
-        goto fail;
-    }
 
     dbus_message_unref(message);
-    dbus_message_unref(reply);
 
     return r;
 
 fail:
 
-    if (dbus_error_is_set(&error)) {
-        avahi_client_set_dbus_error(client, &error);
-        dbus_error_free(&error);
-    }
-
     if (r)
         avahi_address_resolver_free(r);
 
     if (message)
         dbus_message_unref(message);
 
-    if (reply)
-        dbus_message_unref(reply);
-
     return NULL;
 
 }
@@ -765,8 +1160,7 @@ int avahi_address_resolver_free(AvahiAddressResolver *r) {
     assert(r);
     client = r->client;
 
-    if (r->path && avahi_client_is_connected(client))
-        ret = avahi_client_simple_method_call(client, r->path, AVAHI_DBUS_INTERFACE_ADDRESS_RESOLVER, "Free");
+    ret = avahi_client_free_object(client, r, r->path, AVAHI_DBUS_INTERFACE_ADDRESS_RESOLVER);
 
     AVAHI_LLIST_REMOVE(AvahiAddressResolver, address_resolvers, client->address_resolvers, r);
 
@@ -0,0 +1,168 @@
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include <avahi-client/client.h>
+#include <avahi-client/lookup.h>
+#include <avahi-client/publish.h>
+
+#include <avahi-common/error.h>
+#include <avahi-common/thread-watch.h>
+#include <avahi-common/gccmacro.h>
+
+#define N_THREADS 32
+#define N_ROUNDS 50
+
+static AvahiThreadedPoll *threaded_poll = NULL;
+static AvahiClient *client = NULL;
+static unsigned n_failed = 0, n_browser_resolvers = 0;
+static int browsed = 0;
+
+static void resolver_callback(
+    AvahiServiceResolver *r,
+    AVAHI_GCC_UNUSED AvahiIfIndex interface,
+    AVAHI_GCC_UNUSED AvahiProtocol protocol,
+    AVAHI_GCC_UNUSED AvahiResolverEvent event,
+    AVAHI_GCC_UNUSED const char *name,
+    AVAHI_GCC_UNUSED const char *type,
+    AVAHI_GCC_UNUSED const char *domain,
+    AVAHI_GCC_UNUSED const char *host_name,
+    AVAHI_GCC_UNUSED const AvahiAddress *a,
+    AVAHI_GCC_UNUSED uint16_t port,
+    AVAHI_GCC_UNUSED AvahiStringList *txt,
+    AVAHI_GCC_UNUSED AvahiLookupResultFlags flags,
+    void *userdata) {
+
+    /* Resolvers of the other threads are freed by those threads, which
+     * may not even have got them back yet */
+    if (userdata)
+        avahi_service_resolver_free(r);
+}
+
+static void browser_callback(
+    AvahiServiceBrowser *b,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    AvahiBrowserEvent event,
+    const char *name,
+    const char *type,
+    const char *domain,
+    AVAHI_GCC_UNUSED AvahiLookupResultFlags flags,
+    AVAHI_GCC_UNUSED void *userdata) {
+
+    if (event == AVAHI_BROWSER_ALL_FOR_NOW || event == AVAHI_BROWSER_FAILURE) {
+        browsed = 1;
+        avahi_threaded_poll_signal(threaded_poll);
+    }
+
+    if (event != AVAHI_BROWSER_NEW)
+        return;
+
+    /* This thread has to read the reply itself */
+    if (!avahi_service_resolver_new(avahi_service_browser_get_client(b), interface, protocol, name, type, domain, AVAHI_PROTO_UNSPEC, 0, resolver_callback, b)) {
+        fprintf(stderr, "Failed to create resolver in the helper thread: %s\n", avahi_strerror(avahi_client_errno(client)));
+        n_failed++;
+    } else
+        n_browser_resolvers++;
+}
+
+static void *thread_func(void *userdata) {
+    unsigned i, n = (unsigned) (uintptr_t) userdata;
+
+    for (i = 0; i < N_ROUNDS; i++) {
+        AvahiServiceResolver *r;
+        char name[64];
+
+        snprintf(name, sizeof(name), "thread-test %u/%u", n, i);
+
+        avahi_threaded_poll_lock(threaded_poll);
+
+        if (!(r = avahi_service_resolver_new(client, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, name, "_thread-test._tcp", NULL, AVAHI_PROTO_UNSPEC, 0, resolver_callback, NULL))) {
+            fprintf(stderr, "Failed to create resolver: %s\n", avahi_strerror(avahi_client_errno(client)));
+            n_failed++;
+        } else
+            avahi_service_resolver_free(r);
+
+        avahi_threaded_poll_unlock(threaded_poll);
+    }
+
+    return NULL;
+}
+
+int main(AVAHI_GCC_UNUSED int argc, AVAHI_GCC_UNUSED char *argv[]) {
+    pthread_t threads[N_THREADS];
+    AvahiEntryGroup *g;
+    unsigned i;
+    int error, r;
+
+    threaded_poll = avahi_threaded_poll_new();
+    assert(threaded_poll);
+
+    if (!(client = avahi_client_new_threaded(threaded_poll, 0, NULL, NULL, &error))) {
+        fprintf(stderr, "Failed to create client: %s\n", avahi_strerror(error));
+        return 1;
+    }
+
+    /* Browsing for a service of our own makes the helper thread create
+     * a resolver while the other threads wait for theirs */
+    g = avahi_entry_group_new(client, NULL, NULL);
+    assert(g);
+    r = avahi_entry_group_add_service(g, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, 0, "thread-test", "_thread-test._tcp", NULL, NULL, 4711, NULL);
+    assert(r >= 0);
+    r = avahi_entry_group_commit(g);
+    assert(r >= 0);
+    if (!avahi_service_browser_new(client, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, "_thread-test._tcp", NULL, 0, browser_callback, NULL)) {
+        fprintf(stderr, "Failed to create browser: %s\n", avahi_strerror(avahi_client_errno(client)));
+        return 1;
+    }
+
+    r = avahi_threaded_poll_start(threaded_poll);
+    assert(r >= 0);
+
+    for (i = 0; i < N_THREADS; i++) {
+        r = pthread_create(&threads[i], NULL, thread_func, (void*) (uintptr_t) i);
+        assert(r == 0);
+    }
+
+    for (i = 0; i < N_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    avahi_threaded_poll_lock(threaded_poll);
+
+    while (!browsed)
+        avahi_threaded_poll_wait(threaded_poll);
+
+    avahi_threaded_poll_unlock(threaded_poll);
+
+    avahi_threaded_poll_stop(threaded_poll);
+
+    printf("%u threads made %u resolvers each, the helper thread %u, %u failed\n", N_THREADS, N_ROUNDS, n_browser_resolvers, n_failed);
+
+    avahi_client_free(client);
+    avahi_threaded_poll_free(threaded_poll);
+
+    return n_failed ? 1 : 0;
+}
@@ -78,7 +78,8 @@ static void connection_data_unref(ConnectionData *d) {
     assert(d->ref >= 1);
 
     if (--d->ref <= 0) {
-        d->poll_api->timeout_free(d->dispatch_timeout);
+        if (d->dispatch_timeout)
+            d->poll_api->timeout_free(d->dispatch_timeout);
         avahi_free(d);
     }
 }
@@ -355,3 +356,36 @@ fail:
 
     return -1;
 }
+
+int avahi_dbus_server_glue(DBusServer *s, const AvahiPoll *poll_api) {
+    ConnectionData *d = NULL;
+
+    assert(s);
+    assert(poll_api);
+
+    /* A server has nothing to dispatch, it only needs its listening
+     * sockets watched */
+    if (!(d = avahi_new(ConnectionData, 1)))
+        return -1;
+
+    d->poll_api = poll_api;
+    d->connection = NULL;
+    d->dispatch_timeout = NULL;
+    d->ref = 1;
+
+    if (!(dbus_server_set_watch_functions(s, add_watch, remove_watch, watch_toggled, connection_data_ref(d), (DBusFreeFunction)connection_data_unref)))
+        goto fail;
+
+    if (!(dbus_server_set_timeout_functions(s, add_timeout, remove_timeout, timeout_toggled, connection_data_ref(d), (DBusFreeFunction)connection_data_unref)))
+        goto fail;
+
+    connection_data_unref(d);
+
+    return 0;
+
+fail:
+
+    connection_data_unref(d);
+
+    return -1;
+}
@@ -27,6 +27,7 @@
 AVAHI_C_DECL_BEGIN
 
 int avahi_dbus_connection_glue(DBusConnection *c, const AvahiPoll *poll_api);
+int avahi_dbus_server_glue(DBusServer *s, const AvahiPoll *poll_api);
 
 AVAHI_C_DECL_END
 
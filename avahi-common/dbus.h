@@ -39,6 +39,7 @@ AVAHI_C_DECL_BEGIN
 #define AVAHI_DBUS_INTERFACE_HOST_NAME_RESOLVER AVAHI_DBUS_NAME".HostNameResolver"
 #define AVAHI_DBUS_INTERFACE_SERVICE_RESOLVER AVAHI_DBUS_NAME".ServiceResolver"
 #define AVAHI_DBUS_INTERFACE_RECORD_BROWSER AVAHI_DBUS_NAME".RecordBrowser"
+#define AVAHI_DBUS_INTERFACE_SERVICE_BATCH_RESOLVER AVAHI_DBUS_NAME".ServiceBatchResolver"
 
 /** The D-Bus API version identifier. The first byte specifies the API
 release, the second byte specifies the revision. If the revision
@@ -47,8 +48,9 @@ compatible. If the release changes compatibility is lost.
 
 Avahi 0.6 implements API version 0x0201;
 Avahi 0.6.1 implements API version 0x0202
-Avahi 0.7 implements API version 0x0203 */
-#define AVAHI_DBUS_API_VERSION ((uint32_t) 0x0204)
+Avahi 0.7 implements API version 0x0203;
+Avahi 0.9 implements API version 0x0205 */
+#define AVAHI_DBUS_API_VERSION ((uint32_t) 0x0205)
 
 #define AVAHI_DBUS_ERR_OK "org.freedesktop.Avahi.Success"
 #define AVAHI_DBUS_ERR_FAILURE "org.freedesktop.Avahi.Failure"
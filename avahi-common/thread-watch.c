@@ -41,6 +41,7 @@ struct AvahiThreadedPoll {
     AvahiSimplePoll *simple_poll;
     pthread_t thread_id;
     pthread_mutex_t mutex;
+    pthread_cond_t cond;
     int thread_running;
     int retval;
 };
@@ -84,6 +85,7 @@ AvahiThreadedPoll *avahi_threaded_poll_new(void) {
         goto fail;
 
     pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->cond, NULL);
 
     avahi_simple_poll_set_func(p->simple_poll, poll_func, &p->mutex);
 
@@ -96,6 +98,7 @@ fail:
         if (p->simple_poll) {
             avahi_simple_poll_free(p->simple_poll);
             pthread_mutex_destroy(&p->mutex);
+            pthread_cond_destroy(&p->cond);
         }
 
         avahi_free(p);
@@ -117,6 +120,7 @@ void avahi_threaded_poll_free(AvahiThreadedPoll *p) {
         avahi_simple_poll_free(p->simple_poll);
 
     pthread_mutex_destroy(&p->mutex);
+    pthread_cond_destroy(&p->cond);
     avahi_free(p);
 }
 
@@ -184,3 +188,20 @@ void avahi_threaded_poll_unlock(AvahiThreadedPoll *p) {
 
     pthread_mutex_unlock(&p->mutex);
 }
+
+int avahi_threaded_poll_wait(AvahiThreadedPoll *p) {
+    assert(p);
+
+    /* Nobody would wake us up */
+    if (!p->thread_running || pthread_equal(pthread_self(), p->thread_id))
+        return -1;
+
+    pthread_cond_wait(&p->cond, &p->mutex);
+    return 0;
+}
+
+void avahi_threaded_poll_signal(AvahiThreadedPoll *p) {
+    assert(p);
+
+    pthread_cond_broadcast(&p->cond);
+}
@@ -75,6 +75,20 @@ void avahi_threaded_poll_lock(AvahiThreadedPoll *p);
  * avahi_threaded_poll_lock() \since 0.6.4 */
 void avahi_threaded_poll_unlock(AvahiThreadedPoll *p);
 
+/** Release the lock of the event loop object until another thread
+ * calls avahi_threaded_poll_signal(), and take it again, like
+ * pthread_cond_wait(). Call this with the lock held, to wait for
+ * something the helper thread does. Wakeups may be spurious, so
+ * check what you are waiting for in a loop. Returns -1 right away if
+ * the helper thread is not running or this is the helper thread,
+ * since nobody would wake you up then. \since 0.9 */
+int avahi_threaded_poll_wait(AvahiThreadedPoll *p);
+
+/** Wake up all threads waiting in avahi_threaded_poll_wait(). Call
+ * this with the lock held, usually from a callback in the helper
+ * thread. \since 0.9 */
+void avahi_threaded_poll_signal(AvahiThreadedPoll *p);
+
 AVAHI_C_DECL_END
 
 #endif
@@ -27,15 +27,15 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
-#include <signal.h>
 #include <netinet/in.h>
 #include <fcntl.h>
 
 #include <sys/types.h>
 #include <sys/socket.h>
 
-#include <avahi-common/simple-watch.h>
+#include <avahi-common/thread-watch.h>
 #include <avahi-common/malloc.h>
+#include <avahi-common/llist.h>
 #include <avahi-common/error.h>
 #include <avahi-common/domain.h>
 #include <avahi-common/alternative.h>
@@ -48,10 +48,7 @@
 #include "dns_sd.h"
 
 enum {
-    COMMAND_POLL = 'p',
-    COMMAND_QUIT = 'q',
-    COMMAND_POLL_DONE = 'P',
-    COMMAND_POLL_FAILED = 'F'
+    COMMAND_EVENTS = 'e'
 };
 
 struct type_info {
@@ -60,17 +57,144 @@ struct type_info {
     int n_subtypes;
 };
 
+typedef struct Connection Connection;
+typedef struct Client Client;
+typedef struct Event Event;
+typedef struct Query Query;
+typedef struct Answer Answer;
+typedef struct Subscription Subscription;
+
+/* A reply queued for the callback of a ref. Which fields are used
+ * depends on the callback. */
+struct Event {
+    /* The ref whose callback gets it, which may be a subordinate of
+     * the ref it is queued on */
+    DNSServiceRef sdref;
+
+    DNSServiceFlags flags;
+    uint32_t interface;
+    DNSServiceErrorType error;
+
+    /* The service name, or the full name of a resolved service or a
+     * record */
+    char *name;
+    char *type, *domain, *host_name;
+
+    /* In network byte order */
+    uint16_t port;
+
+    uint16_t rrtype, rrclass;
+
+    /* The TXT data of a resolved service, or the record data */
+    uint16_t rdlen;
+    void *rdata;
+
+    AVAHI_LLIST_FIELDS(Event, events);
+};
+
+/* The daemon limits the number of objects per client, each ref needs
+ * one */
+#define CLIENT_REFS_MAX 256
+
+#define QUERIES_HASH_SIZE 127
+
+/* All refs share one thread, which only queues the replies for each
+ * ref. They are passed on to the application in
+ * DNSServiceProcessResult(). It exists as long as there are refs. */
+struct Connection {
+    int n_ref;
+
+    AvahiThreadedPoll *threaded_poll;
+
+    /* Protected by the lock of threaded_poll, like everything the
+     * thread touches */
+    AVAHI_LLIST_HEAD(Client, clients);
+
+    /* Hashed by name and type */
+    Query *queries[QUERIES_HASH_SIZE];
+};
+
+/* Refs share clients too, a new one is only created when the others
+ * are full or have failed. Failed clients are kept until their refs
+ * have been deallocated. */
+struct Client {
+    Connection *connection;
+    AvahiClient *client;
+    int failed;
+
+    /* Refs and queries, both need an object in the daemon */
+    unsigned n_refs;
+    AVAHI_LLIST_HEAD(struct _DNSServiceRef_t, refs);
+    AVAHI_LLIST_HEAD(Query, client_queries);
+
+    AVAHI_LLIST_FIELDS(Client, clients);
+};
+
+/* A record the browser of a query has reported and not yet removed.
+ * The same record is reported once per protocol, refs only hear of it
+ * once. */
+struct Answer {
+    AvahiIfIndex interface;
+    unsigned n_protocols;
+
+    char *name;
+    uint16_t rdlen;
+    void *rdata;
+
+    AVAHI_LLIST_FIELDS(Answer, answers);
+};
+
+/* Refs asking the same question share one record browser. Its answers
+ * are kept, so that refs joining later get them right away. */
+struct Query {
+    Connection *connection;
+    Client *client;
+    AvahiRecordBrowser *record_browser;
+    int failed;
+
+    AvahiIfIndex interface;
+    char *name;
+    uint16_t clazz, type;
+
+    AVAHI_LLIST_HEAD(Answer, answers);
+    AVAHI_LLIST_HEAD(Subscription, subscriptions);
+
+    AVAHI_LLIST_FIELDS(Query, queries);
+    AVAHI_LLIST_FIELDS(Query, client_queries);
+};
+
+#define REF_QUERIES_MAX 2
+
+struct Subscription {
+    DNSServiceRef sdref;
+    Query *query;
+
+    AVAHI_LLIST_FIELDS(Subscription, subscriptions);
+};
+
 struct _DNSServiceRef_t {
     int n_ref;
 
-    AvahiSimplePoll *simple_poll;
+    Connection *connection;
+    Client *shared_client;
 
-    int thread_fd, main_fd;
+    /* Set on refs created by DNSServiceCreateConnection() */
+    int is_connection;
 
-    pthread_t thread;
-    int thread_running;
+    /* Refs created with kDNSServiceFlagsShareConnection have no
+     * socket and no events of their own, they use those of their
+     * primary. They are deallocated with it. */
+    DNSServiceRef primary;
+    AVAHI_LLIST_HEAD(struct _DNSServiceRef_t, subordinates);
+
+    /* main_fd is readable while events_signalled is set */
+    int thread_fd, main_fd;
+    int events_signalled;
 
-    pthread_mutex_t mutex;
+    /* Newest first */
+    AVAHI_LLIST_HEAD(Event, events);
+    Event *events_tail;
+    unsigned n_events;
 
     void *context;
     DNSServiceBrowseReply service_browser_callback;
@@ -78,12 +202,16 @@ struct _DNSServiceRef_t {
     DNSServiceDomainEnumReply domain_browser_callback;
     DNSServiceRegisterReply service_register_callback;
     DNSServiceQueryRecordReply query_resolver_callback;
+    DNSServiceGetAddrInfoReply addr_info_callback;
 
     AvahiClient *client;
     AvahiServiceBrowser *service_browser;
     AvahiServiceResolver *service_resolver;
     AvahiDomainBrowser *domain_browser;
-    AvahiRecordBrowser *record_browser;
+
+    /* The A and AAAA queries of DNSServiceGetAddrInfo(), only the first
+     * one is used by DNSServiceQueryRecord() */
+    Subscription subscriptions[REF_QUERIES_MAX];
 
     struct type_info type_info;
     char *service_name, *service_name_chosen, *service_domain, *service_host;
@@ -92,8 +220,15 @@ struct _DNSServiceRef_t {
     AvahiStringList *service_txt;
 
     AvahiEntryGroup *entry_group;
+
+    AVAHI_LLIST_FIELDS(struct _DNSServiceRef_t, refs);
+    AVAHI_LLIST_FIELDS(struct _DNSServiceRef_t, subordinates);
 };
 
+/* Protects connection and its reference counter */
+static pthread_mutex_t connection_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Connection *connection = NULL;
+
 #define ASSERT_SUCCESS(r) { int __ret = (r); assert(__ret == 0); }
 
 static DNSServiceErrorType map_error(int error) {
@@ -285,153 +420,693 @@ static int write_command(int fd, char reply) {
     return 0;
 }
 
-static int poll_func(struct pollfd *ufds, unsigned int nfds, int timeout, void *userdata) {
-    DNSServiceRef sdref = userdata;
-    int ret;
+static void reg_client_callback(DNSServiceRef sdref, AvahiClientState state);
+
+static Event *event_new(DNSServiceFlags flags, uint32_t interface, DNSServiceErrorType error) {
+    Event *e;
+
+    if (!(e = avahi_new0(Event, 1)))
+        return NULL;
+
+    e->flags = flags;
+    e->interface = interface;
+    e->error = error;
+
+    return e;
+}
+
+static void event_free(Event *e) {
+    assert(e);
+
+    avahi_free(e->name);
+    avahi_free(e->type);
+    avahi_free(e->domain);
+    avahi_free(e->host_name);
+    avahi_free(e->rdata);
+    avahi_free(e);
+}
+
+/* Called with the lock of the event loop held, takes e */
+static void sdref_queue(DNSServiceRef sdref, Event *e) {
+    DNSServiceRef q;
 
     assert(sdref);
+    assert(e);
 
-    ASSERT_SUCCESS(pthread_mutex_unlock(&sdref->mutex));
+    e->sdref = sdref;
+    q = sdref->primary ? sdref->primary : sdref;
 
-/*     fprintf(stderr, "pre-syscall\n"); */
-    ret = poll(ufds, nfds, timeout);
-/*     fprintf(stderr, "post-syscall\n"); */
+    /* One byte on the socket stands for all queued events */
+    if (!q->events_signalled && write_command(q->thread_fd, COMMAND_EVENTS) >= 0)
+        q->events_signalled = 1;
 
-    ASSERT_SUCCESS(pthread_mutex_lock(&sdref->mutex));
+    AVAHI_LLIST_PREPEND(Event, events, q->events, e);
 
-    return ret;
+    if (!q->events_tail)
+        q->events_tail = e;
+
+    q->n_events++;
 }
 
-static void * thread_func(void *data) {
-    DNSServiceRef sdref = data;
-    sigset_t mask;
+/* Called with the lock of the event loop held */
+static void sdref_unqueue(DNSServiceRef q, Event *e) {
+    assert(q);
+    assert(e);
+    assert(q->n_events >= 1);
 
-    sigfillset(&mask);
-    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+    if (q->events_tail == e)
+        q->events_tail = e->events_prev;
 
-    sdref->thread = pthread_self();
-    sdref->thread_running = 1;
+    AVAHI_LLIST_REMOVE(Event, events, q->events, e);
+    q->n_events--;
+}
 
-    for (;;) {
-        char command;
+/* For the callbacks that get a service name, type and domain. Events
+ * are dropped if there's no memory to queue them. */
+static void sdref_queue_names(DNSServiceRef sdref, DNSServiceFlags flags, uint32_t interface, DNSServiceErrorType error, const char *name, const char *type, const char *domain) {
+    Event *e;
 
-        if ((command = read_command(sdref->thread_fd)) < 0)
-            break;
+    assert(sdref);
+
+    if (!(e = event_new(flags, interface, error)))
+        return;
+
+    if ((name && !(e->name = avahi_strdup(name))) ||
+        (type && !(e->type = avahi_strdup(type))) ||
+        (domain && !(e->domain = avahi_strdup(domain)))) {
+        event_free(e);
+        return;
+    }
+
+    sdref_queue(sdref, e);
+}
+
+static void sdref_dispatch(DNSServiceRef sdref, Event *e) {
+    assert(sdref);
+    assert(e);
+
+    if (sdref->service_browser_callback)
+        sdref->service_browser_callback(sdref, e->flags, e->interface, e->error, e->name, e->type, e->domain, sdref->context);
+    else if (sdref->service_resolver_callback)
+        sdref->service_resolver_callback(sdref, e->flags, e->interface, e->error, e->name, e->host_name, e->port, e->rdlen, e->rdata, sdref->context);
+    else if (sdref->domain_browser_callback)
+        sdref->domain_browser_callback(sdref, e->flags, e->interface, e->error, e->domain, sdref->context);
+    else if (sdref->service_register_callback)
+        sdref->service_register_callback(sdref, e->flags, e->error, e->name, e->type, e->domain, sdref->context);
+    else if (sdref->query_resolver_callback)
+        sdref->query_resolver_callback(sdref, e->flags, e->interface, e->error, e->name, e->rrtype, e->rrclass, e->rdlen, e->rdata, 0, sdref->context);
+    else if (sdref->addr_info_callback) {
+        struct sockaddr_in sa;
+        struct sockaddr_in6 sa6;
+        const struct sockaddr *address = NULL;
+
+        if (e->rrtype == AVAHI_DNS_TYPE_A && e->rdlen == sizeof(sa.sin_addr)) {
+            memset(&sa, 0, sizeof(sa));
+            sa.sin_family = AF_INET;
+            memcpy(&sa.sin_addr, e->rdata, sizeof(sa.sin_addr));
+            address = (const struct sockaddr*) &sa;
+
+        } else if (e->rrtype == AVAHI_DNS_TYPE_AAAA && e->rdlen == sizeof(sa6.sin6_addr)) {
+            memset(&sa6, 0, sizeof(sa6));
+            sa6.sin6_family = AF_INET6;
+            memcpy(&sa6.sin6_addr, e->rdata, sizeof(sa6.sin6_addr));
+
+            if (IN6_IS_ADDR_LINKLOCAL(&sa6.sin6_addr))
+                sa6.sin6_scope_id = e->interface;
+
+            address = (const struct sockaddr*) &sa6;
+
+        } else if (e->error == kDNSServiceErr_NoError)
+            return;
+
+        sdref->addr_info_callback(sdref, e->flags, e->interface, e->error, e->name, address, 0, sdref->context);
+    }
+}
+
+static void client_callback(AvahiClient *s, AvahiClientState state, void* userdata) {
+    Client *c = userdata;
+    DNSServiceRef sdref;
+    Query *q;
+    Subscription *sub;
+
+    assert(s);
+    assert(c);
+
+    /* Make new refs on another client */
+    if (state == AVAHI_CLIENT_FAILURE)
+        c->failed = 1;
+
+    for (sdref = c->refs; sdref; sdref = sdref->refs_next) {
+
+        if (sdref->service_register_callback)
+            reg_client_callback(sdref, state);
+        else if (state == AVAHI_CLIENT_FAILURE)
+            sdref_queue_names(sdref, 0, 0, kDNSServiceErr_Unknown, NULL, NULL, NULL);
+    }
+
+    if (state != AVAHI_CLIENT_FAILURE)
+        return;
+
+    /* Refs of other clients may be waiting for our queries too */
+    for (q = c->client_queries; q; q = q->client_queries_next) {
+        q->failed = 1;
+
+        for (sub = q->subscriptions; sub; sub = sub->subscriptions_next)
+            if (sub->sdref->shared_client != c)
+                sdref_queue_names(sub->sdref, 0, 0, kDNSServiceErr_Unknown, NULL, NULL, NULL);
+    }
+}
+
+static void client_free(Client *c) {
+    assert(c);
+    assert(c->n_refs == 0);
+    assert(!c->client_queries);
+
+    AVAHI_LLIST_REMOVE(Client, clients, c->connection->clients, c);
+
+    if (c->client)
+        avahi_client_free(c->client);
+
+    avahi_free(c);
+}
+
+/* Called with the lock of the event loop held. Returns preferred if
+ * it can take another ref. */
+static Client *client_get(Connection *connection, Client *preferred, int *ret_error) {
+    Client *c, *next;
+
+    assert(connection);
+    assert(ret_error);
+
+    if (preferred && !preferred->failed && preferred->n_refs < CLIENT_REFS_MAX)
+        return preferred;
+
+    for (c = connection->clients; c; c = next) {
+        next = c->clients_next;
+
+        if (c->failed && c->n_refs == 0)
+            client_free(c);
+        else if (!c->failed && c->n_refs < CLIENT_REFS_MAX)
+            return c;
+    }
+
+    if (!(c = avahi_new0(Client, 1))) {
+        *ret_error = AVAHI_ERR_NO_MEMORY;
+        return NULL;
+    }
+
+    c->connection = connection;
+    AVAHI_LLIST_PREPEND(Client, clients, connection->clients, c);
+
+    if (!(c->client = avahi_client_new_threaded(connection->threaded_poll, 0, client_callback, c, ret_error))) {
+        client_free(c);
+        return NULL;
+    }
+
+    return c;
+}
+
+/* Called with the lock of the event loop held, when a ref or query
+ * that counted in c->n_refs is gone */
+static void client_release(Client *c) {
+    assert(c);
+    assert(c->n_refs >= 1);
+
+    /* Keep one client around for the next ref */
+    if (--c->n_refs == 0 && (c->failed || c->clients_next || c->clients_prev))
+        client_free(c);
+}
+
+static void connection_free(Connection *c) {
+    assert(c);
+    assert(c->n_ref <= 0);
+
+    /* Nobody uses the clients anymore, no lock needed once the thread
+     * is gone */
+    if (c->threaded_poll)
+        avahi_threaded_poll_stop(c->threaded_poll);
+
+    while (c->clients)
+        client_free(c->clients);
 
-/*         fprintf(stderr, "Command: %c\n", command); */
+    if (c->threaded_poll)
+        avahi_threaded_poll_free(c->threaded_poll);
 
-        switch (command) {
+    avahi_free(c);
+}
+
+static Connection *connection_ref(int *ret_error) {
+    Connection *c;
+
+    assert(ret_error);
+
+    ASSERT_SUCCESS(pthread_mutex_lock(&connection_mutex));
+
+    if (!(c = connection)) {
+
+        if (!(c = avahi_new0(Connection, 1))) {
+            *ret_error = AVAHI_ERR_NO_MEMORY;
+            goto finish;
+        }
+
+        if (!(c->threaded_poll = avahi_threaded_poll_new()) ||
+            avahi_threaded_poll_start(c->threaded_poll) < 0) {
+            connection_free(c);
+            c = NULL;
+            *ret_error = AVAHI_ERR_NO_MEMORY;
+            goto finish;
+        }
+
+        connection = c;
+    }
+
+    c->n_ref++;
+
+finish:
+    ASSERT_SUCCESS(pthread_mutex_unlock(&connection_mutex));
+
+    return c;
+}
+
+static void connection_unref(Connection *c) {
+    int last;
+
+    assert(c);
+    assert(c->n_ref >= 1);
+
+    ASSERT_SUCCESS(pthread_mutex_lock(&connection_mutex));
+
+    if ((last = --c->n_ref <= 0))
+        connection = NULL;
+
+    ASSERT_SUCCESS(pthread_mutex_unlock(&connection_mutex));
+
+    if (last)
+        connection_free(c);
+}
+
+static unsigned query_hash(const char *name, uint16_t type) {
+    assert(name);
+
+    return (avahi_domain_hash(name) + type) % QUERIES_HASH_SIZE;
+}
 
-            case COMMAND_POLL: {
-                int ret;
+static void answer_free(Answer *a) {
+    assert(a);
 
-                ASSERT_SUCCESS(pthread_mutex_lock(&sdref->mutex));
+    avahi_free(a->name);
+    avahi_free(a->rdata);
+    avahi_free(a);
+}
+
+/* Called with the lock of the event loop held */
+static void query_queue(Subscription *sub, Answer *a, DNSServiceFlags flags) {
+    Query *q;
+    Event *e;
+
+    assert(sub);
+    assert(a);
+
+    q = sub->query;
+
+    if (!(e = event_new(flags, a->interface, kDNSServiceErr_NoError)))
+        return;
+
+    e->rrtype = q->type;
+    e->rrclass = q->clazz;
+    e->rdlen = a->rdlen;
+
+    if (!(e->name = avahi_strdup(a->name)) ||
+        (a->rdlen > 0 && !(e->rdata = avahi_memdup(a->rdata, a->rdlen)))) {
+        event_free(e);
+        return;
+    }
+
+    sdref_queue(sub->sdref, e);
+}
+
+static void query_callback(
+        AvahiRecordBrowser *r,
+        AvahiIfIndex interface,
+        AVAHI_GCC_UNUSED AvahiProtocol protocol,
+        AvahiBrowserEvent event,
+        const char *name,
+        AVAHI_GCC_UNUSED uint16_t clazz,
+        AVAHI_GCC_UNUSED uint16_t type,
+        const void* rdata,
+        size_t size,
+        AVAHI_GCC_UNUSED AvahiLookupResultFlags flags,
+        void *userdata) {
 
-                for (;;) {
-                    errno = 0;
+    Query *q = userdata;
+    Subscription *sub;
+    Answer *a;
 
-                    if ((ret = avahi_simple_poll_run(sdref->simple_poll)) < 0) {
+    assert(r);
+    assert(q);
 
-                        if (errno == EINTR)
-                            continue;
+    switch (event) {
 
-                        fprintf(stderr, __FILE__": avahi_simple_poll_run() failed: %s\n", strerror(errno));
-                    }
+        case AVAHI_BROWSER_NEW:
+        case AVAHI_BROWSER_REMOVE:
 
+            for (a = q->answers; a; a = a->answers_next)
+                if (a->interface == interface && a->rdlen == size && (size == 0 || memcmp(a->rdata, rdata, size) == 0))
+                    break;
+
+            if (event == AVAHI_BROWSER_NEW) {
+
+                if (a) {
+                    a->n_protocols++;
                     break;
                 }
 
-                ASSERT_SUCCESS(pthread_mutex_unlock(&sdref->mutex));
+                if (size > 0xFFFF || !(a = avahi_new0(Answer, 1)))
+                    break;
+
+                a->interface = interface;
+                a->n_protocols = 1;
+                a->rdlen = (uint16_t) size;
 
-                if (write_command(sdref->thread_fd, ret < 0 ? COMMAND_POLL_FAILED : COMMAND_POLL_DONE) < 0)
+                if (!(a->name = avahi_strdup(name)) ||
+                    (size > 0 && !(a->rdata = avahi_memdup(rdata, size)))) {
+                    answer_free(a);
                     break;
+                }
 
-                break;
+                AVAHI_LLIST_PREPEND(Answer, answers, q->answers, a);
+
+                for (sub = q->subscriptions; sub; sub = sub->subscriptions_next)
+                    query_queue(sub, a, kDNSServiceFlagsAdd);
+
+            } else {
+
+                if (!a || --a->n_protocols > 0)
+                    break;
+
+                AVAHI_LLIST_REMOVE(Answer, answers, q->answers, a);
+
+                for (sub = q->subscriptions; sub; sub = sub->subscriptions_next)
+                    query_queue(sub, a, 0);
+
+                answer_free(a);
             }
 
-            case COMMAND_QUIT:
-                return NULL;
-        }
+            break;
 
+        case AVAHI_BROWSER_ALL_FOR_NOW:
+        case AVAHI_BROWSER_CACHE_EXHAUSTED:
+            /* not implemented */
+            break;
+
+        case AVAHI_BROWSER_FAILURE:
+
+            /* New refs will start over with a query of their own */
+            q->failed = 1;
+
+            for (sub = q->subscriptions; sub; sub = sub->subscriptions_next)
+                sdref_queue_names(sub->sdref, 0, interface, map_error(avahi_client_errno(q->client->client)), NULL, NULL, NULL);
+
+            break;
     }
+}
+
+/* Called with the lock of the event loop held. A new query is created
+ * on preferred if it has room. */
+static Query *query_get(Connection *connection, Client *preferred, AvahiIfIndex interface, const char *name, uint16_t clazz, uint16_t type, int *ret_error) {
+    unsigned h;
+    Query *q;
+    Client *c;
+
+    assert(connection);
+    assert(name);
+    assert(ret_error);
+
+    h = query_hash(name, type);
+
+    for (q = connection->queries[h]; q; q = q->queries_next)
+        if (!q->failed &&
+            q->interface == interface &&
+            q->clazz == clazz &&
+            q->type == type &&
+            avahi_domain_equal(q->name, name))
+            return q;
+
+    if (!(c = client_get(connection, preferred, ret_error)))
+        return NULL;
+
+    if (!(q = avahi_new0(Query, 1)) || !(q->name = avahi_strdup(name))) {
+        avahi_free(q);
+        *ret_error = AVAHI_ERR_NO_MEMORY;
+        return NULL;
+    }
+
+    q->connection = connection;
+    q->client = c;
+    q->interface = interface;
+    q->clazz = clazz;
+    q->type = type;
+    c->n_refs++;
+
+    /* The query is linked only after this, since the lock may be let
+     * go in between. Nobody else will find it before it is
+     * complete. */
+    if (!(q->record_browser = avahi_record_browser_new(c->client, interface, AVAHI_PROTO_UNSPEC, name, clazz, type, 0, query_callback, q))) {
+        *ret_error = avahi_client_errno(c->client);
+
+        avahi_free(q->name);
+        avahi_free(q);
+        client_release(c);
+        return NULL;
+    }
+
+    q->failed = c->failed;
+
+    AVAHI_LLIST_PREPEND(Query, queries, connection->queries[h], q);
+    AVAHI_LLIST_PREPEND(Query, client_queries, c->client_queries, q);
+
+    return q;
+}
+
+/* Called with the lock of the event loop held */
+static void query_free(Query *q) {
+    Client *c;
+    Answer *a;
+
+    assert(q);
+    assert(!q->subscriptions);
+
+    c = q->client;
+
+    AVAHI_LLIST_REMOVE(Query, queries, q->connection->queries[query_hash(q->name, q->type)], q);
+    AVAHI_LLIST_REMOVE(Query, client_queries, c->client_queries, q);
+
+    /* May let go of the lock, answers coming in until then have
+     * nobody to go to */
+    avahi_record_browser_free(q->record_browser);
+
+    while ((a = q->answers)) {
+        AVAHI_LLIST_REMOVE(Answer, answers, q->answers, a);
+        answer_free(a);
+    }
+
+    avahi_free(q->name);
+    avahi_free(q);
+
+    client_release(c);
+}
+
+/* Called with the lock of the event loop held. The ref gets the answers
+ * known so far right away. */
+static void query_subscribe(Query *q, Subscription *sub, DNSServiceRef sdref) {
+    Answer *a;
+
+    assert(q);
+    assert(sub);
+    assert(sdref);
+    assert(!sub->query);
+
+    sub->sdref = sdref;
+    sub->query = q;
+    AVAHI_LLIST_PREPEND(Subscription, subscriptions, q->subscriptions, sub);
+
+    for (a = q->answers; a; a = a->answers_next)
+        query_queue(sub, a, kDNSServiceFlagsAdd);
+}
+
+/* Called with the lock of the event loop held */
+static void query_unsubscribe(Subscription *sub) {
+    Query *q;
+
+    assert(sub);
+    assert(sub->query);
+
+    q = sub->query;
+    AVAHI_LLIST_REMOVE(Subscription, subscriptions, q->subscriptions, sub);
+    sub->query = NULL;
 
-    return NULL;
+    if (!q->subscriptions)
+        query_free(q);
 }
 
-static DNSServiceRef sdref_new(void) {
+/* Returns with the lock of the event loop held on success. If primary
+ * is set, the new ref is its subordinate. */
+static DNSServiceRef sdref_new(DNSServiceRef primary, int *ret_error) {
     int fd[2] = { -1, -1 };
     DNSServiceRef sdref = NULL;
-    pthread_mutexattr_t mutex_attr;
+    Connection *connection;
+    Client *c;
 
-    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fd) < 0)
-        goto fail;
+    assert(ret_error);
+
+    if (!primary && socketpair(AF_UNIX, SOCK_STREAM, 0, fd) < 0) {
+        *ret_error = AVAHI_ERR_OS;
+        return NULL;
+    }
 
-    if (!(sdref = avahi_new0(struct _DNSServiceRef_t, 1)))
-        goto fail;
+    if (!(sdref = avahi_new0(struct _DNSServiceRef_t, 1))) {
+        if (fd[0] >= 0) {
+            close(fd[0]);
+            close(fd[1]);
+        }
+        *ret_error = AVAHI_ERR_NO_MEMORY;
+        return NULL;
+    }
 
     sdref->n_ref = 1;
     sdref->thread_fd = fd[0];
     sdref->main_fd = fd[1];
 
-    sdref->client = NULL;
-    sdref->service_browser = NULL;
-    sdref->service_resolver = NULL;
-    sdref->domain_browser = NULL;
-    sdref->entry_group = NULL;
+    type_info_init(&sdref->type_info);
+
+    if (!(connection = connection_ref(ret_error))) {
+        DNSServiceRefDeallocate(sdref);
+        return NULL;
+    }
 
-    sdref->service_name = sdref->service_name_chosen = sdref->service_domain = sdref->service_host = NULL;
-    sdref->service_txt = NULL;
+    sdref->connection = connection;
 
-    type_info_init(&sdref->type_info);
+    avahi_threaded_poll_lock(connection->threaded_poll);
 
-    ASSERT_SUCCESS(pthread_mutexattr_init(&mutex_attr));
-    pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_RECURSIVE);
-    ASSERT_SUCCESS(pthread_mutex_init(&sdref->mutex, &mutex_attr));
+    if (!(c = client_get(connection, primary ? primary->shared_client : NULL, ret_error))) {
+        avahi_threaded_poll_unlock(connection->threaded_poll);
+        DNSServiceRefDeallocate(sdref);
+        return NULL;
+    }
 
-    sdref->thread_running = 0;
+    sdref->shared_client = c;
+    sdref->client = c->client;
+    c->n_refs++;
+    AVAHI_LLIST_PREPEND(struct _DNSServiceRef_t, refs, c->refs, sdref);
 
-    if (!(sdref->simple_poll = avahi_simple_poll_new()))
-        goto fail;
+    if (primary) {
+        sdref->primary = primary;
+        AVAHI_LLIST_PREPEND(struct _DNSServiceRef_t, subordinates, primary->subordinates, sdref);
+    }
 
-    avahi_simple_poll_set_func(sdref->simple_poll, poll_func, sdref);
+    return sdref;
+}
 
-    /* Start simple poll */
-    if (avahi_simple_poll_prepare(sdref->simple_poll, -1) < 0)
-        goto fail;
+/* With kDNSServiceFlagsShareConnection, *ret_sdref is the primary the
+ * new ref is to be created on. Clears the flag and *ret_sdref. */
+static DNSServiceErrorType sdref_take_primary(DNSServiceRef *ret_sdref, DNSServiceFlags *flags, DNSServiceRef *primary) {
+    assert(ret_sdref);
+    assert(flags);
+    assert(primary);
 
-    /* Queue an initial POLL command for the thread */
-    if (write_command(sdref->main_fd, COMMAND_POLL) < 0)
-        goto fail;
+    *primary = NULL;
 
-    if (pthread_create(&sdref->thread, NULL, thread_func, sdref) != 0)
-        goto fail;
+    if (*flags & kDNSServiceFlagsShareConnection) {
+        DNSServiceRef p = *ret_sdref;
 
-    sdref->thread_running = 1;
+        if (!p || p->n_ref <= 0 || !p->is_connection)
+            return kDNSServiceErr_BadReference;
 
-    return sdref;
+        *primary = p;
+        *flags &= ~kDNSServiceFlagsShareConnection;
+    }
 
-fail:
+    *ret_sdref = NULL;
 
-    if (sdref)
-        DNSServiceRefDeallocate(sdref);
+    return kDNSServiceErr_NoError;
+}
+
+static void sdref_lock(DNSServiceRef sdref) {
+    assert(sdref);
+
+    avahi_threaded_poll_lock(sdref->connection->threaded_poll);
+}
+
+static void sdref_unlock(DNSServiceRef sdref) {
+    assert(sdref);
 
-    return NULL;
+    avahi_threaded_poll_unlock(sdref->connection->threaded_poll);
 }
 
 static void sdref_free(DNSServiceRef sdref) {
+    Connection *connection;
+    Client *c;
+    Event *e, *next;
+    unsigned i;
+
     assert(sdref);
 
-    if (sdref->thread_running) {
-        ASSERT_SUCCESS(write_command(sdref->main_fd, COMMAND_QUIT));
-        avahi_simple_poll_wakeup(sdref->simple_poll);
-        ASSERT_SUCCESS(pthread_join(sdref->thread, NULL));
-    }
+    /* Only the application touches this list */
+    while (sdref->subordinates)
+        sdref_free(sdref->subordinates);
+
+    if ((connection = sdref->connection)) {
+        avahi_threaded_poll_lock(connection->threaded_poll);
+
+        if ((c = sdref->shared_client)) {
+
+            /* The client may let go of the lock while freeing these,
+             * the client callback won't find the ref anymore then */
+            AVAHI_LLIST_REMOVE(struct _DNSServiceRef_t, refs, c->refs, sdref);
+
+            if (sdref->service_browser)
+                avahi_service_browser_free(sdref->service_browser);
+
+            if (sdref->service_resolver)
+                avahi_service_resolver_free(sdref->service_resolver);
 
-    if (sdref->client)
-        avahi_client_free(sdref->client);
+            if (sdref->domain_browser)
+                avahi_domain_browser_free(sdref->domain_browser);
 
-    if (sdref->simple_poll)
-        avahi_simple_poll_free(sdref->simple_poll);
+            for (i = 0; i < REF_QUERIES_MAX; i++)
+                if (sdref->subscriptions[i].query)
+                    query_unsubscribe(&sdref->subscriptions[i]);
+
+            if (sdref->entry_group)
+                avahi_entry_group_free(sdref->entry_group);
+
+            client_release(c);
+        }
+
+        /* Nothing is queued for the ref anymore once its objects are
+         * gone */
+        if (sdref->primary) {
+            AVAHI_LLIST_REMOVE(struct _DNSServiceRef_t, subordinates, sdref->primary->subordinates, sdref);
+
+            for (e = sdref->primary->events; e; e = next) {
+                next = e->events_next;
+
+                if (e->sdref == sdref) {
+                    sdref_unqueue(sdref->primary, e);
+                    event_free(e);
+                }
+            }
+        }
+
+        avahi_threaded_poll_unlock(connection->threaded_poll);
+
+        connection_unref(connection);
+    }
+
+    while ((e = sdref->events)) {
+        AVAHI_LLIST_REMOVE(Event, events, sdref->events, e);
+        event_free(e);
+    }
 
     if (sdref->thread_fd >= 0)
         close(sdref->thread_fd);
@@ -439,8 +1114,6 @@ static void sdref_free(DNSServiceRef sdref) {
     if (sdref->main_fd >= 0)
         close(sdref->main_fd);
 
-    ASSERT_SUCCESS(pthread_mutex_destroy(&sdref->mutex));
-
     avahi_free(sdref->service_name);
     avahi_free(sdref->service_name_chosen);
     avahi_free(sdref->service_domain);
@@ -480,41 +1153,54 @@ int DNSSD_API DNSServiceRefSockFD(DNSServiceRef sdref) {
 
 DNSServiceErrorType DNSSD_API DNSServiceProcessResult(DNSServiceRef sdref) {
     DNSServiceErrorType ret = kDNSServiceErr_Unknown;
+    unsigned n;
+    Event *e;
 
     AVAHI_WARN_LINKAGE;
 
     if (!sdref || sdref->n_ref <= 0)
         return kDNSServiceErr_BadParam;
 
-    sdref_ref(sdref);
+    /* Their events are processed on the primary */
+    if (sdref->primary)
+        return kDNSServiceErr_BadReference;
 
-    ASSERT_SUCCESS(pthread_mutex_lock(&sdref->mutex));
+    sdref_ref(sdref);
 
-    /* Cleanup notification socket */
-    if (read_command(sdref->main_fd) != COMMAND_POLL_DONE)
+    /* Blocks until there is something to dispatch */
+    if (read_command(sdref->main_fd) != COMMAND_EVENTS)
         goto finish;
 
-    if (avahi_simple_poll_dispatch(sdref->simple_poll) < 0)
-        goto finish;
+    sdref_lock(sdref);
 
-    if (sdref->n_ref > 1) /* Perhaps we should die */
+    sdref->events_signalled = 0;
 
-        /* Dispatch events */
-        if (avahi_simple_poll_prepare(sdref->simple_poll, -1) < 0)
-            goto finish;
+    /* Only those queued by now, so that a steady stream of new ones
+     * doesn't keep us here forever. Oldest first. */
+    for (n = sdref->n_events; n > 0 && sdref->n_ref > 1 && (e = sdref->events_tail); n--) { /* Perhaps we should die */
 
-    if (sdref->n_ref > 1)
+        sdref_unqueue(sdref, e);
 
-        /* Request the poll */
-        if (write_command(sdref->main_fd, COMMAND_POLL) < 0)
-            goto finish;
+        if (sdref->events)
+            e->flags |= kDNSServiceFlagsMoreComing;
+
+        /* Without the lock held, the callbacks may call into the
+         * library again, and deallocate any subordinate ref */
+        sdref_unlock(sdref);
+        sdref_dispatch(e->sdref, e);
+        event_free(e);
+        sdref_lock(sdref);
+    }
+
+    if (sdref->events && !sdref->events_signalled && write_command(sdref->thread_fd, COMMAND_EVENTS) >= 0)
+        sdref->events_signalled = 1;
+
+    sdref_unlock(sdref);
 
     ret = kDNSServiceErr_NoError;
 
 finish:
 
-    ASSERT_SUCCESS(pthread_mutex_unlock(&sdref->mutex));
-
     sdref_unref(sdref);
 
     return ret;
@@ -527,6 +1213,27 @@ void DNSSD_API DNSServiceRefDeallocate(DNSServiceRef sdref) {
         sdref_unref(sdref);
 }
 
+DNSServiceErrorType DNSSD_API DNSServiceCreateConnection(DNSServiceRef *ret_sdref) {
+    int error;
+    DNSServiceRef sdref;
+
+    AVAHI_WARN_LINKAGE;
+
+    if (!ret_sdref)
+        return kDNSServiceErr_BadParam;
+    *ret_sdref = NULL;
+
+    if (!(sdref = sdref_new(NULL, &error)))
+        return map_error(error);
+
+    sdref->is_connection = 1;
+
+    sdref_unlock(sdref);
+
+    *ret_sdref = sdref;
+    return kDNSServiceErr_NoError;
+}
+
 static void service_browser_callback(
     AvahiServiceBrowser *b,
     AvahiIfIndex interface,
@@ -549,15 +1256,15 @@ static void service_browser_callback(
 
     switch (event) {
         case AVAHI_BROWSER_NEW:
-            sdref->service_browser_callback(sdref, kDNSServiceFlagsAdd, interface, kDNSServiceErr_NoError, name, type, domain, sdref->context);
+            sdref_queue_names(sdref, kDNSServiceFlagsAdd, interface, kDNSServiceErr_NoError, name, type, domain);
             break;
 
         case AVAHI_BROWSER_REMOVE:
-            sdref->service_browser_callback(sdref, 0, interface, kDNSServiceErr_NoError, name, type, domain, sdref->context);
+            sdref_queue_names(sdref, 0, interface, kDNSServiceErr_NoError, name, type, domain);
             break;
 
         case AVAHI_BROWSER_FAILURE:
-            sdref->service_browser_callback(sdref, 0, interface, map_error(avahi_client_errno(sdref->client)), NULL, NULL, NULL, sdref->context);
+            sdref_queue_names(sdref, 0, interface, map_error(avahi_client_errno(sdref->client)), NULL, NULL, NULL);
             break;
 
         case AVAHI_BROWSER_CACHE_EXHAUSTED:
@@ -566,37 +1273,6 @@ static void service_browser_callback(
     }
 }
 
-static void generic_client_callback(AvahiClient *s, AvahiClientState state, void* userdata) {
-    DNSServiceRef sdref = userdata;
-    int error = kDNSServiceErr_Unknown;
-
-    assert(s);
-    assert(sdref);
-    assert(sdref->n_ref >= 1);
-
-    switch (state) {
-
-        case AVAHI_CLIENT_FAILURE:
-
-            if (sdref->service_browser_callback)
-                sdref->service_browser_callback(sdref, 0, 0, error, NULL, NULL, NULL, sdref->context);
-            else if (sdref->service_resolver_callback)
-                sdref->service_resolver_callback(sdref, 0, 0, error, NULL, NULL, 0, 0, NULL, sdref->context);
-            else if (sdref->domain_browser_callback)
-                sdref->domain_browser_callback(sdref, 0, 0, error, NULL, sdref->context);
-            else if (sdref->query_resolver_callback)
-                sdref->query_resolver_callback(sdref, 0, 0, error, NULL, 0, 0, 0, NULL, 0, sdref->context);
-
-            break;
-
-        case AVAHI_CLIENT_S_RUNNING:
-        case AVAHI_CLIENT_S_COLLISION:
-        case AVAHI_CLIENT_S_REGISTERING:
-        case AVAHI_CLIENT_CONNECTING:
-            break;
-    }
-}
-
 DNSServiceErrorType DNSSD_API DNSServiceBrowse(
         DNSServiceRef *ret_sdref,
         DNSServiceFlags flags,
@@ -608,7 +1284,7 @@ DNSServiceErrorType DNSSD_API DNSServiceBrowse(
 
     DNSServiceErrorType ret = kDNSServiceErr_Unknown;
     int error;
-    DNSServiceRef sdref = NULL;
+    DNSServiceRef sdref = NULL, primary;
     AvahiIfIndex ifindex;
     struct type_info type_info;
 
@@ -616,7 +1292,9 @@ DNSServiceErrorType DNSSD_API DNSServiceBrowse(
 
     if (!ret_sdref || !regtype)
         return kDNSServiceErr_BadParam;
-    *ret_sdref = NULL;
+
+    if ((ret = sdref_take_primary(ret_sdref, &flags, &primary)) != kDNSServiceErr_NoError)
+        return ret;
 
     if (interface == kDNSServiceInterfaceIndexLocalOnly || flags != 0) {
         AVAHI_WARN_UNSUPPORTED;
@@ -633,21 +1311,14 @@ DNSServiceErrorType DNSSD_API DNSServiceBrowse(
     } else
         regtype = type_info.subtypes ? (char*) type_info.subtypes->text : type_info.type;
 
-    if (!(sdref = sdref_new())) {
+    if (!(sdref = sdref_new(primary, &error))) {
         type_info_free(&type_info);
-        return kDNSServiceErr_Unknown;
+        return map_error(error);
     }
 
     sdref->context = context;
     sdref->service_browser_callback = callback;
 
-    ASSERT_SUCCESS(pthread_mutex_lock(&sdref->mutex));
-
-    if (!(sdref->client = avahi_client_new(avahi_simple_poll_get(sdref->simple_poll), 0, generic_client_callback, sdref, &error))) {
-        ret =  map_error(error);
-        goto finish;
-    }
-
     ifindex = interface == kDNSServiceInterfaceIndexAny ? AVAHI_IF_UNSPEC : (AvahiIfIndex) interface;
 
     if (!(sdref->service_browser = avahi_service_browser_new(sdref->client, ifindex, AVAHI_PROTO_UNSPEC, regtype, domain, 0, service_browser_callback, sdref))) {
@@ -660,7 +1331,7 @@ DNSServiceErrorType DNSSD_API DNSServiceBrowse(
 
 finish:
 
-    ASSERT_SUCCESS(pthread_mutex_unlock(&sdref->mutex));
+    sdref_unlock(sdref);
 
     if (ret != kDNSServiceErr_NoError)
         DNSServiceRefDeallocate(sdref);
@@ -697,27 +1368,36 @@ static void service_resolver_callback(
             char host_name_fixed[AVAHI_DOMAIN_NAME_MAX];
             char full_name[AVAHI_DOMAIN_NAME_MAX];
             int ret;
-            char *p = NULL;
-            size_t l = 0;
+            size_t l;
+            Event *e;
 
             host_name = add_trailing_dot(host_name, host_name_fixed, sizeof(host_name_fixed));
 
-            if ((p = avahi_new0(char, (l = avahi_string_list_serialize(txt, NULL, 0))+1)))
-                avahi_string_list_serialize(txt, p, l);
-
             ret = avahi_service_name_join(full_name, sizeof(full_name), name, type, domain);
             assert(ret == AVAHI_OK);
 
             strcat(full_name, ".");
 
-            sdref->service_resolver_callback(sdref, 0, interface, kDNSServiceErr_NoError, full_name, host_name, htons(port), l, (unsigned char*) p, sdref->context);
+            if (!(e = event_new(0, interface, kDNSServiceErr_NoError)))
+                break;
+
+            e->port = htons(port);
 
-            avahi_free(p);
+            if (!(e->name = avahi_strdup(full_name)) ||
+                !(e->host_name = avahi_strdup(host_name)) ||
+                !(e->rdata = avahi_new0(char, (l = avahi_string_list_serialize(txt, NULL, 0))+1))) {
+                event_free(e);
+                break;
+            }
+
+            e->rdlen = (uint16_t) avahi_string_list_serialize(txt, e->rdata, l);
+
+            sdref_queue(sdref, e);
             break;
         }
 
         case AVAHI_RESOLVER_FAILURE:
-            sdref->service_resolver_callback(sdref, 0, interface, map_error(avahi_client_errno(sdref->client)), NULL, NULL, 0, 0, NULL, sdref->context);
+            sdref_queue_names(sdref, 0, interface, map_error(avahi_client_errno(sdref->client)), NULL, NULL, NULL);
             break;
     }
 }
@@ -734,33 +1414,28 @@ DNSServiceErrorType DNSSD_API DNSServiceResolve(
 
     DNSServiceErrorType ret = kDNSServiceErr_Unknown;
     int error;
-    DNSServiceRef sdref = NULL;
+    DNSServiceRef sdref = NULL, primary;
     AvahiIfIndex ifindex;
 
     AVAHI_WARN_LINKAGE;
 
     if (!ret_sdref || !name || !regtype || !domain || !callback)
         return kDNSServiceErr_BadParam;
-    *ret_sdref = NULL;
+
+    if ((ret = sdref_take_primary(ret_sdref, &flags, &primary)) != kDNSServiceErr_NoError)
+        return ret;
 
     if (interface == kDNSServiceInterfaceIndexLocalOnly || flags != 0) {
         AVAHI_WARN_UNSUPPORTED;
         return kDNSServiceErr_Unsupported;
     }
 
-    if (!(sdref = sdref_new()))
-        return kDNSServiceErr_Unknown;
+    if (!(sdref = sdref_new(primary, &error)))
+        return map_error(error);
 
     sdref->context = context;
     sdref->service_resolver_callback = callback;
 
-    ASSERT_SUCCESS(pthread_mutex_lock(&sdref->mutex));
-
-    if (!(sdref->client = avahi_client_new(avahi_simple_poll_get(sdref->simple_poll), 0, generic_client_callback, sdref, &error))) {
-        ret =  map_error(error);
-        goto finish;
-    }
-
     ifindex = interface == kDNSServiceInterfaceIndexAny ? AVAHI_IF_UNSPEC : (AvahiIfIndex) interface;
 
     if (!(sdref->service_resolver = avahi_service_resolver_new(sdref->client, ifindex, AVAHI_PROTO_UNSPEC, name, regtype, domain, AVAHI_PROTO_UNSPEC, 0, service_resolver_callback, sdref))) {
@@ -774,7 +1449,7 @@ DNSServiceErrorType DNSSD_API DNSServiceResolve(
 
 finish:
 
-    ASSERT_SUCCESS(pthread_mutex_unlock(&sdref->mutex));
+    sdref_unlock(sdref);
 
     if (ret != kDNSServiceErr_NoError)
         DNSServiceRefDeallocate(sdref);
@@ -819,15 +1494,15 @@ static void domain_browser_callback(
 
     switch (event) {
         case AVAHI_BROWSER_NEW:
-            sdref->domain_browser_callback(sdref, kDNSServiceFlagsAdd, interface, kDNSServiceErr_NoError, domain, sdref->context);
+            sdref_queue_names(sdref, kDNSServiceFlagsAdd, interface, kDNSServiceErr_NoError, NULL, NULL, domain);
             break;
 
         case AVAHI_BROWSER_REMOVE:
-            sdref->domain_browser_callback(sdref, 0, interface, kDNSServiceErr_NoError, domain, sdref->context);
+            sdref_queue_names(sdref, 0, interface, kDNSServiceErr_NoError, NULL, NULL, domain);
             break;
 
         case AVAHI_BROWSER_FAILURE:
-            sdref->domain_browser_callback(sdref, 0, interface, map_error(avahi_client_errno(sdref->client)), domain, sdref->context);
+            sdref_queue_names(sdref, 0, interface, map_error(avahi_client_errno(sdref->client)), NULL, NULL, domain);
             break;
 
         case AVAHI_BROWSER_CACHE_EXHAUSTED:
@@ -845,14 +1520,16 @@ DNSServiceErrorType DNSSD_API DNSServiceEnumerateDomains(
 
     DNSServiceErrorType ret = kDNSServiceErr_Unknown;
     int error;
-    DNSServiceRef sdref = NULL;
+    DNSServiceRef sdref = NULL, primary;
     AvahiIfIndex ifindex;
 
     AVAHI_WARN_LINKAGE;
 
     if (!ret_sdref || !callback)
         return kDNSServiceErr_BadParam;
-    *ret_sdref = NULL;
+
+    if ((ret = sdref_take_primary(ret_sdref, &flags, &primary)) != kDNSServiceErr_NoError)
+        return ret;
 
     if (interface == kDNSServiceInterfaceIndexLocalOnly ||
         (flags != kDNSServiceFlagsBrowseDomains &&  flags != kDNSServiceFlagsRegistrationDomains)) {
@@ -860,19 +1537,12 @@ DNSServiceErrorType DNSSD_API DNSServiceEnumerateDomains(
         return kDNSServiceErr_Unsupported;
     }
 
-    if (!(sdref = sdref_new()))
-        return kDNSServiceErr_Unknown;
+    if (!(sdref = sdref_new(primary, &error)))
+        return map_error(error);
 
     sdref->context = context;
     sdref->domain_browser_callback = callback;
 
-    ASSERT_SUCCESS(pthread_mutex_lock(&sdref->mutex));
-
-    if (!(sdref->client = avahi_client_new(avahi_simple_poll_get(sdref->simple_poll), 0, generic_client_callback, sdref, &error))) {
-        ret =  map_error(error);
-        goto finish;
-    }
-
     ifindex = interface == kDNSServiceInterfaceIndexAny ? AVAHI_IF_UNSPEC : (AvahiIfIndex) interface;
 
     if (!(sdref->domain_browser = avahi_domain_browser_new(sdref->client, ifindex, AVAHI_PROTO_UNSPEC, "local",
@@ -887,7 +1557,7 @@ DNSServiceErrorType DNSSD_API DNSServiceEnumerateDomains(
 
 finish:
 
-    ASSERT_SUCCESS(pthread_mutex_unlock(&sdref->mutex));
+    sdref_unlock(sdref);
 
     if (ret != kDNSServiceErr_NoError)
         DNSServiceRefDeallocate(sdref);
@@ -907,12 +1577,11 @@ static void reg_report_error(DNSServiceRef sdref, DNSServiceErrorType error) {
     regtype = add_trailing_dot(sdref->type_info.type, regtype_fixed, sizeof(regtype_fixed));
     domain = add_trailing_dot(sdref->service_domain, domain_fixed, sizeof(domain_fixed));
 
-    sdref->service_register_callback(
-        sdref, 0, error,
+    sdref_queue_names(
+        sdref, 0, 0, error,
         sdref->service_name_chosen ? sdref->service_name_chosen : sdref->service_name,
         regtype,
-        domain,
-        sdref->context);
+        domain);
 }
 
 static int reg_create_service(DNSServiceRef sdref) {
@@ -956,10 +1625,7 @@ static int reg_create_service(DNSServiceRef sdref) {
     return 0;
 }
 
-static void reg_client_callback(AvahiClient *s, AvahiClientState state, void* userdata) {
-    DNSServiceRef sdref = userdata;
-
-    assert(s);
+static void reg_client_callback(DNSServiceRef sdref, AvahiClientState state) {
     assert(sdref);
     assert(sdref->n_ref >= 1);
 
@@ -1096,7 +1762,7 @@ DNSServiceErrorType DNSSD_API DNSServiceRegister (
 
     DNSServiceErrorType ret = kDNSServiceErr_Unknown;
     int error;
-    DNSServiceRef sdref = NULL;
+    DNSServiceRef sdref = NULL, primary;
     AvahiStringList *txt = NULL;
     struct type_info type_info;
 
@@ -1104,7 +1770,9 @@ DNSServiceErrorType DNSSD_API DNSServiceRegister (
 
     if (!ret_sdref || !regtype)
         return kDNSServiceErr_BadParam;
-    *ret_sdref = NULL;
+
+    if ((ret = sdref_take_primary(ret_sdref, &flags, &primary)) != kDNSServiceErr_NoError)
+        return ret;
 
     if (!txtRecord) {
         txtLen = 1;
@@ -1125,10 +1793,10 @@ DNSServiceErrorType DNSSD_API DNSServiceRegister (
         return kDNSServiceErr_Invalid;
     }
 
-    if (!(sdref = sdref_new())) {
+    if (!(sdref = sdref_new(primary, &error))) {
         avahi_string_list_free(txt);
         type_info_free(&type_info);
-        return kDNSServiceErr_Unknown;
+        return map_error(error);
     }
 
     sdref->context = context;
@@ -1144,13 +1812,6 @@ DNSServiceErrorType DNSSD_API DNSServiceRegister (
 
     /* Some OOM checking would be cool here */
 
-    ASSERT_SUCCESS(pthread_mutex_lock(&sdref->mutex));
-
-    if (!(sdref->client = avahi_client_new(avahi_simple_poll_get(sdref->simple_poll), 0, reg_client_callback, sdref, &error))) {
-        ret =  map_error(error);
-        goto finish;
-    }
-
     if (!sdref->service_domain) {
         const char *d;
 
@@ -1199,7 +1860,7 @@ DNSServiceErrorType DNSSD_API DNSServiceRegister (
 
 finish:
 
-    ASSERT_SUCCESS(pthread_mutex_unlock(&sdref->mutex));
+    sdref_unlock(sdref);
 
     if (ret != kDNSServiceErr_NoError)
         DNSServiceRefDeallocate(sdref);
@@ -1232,7 +1893,7 @@ DNSServiceErrorType DNSSD_API DNSServiceUpdateRecord(
         if (avahi_string_list_parse(rdata, rdlen, &txt) < 0)
             return kDNSServiceErr_Invalid;
 
-    ASSERT_SUCCESS(pthread_mutex_lock(&sdref->mutex));
+    sdref_lock(sdref);
 
     if (!avahi_string_list_equal(txt, sdref->service_txt)) {
 
@@ -1264,98 +1925,132 @@ DNSServiceErrorType DNSSD_API DNSServiceUpdateRecord(
     ret = kDNSServiceErr_NoError;
 
 finish:
-    ASSERT_SUCCESS(pthread_mutex_unlock(&sdref->mutex));
+    sdref_unlock(sdref);
 
     return ret;
 }
 
-static void query_resolver_callback(
-        AvahiRecordBrowser *r,
-        AvahiIfIndex interface,
-        AVAHI_GCC_UNUSED AvahiProtocol protocol,
-        AvahiBrowserEvent event,
-        const char *name,
-        uint16_t clazz,
-        uint16_t type,
-        const void* rdata,
-        size_t size,
-        AVAHI_GCC_UNUSED AvahiLookupResultFlags flags,
-        void *userdata) {
-
-    DNSServiceRef sdref = userdata;
+DNSServiceErrorType DNSSD_API DNSServiceQueryRecord (
+    DNSServiceRef *ret_sdref,
+    DNSServiceFlags flags,
+    uint32_t interface,
+    const char *fullname,
+    uint16_t type,
+    uint16_t clazz,
+    DNSServiceQueryRecordReply callback,
+    void *context) {
 
-    assert(r);
-    assert(sdref);
-    assert(sdref->n_ref >= 1);
+    DNSServiceErrorType ret = kDNSServiceErr_Unknown;
+    int error;
+    DNSServiceRef sdref = NULL, primary;
+    AvahiIfIndex ifindex;
+    Query *q;
 
-    switch (event) {
+    AVAHI_WARN_LINKAGE;
 
-    case AVAHI_BROWSER_NEW:
-    case AVAHI_BROWSER_REMOVE: {
+    if (!ret_sdref || !fullname)
+        return kDNSServiceErr_BadParam;
 
-        DNSServiceFlags qflags = 0;
-        if (event == AVAHI_BROWSER_NEW)
-            qflags |= kDNSServiceFlagsAdd;
+    if ((ret = sdref_take_primary(ret_sdref, &flags, &primary)) != kDNSServiceErr_NoError)
+        return ret;
 
-        sdref->query_resolver_callback(sdref, qflags, interface, kDNSServiceErr_NoError, name, type, clazz, size, rdata, 0, sdref->context);
-        break;
+    if (interface == kDNSServiceInterfaceIndexLocalOnly || flags != 0) {
+        AVAHI_WARN_UNSUPPORTED;
+        return kDNSServiceErr_Unsupported;
     }
 
-    case AVAHI_BROWSER_ALL_FOR_NOW:
-    case AVAHI_BROWSER_CACHE_EXHAUSTED:
-        /* not implemented */
-        break;
+    if (!avahi_is_valid_domain_name(fullname))
+        return kDNSServiceErr_BadParam;
+
+    if (!(sdref = sdref_new(primary, &error)))
+        return map_error(error);
+
+    sdref->context = context;
+    sdref->query_resolver_callback = callback;
+
+    ifindex = interface == kDNSServiceInterfaceIndexAny ? AVAHI_IF_UNSPEC : (AvahiIfIndex) interface;
 
-    case AVAHI_BROWSER_FAILURE:
-        sdref->query_resolver_callback(sdref, 0, interface, map_error(avahi_client_errno(sdref->client)), NULL, 0, 0, 0, NULL, 0, sdref->context);
-        break;
+    if (!(q = query_get(sdref->connection, sdref->shared_client, ifindex, fullname, clazz, type, &error))) {
+        ret = map_error(error);
+        goto finish;
     }
+
+    query_subscribe(q, &sdref->subscriptions[0], sdref);
+
+    ret = kDNSServiceErr_NoError;
+    *ret_sdref = sdref;
+
+finish:
+
+    sdref_unlock(sdref);
+
+    if (ret != kDNSServiceErr_NoError)
+        DNSServiceRefDeallocate(sdref);
+
+    return ret;
 }
 
-DNSServiceErrorType DNSSD_API DNSServiceQueryRecord (
+DNSServiceErrorType DNSSD_API DNSServiceGetAddrInfo(
     DNSServiceRef *ret_sdref,
     DNSServiceFlags flags,
     uint32_t interface,
-    const char *fullname,
-    uint16_t type,
-    uint16_t clazz,
-    DNSServiceQueryRecordReply callback,
+    DNSServiceProtocol protocol,
+    const char *hostname,
+    DNSServiceGetAddrInfoReply callback,
     void *context) {
 
     DNSServiceErrorType ret = kDNSServiceErr_Unknown;
     int error;
-    DNSServiceRef sdref = NULL;
+    DNSServiceRef sdref = NULL, primary;
     AvahiIfIndex ifindex;
+    Query *q;
+    unsigned i = 0;
 
     AVAHI_WARN_LINKAGE;
 
-    if (!ret_sdref || !fullname)
+    if (!ret_sdref || !hostname || !callback)
         return kDNSServiceErr_BadParam;
-    *ret_sdref = NULL;
+
+    if ((ret = sdref_take_primary(ret_sdref, &flags, &primary)) != kDNSServiceErr_NoError)
+        return ret;
 
     if (interface == kDNSServiceInterfaceIndexLocalOnly || flags != 0) {
         AVAHI_WARN_UNSUPPORTED;
         return kDNSServiceErr_Unsupported;
     }
 
-    if (!(sdref = sdref_new()))
-        return kDNSServiceErr_Unknown;
+    if (protocol & ~(kDNSServiceProtocol_IPv4|kDNSServiceProtocol_IPv6) ||
+        !avahi_is_valid_domain_name(hostname))
+        return kDNSServiceErr_BadParam;
+
+    /* Both unless told otherwise */
+    if (!protocol)
+        protocol = kDNSServiceProtocol_IPv4|kDNSServiceProtocol_IPv6;
+
+    if (!(sdref = sdref_new(primary, &error)))
+        return map_error(error);
 
     sdref->context = context;
-    sdref->query_resolver_callback = callback;
+    sdref->addr_info_callback = callback;
 
-    ASSERT_SUCCESS(pthread_mutex_lock(&sdref->mutex));
+    ifindex = interface == kDNSServiceInterfaceIndexAny ? AVAHI_IF_UNSPEC : (AvahiIfIndex) interface;
 
-    if (!(sdref->client = avahi_client_new(avahi_simple_poll_get(sdref->simple_poll), 0, generic_client_callback, sdref, &error))) {
-        ret =  map_error(error);
-        goto finish;
+    if (protocol & kDNSServiceProtocol_IPv4) {
+        if (!(q = query_get(sdref->connection, sdref->shared_client, ifindex, hostname, AVAHI_DNS_CLASS_IN, AVAHI_DNS_TYPE_A, &error))) {
+            ret = map_error(error);
+            goto finish;
+        }
+
+        query_subscribe(q, &sdref->subscriptions[i++], sdref);
     }
 
-    ifindex = interface == kDNSServiceInterfaceIndexAny ? AVAHI_IF_UNSPEC : (AvahiIfIndex) interface;
+    if (protocol & kDNSServiceProtocol_IPv6) {
+        if (!(q = query_get(sdref->connection, sdref->shared_client, ifindex, hostname, AVAHI_DNS_CLASS_IN, AVAHI_DNS_TYPE_AAAA, &error))) {
+            ret = map_error(error);
+            goto finish;
+        }
 
-    if (!(sdref->record_browser = avahi_record_browser_new(sdref->client, ifindex, AVAHI_PROTO_UNSPEC, fullname, clazz, type, 0, query_resolver_callback, sdref))) {
-        ret = map_error(avahi_client_errno(sdref->client));
-        goto finish;
+        query_subscribe(q, &sdref->subscriptions[i++], sdref);
     }
 
     ret = kDNSServiceErr_NoError;
@@ -1363,7 +2058,7 @@ DNSServiceErrorType DNSSD_API DNSServiceQueryRecord (
 
 finish:
 
-    ASSERT_SUCCESS(pthread_mutex_unlock(&sdref->mutex));
+    sdref_unlock(sdref);
 
     if (ret != kDNSServiceErr_NoError)
         DNSServiceRefDeallocate(sdref);
@@ -151,10 +151,19 @@ enum
      * even for a name in a domain (e.g. foo.apple.com.) that would normally imply unicast DNS.
      */
 
-    kDNSServiceFlagsReturnCNAME         = 0x800
+    kDNSServiceFlagsReturnCNAME         = 0x800,
     /* Flag for returning CNAME records in the DNSServiceQueryRecord call. CNAME records are
      * normally followed without indicating to the client that there was a CNAME record.
      */
+
+    kDNSServiceFlagsShareConnection     = 0x4000
+    /* Flag for running an operation on a connection created by DNSServiceCreateConnection().
+     * Initialize the DNSServiceRef passed to the call with a copy of the connection's ref;
+     * the call replaces it with a new subordinate ref. Results for all subordinate refs are
+     * delivered through the connection's socket and its DNSServiceProcessResult(); the
+     * subordinate refs themselves have no socket. A subordinate ref may be deallocated on its
+     * own, deallocating the connection's ref deallocates all its subordinate refs too.
+     */
     };
 
 /*
@@ -1022,7 +1031,8 @@ DNSServiceErrorType DNSSD_API DNSServiceResolve
 /* DNSServiceCreateConnection()
  *
  * Create a connection to the daemon allowing efficient registration of
- * multiple individual records.
+ * multiple individual records, or running many operations over a single
+ * socket with kDNSServiceFlagsShareConnection.
  *
  *
  * Parameters:
@@ -1239,6 +1249,99 @@ DNSServiceErrorType DNSSD_API DNSServiceQueryRecord
     );
 
 
+/* DNSServiceGetAddrInfo
+ *
+ * Queries for the IP address of a hostname by using either Multicast or Unicast DNS.
+ *
+ * DNSServiceGetAddrInfoReply() parameters:
+ *
+ * sdRef:           The DNSServiceRef initialized by DNSServiceGetAddrInfo().
+ *
+ * flags:           Possible values are kDNSServiceFlagsMoreComing and
+ *                  kDNSServiceFlagsAdd.
+ *
+ * interfaceIndex:  The interface to which the answers pertain.
+ *
+ * errorCode:       Will be kDNSServiceErr_NoError on success, otherwise will
+ *                  indicate the failure that occurred.  Other parameters are
+ *                  undefined if errorCode is nonzero.
+ *
+ * hostname:        The fully qualified domain name of the host to be queried for.
+ *
+ * address:         IPv4 or IPv6 address.
+ *
+ * ttl:             If the client wishes to cache the result for performance reasons,
+ *                  the TTL indicates how long the client may legitimately hold onto
+ *                  this result, in seconds.
+ *
+ * context:         The context pointer that was passed to the callout.
+ *
+ */
+
+struct sockaddr;
+
+typedef uint32_t DNSServiceProtocol;
+
+enum
+    {
+    kDNSServiceProtocol_IPv4 = 0x01,
+    kDNSServiceProtocol_IPv6 = 0x02
+    /* 0x04 and 0x08 reserved for future internetwork protocols */
+    };
+
+typedef void (DNSSD_API *DNSServiceGetAddrInfoReply)
+    (
+    DNSServiceRef                    sdRef,
+    DNSServiceFlags                  flags,
+    uint32_t                         interfaceIndex,
+    DNSServiceErrorType              errorCode,
+    const char                       *hostname,
+    const struct sockaddr            *address,
+    uint32_t                         ttl,
+    void                             *context
+    );
+
+
+/* DNSServiceGetAddrInfo() Parameters:
+ *
+ * sdRef:           A pointer to an uninitialized DNSServiceRef. If the call succeeds then it
+ *                  initializes the DNSServiceRef, returns kDNSServiceErr_NoError, and the query
+ *                  begins and will last indefinitely until the client terminates the query
+ *                  by passing this DNSServiceRef to DNSServiceRefDeallocate().
+ *
+ * flags:           kDNSServiceFlagsShareConnection, or 0.
+ *
+ * interfaceIndex:  The interface on which to issue the query.  Passing 0 causes the query to be
+ *                  sent on all active interfaces via Multicast or the primary interface via Unicast.
+ *
+ * protocol:        Pass in kDNSServiceProtocol_IPv4 to look up IPv4 addresses, or kDNSServiceProtocol_IPv6
+ *                  to look up IPv6 addresses, or both to look up both kinds. If neither flag is
+ *                  set, both kinds of addresses are looked up.
+ *
+ * hostname:        The fully qualified domain name of the host to be queried for.
+ *
+ * callBack:        The function to be called when the query succeeds or fails asynchronously.
+ *
+ * context:         An application context pointer which is passed to the callback function
+ *                  (may be NULL).
+ *
+ * return value:    Returns kDNSServiceErr_NoError on success (any subsequent, asynchronous
+ *                  errors are delivered to the callback), otherwise returns an error code indicating
+ *                  the error that occurred.
+ */
+
+DNSServiceErrorType DNSSD_API DNSServiceGetAddrInfo
+    (
+    DNSServiceRef                    *sdRef,
+    DNSServiceFlags                  flags,
+    uint32_t                         interfaceIndex,
+    DNSServiceProtocol               protocol,
+    const char                       *hostname,
+    DNSServiceGetAddrInfoReply       callBack,
+    void                             *context          /* may be NULL */
+    );
+
+
 /* DNSServiceReconfirmRecord
  *
  * Instruct the daemon to verify the validity of a resource record that appears to
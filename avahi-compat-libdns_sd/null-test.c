@@ -43,7 +43,8 @@ static void reply(
 
 int main(AVAHI_GCC_UNUSED int argc, AVAHI_GCC_UNUSED char*argv[]) {
 
-    DNSServiceRef ref1, ref2, ref3, ref4 = NULL;
+    DNSServiceRef ref1, ref2, ref3, ref4 = NULL, ref5 = NULL, ref6;
+    DNSServiceErrorType r;
 
     DNSServiceRegister(&ref1, 0, 0, "simple", "_simple._tcp", NULL, NULL, 4711, 0, NULL, NULL, NULL);
     DNSServiceRegister(&ref2, 0, 0, "subtype #1", "_simple._tcp,_subtype1", NULL, NULL, 4711, 0, NULL, NULL, NULL);
@@ -60,6 +61,21 @@ int main(AVAHI_GCC_UNUSED int argc, AVAHI_GCC_UNUSED char*argv[]) {
 
     DNSServiceBrowse(&ref4, 0, 0, "_simple._tcp,_gurke", NULL, reply, NULL);
 
+    /* Only refs from DNSServiceCreateConnection() can be shared */
+    ref6 = ref1;
+    r = DNSServiceBrowse(&ref6, kDNSServiceFlagsShareConnection, 0, "_simple._tcp", NULL, reply, NULL);
+    assert(r == kDNSServiceErr_BadReference);
+
+    if (DNSServiceCreateConnection(&ref5) == kDNSServiceErr_NoError) {
+        ref6 = ref5;
+        if (DNSServiceBrowse(&ref6, kDNSServiceFlagsShareConnection, 0, "_simple._tcp", NULL, reply, NULL) == kDNSServiceErr_NoError) {
+            assert(ref6 != ref5);
+            assert(DNSServiceRefSockFD(ref6) < 0);
+            r = DNSServiceProcessResult(ref6);
+            assert(r == kDNSServiceErr_BadReference);
+        }
+    }
+
     sleep(20);
 
     DNSServiceRefDeallocate(ref1);
@@ -67,5 +83,8 @@ int main(AVAHI_GCC_UNUSED int argc, AVAHI_GCC_UNUSED char*argv[]) {
     DNSServiceRefDeallocate(ref3);
     DNSServiceRefDeallocate(ref4);
 
+    /* Takes ref6 with it */
+    DNSServiceRefDeallocate(ref5);
+
     return 0;
 }
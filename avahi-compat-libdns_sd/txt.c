@@ -34,8 +34,22 @@
 typedef struct TXTRecordInternal {
     uint8_t *buffer, *malloc_buffer;
     size_t size, max_size;
+
+    /* Removed items stay in the buffer until it is needed in one piece
+     * again. Their key starts with '=', which no valid key does. */
+    size_t garbage;
+
+    /* Open addressing hash table of the items by key. Slots hold the
+     * offset of an item plus one, or one of the values below. */
+    uint16_t *index;
+    size_t index_size, index_used;
 } TXTRecordInternal;
 
+#define INDEX_EMPTY 0
+#define INDEX_DELETED 0xFFFF
+
+#define INDEX_SIZE_MIN 16
+
 #define INTERNAL_PTR(txtref) (* (TXTRecordInternal**) (txtref))
 #define INTERNAL_PTR_CONST(txtref) (* (const TXTRecordInternal* const *) (txtref))
 
@@ -56,11 +70,9 @@ void DNSSD_API TXTRecordCreate(
      * our own memory. Please, Apple, do your homework next time
      * before designing an API! */
 
-    if ((t = avahi_new(TXTRecordInternal, 1))) {
+    if ((t = avahi_new0(TXTRecordInternal, 1))) {
         t->buffer = buffer;
         t->max_size = buffer ? length : (size_t)0;
-        t->size = 0;
-        t->malloc_buffer = NULL;
     }
 
     /* If we were unable to allocate memory, we store a NULL pointer
@@ -80,12 +92,140 @@ void DNSSD_API TXTRecordDeallocate(TXTRecordRef *txtref) {
         return;
 
     avahi_free(t->malloc_buffer);
+    avahi_free(t->index);
     avahi_free(t);
 
     /* Just in case ... */
     INTERNAL_PTR(txtref) = NULL;
 }
 
+static unsigned hash_key(const char *key, size_t key_len) {
+    unsigned hash = 2166136261U;
+
+    /* FNV-1a */
+    while (key_len-- > 0)
+        hash = (hash ^ (uint8_t) *(key++)) * 16777619U;
+
+    return hash;
+}
+
+static int item_has_key(const uint8_t *p, const char *key, size_t key_len) {
+    return
+        key_len <= *p &&
+        memcmp(key, p+1, key_len) == 0 &&
+        (key_len == *p || p[1+key_len] == '=');
+}
+
+/* Returns the slot of the item with the key, or if there is none the
+ * empty slot it would go in */
+static uint16_t *index_lookup(TXTRecordInternal *t, const char *key, size_t key_len) {
+    size_t mask, i;
+    uint16_t *deleted = NULL;
+
+    assert(t);
+    assert(t->index);
+
+    mask = t->index_size - 1;
+
+    for (i = hash_key(key, key_len) & mask;; i = (i + 1) & mask) {
+        uint16_t *slot = t->index + i;
+
+        if (*slot == INDEX_EMPTY)
+            return deleted ? deleted : slot;
+
+        if (*slot == INDEX_DELETED) {
+            if (!deleted)
+                deleted = slot;
+        } else if (item_has_key(t->buffer + *slot - 1, key, key_len))
+            return slot;
+    }
+}
+
+/* Refill the index from the buffer, which drops the deleted slots */
+static void index_fill(TXTRecordInternal *t) {
+    size_t i;
+    uint8_t *p;
+
+    assert(t);
+    assert(t->index);
+
+    memset(t->index, 0, t->index_size * sizeof(uint16_t));
+    t->index_used = 0;
+
+    for (i = 0, p = t->buffer; i < t->size; i += *p + 1, p += *p + 1) {
+        const uint8_t *d;
+
+        if (p[1] == '=')
+            continue;
+
+        d = memchr(p+1, '=', *p);
+        *index_lookup(t, (const char*) p+1, d ? (size_t) (d - p - 1) : *p) = (uint16_t) (i + 1);
+        t->index_used++;
+    }
+}
+
+/* Make room in the index for one more item */
+static int index_reserve(TXTRecordInternal *t) {
+    size_t n = 0, i, nsize;
+
+    assert(t);
+
+    /* At most half full, counting deleted slots */
+    if (t->index && (t->index_used + 1) * 2 <= t->index_size)
+        return 0;
+
+    for (i = 0; i < t->size; i += t->buffer[i] + 1)
+        if (t->buffer[i+1] != '=')
+            n++;
+
+    for (nsize = INDEX_SIZE_MIN; nsize < (n + 1) * 2; nsize *= 2)
+        ;
+
+    /* Only ever grows, records are short-lived */
+    if (nsize > t->index_size) {
+        uint16_t *index;
+
+        if (!(index = avahi_new(uint16_t, nsize)))
+            return -1;
+
+        avahi_free(t->index);
+        t->index = index;
+        t->index_size = nsize;
+    }
+
+    index_fill(t);
+    return 0;
+}
+
+/* Drop removed items from the buffer */
+static void compact(TXTRecordInternal *t) {
+    size_t i, l;
+    uint8_t *p, *w;
+
+    assert(t);
+
+    if (!t->garbage)
+        return;
+
+    for (i = 0, p = w = t->buffer; i < t->size; i += l, p += l) {
+        l = *p + 1;
+
+        if (p[1] == '=')
+            continue;
+
+        if (w != p)
+            memmove(w, p, l);
+
+        w += l;
+    }
+
+    t->size = w - t->buffer;
+    t->garbage = 0;
+
+    /* The offsets have changed */
+    index_fill(t);
+}
+
 static int make_sure_fits_in(TXTRecordInternal *t, size_t size) {
     uint8_t *n;
     size_t nsize;
@@ -95,11 +235,23 @@ static int make_sure_fits_in(TXTRecordInternal *t, size_t size) {
     if (t->size + size <= t->max_size)
         return 0;
 
-    nsize = t->size + size + 100;
+    compact(t);
 
-    if (nsize > 0xFFFF)
+    if (t->size + size <= t->max_size)
+        return 0;
+
+    if (t->size + size > 0xFFFF)
         return -1;
 
+    /* Grow by doubling, so that appends are cheap */
+    nsize = t->max_size * 2;
+
+    if (nsize < t->size + size + 100)
+        nsize = t->size + size + 100;
+
+    if (nsize > 0xFFFF)
+        nsize = 0xFFFF;
+
     if (!(n = avahi_realloc(t->malloc_buffer, nsize)))
         return -1;
 
@@ -113,48 +265,28 @@ static int make_sure_fits_in(TXTRecordInternal *t, size_t size) {
 }
 
 static int remove_key(TXTRecordInternal *t, const char *key) {
-    size_t i;
-    uint8_t *p;
     size_t key_len;
-    int found = 0;
+    uint16_t *slot;
+    uint8_t *p;
 
     key_len = strlen(key);
     assert(key_len <= 0xFF);
 
-    p = t->buffer;
-    i = 0;
-
-    while (i < t->size) {
-
-        /* Does the item fit in? */
-        assert(*p <= t->size - i - 1);
-
-        /* Key longer than buffer */
-        if (key_len > t->size - i - 1)
-            break;
-
-        if (key_len <= *p &&
-            strncmp(key, (char*) p+1, key_len) == 0 &&
-            (key_len == *p || p[1+key_len] == '=')) {
-
-            uint8_t s;
+    if (!t->index)
+        return 0;
 
-            /* Key matches, so let's remove it */
+    slot = index_lookup(t, key, key_len);
 
-            s = *p;
-            memmove(p, p + 1 + *p, t->size - i - *p -1);
-            t->size -= s + 1;
+    if (*slot == INDEX_EMPTY || *slot == INDEX_DELETED)
+        return 0;
 
-            found = 1;
-        } else {
-            /* Skip to next */
+    p = t->buffer + *slot - 1;
+    p[1] = '=';
+    t->garbage += *p + 1;
 
-            i += *p +1;
-            p += *p +1;
-        }
-    }
+    *slot = INDEX_DELETED;
 
-    return found;
+    return 1;
 }
 
 DNSServiceErrorType DNSSD_API TXTRecordSetValue(
@@ -165,6 +297,7 @@ DNSServiceErrorType DNSSD_API TXTRecordSetValue(
 
     TXTRecordInternal *t;
     uint8_t *p;
+    uint16_t *slot;
     size_t l, n;
 
     AVAHI_WARN_LINKAGE;
@@ -185,11 +318,22 @@ DNSServiceErrorType DNSSD_API TXTRecordSetValue(
     if (n > 0xFF)
         return kDNSServiceErr_Invalid;
 
+    if (index_reserve(t) < 0)
+        return kDNSServiceErr_NoMemory;
+
     if (make_sure_fits_in(t, 1 + n) < 0)
         return kDNSServiceErr_NoMemory;
 
     remove_key(t, key);
 
+    /* Likely the slot of the item just removed */
+    slot = index_lookup(t, key, l);
+
+    if (*slot == INDEX_EMPTY)
+        t->index_used++;
+
+    *slot = (uint16_t) (t->size + 1);
+
     p = t->buffer + t->size;
 
     *(p++) = (uint8_t) n;
@@ -240,6 +384,8 @@ uint16_t DNSSD_API TXTRecordGetLength(const TXTRecordRef *txtref) {
     if (!(t = INTERNAL_PTR_CONST(txtref)))
         return 0;
 
+    compact((TXTRecordInternal*) t);
+
     assert(t->size <= 0xFFFF);
     return (uint16_t) t->size;
 }
@@ -254,6 +400,8 @@ const void * DNSSD_API TXTRecordGetBytesPtr(const TXTRecordRef *txtref) {
     if (!(t = INTERNAL_PTR_CONST(txtref)) || !t->buffer)
         return "";
 
+    compact((TXTRecordInternal*) t);
+
     return t->buffer;
 }
 
@@ -279,14 +427,9 @@ static const uint8_t *find_key(const uint8_t *buffer, size_t size, const char *k
         if (key_len > size - i - 1)
             return NULL;
 
-        if (key_len <= *p &&
-            strncmp(key, (const char*) p+1, key_len) == 0 &&
-            (key_len == *p || p[1+key_len] == '=')) {
-
-            /* Key matches, so let's return it */
-
+        /* Key matches, so let's return it */
+        if (item_has_key(p, key, key_len))
             return p;
-        }
 
         /* Skip to next */
         i += *p +1;
@@ -22,6 +22,7 @@
 #endif
 
 #include <stdlib.h>
+#include <stdint.h>
 
 #include <avahi-common/timeval.h>
 #include <avahi-common/malloc.h>
@@ -34,13 +35,79 @@
 #define AVAHI_PROBE_JITTER_MSEC 250
 #define AVAHI_PROBE_INTERVAL_MSEC 250
 
+static AvahiAnnounceSlot *get_slot(AvahiServer *s, AvahiSEntryGroup *g, AvahiInterface *i) {
+    AvahiAnnounceSlot *slot;
+
+    assert(s);
+    assert(i);
+
+    for (slot = g ? g->announce_slots : s->announce_slots; slot; slot = slot->slots_next)
+        if (slot->interface == i)
+            return slot;
+
+    if (!(slot = avahi_new(AvahiAnnounceSlot, 1))) {
+        avahi_log_error(__FILE__": Out of memory.");
+        return NULL;
+    }
+
+    slot->server = s;
+    slot->interface = i;
+    slot->group = g;
+    slot->time_event = NULL;
+    slot->dispatching = 0;
+    slot->have_target = slot->have_next = 0;
+
+    AVAHI_LLIST_HEAD_INIT(AvahiAnnouncer, slot->announcers);
+    AVAHI_LLIST_HEAD_INIT(AvahiAnnouncer, slot->pending);
+
+    if (g)
+        AVAHI_LLIST_PREPEND(AvahiAnnounceSlot, slots, g->announce_slots, slot);
+    else
+        AVAHI_LLIST_PREPEND(AvahiAnnounceSlot, slots, s->announce_slots, slot);
+
+    return slot;
+}
+
+static void free_slot(AvahiAnnounceSlot *slot) {
+    assert(slot);
+    assert(!slot->announcers);
+    assert(!slot->dispatching);
+
+    if (slot->time_event)
+        avahi_time_event_free(slot->time_event);
+
+    if (slot->group)
+        AVAHI_LLIST_REMOVE(AvahiAnnounceSlot, slots, slot->group->announce_slots, slot);
+    else
+        AVAHI_LLIST_REMOVE(AvahiAnnounceSlot, slots, slot->server->announce_slots, slot);
+
+    avahi_free(slot);
+}
+
+static void unqueue(AvahiAnnouncer *a) {
+    assert(a);
+
+    if (a->is_pending) {
+        AVAHI_LLIST_REMOVE(AvahiAnnouncer, pending, a->slot->pending, a);
+        a->is_pending = 0;
+    }
+}
+
 static void remove_announcer(AvahiServer *s, AvahiAnnouncer *a) {
+    AvahiAnnounceSlot *slot;
+
     assert(s);
     assert(a);
 
-    if (a->time_event)
-        avahi_time_event_free(a->time_event);
+    slot = a->slot;
+
+    unqueue(a);
+    AVAHI_LLIST_REMOVE(AvahiAnnouncer, by_slot, slot->announcers, a);
 
+    if (!slot->announcers && !slot->dispatching)
+        free_slot(slot);
+
+    avahi_hashmap_remove(s->announcer_hashmap, a);
     AVAHI_LLIST_REMOVE(AvahiAnnouncer, by_interface, a->interface->announcers, a);
     AVAHI_LLIST_REMOVE(AvahiAnnouncer, by_entry, a->entry->announcers, a);
 
@@ -53,29 +120,110 @@ static void remove_announcer(AvahiServer *s, AvahiAnnouncer *a) {
     avahi_free(a);
 }
 
-static void elapse_announce(AvahiTimeEvent *e, void *userdata);
+static void elapse_slot(AvahiTimeEvent *e, void *userdata);
+
+static void slot_set_expiry(AvahiAnnounceSlot *slot, const struct timeval *tv) {
+    assert(slot);
+    assert(tv);
+
+    slot->expiry = *tv;
+
+    if (slot->time_event)
+        avahi_time_event_update(slot->time_event, &slot->expiry);
+    else
+        slot->time_event = avahi_time_event_new(slot->server->time_event_queue, &slot->expiry, elapse_slot, slot);
+}
+
+static void set_timeout_at(AvahiAnnouncer *a, const struct timeval *tv) {
+    AvahiAnnounceSlot *slot;
 
-static void set_timeout(AvahiAnnouncer *a, const struct timeval *tv) {
     assert(a);
+    assert(tv);
+    slot = a->slot;
 
-    if (!tv) {
-        if (a->time_event) {
-            avahi_time_event_free(a->time_event);
-            a->time_event = NULL;
+    unqueue(a);
+
+    a->expiry = *tv;
+    a->scheduled = 1;
+
+    if (slot->dispatching) {
+        /* The slot timer is set up when dispatching is complete */
+        if (!slot->have_next || avahi_timeval_compare(&a->expiry, &slot->next) < 0) {
+            slot->next = a->expiry;
+            slot->have_next = 1;
         }
+
+        return;
+    }
+
+    if (!slot->time_event || avahi_timeval_compare(&a->expiry, &slot->expiry) < 0)
+        slot_set_expiry(slot, &a->expiry);
+}
+
+static void set_timeout(AvahiAnnouncer *a, unsigned msec, unsigned jitter) {
+    AvahiAnnounceSlot *slot;
+    const struct timeval *target = NULL;
+    struct timeval tv;
+
+    assert(a);
+    slot = a->slot;
+
+    /* While dispatching all announcers are stepped relative to the
+     * time the slot elapsed, so that they stay in lockstep */
+    if (slot->dispatching) {
+        tv = slot->now;
+        avahi_timeval_add(&tv, (AvahiUsec) msec*1000);
+
+        if (slot->have_target)
+            target = &slot->target;
     } else {
+        avahi_elapse_time(&tv, msec, 0);
 
-        if (a->time_event)
-            avahi_time_event_update(a->time_event, tv);
-        else
-            a->time_event = avahi_time_event_new(a->server->time_event_queue, tv, elapse_announce, a);
+        if (slot->time_event)
+            target = &slot->expiry;
     }
+
+    if (jitter <= 0) {
+        set_timeout_at(a, &tv);
+        return;
+    }
+
+    if (target &&
+        avahi_timeval_compare(target, &tv) >= 0 &&
+        avahi_timeval_diff(target, &tv) <= (AvahiUsec) jitter*1000)
+
+        /* The slot is going to be dispatched within the jitter
+         * interval anyway, so let's piggyback on it */
+        tv = *target;
+
+    else {
+        avahi_timeval_add(&tv, (AvahiUsec) (jitter*1000.0*rand()/(RAND_MAX+1.0)));
+
+        /* Let the announcers stepped after this one follow */
+        if (slot->dispatching) {
+            slot->target = tv;
+            slot->have_target = 1;
+        }
+    }
+
+    set_timeout_at(a, &tv);
+}
+
+static void clear_timeout(AvahiAnnouncer *a) {
+    assert(a);
+
+    unqueue(a);
+
+    /* We don't touch the slot timer here, if it elapses too early it
+     * will simply be rescheduled */
+    a->scheduled = 0;
 }
 
 static void next_state(AvahiAnnouncer *a);
+static void announce(AvahiAnnouncer *a);
 
 void avahi_s_entry_group_check_probed(AvahiSEntryGroup *g, int immediately) {
-    AvahiEntry *e;
+    AvahiAnnounceSlot *slot;
     assert(g);
     assert(!g->dead);
 
@@ -89,10 +237,11 @@ void avahi_s_entry_group_check_probed(AvahiSEntryGroup *g, int immediately) {
     if (g->dead)
         return;
 
-    for (e = g->entries; e; e = e->by_group_next) {
+    for (slot = g->announce_slots; slot; slot = slot->slots_next) {
         AvahiAnnouncer *a;
+        unsigned n = 0;
 
-        for (a = e->announcers; a; a = a->by_entry_next) {
+        for (a = slot->announcers; a; a = a->by_slot_next) {
 
             if (a->state != AVAHI_WAITING)
                 continue;
@@ -103,14 +252,45 @@ void avahi_s_entry_group_check_probed(AvahiSEntryGroup *g, int immediately) {
                 /* Shortcut */
 
                 a->n_iteration = 1;
-                next_state(a);
+                announce(a);
+                n++;
             } else {
-                struct timeval tv;
                 a->n_iteration = 0;
-                avahi_elapse_time(&tv, 0, AVAHI_ANNOUNCEMENT_JITTER_MSEC);
-                set_timeout(a, &tv);
+                set_timeout(a, 0, AVAHI_ANNOUNCEMENT_JITTER_MSEC);
             }
         }
+
+        /* Send the announcements of all records of the group on this
+         * interface at once */
+        if (n > 0)
+            avahi_server_generate_response(g->server, slot->interface, NULL, NULL, 0, 0, 0);
+    }
+}
+
+static void announce(AvahiAnnouncer *a) {
+    assert(a);
+    assert(a->state == AVAHI_ANNOUNCING);
+
+    /* Only queues the records for the next response, the caller has
+     * to call avahi_server_generate_response() afterwards. */
+
+    if (a->entry->flags & AVAHI_PUBLISH_UNIQUE)
+        /* Send the whole rrset at once */
+        avahi_server_prepare_matching_responses(a->server, a->interface, a->entry->record->key, 0);
+    else
+        avahi_server_prepare_response(a->server, a->interface, a->entry, 0, 0);
+
+    if (++a->n_iteration >= 4) {
+        /* Announcing done */
+
+        a->state = AVAHI_ESTABLISHED;
+
+        clear_timeout(a);
+    } else {
+        set_timeout(a, a->sec_delay*1000, AVAHI_ANNOUNCEMENT_JITTER_MSEC);
+
+        if (a->n_iteration < 10)
+            a->sec_delay *= 2;
     }
 }
 
@@ -140,70 +320,148 @@ static void next_state(AvahiAnnouncer *a) {
                 a->n_iteration = 1;
             }
 
-            set_timeout(a, NULL);
+            clear_timeout(a);
             next_state(a);
         } else {
-            struct timeval tv;
-
             avahi_interface_post_probe(a->interface, a->entry->record, 0);
 
-            avahi_elapse_time(&tv, AVAHI_PROBE_INTERVAL_MSEC, 0);
-            set_timeout(a, &tv);
+            set_timeout(a, AVAHI_PROBE_INTERVAL_MSEC, 0);
 
             a->n_iteration++;
         }
 
     } else if (a->state == AVAHI_ANNOUNCING) {
 
-        if (a->entry->flags & AVAHI_PUBLISH_UNIQUE)
-            /* Send the whole rrset at once */
-            avahi_server_prepare_matching_responses(a->server, a->interface, a->entry->record->key, 0);
-        else
-            avahi_server_prepare_response(a->server, a->interface, a->entry, 0, 0);
-
+        announce(a);
         avahi_server_generate_response(a->server, a->interface, NULL, NULL, 0, 0, 0);
+    }
+}
 
-        if (++a->n_iteration >= 4) {
-            /* Announcing done */
+static int is_due(AvahiAnnouncer *a, const struct timeval *now) {
+    assert(a);
+    assert(now);
 
-            a->state = AVAHI_ESTABLISHED;
+    return a->scheduled && avahi_timeval_compare(&a->expiry, now) <= 0;
+}
 
-            set_timeout(a, NULL);
-        } else {
-            struct timeval tv;
-            avahi_elapse_time(&tv, a->sec_delay*1000, AVAHI_ANNOUNCEMENT_JITTER_MSEC);
+static void elapse_slot(AvahiTimeEvent *e, void *userdata) {
+    AvahiAnnounceSlot *slot = userdata;
+    AvahiAnnouncer *a;
+    unsigned n = 0;
 
-            if (a->n_iteration < 10)
-                a->sec_delay *= 2;
+    assert(e);
+    assert(slot);
+    assert(!slot->dispatching);
+
+    gettimeofday(&slot->now, NULL);
+
+    slot->dispatching = 1;
+    slot->have_target = slot->have_next = 0;
+
+    /* First, send all announcements that are due. This never calls
+     * into user code, hence we can pack them all into the same
+     * response. */
+    for (a = slot->announcers; a; a = a->by_slot_next)
+        if (a->state == AVAHI_ANNOUNCING && is_due(a, &slot->now)) {
+            clear_timeout(a);
+            announce(a);
+            n++;
+        }
+
+    if (n > 0)
+        avahi_server_generate_response(slot->server, slot->interface, NULL, NULL, 0, 0, 0);
+
+    /* Then step all other announcers that are due. Finishing probing
+     * might end up in the entry group callback which in turn might
+     * remove announcers of this slot, hence we queue them first and
+     * process the queue one by one. While walking the list we also
+     * look for the next time the slot needs to be dispatched. */
+    for (a = slot->announcers; a; a = a->by_slot_next) {
+
+        if (!a->scheduled)
+            continue;
 
-            set_timeout(a, &tv);
+        if (is_due(a, &slot->now)) {
+            clear_timeout(a);
+            a->is_pending = 1;
+            AVAHI_LLIST_PREPEND(AvahiAnnouncer, pending, slot->pending, a);
+        } else if (!slot->have_next || avahi_timeval_compare(&a->expiry, &slot->next) < 0) {
+            slot->next = a->expiry;
+            slot->have_next = 1;
         }
     }
+
+    while ((a = slot->pending)) {
+        unqueue(a);
+        next_state(a);
+    }
+
+    slot->dispatching = 0;
+
+    if (!slot->announcers)
+        free_slot(slot);
+    else if (slot->have_next)
+        /* If the announcer this has been taken from has been removed
+         * in the meantime we simply elapse for nothing */
+        slot_set_expiry(slot, &slot->next);
+    else if (slot->time_event) {
+        avahi_time_event_free(slot->time_event);
+        slot->time_event = NULL;
+    }
 }
 
-static void elapse_announce(AvahiTimeEvent *e, void *userdata) {
-    assert(e);
+unsigned avahi_announcer_hash(const void *data) {
+    const AvahiAnnouncer *a = data;
+
+    assert(a);
+
+    return
+        (unsigned) ((uintptr_t) a->interface / sizeof(void*)) * 31 +
+        (unsigned) ((uintptr_t) a->entry / sizeof(void*));
+}
+
+int avahi_announcer_equal(const void *a, const void *b) {
+    const AvahiAnnouncer *x = a, *y = b;
+
+    assert(x);
+    assert(y);
 
-    next_state(userdata);
+    return x->interface == y->interface && x->entry == y->entry;
 }
 
 static AvahiAnnouncer *get_announcer(AvahiServer *s, AvahiEntry *e, AvahiInterface *i) {
-    AvahiAnnouncer *a;
+    AvahiAnnouncer k;
 
     assert(s);
     assert(e);
     assert(i);
 
-    for (a = e->announcers; a; a = a->by_entry_next)
-        if (a->interface == i)
-            return a;
+    k.interface = i;
+    k.entry = e;
+
+    return avahi_hashmap_lookup(s->announcer_hashmap, &k);
+}
+
+static const struct timeval *get_start_time(AvahiServer *s) {
+    struct timeval now;
+
+    assert(s);
+
+    /* Entries that are committed within the jitter interval of each
+     * other share the same random start delay, so that their probes
+     * and announcements are sent in the same packets. */
+
+    gettimeofday(&now, NULL);
+
+    if (avahi_timeval_compare(&s->announce_start, &now) < 0 ||
+        avahi_timeval_diff(&s->announce_start, &now) > (AvahiUsec) AVAHI_PROBE_JITTER_MSEC*1000)
+        avahi_elapse_time(&s->announce_start, 0, AVAHI_PROBE_JITTER_MSEC);
 
-    return NULL;
+    return &s->announce_start;
 }
 
-static void go_to_initial_state(AvahiAnnouncer *a) {
+static void go_to_initial_state(AvahiAnnouncer *a, const struct timeval *start) {
     AvahiEntry *e;
-    struct timeval tv;
 
     assert(a);
     e = a->entry;
@@ -226,16 +484,15 @@ static void go_to_initial_state(AvahiAnnouncer *a) {
     if (a->state == AVAHI_PROBING && e->group)
         e->group->n_probing++;
 
-    if (a->state == AVAHI_PROBING)
-        set_timeout(a, avahi_elapse_time(&tv, 0, AVAHI_PROBE_JITTER_MSEC));
-    else if (a->state == AVAHI_ANNOUNCING)
-        set_timeout(a, avahi_elapse_time(&tv, 0, AVAHI_ANNOUNCEMENT_JITTER_MSEC));
+    if (a->state == AVAHI_PROBING || a->state == AVAHI_ANNOUNCING)
+        set_timeout_at(a, start ? start : get_start_time(a->server));
     else
-        set_timeout(a, NULL);
+        clear_timeout(a);
 }
 
-static void new_announcer(AvahiServer *s, AvahiInterface *i, AvahiEntry *e) {
+static void new_announcer(AvahiServer *s, AvahiInterface *i, AvahiEntry *e, const struct timeval *start) {
     AvahiAnnouncer *a;
+    AvahiAnnounceSlot *slot;
 
     assert(s);
     assert(i);
@@ -249,20 +506,40 @@ static void new_announcer(AvahiServer *s, AvahiInterface *i, AvahiEntry *e) {
     if (get_announcer(s, e, i))
         return;
 
+    if (!(slot = get_slot(s, e->group, i)))
+        return;
+
     if ((!(a = avahi_new(AvahiAnnouncer, 1)))) {
         avahi_log_error(__FILE__": Out of memory.");
+
+        if (!slot->announcers && !slot->dispatching)
+            free_slot(slot);
+
         return;
     }
 
     a->server = s;
     a->interface = i;
     a->entry = e;
-    a->time_event = NULL;
+    a->slot = slot;
+    a->scheduled = 0;
+    a->is_pending = 0;
 
+    if (avahi_hashmap_insert(s->announcer_hashmap, a, a) < 0) {
+        avahi_log_error(__FILE__": Out of memory.");
+        avahi_free(a);
+
+        if (!slot->announcers && !slot->dispatching)
+            free_slot(slot);
+
+        return;
+    }
+
+    AVAHI_LLIST_PREPEND(AvahiAnnouncer, by_slot, slot->announcers, a);
     AVAHI_LLIST_PREPEND(AvahiAnnouncer, by_interface, i->announcers, a);
     AVAHI_LLIST_PREPEND(AvahiAnnouncer, by_entry, e->announcers, a);
 
-    go_to_initial_state(a);
+    go_to_initial_state(a, start);
 }
 
 void avahi_announce_interface(AvahiServer *s, AvahiInterface *i) {
@@ -276,26 +553,41 @@ void avahi_announce_interface(AvahiServer *s, AvahiInterface *i) {
 
     for (e = s->entries; e; e = e->entries_next)
         if (!e->dead)
-            new_announcer(s, i, e);
+            new_announcer(s, i, e, NULL);
 }
 
+struct announce_walk_data {
+    AvahiEntry *entry;
+    const struct timeval *start;
+};
+
 static void announce_walk_callback(AvahiInterfaceMonitor *m, AvahiInterface *i, void* userdata) {
-    AvahiEntry *e = userdata;
+    struct announce_walk_data *d = userdata;
 
     assert(m);
     assert(i);
-    assert(e);
-    assert(!e->dead);
+    assert(d);
+    assert(d->entry);
+    assert(!d->entry->dead);
 
-    new_announcer(m->server, i, e);
+    new_announcer(m->server, i, d->entry, d->start);
 }
 
-void avahi_announce_entry(AvahiServer *s, AvahiEntry *e) {
+static void announce_entry(AvahiServer *s, AvahiEntry *e, const struct timeval *start) {
+    struct announce_walk_data d;
+
     assert(s);
     assert(e);
     assert(!e->dead);
 
-    avahi_interface_monitor_walk(s->monitor, e->interface, e->protocol, announce_walk_callback, e);
+    d.entry = e;
+    d.start = start;
+
+    avahi_interface_monitor_walk(s->monitor, e->interface, e->protocol, announce_walk_callback, &d);
+}
+
+void avahi_announce_entry(AvahiServer *s, AvahiEntry *e) {
+    announce_entry(s, e, NULL);
 }
 
 void avahi_announce_group(AvahiServer *s, AvahiSEntryGroup *g) {
@@ -309,6 +601,30 @@ void avahi_announce_group(AvahiServer *s, AvahiSEntryGroup *g) {
             avahi_announce_entry(s, e);
 }
 
+void avahi_announce_groups(AvahiServer *s, AvahiSEntryGroup *groups[], unsigned n_groups) {
+    struct timeval start;
+    unsigned j;
+
+    assert(s);
+    assert(groups || n_groups == 0);
+
+    /* Let all groups start probing/announcing at the very same
+     * (randomly chosen) time, even if this takes longer than the
+     * jitter interval */
+    start = *get_start_time(s);
+
+    for (j = 0; j < n_groups; j++) {
+        AvahiEntry *e;
+
+        if (!groups[j] || groups[j]->dead)
+            continue;
+
+        for (e = groups[j]->entries; e; e = e->by_group_next)
+            if (!e->dead)
+                announce_entry(s, e, &start);
+    }
+}
+
 int avahi_entry_is_registered(AvahiServer *s, AvahiEntry *e, AvahiInterface *i) {
     AvahiAnnouncer *a;
 
@@ -355,7 +671,7 @@ void avahi_entry_return_to_initial_state(AvahiServer *s, AvahiEntry *e, AvahiInt
     if (a->state == AVAHI_PROBING && a->entry->group)
         a->entry->group->n_probing--;
 
-    go_to_initial_state(a);
+    go_to_initial_state(a, NULL);
 }
 
 static AvahiRecord *make_goodbye_record(AvahiRecord *r) {
@@ -422,7 +738,6 @@ static void send_goodbye_callback(AvahiInterfaceMonitor *m, AvahiInterface *i, v
 
 static void reannounce(AvahiAnnouncer *a) {
     AvahiEntry *e;
-    struct timeval tv;
 
     assert(a);
     e = a->entry;
@@ -465,11 +780,11 @@ static void reannounce(AvahiAnnouncer *a) {
     a->sec_delay = 1;
 
     if (a->state == AVAHI_PROBING)
-        set_timeout(a, avahi_elapse_time(&tv, 0, AVAHI_PROBE_JITTER_MSEC));
+        set_timeout(a, 0, AVAHI_PROBE_JITTER_MSEC);
     else if (a->state == AVAHI_ANNOUNCING)
-        set_timeout(a, avahi_elapse_time(&tv, 0, AVAHI_ANNOUNCEMENT_JITTER_MSEC));
+        set_timeout(a, 0, AVAHI_ANNOUNCEMENT_JITTER_MSEC);
     else
-        set_timeout(a, NULL);
+        clear_timeout(a);
 }
 
 
@@ -21,6 +21,7 @@
 ***/
 
 typedef struct AvahiAnnouncer AvahiAnnouncer;
+typedef struct AvahiAnnounceSlot AvahiAnnounceSlot;
 
 #include <avahi-common/llist.h>
 #include "iface.h"
@@ -35,12 +36,38 @@ typedef enum {
     AVAHI_ESTABLISHED      /* we'e established */
 } AvahiAnnouncerState;
 
+/* All announcers for the entries of one entry group (or for all
+ * entries without a group) on one interface are driven by a single
+ * timer and stepped together, so that their announcements end up in
+ * shared packets. */
+struct AvahiAnnounceSlot {
+    AvahiServer *server;
+    AvahiInterface *interface;
+    AvahiSEntryGroup *group;
+
+    AvahiTimeEvent *time_event;
+    struct timeval expiry;
+
+    /* While dispatching: the time the slot elapsed, the time the
+     * stepped announcers are moved to, and the earliest time any
+     * announcer of the slot is scheduled for */
+    int dispatching;
+    struct timeval now, target, next;
+    int have_target, have_next;
+
+    AVAHI_LLIST_FIELDS(AvahiAnnounceSlot, slots);
+    AVAHI_LLIST_HEAD(AvahiAnnouncer, announcers);
+    AVAHI_LLIST_HEAD(AvahiAnnouncer, pending);
+};
+
 struct AvahiAnnouncer {
     AvahiServer *server;
     AvahiInterface *interface;
     AvahiEntry *entry;
+    AvahiAnnounceSlot *slot;
 
-    AvahiTimeEvent *time_event;
+    int scheduled, is_pending;
+    struct timeval expiry;
 
     AvahiAnnouncerState state;
     unsigned n_iteration;
@@ -48,11 +75,17 @@ struct AvahiAnnouncer {
 
     AVAHI_LLIST_FIELDS(AvahiAnnouncer, by_interface);
     AVAHI_LLIST_FIELDS(AvahiAnnouncer, by_entry);
+    AVAHI_LLIST_FIELDS(AvahiAnnouncer, by_slot);
+    AVAHI_LLIST_FIELDS(AvahiAnnouncer, pending);
 };
 
+unsigned avahi_announcer_hash(const void *data);
+int avahi_announcer_equal(const void *a, const void *b);
+
 void avahi_announce_interface(AvahiServer *s, AvahiInterface *i);
 void avahi_announce_entry(AvahiServer *s, AvahiEntry *e);
 void avahi_announce_group(AvahiServer *s, AvahiSEntryGroup *g);
+void avahi_announce_groups(AvahiServer *s, AvahiSEntryGroup *groups[], unsigned n_groups);
 
 void avahi_entry_return_to_initial_state(AvahiServer *s, AvahiEntry *e, AvahiInterface *i);
 
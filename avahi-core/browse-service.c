@@ -177,6 +177,112 @@ void avahi_s_service_browser_start(AvahiSServiceBrowser *b) {
     avahi_s_record_browser_start_query(b->record_browser);
 }
 
+struct scan_data {
+    AvahiServer *server;
+    AvahiKey *key;
+    AvahiSServiceScanCallback callback;
+    void *userdata;
+    int n_found;
+};
+
+static void scan_cache_callback(
+    AvahiMulticastLookupEngine *e,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    AvahiBrowserEvent event,
+    AvahiLookupResultFlags flags,
+    AvahiRecord *record,
+    void *userdata) {
+
+    struct scan_data *d = userdata;
+    char service[AVAHI_LABEL_MAX], type[AVAHI_DOMAIN_NAME_MAX], domain[AVAHI_DOMAIN_NAME_MAX];
+
+    assert(e);
+    assert(record);
+    assert(d);
+
+    /* We don't follow CNAMEs here */
+    if (record->key->type != AVAHI_DNS_TYPE_PTR)
+        return;
+
+    flags &= AVAHI_LOOKUP_RESULT_CACHED | AVAHI_LOOKUP_RESULT_MULTICAST;
+
+    if (avahi_server_is_service_local(d->server, interface, protocol, record->data.ptr.name))
+        flags |= AVAHI_LOOKUP_RESULT_LOCAL;
+
+    if (avahi_service_name_split(record->data.ptr.name, service, sizeof(service), type, sizeof(type), domain, sizeof(domain)) < 0) {
+        avahi_log_debug("Failed to split service name '%s'", record->data.ptr.name);
+        return;
+    }
+
+    if (!avahi_is_valid_service_type_strict(type)) {
+        avahi_log_debug("Invalid service '%s'", record->data.ptr.name);
+        return;
+    }
+
+    d->callback(d->server, interface, protocol, service, type, domain, flags, d->userdata);
+    d->n_found++;
+}
+
+static void refresh_interface_callback(AvahiInterfaceMonitor *m, AvahiInterface *i, void* userdata) {
+    struct scan_data *d = userdata;
+
+    assert(m);
+    assert(i);
+    assert(d);
+
+    avahi_interface_post_query(i, d->key, 0, NULL);
+}
+
+int avahi_s_service_browser_scan_cache(
+    AvahiServer *server,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *service_type,
+    const char *domain,
+    AvahiLookupFlags flags,
+    int refresh,
+    AvahiSServiceScanCallback callback,
+    void* userdata) {
+
+    struct scan_data d;
+    char n[AVAHI_DOMAIN_NAME_MAX];
+    int r;
+
+    assert(server);
+    assert(callback);
+    assert(service_type);
+
+    AVAHI_CHECK_VALIDITY(server, AVAHI_IF_VALID(interface), AVAHI_ERR_INVALID_INTERFACE);
+    AVAHI_CHECK_VALIDITY(server, AVAHI_PROTO_VALID(protocol), AVAHI_ERR_INVALID_PROTOCOL);
+    AVAHI_CHECK_VALIDITY(server, !domain || avahi_is_valid_domain_name(domain), AVAHI_ERR_INVALID_DOMAIN_NAME);
+    AVAHI_CHECK_VALIDITY(server, AVAHI_FLAGS_VALID(flags, AVAHI_LOOKUP_USE_MULTICAST), AVAHI_ERR_INVALID_FLAGS);
+    AVAHI_CHECK_VALIDITY(server, avahi_is_valid_service_type_generic(service_type), AVAHI_ERR_INVALID_SERVICE_TYPE);
+
+    if (!domain)
+        domain = server->domain_name;
+
+    if ((r = avahi_service_name_join(n, sizeof(n), NULL, service_type, domain)) < 0)
+        return avahi_server_set_errno(server, r);
+
+    if (!(d.key = avahi_key_new(n, AVAHI_DNS_CLASS_IN, AVAHI_DNS_TYPE_PTR)))
+        return avahi_server_set_errno(server, AVAHI_ERR_NO_MEMORY);
+
+    d.server = server;
+    d.callback = callback;
+    d.userdata = userdata;
+    d.n_found = 0;
+
+    avahi_multicast_lookup_engine_scan_cache(server->multicast_lookup_engine, interface, protocol, d.key, scan_cache_callback, &d);
+
+    if (refresh)
+        avahi_interface_monitor_walk(server->monitor, interface, protocol, refresh_interface_callback, &d);
+
+    avahi_key_unref(d.key);
+
+    return d.n_found;
+}
+
 AvahiSServiceBrowser *avahi_s_service_browser_new(
     AvahiServer *server,
     AvahiIfIndex interface,
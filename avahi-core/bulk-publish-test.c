@@ -0,0 +1,141 @@
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <avahi-common/error.h>
+#include <avahi-common/watch.h>
+#include <avahi-common/simple-watch.h>
+#include <avahi-common/malloc.h>
+#include <avahi-common/timeval.h>
+
+#include <avahi-core/core.h>
+#include <avahi-core/log.h>
+#include <avahi-core/publish.h>
+
+/* Measures how long it takes to publish N services, each in its own
+ * entry group, as a daemon would do at boot time. Usage:
+ *
+ *     bulk-publish-test [N] [--one-by-one]
+ */
+
+static AvahiSimplePoll *simple_poll = NULL;
+static AvahiSEntryGroup **groups = NULL;
+static unsigned n_groups = 1000, n_established = 0;
+static int one_by_one = 0;
+static struct timeval start;
+
+static void group_callback(AVAHI_GCC_UNUSED AvahiServer *s, AVAHI_GCC_UNUSED AvahiSEntryGroup *g, AvahiEntryGroupState state, AVAHI_GCC_UNUSED void* userdata) {
+
+    if (state == AVAHI_ENTRY_GROUP_COLLISION || state == AVAHI_ENTRY_GROUP_FAILURE) {
+        fprintf(stderr, "Group failed to register: %i\n", state);
+        avahi_simple_poll_quit(simple_poll);
+        return;
+    }
+
+    if (state != AVAHI_ENTRY_GROUP_ESTABLISHED)
+        return;
+
+    if (++n_established >= n_groups) {
+        printf("All %u groups established after %llu ms\n", n_groups, (unsigned long long) avahi_age(&start) / 1000);
+        avahi_simple_poll_quit(simple_poll);
+    }
+}
+
+static void server_callback(AvahiServer *s, AvahiServerState state, AVAHI_GCC_UNUSED void* userdata) {
+    unsigned i;
+    int ret;
+
+    if (state != AVAHI_SERVER_RUNNING || groups)
+        return;
+
+    groups = avahi_new(AvahiSEntryGroup*, n_groups);
+    assert(groups);
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < n_groups; i++) {
+        char name[64];
+
+        snprintf(name, sizeof(name), "Bulk Service %u", i);
+
+        groups[i] = avahi_s_entry_group_new(s, group_callback, NULL);
+        assert(groups[i]);
+
+        ret = avahi_server_add_service(s, groups[i], AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, 0, name, "_http._tcp", NULL, NULL, 80, "path=/", NULL);
+        assert(ret == AVAHI_OK);
+    }
+
+    printf("Added %u services in %llu ms\n", n_groups, (unsigned long long) avahi_age(&start) / 1000);
+
+    if (one_by_one) {
+        for (i = 0; i < n_groups; i++) {
+            ret = avahi_s_entry_group_commit(groups[i]);
+            assert(ret == AVAHI_OK);
+        }
+    } else {
+        ret = avahi_s_entry_group_commit_many(groups, n_groups, NULL);
+        assert(ret == AVAHI_OK);
+    }
+
+    printf("Committed %u groups in %llu ms\n", n_groups, (unsigned long long) avahi_age(&start) / 1000);
+}
+
+int main(int argc, char *argv[]) {
+    const AvahiPoll *poll_api;
+    AvahiServer *server;
+    AvahiServerConfig config;
+    int error, i;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--one-by-one"))
+            one_by_one = 1;
+        else
+            n_groups = (unsigned) atoi(argv[i]);
+    }
+
+    assert(n_groups > 0);
+
+    simple_poll = avahi_simple_poll_new();
+    assert(simple_poll);
+
+    poll_api = avahi_simple_poll_get(simple_poll);
+    assert(poll_api);
+
+    avahi_server_config_init(&config);
+    config.publish_domain = config.publish_workstation = config.use_ipv6 = config.publish_hinfo = 0;
+    server = avahi_server_new(poll_api, &config, server_callback, NULL, &error);
+    assert(server);
+    avahi_server_config_free(&config);
+
+    avahi_simple_poll_loop(simple_poll);
+
+    avahi_server_free(server);
+    avahi_free(groups);
+    avahi_simple_poll_free(simple_poll);
+
+    return 0;
+}
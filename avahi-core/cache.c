@@ -414,6 +414,26 @@ int avahi_cache_dump(AvahiCache *c, AvahiDumpCallback callback, void* userdata)
     return 0;
 }
 
+int avahi_cache_snapshot(AvahiCache *c, AvahiSDump *d) {
+    AvahiCacheEntry *e;
+    struct timeval now;
+
+    assert(c);
+    assert(d);
+
+    gettimeofday(&now, NULL);
+
+    for (e = c->entries; e; e = e->entry_next) {
+        AvahiUsec age = avahi_timeval_diff(&now, &e->timestamp)/1000000;
+        uint32_t ttl = age < e->record->ttl ? e->record->ttl - (uint32_t) age : 0;
+
+        if (avahi_s_dump_add(d, AVAHI_DUMP_CACHE, c->interface->hardware->index, c->interface->protocol, e->record, ttl) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
 int avahi_cache_entry_half_ttl(AvahiCache *c, AvahiCacheEntry *e) {
     struct timeval now;
     unsigned age;
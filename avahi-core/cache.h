@@ -83,6 +83,7 @@ void avahi_cache_free(AvahiCache *c);
 void avahi_cache_update(AvahiCache *c, AvahiRecord *r, int cache_flush, const AvahiAddress *a);
 
 int avahi_cache_dump(AvahiCache *c, AvahiDumpCallback callback, void* userdata);
+int avahi_cache_snapshot(AvahiCache *c, AvahiSDump *d);
 
 typedef void* AvahiCacheWalkCallback(AvahiCache *c, AvahiKey *pattern, AvahiCacheEntry *e, void* userdata);
 void* avahi_cache_walk(AvahiCache *c, AvahiKey *pattern, AvahiCacheWalkCallback cb, void* userdata);
@@ -0,0 +1,185 @@
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <avahi-common/error.h>
+#include <avahi-common/watch.h>
+#include <avahi-common/simple-watch.h>
+#include <avahi-common/malloc.h>
+#include <avahi-common/timeval.h>
+
+#include <avahi-core/core.h>
+#include <avahi-core/log.h>
+#include <avahi-core/publish.h>
+
+/* Commits a batch of entry groups with avahi_s_entry_group_commit_many()
+ * whose state callbacks free, reset and commit other groups of the
+ * very same batch while it is still being processed, or reset and
+ * commit their own group again. */
+
+#define N_GROUPS 6
+
+static AvahiSimplePoll *simple_poll = NULL;
+static AvahiSEntryGroup *groups[N_GROUPS];
+static unsigned n_established = 0;
+static int done = 0;
+static struct timeval recommit_time;
+static int recommitted = 0;
+
+static void group_callback(AvahiServer *s, AvahiSEntryGroup *g, AvahiEntryGroupState state, void* userdata) {
+    unsigned idx = (unsigned) (size_t) userdata;
+
+    assert(g == groups[idx]);
+
+    avahi_log_debug("group %u: state %i", idx, state);
+
+    if (state == AVAHI_ENTRY_GROUP_REGISTERING && idx == 0 && groups[2]) {
+
+        /* Free a group that comes later in the batch */
+        avahi_s_entry_group_free(groups[2]);
+        groups[2] = NULL;
+
+        /* Reset another one */
+        avahi_s_entry_group_reset(groups[3]);
+
+        /* And commit one ourselves */
+        assert(avahi_s_entry_group_commit(groups[4]) == AVAHI_OK);
+    }
+
+    if (state == AVAHI_ENTRY_GROUP_REGISTERING && idx == 1 && groups[0]) {
+
+        /* Free a group that comes earlier in the batch and has
+         * already been moved to REGISTERING */
+        avahi_s_entry_group_free(groups[0]);
+        groups[0] = NULL;
+
+        /* Reset our own group and commit it again, which defers
+         * probing until the holdoff time has passed */
+        avahi_s_entry_group_reset(g);
+        assert(avahi_server_add_service(s, g, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, 0, "Commit Many 1 again", "_http._tcp", NULL, NULL, 80, NULL) == AVAHI_OK);
+        gettimeofday(&recommit_time, NULL);
+        assert(avahi_s_entry_group_commit(g) == AVAHI_OK);
+        recommitted = 1;
+    }
+
+    /* The batch must not start probing the group committed again
+     * before its holdoff time */
+    if (state == AVAHI_ENTRY_GROUP_ESTABLISHED && idx == 1) {
+        assert(recommitted);
+        assert(avahi_age(&recommit_time) >= 1000*1000);
+    }
+
+    if (state == AVAHI_ENTRY_GROUP_COLLISION || state == AVAHI_ENTRY_GROUP_FAILURE) {
+        fprintf(stderr, "Group %u failed to register: %i\n", idx, state);
+        abort();
+    }
+
+    if (state == AVAHI_ENTRY_GROUP_ESTABLISHED)
+        n_established++;
+}
+
+static void timeout_callback(AVAHI_GCC_UNUSED AvahiTimeout *t, AVAHI_GCC_UNUSED void *userdata) {
+    avahi_simple_poll_quit(simple_poll);
+}
+
+static void server_callback(AvahiServer *s, AvahiServerState state, AVAHI_GCC_UNUSED void* userdata) {
+    int results[N_GROUPS];
+    unsigned i;
+    int ret;
+
+    if (state != AVAHI_SERVER_RUNNING || done)
+        return;
+
+    done = 1;
+
+    for (i = 0; i < N_GROUPS; i++) {
+        char name[64];
+
+        groups[i] = avahi_s_entry_group_new(s, group_callback, (void*) (size_t) i);
+        assert(groups[i]);
+
+        /* Leave the last group empty, so that it fails to commit */
+        if (i == N_GROUPS-1)
+            continue;
+
+        snprintf(name, sizeof(name), "Commit Many %u", i);
+        ret = avahi_server_add_service(s, groups[i], AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, 0, name, "_http._tcp", NULL, NULL, 80, NULL);
+        assert(ret == AVAHI_OK);
+    }
+
+    ret = avahi_s_entry_group_commit_many(groups, N_GROUPS, results);
+    assert(ret == AVAHI_ERR_IS_EMPTY);
+
+    assert(!groups[0]);
+    assert(!groups[2]);
+
+    assert(results[1] == AVAHI_OK);
+    assert(avahi_s_entry_group_get_state(groups[1]) == AVAHI_ENTRY_GROUP_REGISTERING);
+
+    /* Group 3 was reset by the callback before its turn came */
+    assert(results[3] == AVAHI_ERR_IS_EMPTY);
+    assert(avahi_s_entry_group_get_state(groups[3]) == AVAHI_ENTRY_GROUP_UNCOMMITED);
+
+    /* Group 4 was committed by the callback before its turn came */
+    assert(results[4] == AVAHI_ERR_BAD_STATE);
+    assert(avahi_s_entry_group_get_state(groups[4]) == AVAHI_ENTRY_GROUP_REGISTERING);
+
+    assert(results[5] == AVAHI_ERR_IS_EMPTY);
+    assert(avahi_s_entry_group_get_state(groups[5]) == AVAHI_ENTRY_GROUP_UNCOMMITED);
+}
+
+int main(AVAHI_GCC_UNUSED int argc, AVAHI_GCC_UNUSED char *argv[]) {
+    const AvahiPoll *poll_api;
+    AvahiServer *server;
+    AvahiServerConfig config;
+    struct timeval tv;
+    int error;
+
+    simple_poll = avahi_simple_poll_new();
+    assert(simple_poll);
+
+    poll_api = avahi_simple_poll_get(simple_poll);
+    assert(poll_api);
+
+    avahi_server_config_init(&config);
+    config.publish_domain = config.publish_workstation = config.use_ipv6 = config.publish_hinfo = 0;
+    server = avahi_server_new(poll_api, &config, server_callback, NULL, &error);
+    assert(server);
+    avahi_server_config_free(&config);
+
+    poll_api->timeout_new(poll_api, avahi_elapse_time(&tv, 1000*5, 0), timeout_callback, NULL);
+
+    avahi_simple_poll_loop(simple_poll);
+
+    assert(done);
+    printf("%u groups established\n", n_established);
+    assert(n_established == 2);
+
+    avahi_server_free(server);
+    avahi_simple_poll_free(simple_poll);
+
+    return 0;
+}
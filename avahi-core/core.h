@@ -146,6 +146,77 @@ typedef void (*AvahiDumpCallback)(const char *text, void* userdata);
 /** Dump the current server status by calling "callback" for each line.  */
 int avahi_server_dump(AvahiServer *s, AvahiDumpCallback callback, void* userdata);
 
+/** Where a record reported by avahi_s_dump_next() comes from \since 0.9 */
+typedef enum {
+    AVAHI_DUMP_LOCAL,                      /**< Registered locally */
+    AVAHI_DUMP_CACHE,                      /**< From the mDNS cache of an interface */
+    AVAHI_DUMP_WIDE_AREA                   /**< From the wide area DNS cache */
+} AvahiDumpSource;
+
+/** A snapshot of the records avahi_server_dump() would report, for
+ * formatting them a few at a time without stalling the main
+ * loop. \since 0.9 */
+typedef struct AvahiSDump AvahiSDump;
+
+/** Callback prototype for avahi_s_dump_next(). For cached records
+ * ttl is the number of seconds that were left when the snapshot was
+ * taken. \since 0.9 */
+typedef void (*AvahiSDumpCallback)(AvahiDumpSource source, AvahiIfIndex interface, AvahiProtocol protocol, AvahiRecord *r, uint32_t ttl, void* userdata);
+
+/** Take a snapshot of all local and cached records. The records are
+ * only referenced, which makes this cheap even for large caches. The
+ * snapshot is not affected by later changes of the server state and
+ * may outlive the server. \since 0.9 */
+AvahiSDump *avahi_s_dump_new(AvahiServer *s);
+
+/** Call "callback" for the next n records of the snapshot at most,
+ * returns the number of records left. \since 0.9 */
+unsigned avahi_s_dump_next(AvahiSDump *d, unsigned n, AvahiSDumpCallback callback, void* userdata);
+
+/** Free a snapshot \since 0.9 */
+void avahi_s_dump_free(AvahiSDump *d);
+
+/** Counters of a single interface, see
+ * avahi_server_get_statistics(). The fields ending in _total only
+ * ever grow, the others describe the current state. \since 0.9 */
+typedef struct AvahiInterfaceStatistics {
+    AvahiIfIndex interface;
+    AvahiProtocol protocol;
+    const char *name;                      /**< The name of the network interface */
+
+    uint64_t packets_received_total;       /**< All packets received on the interface, including invalid ones */
+    uint64_t packets_invalid_total;        /**< Packets dropped because they were malformed or failed a sanity check */
+    uint64_t queries_received_total;       /**< Query packets accepted for processing */
+    uint64_t responses_received_total;     /**< Response packets accepted for processing */
+    uint64_t packets_sent_total;
+    uint64_t packets_rate_limited_total;   /**< Packets not sent because of rate limiting */
+    uint64_t queries_suppressed_total;     /**< Queries not sent due to duplicate question suppression */
+    uint64_t responses_suppressed_total;   /**< Responses not sent due to known answer or duplicate answer suppression */
+    uint64_t cache_lookups_total;          /**< Lookups started on this interface */
+    uint64_t cache_hits_total;             /**< Lookups the cache already had an answer for */
+
+    unsigned cache_entries;
+    unsigned queries_scheduled;            /**< Length of the query scheduler queue */
+    unsigned responses_scheduled;          /**< Length of the response scheduler queue */
+    unsigned probes_scheduled;             /**< Length of the probe scheduler queue */
+} AvahiInterfaceStatistics;
+
+/** Server wide counters, see avahi_server_get_statistics() \since 0.9 */
+typedef struct AvahiServerStatistics {
+    uint64_t packets_unknown_interface_total; /**< Packets received on interfaces the server doesn't use */
+    unsigned entries;                      /**< Records registered locally */
+    unsigned entry_groups;
+    unsigned record_browsers;              /**< Active record browsers, the basis of all other browsers and resolvers */
+} AvahiServerStatistics;
+
+/** Callback prototype for avahi_server_get_statistics() \since 0.9 */
+typedef void (*AvahiInterfaceStatisticsCallback)(const AvahiInterfaceStatistics *st, void* userdata);
+
+/** Fill in the server wide counters and call "callback" with the
+ * counters of each interface in use. Either of ret and callback may
+ * be NULL. Counting is cheap and always enabled. \since 0.9 */
+int avahi_server_get_statistics(AvahiServer *s, AvahiServerStatistics *ret, AvahiInterfaceStatisticsCallback callback, void* userdata);
+
 /** Return the last error code */
 int avahi_server_errno(AvahiServer *s);
 
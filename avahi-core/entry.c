@@ -103,6 +103,8 @@ void avahi_entry_group_free(AvahiServer *s, AvahiSEntryGroup *g) {
     while (g->entries)
         avahi_entry_free(s, g->entries);
 
+    assert(!g->announce_slots);
+
     if (g->register_time_event)
         avahi_time_event_free(g->register_time_event);
 
@@ -375,6 +377,152 @@ int avahi_server_dump(AvahiServer *s, AvahiDumpCallback callback, void* userdata
     return AVAHI_OK;
 }
 
+typedef struct AvahiSDumpItem {
+    AvahiDumpSource source;
+    AvahiIfIndex interface;
+    AvahiProtocol protocol;
+    AvahiRecord *record;
+    uint32_t ttl;
+} AvahiSDumpItem;
+
+struct AvahiSDump {
+    AvahiSDumpItem *items;
+    unsigned n_items, n_allocated;
+
+    /* The next item to report */
+    unsigned index;
+};
+
+int avahi_s_dump_add(AvahiSDump *d, AvahiDumpSource source, AvahiIfIndex interface, AvahiProtocol protocol, AvahiRecord *r, uint32_t ttl) {
+    AvahiSDumpItem *item;
+
+    assert(d);
+    assert(r);
+
+    if (d->n_items >= d->n_allocated) {
+        unsigned n = d->n_allocated ? d->n_allocated * 2 : 64;
+
+        if (!(item = avahi_realloc(d->items, sizeof(AvahiSDumpItem) * n)))
+            return -1;
+
+        d->items = item;
+        d->n_allocated = n;
+    }
+
+    item = &d->items[d->n_items++];
+    item->source = source;
+    item->interface = interface;
+    item->protocol = protocol;
+    item->record = avahi_record_ref(r);
+    item->ttl = ttl;
+
+    return 0;
+}
+
+AvahiSDump *avahi_s_dump_new(AvahiServer *s) {
+    AvahiSDump *d;
+    AvahiEntry *e;
+    AvahiInterface *i;
+
+    assert(s);
+
+    if (!(d = avahi_new0(AvahiSDump, 1))) {
+        avahi_server_set_errno(s, AVAHI_ERR_NO_MEMORY);
+        return NULL;
+    }
+
+    for (e = s->entries; e; e = e->entries_next) {
+
+        if (e->dead)
+            continue;
+
+        if (avahi_s_dump_add(d, AVAHI_DUMP_LOCAL, e->interface, e->protocol, e->record, e->record->ttl) < 0)
+            goto fail;
+    }
+
+    for (i = s->monitor->interfaces; i; i = i->interface_next)
+        if (avahi_interface_is_relevant(i))
+            if (avahi_cache_snapshot(i->cache, d) < 0)
+                goto fail;
+
+    if (s->wide_area_lookup_engine)
+        if (avahi_wide_area_cache_snapshot(s->wide_area_lookup_engine, d) < 0)
+            goto fail;
+
+    return d;
+
+fail:
+    avahi_s_dump_free(d);
+    avahi_server_set_errno(s, AVAHI_ERR_NO_MEMORY);
+    return NULL;
+}
+
+unsigned avahi_s_dump_next(AvahiSDump *d, unsigned n, AvahiSDumpCallback callback, void* userdata) {
+    assert(d);
+    assert(callback);
+
+    for (; n > 0 && d->index < d->n_items; n--, d->index++) {
+        AvahiSDumpItem *item = &d->items[d->index];
+
+        callback(item->source, item->interface, item->protocol, item->record, item->ttl, userdata);
+    }
+
+    return d->n_items - d->index;
+}
+
+void avahi_s_dump_free(AvahiSDump *d) {
+    unsigned j;
+
+    assert(d);
+
+    for (j = 0; j < d->n_items; j++)
+        avahi_record_unref(d->items[j].record);
+
+    avahi_free(d->items);
+    avahi_free(d);
+}
+
+int avahi_server_get_statistics(AvahiServer *s, AvahiServerStatistics *ret, AvahiInterfaceStatisticsCallback callback, void* userdata) {
+    assert(s);
+
+    if (ret) {
+        AvahiEntry *e;
+        AvahiSEntryGroup *g;
+        AvahiSRecordBrowser *b;
+
+        memset(ret, 0, sizeof(*ret));
+        ret->packets_unknown_interface_total = s->packets_unknown_interface;
+
+        for (e = s->entries; e; e = e->entries_next)
+            if (!e->dead)
+                ret->entries++;
+
+        for (g = s->groups; g; g = g->groups_next)
+            if (!g->dead)
+                ret->entry_groups++;
+
+        for (b = s->record_browsers; b; b = b->browser_next)
+            if (!b->dead)
+                ret->record_browsers++;
+    }
+
+    if (callback) {
+        AvahiInterface *i;
+
+        for (i = s->monitor->interfaces; i; i = i->interface_next) {
+            AvahiInterfaceStatistics st;
+
+            if (!avahi_interface_is_relevant(i))
+                continue;
+
+            avahi_interface_get_statistics(i, &st);
+            callback(&st, userdata);
+        }
+    }
+
+    return AVAHI_OK;
+}
+
 static AvahiEntry *server_add_ptr_internal(
     AvahiServer *s,
     AvahiSEntryGroup *g,
@@ -1060,9 +1208,11 @@ AvahiSEntryGroup *avahi_s_entry_group_new(AvahiServer *s, AvahiSEntryGroupCallba
     g->n_probing = 0;
     g->n_register_try = 0;
     g->register_time_event = NULL;
+    g->announce_pending = 0;
     g->register_time.tv_sec = 0;
     g->register_time.tv_usec = 0;
     AVAHI_LLIST_HEAD_INIT(AvahiEntry, g->entries);
+    AVAHI_LLIST_HEAD_INIT(AvahiAnnounceSlot, g->announce_slots);
 
     AVAHI_LLIST_PREPEND(AvahiSEntryGroup, groups, s->groups, g);
     return g;
@@ -1136,9 +1286,11 @@ static void entry_group_register_time_event_callback(AVAHI_GCC_UNUSED AvahiTimeE
     entry_group_commit_real(g);
 }
 
-int avahi_s_entry_group_commit(AvahiSEntryGroup *g) {
-    struct timeval now;
-
+/* Returns a negative error code if the group cannot be committed, 0
+ * if the registration has been deferred because the holdoff time has
+ * not passed yet, and 1 if the caller shall start probing right
+ * away. */
+static int entry_group_check_commit(AvahiSEntryGroup *g) {
     assert(g);
     assert(!g->dead);
 
@@ -1148,6 +1300,19 @@ int avahi_s_entry_group_commit(AvahiSEntryGroup *g) {
     if (avahi_s_entry_group_is_empty(g))
         return avahi_server_set_errno(g->server, AVAHI_ERR_IS_EMPTY);
 
+    return AVAHI_OK;
+}
+
+static int entry_group_prepare_commit(AvahiSEntryGroup *g) {
+    struct timeval now;
+    int r;
+
+    assert(g);
+
+    if ((r = entry_group_check_commit(g)) < 0)
+        return r;
+
+    g->announce_pending = 0;
     g->n_register_try++;
 
     avahi_timeval_add(&g->register_time,
@@ -1157,20 +1322,130 @@ int avahi_s_entry_group_commit(AvahiSEntryGroup *g) {
 
     gettimeofday(&now, NULL);
 
-    if (avahi_timeval_compare(&g->register_time, &now) <= 0) {
-
+    if (avahi_timeval_compare(&g->register_time, &now) <= 0)
         /* Holdoff time passed, so let's start probing */
+        return 1;
+
+    /* Holdoff time has not yet passed, so let's wait */
+    assert(!g->register_time_event);
+    g->register_time_event = avahi_time_event_new(g->server->time_event_queue, &g->register_time, entry_group_register_time_event_callback, g);
+
+    avahi_s_entry_group_change_state(g, AVAHI_ENTRY_GROUP_REGISTERING);
+
+    return 0;
+}
+
+int avahi_s_entry_group_commit(AvahiSEntryGroup *g) {
+    int r;
+
+    assert(g);
+    assert(!g->dead);
+
+    if ((r = entry_group_prepare_commit(g)) < 0)
+        return r;
+
+    if (r > 0)
         entry_group_commit_real(g);
-    } else {
 
-         /* Holdoff time has not yet passed, so let's wait */
-        assert(!g->register_time_event);
-        g->register_time_event = avahi_time_event_new(g->server->time_event_queue, &g->register_time, entry_group_register_time_event_callback, g);
+    return AVAHI_OK;
+}
+
+int avahi_s_entry_group_commit_many(AvahiSEntryGroup *groups[], unsigned n_groups, int results[]) {
+    AvahiServer *s;
+    AvahiSEntryGroup **ready;
+    unsigned i;
+    int ret = AVAHI_OK;
+
+    assert(groups || n_groups == 0);
+
+    if (n_groups <= 0)
+        return AVAHI_OK;
 
-        avahi_s_entry_group_change_state(g, AVAHI_ENTRY_GROUP_REGISTERING);
+    assert(groups[0]);
+    s = groups[0]->server;
+
+    if (!(ready = avahi_new(AvahiSEntryGroup*, n_groups)))
+        return avahi_server_set_errno(s, AVAHI_ERR_NO_MEMORY);
+
+    /* Validate all groups first, before any state change callback
+     * gets a chance to run */
+    for (i = 0; i < n_groups; i++) {
+        int r;
+
+        assert(groups[i]);
+        assert(groups[i]->server == s);
+
+        if ((r = entry_group_check_commit(groups[i])) < 0) {
+            if (ret == AVAHI_OK)
+                ret = r;
+            ready[i] = NULL;
+        } else
+            ready[i] = groups[i];
+
+        if (results)
+            results[i] = r;
     }
 
-    return AVAHI_OK;
+    /* The state change callbacks might free, reset or commit any of
+     * the groups, hence we check their state again before each
+     * step. Dead groups stay allocated until the next cleanup run,
+     * so looking at the flag is safe. */
+
+    for (i = 0; i < n_groups; i++) {
+        int r;
+
+        if (!ready[i])
+            continue;
+
+        if (ready[i]->dead) {
+            ready[i] = NULL;
+            continue;
+        }
+
+        if ((r = entry_group_prepare_commit(ready[i])) <= 0) {
+
+            if (r < 0) {
+                if (ret == AVAHI_OK)
+                    ret = r;
+
+                if (results)
+                    results[i] = r;
+            }
+
+            /* Failed or deferred until the holdoff time passed */
+            ready[i] = NULL;
+            continue;
+        }
+
+        gettimeofday(&ready[i]->register_time, NULL);
+        ready[i]->announce_pending = 1;
+        avahi_s_entry_group_change_state(ready[i], AVAHI_ENTRY_GROUP_REGISTERING);
+    }
+
+    /* A group that has been reset and committed again by a callback
+     * is in REGISTERING state too, but its new commit takes care of
+     * announcing it, possibly only after the holdoff time */
+    for (i = 0; i < n_groups; i++) {
+        if (!ready[i])
+            continue;
+
+        if (ready[i]->dead || !ready[i]->announce_pending || ready[i]->state != AVAHI_ENTRY_GROUP_REGISTERING) {
+            ready[i] = NULL;
+            continue;
+        }
+
+        ready[i]->announce_pending = 0;
+    }
+
+    avahi_announce_groups(s, ready, n_groups);
+
+    for (i = 0; i < n_groups; i++)
+        if (ready[i] && !ready[i]->dead && ready[i]->state == AVAHI_ENTRY_GROUP_REGISTERING)
+            avahi_s_entry_group_check_probed(ready[i], 0);
+
+    avahi_free(ready);
+
+    return ret;
 }
 
 void avahi_s_entry_group_reset(AvahiSEntryGroup *g) {
@@ -1186,6 +1461,7 @@ void avahi_s_entry_group_reset(AvahiSEntryGroup *g) {
     g->server->need_entry_cleanup = 1;
 
     g->n_probing = 0;
+    g->announce_pending = 0;
 
     avahi_s_entry_group_change_state(g, AVAHI_ENTRY_GROUP_UNCOMMITED);
 
@@ -341,6 +341,7 @@ AvahiInterface* avahi_interface_new(AvahiInterfaceMonitor *m, AvahiHwInterface *
     i->protocol = protocol;
     i->announcing = 0;
     i->mcast_joined = 0;
+    memset(&i->statistics, 0, sizeof(i->statistics));
 
     AVAHI_LLIST_HEAD_INIT(AvahiInterfaceAddress, i->addresses);
     AVAHI_LLIST_HEAD_INIT(AvahiAnnouncer, i->announcers);
@@ -592,8 +593,10 @@ void avahi_interface_send_packet_unicast(AvahiInterface *i, AvahiDnsPacket *p, c
             i->hardware->ratelimit_counter = 0;
         }
 
-        if (i->hardware->ratelimit_counter > i->monitor->server->config.ratelimit_burst)
+        if (i->hardware->ratelimit_counter > i->monitor->server->config.ratelimit_burst) {
+            i->statistics.packets_rate_limited_total++;
             return;
+        }
 
         i->hardware->ratelimit_counter++;
     }
@@ -602,6 +605,10 @@ void avahi_interface_send_packet_unicast(AvahiInterface *i, AvahiDnsPacket *p, c
         avahi_send_dns_packet_ipv4(i->monitor->server->fd_ipv4, i->hardware->index, p, i->mcast_joined ? &i->local_mcast_address.data.ipv4 : NULL, a ? &a->data.ipv4 : NULL, port);
     else if (i->protocol == AVAHI_PROTO_INET6 && i->monitor->server->fd_ipv6 >= 0)
         avahi_send_dns_packet_ipv6(i->monitor->server->fd_ipv6, i->hardware->index, p, i->mcast_joined ? &i->local_mcast_address.data.ipv6 : NULL, a ? &a->data.ipv6 : NULL, port);
+    else
+        return;
+
+    i->statistics.packets_sent_total++;
 }
 
 void avahi_interface_send_packet(AvahiInterface *i, AvahiDnsPacket *p) {
@@ -663,6 +670,20 @@ int avahi_dump_caches(AvahiInterfaceMonitor *m, AvahiDumpCallback callback, void
     return 0;
 }
 
+void avahi_interface_get_statistics(AvahiInterface *i, AvahiInterfaceStatistics *ret) {
+    assert(i);
+    assert(ret);
+
+    *ret = i->statistics;
+    ret->interface = i->hardware->index;
+    ret->protocol = i->protocol;
+    ret->name = i->hardware->name;
+    ret->cache_entries = i->cache->n_entries;
+    ret->queries_scheduled = avahi_query_scheduler_count_jobs(i->query_scheduler);
+    ret->responses_scheduled = avahi_response_scheduler_count_jobs(i->response_scheduler);
+    ret->probes_scheduled = avahi_probe_scheduler_count_jobs(i->probe_scheduler);
+}
+
 static int avahi_interface_is_relevant_internal(AvahiInterface *i) {
     AvahiInterfaceAddress *a;
 
@@ -115,6 +115,10 @@ struct AvahiInterface {
 
     AvahiHashmap *queriers_by_key;
     AVAHI_LLIST_HEAD(AvahiQuerier, queriers);
+
+    /* Only the *_total counters are maintained here, the other fields
+     * are filled in by avahi_interface_get_statistics() */
+    AvahiInterfaceStatistics statistics;
 };
 
 struct AvahiInterfaceAddress {
@@ -143,6 +147,8 @@ typedef void (*AvahiInterfaceMonitorWalkCallback)(AvahiInterfaceMonitor *m, Avah
 void avahi_interface_monitor_walk(AvahiInterfaceMonitor *m, AvahiIfIndex idx, AvahiProtocol protocol, AvahiInterfaceMonitorWalkCallback callback, void* userdata);
 int avahi_dump_caches(AvahiInterfaceMonitor *m, AvahiDumpCallback callback, void* userdata);
 
+void avahi_interface_get_statistics(AvahiInterface *i, AvahiInterfaceStatistics *ret);
+
 void avahi_interface_monitor_update_rrs(AvahiInterfaceMonitor *m, int remove_rrs);
 int avahi_address_is_local(AvahiInterfaceMonitor *m, const AvahiAddress *a);
 void avahi_interface_monitor_check_relevant(AvahiInterfaceMonitor *m);
@@ -93,10 +93,17 @@ struct AvahiSEntryGroup {
     struct timeval register_time;
     AvahiTimeEvent *register_time_event;
 
+    /* Set while avahi_s_entry_group_commit_many() still has to
+     * announce this group, cleared by any reset or later commit */
+    int announce_pending;
+
     struct timeval established_at;
 
     AVAHI_LLIST_FIELDS(AvahiSEntryGroup, groups);
     AVAHI_LLIST_HEAD(AvahiEntry, entries);
+
+    /* One announcement slot per interface */
+    AVAHI_LLIST_HEAD(AvahiAnnounceSlot, announce_slots);
 };
 
 struct AvahiServer {
@@ -110,6 +117,16 @@ struct AvahiServer {
 
     AVAHI_LLIST_HEAD(AvahiSEntryGroup, groups);
 
+    /* Announcement slots for entries that don't belong to a group */
+    AVAHI_LLIST_HEAD(AvahiAnnounceSlot, announce_slots);
+
+    /* All announcers, indexed by (interface, entry) */
+    AvahiHashmap *announcer_hashmap;
+
+    /* The randomly delayed time at which recently committed entries
+     * start probing/announcing */
+    struct timeval announce_start;
+
     AVAHI_LLIST_HEAD(AvahiSRecordBrowser, record_browsers);
     AvahiHashmap *record_browser_hashmap;
     AVAHI_LLIST_HEAD(AvahiSHostNameResolver, host_name_resolvers);
@@ -159,6 +176,9 @@ struct AvahiServer {
 
     AvahiMulticastLookupEngine *multicast_lookup_engine;
     AvahiWideAreaLookupEngine *wide_area_lookup_engine;
+
+    /* Packets that couldn't be accounted to any interface */
+    uint64_t packets_unknown_interface;
 };
 
 void avahi_entry_free(AvahiServer*s, AvahiEntry *e);
@@ -182,6 +202,9 @@ void avahi_server_decrease_host_rr_pending(AvahiServer *s);
 
 int avahi_server_set_errno(AvahiServer *s, int error);
 
+/* Add a record to a snapshot taken by avahi_s_dump_new() */
+int avahi_s_dump_add(AvahiSDump *d, AvahiDumpSource source, AvahiIfIndex interface, AvahiProtocol protocol, AvahiRecord *r, uint32_t ttl);
+
 int avahi_server_is_service_local(AvahiServer *s, AvahiIfIndex interface, AvahiProtocol protocol, const char *name);
 int avahi_server_is_record_local(AvahiServer *s, AvahiIfIndex interface, AvahiProtocol protocol, AvahiRecord *record);
 
@@ -279,6 +279,36 @@ void avahi_s_service_browser_start(AvahiSServiceBrowser *b);
 /** Free an AvahiSServiceBrowser object */
 void avahi_s_service_browser_free(AvahiSServiceBrowser *b);
 
+/** Callback prototype for avahi_s_service_browser_scan_cache() \since 0.9 */
+typedef void (*AvahiSServiceScanCallback)(
+    AvahiServer *server,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *name     /**< Service name, e.g. "Lennart's Files" */,
+    const char *type     /**< DNS-SD type, e.g. "_http._tcp" */,
+    const char *domain   /**< Domain of this service, e.g. "local" */,
+    AvahiLookupResultFlags flags,  /**< Lookup flags */
+    void* userdata);
+
+/** Report all services of the specified type currently found in the
+ * multicast DNS cache, without creating a browser. The callback is
+ * called synchronously for each of them. If refresh is non-zero a
+ * query for the type is sent on all matching interfaces, so that
+ * services that haven't been seen yet show up in the cache
+ * shortly. Only AVAHI_LOOKUP_USE_MULTICAST may be passed in
+ * flags. Returns the number of services reported, or a negative
+ * error code. \since 0.9 */
+int avahi_s_service_browser_scan_cache(
+    AvahiServer *server,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *service_type /** DNS-SD service type, e.g. "_http._tcp" */,
+    const char *domain,
+    AvahiLookupFlags flags,                 /**< Lookup flags. */
+    int refresh,
+    AvahiSServiceScanCallback callback,
+    void* userdata);
+
 /** Callback prototype for AvahiSServiceResolver events */
 typedef void (*AvahiSServiceResolverCallback)(
     AvahiSServiceResolver *r,
@@ -30,6 +30,7 @@
 #include "probe-sched.h"
 #include "log.h"
 #include "rr-util.h"
+#include "hashmap.h"
 
 #define AVAHI_PROBE_HISTORY_MSEC 150
 #define AVAHI_PROBE_DEFER_MSEC 50
@@ -38,27 +39,43 @@ typedef struct AvahiProbeJob AvahiProbeJob;
 
 struct AvahiProbeJob {
     AvahiProbeScheduler *scheduler;
-    AvahiTimeEvent *time_event;
 
     int chosen; /* Use for packet assembling */
+    int due; /* Use for packet assembling */
     int done;
     struct timeval delivery;
 
     AvahiRecord *record;
 
     AVAHI_LLIST_FIELDS(AvahiProbeJob, jobs);
+    AVAHI_LLIST_FIELDS(AvahiProbeJob, by_name);
 };
 
 struct AvahiProbeScheduler {
     AvahiInterface *interface;
     AvahiTimeEventQueue *time_event_queue;
 
+    /* All jobs that are due are sent together when this event
+     * elapses, spread over as many packets as necessary */
+    AvahiTimeEvent *time_event;
+    struct timeval delivery;
+
+    unsigned n_jobs;
+
+    /* Removes outdated jobs from the history */
+    AvahiTimeEvent *history_time_event;
+
     AVAHI_LLIST_HEAD(AvahiProbeJob, jobs);
     AVAHI_LLIST_HEAD(AvahiProbeJob, history);
+
+    /* Both scheduled and history jobs, indexed by record name */
+    AvahiHashmap *jobs_by_name;
 };
 
+static void history_elapse_callback(AvahiTimeEvent *e, void* data);
+
 static AvahiProbeJob* job_new(AvahiProbeScheduler *s, AvahiRecord *record, int done) {
-    AvahiProbeJob *pj;
+    AvahiProbeJob *pj, *t;
 
     assert(s);
     assert(record);
@@ -70,48 +87,47 @@ static AvahiProbeJob* job_new(AvahiProbeScheduler *s, AvahiRecord *record, int d
 
     pj->scheduler = s;
     pj->record = avahi_record_ref(record);
-    pj->time_event = NULL;
     pj->chosen = 0;
+    pj->due = 0;
 
     if ((pj->done = done))
         AVAHI_LLIST_PREPEND(AvahiProbeJob, jobs, s->history, pj);
-    else
+    else {
         AVAHI_LLIST_PREPEND(AvahiProbeJob, jobs, s->jobs, pj);
+        s->n_jobs++;
+    }
+
+    t = avahi_hashmap_lookup(s->jobs_by_name, pj->record->key->name);
+    AVAHI_LLIST_PREPEND(AvahiProbeJob, by_name, t, pj);
+    avahi_hashmap_replace(s->jobs_by_name, pj->record->key->name, t);
 
     return pj;
 }
 
 static void job_free(AvahiProbeScheduler *s, AvahiProbeJob *pj) {
-    assert(pj);
+    AvahiProbeJob *t;
 
-    if (pj->time_event)
-        avahi_time_event_free(pj->time_event);
+    assert(pj);
 
     if (pj->done)
         AVAHI_LLIST_REMOVE(AvahiProbeJob, jobs, s->history, pj);
-    else
+    else {
         AVAHI_LLIST_REMOVE(AvahiProbeJob, jobs, s->jobs, pj);
+        assert(s->n_jobs > 0);
+        s->n_jobs--;
+    }
+
+    t = avahi_hashmap_lookup(s->jobs_by_name, pj->record->key->name);
+    AVAHI_LLIST_REMOVE(AvahiProbeJob, by_name, t, pj);
+    if (t)
+        avahi_hashmap_replace(s->jobs_by_name, t->record->key->name, t);
+    else
+        avahi_hashmap_remove(s->jobs_by_name, pj->record->key->name);
 
     avahi_record_unref(pj->record);
     avahi_free(pj);
 }
 
-static void elapse_callback(AvahiTimeEvent *e, void* data);
-
-static void job_set_elapse_time(AvahiProbeScheduler *s, AvahiProbeJob *pj, unsigned msec, unsigned jitter) {
-    struct timeval tv;
-
-    assert(s);
-    assert(pj);
-
-    avahi_elapse_time(&tv, msec, jitter);
-
-    if (pj->time_event)
-        avahi_time_event_update(pj->time_event, &tv);
-    else
-        pj->time_event = avahi_time_event_new(s->time_event_queue, &tv, elapse_callback, pj);
-}
-
 static void job_mark_done(AvahiProbeScheduler *s, AvahiProbeJob *pj) {
     assert(s);
     assert(pj);
@@ -121,10 +137,49 @@ static void job_mark_done(AvahiProbeScheduler *s, AvahiProbeJob *pj) {
     AVAHI_LLIST_REMOVE(AvahiProbeJob, jobs, s->jobs, pj);
     AVAHI_LLIST_PREPEND(AvahiProbeJob, jobs, s->history, pj);
 
+    assert(s->n_jobs > 0);
+    s->n_jobs--;
+
     pj->done = 1;
+    pj->chosen = 0;
+    pj->due = 0;
 
-    job_set_elapse_time(s, pj, AVAHI_PROBE_HISTORY_MSEC, 0);
     gettimeofday(&pj->delivery, NULL);
+
+    if (!s->history_time_event) {
+        struct timeval tv;
+
+        avahi_elapse_time(&tv, AVAHI_PROBE_HISTORY_MSEC, 0);
+        s->history_time_event = avahi_time_event_new(s->time_event_queue, &tv, history_elapse_callback, s);
+    }
+}
+
+static void history_elapse_callback(AVAHI_GCC_UNUSED AvahiTimeEvent *e, void* data) {
+    AvahiProbeScheduler *s = data;
+    AvahiProbeJob *pj, *next;
+    const struct timeval *oldest = NULL;
+
+    assert(s);
+
+    /* Let's remove all outdated jobs from the history */
+    for (pj = s->history; pj; pj = next) {
+        next = pj->jobs_next;
+
+        if (avahi_age(&pj->delivery) >= AVAHI_PROBE_HISTORY_MSEC*1000)
+            job_free(s, pj);
+        else if (!oldest || avahi_timeval_compare(&pj->delivery, oldest) < 0)
+            oldest = &pj->delivery;
+    }
+
+    if (oldest) {
+        struct timeval tv = *oldest;
+
+        avahi_timeval_add(&tv, AVAHI_PROBE_HISTORY_MSEC*1000);
+        avahi_time_event_update(s->history_time_event, &tv);
+    } else {
+        avahi_time_event_free(s->history_time_event);
+        s->history_time_event = NULL;
+    }
 }
 
 AvahiProbeScheduler *avahi_probe_scheduler_new(AvahiInterface *i) {
@@ -137,8 +192,17 @@ AvahiProbeScheduler *avahi_probe_scheduler_new(AvahiInterface *i) {
         return NULL;
     }
 
+    if (!(s->jobs_by_name = avahi_hashmap_new((AvahiHashFunc) avahi_domain_hash, (AvahiEqualFunc) avahi_domain_equal, NULL, NULL))) {
+        avahi_log_error(__FILE__": Out of memory");
+        avahi_free(s);
+        return NULL;
+    }
+
     s->interface = i;
     s->time_event_queue = i->monitor->server->time_event_queue;
+    s->time_event = NULL;
+    s->history_time_event = NULL;
+    s->n_jobs = 0;
 
     AVAHI_LLIST_HEAD_INIT(AvahiProbeJob, s->jobs);
     AVAHI_LLIST_HEAD_INIT(AvahiProbeJob, s->history);
@@ -150,6 +214,7 @@ void avahi_probe_scheduler_free(AvahiProbeScheduler *s) {
     assert(s);
 
     avahi_probe_scheduler_clear(s);
+    avahi_hashmap_free(s->jobs_by_name);
     avahi_free(s);
 }
 
@@ -160,6 +225,22 @@ void avahi_probe_scheduler_clear(AvahiProbeScheduler *s) {
         job_free(s, s->jobs);
     while (s->history)
         job_free(s, s->history);
+
+    if (s->time_event) {
+        avahi_time_event_free(s->time_event);
+        s->time_event = NULL;
+    }
+
+    if (s->history_time_event) {
+        avahi_time_event_free(s->history_time_event);
+        s->history_time_event = NULL;
+    }
+}
+
+unsigned avahi_probe_scheduler_count_jobs(AvahiProbeScheduler *s) {
+    assert(s);
+
+    return s->n_jobs;
 }
 
 static int packet_add_probe_query(AvahiProbeScheduler *s, AvahiDnsPacket *p, AvahiProbeJob *pj) {
@@ -172,6 +253,7 @@ static int packet_add_probe_query(AvahiProbeScheduler *s, AvahiDnsPacket *p, Ava
     assert(pj);
 
     assert(!pj->chosen);
+    assert(pj->due);
 
     /* Estimate the size for this record */
     size =
@@ -196,20 +278,20 @@ static int packet_add_probe_query(AvahiProbeScheduler *s, AvahiDnsPacket *p, Ava
     pj->chosen = 1;
 
     /* Scan for more jobs with matching key pattern */
-    for (pj = s->jobs; pj; pj = pj->jobs_next) {
-        if (pj->chosen)
+    for (pj = avahi_hashmap_lookup(s->jobs_by_name, k->name); pj; pj = pj->by_name_next) {
+        if (pj->chosen || !pj->due)
             continue;
 
         /* Does the record match the probe? */
-        if (k->clazz != pj->record->key->clazz || !avahi_domain_equal(k->name, pj->record->key->name))
+        if (k->clazz != pj->record->key->clazz)
             continue;
 
         /* This job wouldn't fit in */
         if (avahi_record_get_estimate_size(pj->record) > avahi_dns_packet_reserved_space(p))
             break;
 
-   /* reserve size for record data */
-   avahi_dns_packet_reserve_size(p, avahi_record_get_estimate_size(pj->record));
+        /* reserve size for record data */
+        avahi_dns_packet_reserve_size(p, avahi_record_get_estimate_size(pj->record));
 
         /* Mark this job for addition to the packet */
         pj->chosen = 1;
@@ -220,68 +302,73 @@ static int packet_add_probe_query(AvahiProbeScheduler *s, AvahiDnsPacket *p, Ava
     return 1;
 }
 
-static void elapse_callback(AVAHI_GCC_UNUSED AvahiTimeEvent *e, void* data) {
-    AvahiProbeJob *pj = data, *next;
-    AvahiProbeScheduler *s;
+static void send_single_probe(AvahiProbeScheduler *s, AvahiProbeJob *pj) {
     AvahiDnsPacket *p;
-    unsigned n;
+    size_t size;
+    AvahiKey *k;
+    int b;
 
+    assert(s);
     assert(pj);
-    s = pj->scheduler;
 
-    if (pj->done) {
-        /* Let's remove it  from the history */
-        job_free(s, pj);
-        return;
-    }
+    /* The probe didn't fit in the package, so let's allocate a larger one */
 
-    if (!(p = avahi_dns_packet_new_query(s->interface->hardware->mtu)))
-        return; /* OOM */
-    n = 1;
+    size =
+        avahi_key_get_estimate_size(pj->record->key) +
+        avahi_record_get_estimate_size(pj->record) +
+        AVAHI_DNS_PACKET_HEADER_SIZE;
 
-    /* Add the import probe */
-    if (!packet_add_probe_query(s, p, pj)) {
-        size_t size;
-        AvahiKey *k;
-        int b;
+    if (!(p = avahi_dns_packet_new_query(size + AVAHI_DNS_PACKET_EXTRA_SIZE)))
+        return; /* OOM */
 
+    if (!(k = avahi_key_new(pj->record->key->name, pj->record->key->clazz, AVAHI_DNS_TYPE_ANY))) {
         avahi_dns_packet_free(p);
+        return;  /* OOM */
+    }
 
-        /* The probe didn't fit in the package, so let's allocate a larger one */
+    b = avahi_dns_packet_append_key(p, k, 0) && avahi_dns_packet_append_record(p, pj->record, 0, 0);
+    avahi_key_unref(k);
 
-        size =
-            avahi_key_get_estimate_size(pj->record->key) +
-            avahi_record_get_estimate_size(pj->record) +
-            AVAHI_DNS_PACKET_HEADER_SIZE;
+    if (b) {
+        avahi_dns_packet_set_field(p, AVAHI_DNS_FIELD_NSCOUNT, 1);
+        avahi_dns_packet_set_field(p, AVAHI_DNS_FIELD_QDCOUNT, 1);
+        avahi_interface_send_packet(s->interface, p);
+    } else
+        avahi_log_warn("Probe record too large, cannot send");
 
-        if (!(p = avahi_dns_packet_new_query(size + AVAHI_DNS_PACKET_EXTRA_SIZE)))
-            return; /* OOM */
+    avahi_dns_packet_free(p);
+}
 
-        if (!(k = avahi_key_new(pj->record->key->name, pj->record->key->clazz, AVAHI_DNS_TYPE_ANY))) {
-            avahi_dns_packet_free(p);
-            return;  /* OOM */
-        }
+/* Sends one packet with as many of the jobs that are due as fit
+ * in. Returns 0 if no job could be sent. */
+static int send_probe_packet(AvahiProbeScheduler *s, AvahiProbeJob *first) {
+    AvahiProbeJob *pj, *next;
+    AvahiDnsPacket *p;
+    unsigned n;
 
-        b = avahi_dns_packet_append_key(p, k, 0) && avahi_dns_packet_append_record(p, pj->record, 0, 0);
-        avahi_key_unref(k);
+    assert(s);
+    assert(first);
+    assert(first->due);
 
-        if (b) {
-            avahi_dns_packet_set_field(p, AVAHI_DNS_FIELD_NSCOUNT, 1);
-            avahi_dns_packet_set_field(p, AVAHI_DNS_FIELD_QDCOUNT, 1);
-            avahi_interface_send_packet(s->interface, p);
-        } else
-            avahi_log_warn("Probe record too large, cannot send");
+    if (!(p = avahi_dns_packet_new_query(s->interface->hardware->mtu)))
+        return 0; /* OOM */
+    n = 1;
 
+    /* Add the first probe */
+    pj = first;
+    if (!packet_add_probe_query(s, p, pj)) {
         avahi_dns_packet_free(p);
+
+        send_single_probe(s, pj);
         job_mark_done(s, pj);
 
-        return;
+        return 1;
     }
 
     /* Try to fill up packet with more probes, if available */
     for (pj = s->jobs; pj; pj = pj->jobs_next) {
 
-        if (pj->chosen)
+        if (pj->chosen || !pj->due)
             continue;
 
         if (!packet_add_probe_query(s, p, pj))
@@ -320,8 +407,69 @@ static void elapse_callback(AVAHI_GCC_UNUSED AvahiTimeEvent *e, void* data) {
     avahi_dns_packet_set_field(p, AVAHI_DNS_FIELD_NSCOUNT, n);
 
     /* Send it now */
-    avahi_interface_send_packet(s->interface, p);
+    if (n > 0)
+        avahi_interface_send_packet(s->interface, p);
+
     avahi_dns_packet_free(p);
+
+    return n > 0;
+}
+
+static void elapse_callback(AVAHI_GCC_UNUSED AvahiTimeEvent *e, void* data) {
+    AvahiProbeScheduler *s = data;
+    AvahiProbeJob *pj, *first;
+    const struct timeval *next = NULL;
+    struct timeval now;
+
+    assert(s);
+
+    gettimeofday(&now, NULL);
+
+    /* Jobs that are not due yet stay where they are, so that no
+     * probe is sent earlier than requested. That keeps the probes of
+     * a record properly spaced. */
+    for (pj = s->jobs; pj; pj = pj->jobs_next)
+        if (avahi_timeval_compare(&pj->delivery, &now) <= 0)
+            pj->due = 1;
+        else if (!next || avahi_timeval_compare(&pj->delivery, next) < 0)
+            next = &pj->delivery;
+
+    /* Send all probes that are due, in as many packets as
+     * necessary. Sent jobs are moved to the history, hence we start
+     * over at the head of the list after each packet. */
+    for (first = s->jobs; first; ) {
+
+        if (!first->due) {
+            first = first->jobs_next;
+            continue;
+        }
+
+        if (!send_probe_packet(s, first)) {
+            AvahiProbeJob *n;
+
+            /* Couldn't send anything, drop the remaining probes that are due */
+            avahi_log_warn(__FILE__": Failed to assemble probe packet.");
+
+            for (pj = s->jobs; pj; pj = n) {
+                n = pj->jobs_next;
+
+                if (pj->due)
+                    job_mark_done(s, pj);
+            }
+
+            break;
+        }
+
+        first = s->jobs;
+    }
+
+    if (next) {
+        s->delivery = *next;
+        avahi_time_event_update(s->time_event, &s->delivery);
+    } else {
+        avahi_time_event_free(s->time_event);
+        s->time_event = NULL;
+    }
 }
 
 static AvahiProbeJob* find_scheduled_job(AvahiProbeScheduler *s, AvahiRecord *record) {
@@ -330,8 +478,10 @@ static AvahiProbeJob* find_scheduled_job(AvahiProbeScheduler *s, AvahiRecord *re
     assert(s);
     assert(record);
 
-    for (pj = s->jobs; pj; pj = pj->jobs_next) {
-        assert(!pj->done);
+    for (pj = avahi_hashmap_lookup(s->jobs_by_name, record->key->name); pj; pj = pj->by_name_next) {
+
+        if (pj->done)
+            continue;
 
         if (avahi_record_equal_no_ttl(pj->record, record))
             return pj;
@@ -346,8 +496,10 @@ static AvahiProbeJob* find_history_job(AvahiProbeScheduler *s, AvahiRecord *reco
     assert(s);
     assert(record);
 
-    for (pj = s->history; pj; pj = pj->jobs_next) {
-        assert(pj->done);
+    for (pj = avahi_hashmap_lookup(s->jobs_by_name, record->key->name); pj; pj = pj->by_name_next) {
+
+        if (!pj->done)
+            continue;
 
         if (avahi_record_equal_no_ttl(pj->record, record)) {
             /* Check whether this entry is outdated */
@@ -380,24 +532,27 @@ int avahi_probe_scheduler_post(AvahiProbeScheduler *s, AvahiRecord *record, int
 
     if ((pj = find_scheduled_job(s, record))) {
 
-        if (avahi_timeval_compare(&tv, &pj->delivery) < 0) {
-            /* If the new entry should be scheduled earlier, update the old entry */
+        if (avahi_timeval_compare(&tv, &pj->delivery) < 0)
             pj->delivery = tv;
-            avahi_time_event_update(pj->time_event, &pj->delivery);
-        }
 
-        return 1;
     } else {
         /* Create a new job and schedule it */
         if (!(pj = job_new(s, record, 0)))
             return 0; /* OOM */
 
         pj->delivery = tv;
-        pj->time_event = avahi_time_event_new(s->time_event_queue, &pj->delivery, elapse_callback, pj);
-
 
 /*     avahi_log_debug("Accepted new probe job."); */
+    }
 
-        return 1;
+    /* Jobs that are due at the same time are sent together */
+    if (!s->time_event) {
+        s->delivery = pj->delivery;
+        s->time_event = avahi_time_event_new(s->time_event_queue, &s->delivery, elapse_callback, s);
+    } else if (avahi_timeval_compare(&pj->delivery, &s->delivery) < 0) {
+        s->delivery = pj->delivery;
+        avahi_time_event_update(s->time_event, &s->delivery);
     }
+
+    return 1;
 }
@@ -28,6 +28,7 @@ typedef struct AvahiProbeScheduler AvahiProbeScheduler;
 AvahiProbeScheduler *avahi_probe_scheduler_new(AvahiInterface *i);
 void avahi_probe_scheduler_free(AvahiProbeScheduler *s);
 void avahi_probe_scheduler_clear(AvahiProbeScheduler *s);
+unsigned avahi_probe_scheduler_count_jobs(AvahiProbeScheduler *s);
 
 int avahi_probe_scheduler_post(AvahiProbeScheduler *s, AvahiRecord *record, int immediately);
 
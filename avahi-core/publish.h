@@ -58,6 +58,17 @@ void avahi_s_entry_group_free(AvahiSEntryGroup *g);
 /** Commit an entry group. This starts the probing and registration process for all RRs in the group */
 int avahi_s_entry_group_commit(AvahiSEntryGroup *g);
 
+/** Commit several entry groups of the same server at once. This is
+ * equivalent to calling avahi_s_entry_group_commit() for each of
+ * them, but all groups start probing at the same time, so that their
+ * probes and announcements are sent in shared packets. This is
+ * useful when publishing a large number of services at startup. If
+ * results is not NULL it needs to point to an array of n_groups
+ * integers which is filled with the return value of each individual
+ * commit. Returns AVAHI_OK if all groups have been committed, the
+ * error code of the first group that failed otherwise. \since 0.9 */
+int avahi_s_entry_group_commit_many(AvahiSEntryGroup *groups[], unsigned n_groups, int results[]);
+
 /** Remove all entries from the entry group and reset the state to AVAHI_ENTRY_GROUP_UNCOMMITED. */
 void avahi_s_entry_group_reset(AvahiSEntryGroup *g);
 
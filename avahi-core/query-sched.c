@@ -33,7 +33,6 @@
 #define AVAHI_QUERY_DEFER_MSEC 100
 
 typedef struct AvahiQueryJob AvahiQueryJob;
-typedef struct AvahiKnownAnswer AvahiKnownAnswer;
 
 struct AvahiQueryJob {
     unsigned id;
@@ -58,13 +57,6 @@ struct AvahiQueryJob {
     AVAHI_LLIST_FIELDS(AvahiQueryJob, jobs);
 };
 
-struct AvahiKnownAnswer {
-    AvahiQueryScheduler *scheduler;
-    AvahiRecord *record;
-
-    AVAHI_LLIST_FIELDS(AvahiKnownAnswer, known_answer);
-};
-
 struct AvahiQueryScheduler {
     AvahiInterface *interface;
     AvahiTimeEventQueue *time_event_queue;
@@ -73,7 +65,13 @@ struct AvahiQueryScheduler {
 
     AVAHI_LLIST_HEAD(AvahiQueryJob, jobs);
     AVAHI_LLIST_HEAD(AvahiQueryJob, history);
-    AVAHI_LLIST_HEAD(AvahiKnownAnswer, known_answers);
+
+    /* Known answers collected for the packet currently being
+     * assembled. The array is kept around between queries so that we
+     * don't have to allocate memory for every cache entry each time a
+     * query is sent. */
+    AvahiRecord **known_answers;
+    unsigned n_known_answers, max_known_answers;
 };
 
 static AvahiQueryJob* job_new(AvahiQueryScheduler *s, AvahiKey *key, int done) {
@@ -163,7 +161,9 @@ AvahiQueryScheduler *avahi_query_scheduler_new(AvahiInterface *i) {
 
     AVAHI_LLIST_HEAD_INIT(AvahiQueryJob, s->jobs);
     AVAHI_LLIST_HEAD_INIT(AvahiQueryJob, s->history);
-    AVAHI_LLIST_HEAD_INIT(AvahiKnownAnswer, s->known_answers);
+
+    s->known_answers = NULL;
+    s->n_known_answers = s->max_known_answers = 0;
 
     return s;
 }
@@ -171,8 +171,9 @@ AvahiQueryScheduler *avahi_query_scheduler_new(AvahiInterface *i) {
 void avahi_query_scheduler_free(AvahiQueryScheduler *s) {
     assert(s);
 
-    assert(!s->known_answers);
+    assert(s->n_known_answers == 0);
     avahi_query_scheduler_clear(s);
+    avahi_free(s->known_answers);
     avahi_free(s);
 }
 
@@ -185,9 +186,20 @@ void avahi_query_scheduler_clear(AvahiQueryScheduler *s) {
         job_free(s, s->history);
 }
 
+unsigned avahi_query_scheduler_count_jobs(AvahiQueryScheduler *s) {
+    AvahiQueryJob *j;
+    unsigned n = 0;
+
+    assert(s);
+
+    for (j = s->jobs; j; j = j->jobs_next)
+        n++;
+
+    return n;
+}
+
 static void* known_answer_walk_callback(AvahiCache *c, AvahiKey *pattern, AvahiCacheEntry *e, void* userdata) {
     AvahiQueryScheduler *s = userdata;
-    AvahiKnownAnswer *ka;
 
     assert(c);
     assert(pattern);
@@ -197,15 +209,22 @@ static void* known_answer_walk_callback(AvahiCache *c, AvahiKey *pattern, AvahiC
     if (avahi_cache_entry_half_ttl(c, e))
         return NULL;
 
-    if (!(ka = avahi_new0(AvahiKnownAnswer, 1))) {
-        avahi_log_error(__FILE__": Out of memory");
-        return NULL;
-    }
+    if (s->n_known_answers >= s->max_known_answers) {
+        AvahiRecord **n;
+        unsigned max;
+
+        max = s->max_known_answers ? s->max_known_answers * 2 : 16;
 
-    ka->scheduler = s;
-    ka->record = avahi_record_ref(e->record);
+        if (!(n = avahi_realloc(s->known_answers, sizeof(AvahiRecord*) * max))) {
+            avahi_log_error(__FILE__": Out of memory");
+            return NULL;
+        }
 
-    AVAHI_LLIST_PREPEND(AvahiKnownAnswer, known_answer, s->known_answers, ka);
+        s->known_answers = n;
+        s->max_known_answers = max;
+    }
+
+    s->known_answers[s->n_known_answers++] = avahi_record_ref(e->record);
     return NULL;
 }
 
@@ -226,17 +245,17 @@ static int packet_add_query_job(AvahiQueryScheduler *s, AvahiDnsPacket *p, Avahi
 }
 
 static void append_known_answers_and_send(AvahiQueryScheduler *s, AvahiDnsPacket *p) {
-    AvahiKnownAnswer *ka;
-    unsigned n;
+    unsigned n, i;
     assert(s);
     assert(p);
 
     n = 0;
 
-    while ((ka = s->known_answers)) {
+    for (i = 0; i < s->n_known_answers; i++) {
+        AvahiRecord *r = s->known_answers[i];
         int too_large = 0;
 
-        while (!avahi_dns_packet_append_record(p, ka->record, 0, 0)) {
+        while (!avahi_dns_packet_append_record(p, r, 0, 0)) {
 
             if (avahi_dns_packet_is_empty(p)) {
                 /* The record is too large to fit into one packet, so
@@ -257,14 +276,14 @@ static void append_known_answers_and_send(AvahiQueryScheduler *s, AvahiDnsPacket
             n = 0;
         }
 
-        AVAHI_LLIST_REMOVE(AvahiKnownAnswer, known_answer, s->known_answers, ka);
-        avahi_record_unref(ka->record);
-        avahi_free(ka);
+        avahi_record_unref(r);
 
         if (!too_large)
             n++;
     }
 
+    s->n_known_answers = 0;
+
     avahi_dns_packet_set_field(p, AVAHI_DNS_FIELD_ANCOUNT, n);
     avahi_interface_send_packet(s->interface, p);
     avahi_dns_packet_free(p);
@@ -286,7 +305,7 @@ static void elapse_callback(AVAHI_GCC_UNUSED AvahiTimeEvent *e, void* data) {
         return;
     }
 
-    assert(!s->known_answers);
+    assert(s->n_known_answers == 0);
 
     if (!(p = avahi_dns_packet_new_query(s->interface->hardware->mtu)))
         return; /* OOM */
@@ -358,8 +377,10 @@ int avahi_query_scheduler_post(AvahiQueryScheduler *s, AvahiKey *key, int immedi
     assert(s);
     assert(key);
 
-    if ((qj = find_history_job(s, key)))
+    if ((qj = find_history_job(s, key))) {
+        s->interface->statistics.queries_suppressed_total++;
         return 0;
+    }
 
     avahi_elapse_time(&tv, immediately ? 0 : AVAHI_QUERY_DEFER_MSEC, 0);
 
@@ -401,6 +422,7 @@ void avahi_query_scheduler_incoming(AvahiQueryScheduler *s, AvahiKey *key) {
      * "DUPLICATE QUESTION SUPPRESSION". */
 
     if ((qj = find_scheduled_job(s, key))) {
+        s->interface->statistics.queries_suppressed_total++;
         job_mark_done(s, qj);
         return;
     }
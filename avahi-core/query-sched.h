@@ -28,6 +28,7 @@ typedef struct AvahiQueryScheduler AvahiQueryScheduler;
 AvahiQueryScheduler *avahi_query_scheduler_new(AvahiInterface *i);
 void avahi_query_scheduler_free(AvahiQueryScheduler *s);
 void avahi_query_scheduler_clear(AvahiQueryScheduler *s);
+unsigned avahi_query_scheduler_count_jobs(AvahiQueryScheduler *s);
 
 int avahi_query_scheduler_post(AvahiQueryScheduler *s, AvahiKey *key, int immediately, unsigned *ret_id);
 int avahi_query_scheduler_withdraw_by_id(AvahiQueryScheduler *s, unsigned id);
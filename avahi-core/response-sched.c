@@ -29,6 +29,7 @@
 #include "response-sched.h"
 #include "log.h"
 #include "rr-util.h"
+#include "hashmap.h"
 
 /* Local packets are suppressed this long after sending them */
 #define AVAHI_RESPONSE_HISTORY_MSEC 500
@@ -62,7 +63,11 @@ struct AvahiResponseJob {
     AvahiAddress querier;
     int querier_valid;
 
+    /* Jobs for records that compare equal have the same hash */
+    unsigned hash;
+
     AVAHI_LLIST_FIELDS(AvahiResponseJob, jobs);
+    AVAHI_LLIST_FIELDS(AvahiResponseJob, by_hash);
 };
 
 struct AvahiResponseScheduler {
@@ -72,10 +77,15 @@ struct AvahiResponseScheduler {
     AVAHI_LLIST_HEAD(AvahiResponseJob, jobs);
     AVAHI_LLIST_HEAD(AvahiResponseJob, history);
     AVAHI_LLIST_HEAD(AvahiResponseJob, suppressed);
+
+    /* All jobs, regardless of their state, chained by record hash.
+     * Announcing a large entry group posts thousands of records at
+     * once, so walking the lists for each of them doesn't scale. */
+    AvahiHashmap *jobs_by_hash;
 };
 
 static AvahiResponseJob* job_new(AvahiResponseScheduler *s, AvahiRecord *record, AvahiResponseJobState state) {
-    AvahiResponseJob *rj;
+    AvahiResponseJob *rj, *t;
 
     assert(s);
     assert(record);
@@ -90,6 +100,11 @@ static AvahiResponseJob* job_new(AvahiResponseScheduler *s, AvahiRecord *record,
     rj->time_event = NULL;
     rj->flush_cache = 0;
     rj->querier_valid = 0;
+    rj->hash = avahi_record_hash_no_ttl(record);
+
+    t = avahi_hashmap_lookup(s->jobs_by_hash, &rj->hash);
+    AVAHI_LLIST_PREPEND(AvahiResponseJob, by_hash, t, rj);
+    avahi_hashmap_replace(s->jobs_by_hash, &rj->hash, t);
 
     if ((rj->state = state) == AVAHI_SCHEDULED)
         AVAHI_LLIST_PREPEND(AvahiResponseJob, jobs, s->jobs, rj);
@@ -102,6 +117,8 @@ static AvahiResponseJob* job_new(AvahiResponseScheduler *s, AvahiRecord *record,
 }
 
 static void job_free(AvahiResponseScheduler *s, AvahiResponseJob *rj) {
+    AvahiResponseJob *t;
+
     assert(s);
     assert(rj);
 
@@ -115,6 +132,13 @@ static void job_free(AvahiResponseScheduler *s, AvahiResponseJob *rj) {
     else /* rj->state == AVAHI_SUPPRESSED */
         AVAHI_LLIST_REMOVE(AvahiResponseJob, jobs, s->suppressed, rj);
 
+    t = avahi_hashmap_lookup(s->jobs_by_hash, &rj->hash);
+    AVAHI_LLIST_REMOVE(AvahiResponseJob, by_hash, t, rj);
+    if (t)
+        avahi_hashmap_replace(s->jobs_by_hash, &t->hash, t);
+    else
+        avahi_hashmap_remove(s->jobs_by_hash, &rj->hash);
+
     avahi_record_unref(rj->record);
     avahi_free(rj);
 }
@@ -167,6 +191,12 @@ AvahiResponseScheduler *avahi_response_scheduler_new(AvahiInterface *i) {
     AVAHI_LLIST_HEAD_INIT(AvahiResponseJob, s->history);
     AVAHI_LLIST_HEAD_INIT(AvahiResponseJob, s->suppressed);
 
+    if (!(s->jobs_by_hash = avahi_hashmap_new(avahi_int_hash, avahi_int_equal, NULL, NULL))) {
+        avahi_log_error(__FILE__": Out of memory");
+        avahi_free(s);
+        return NULL;
+    }
+
     return s;
 }
 
@@ -174,6 +204,7 @@ void avahi_response_scheduler_free(AvahiResponseScheduler *s) {
     assert(s);
 
     avahi_response_scheduler_clear(s);
+    avahi_hashmap_free(s->jobs_by_hash);
     avahi_free(s);
 }
 
@@ -188,6 +219,18 @@ void avahi_response_scheduler_clear(AvahiResponseScheduler *s) {
         job_free(s, s->suppressed);
 }
 
+unsigned avahi_response_scheduler_count_jobs(AvahiResponseScheduler *s) {
+    AvahiResponseJob *j;
+    unsigned n = 0;
+
+    assert(s);
+
+    for (j = s->jobs; j; j = j->jobs_next)
+        n++;
+
+    return n;
+}
+
 static void enumerate_aux_records_callback(AVAHI_GCC_UNUSED AvahiServer *s, AvahiRecord *r, int flush_cache, void* userdata) {
     AvahiResponseJob *rj = userdata;
 
@@ -273,18 +316,25 @@ static void elapse_callback(AVAHI_GCC_UNUSED AvahiTimeEvent *e, void* data) {
         send_response_packet(rj->scheduler, rj);
 }
 
+static AvahiResponseJob* find_jobs(AvahiResponseScheduler *s, AvahiRecord *record) {
+    unsigned hash;
+
+    assert(s);
+    assert(record);
+
+    hash = avahi_record_hash_no_ttl(record);
+    return avahi_hashmap_lookup(s->jobs_by_hash, &hash);
+}
+
 static AvahiResponseJob* find_scheduled_job(AvahiResponseScheduler *s, AvahiRecord *record) {
     AvahiResponseJob *rj;
 
     assert(s);
     assert(record);
 
-    for (rj = s->jobs; rj; rj = rj->jobs_next) {
-        assert(rj->state == AVAHI_SCHEDULED);
-
-        if (avahi_record_equal_no_ttl(rj->record, record))
+    for (rj = find_jobs(s, record); rj; rj = rj->by_hash_next)
+        if (rj->state == AVAHI_SCHEDULED && avahi_record_equal_no_ttl(rj->record, record))
             return rj;
-    }
 
     return NULL;
 }
@@ -295,10 +345,9 @@ static AvahiResponseJob* find_history_job(AvahiResponseScheduler *s, AvahiRecord
     assert(s);
     assert(record);
 
-    for (rj = s->history; rj; rj = rj->jobs_next) {
-        assert(rj->state == AVAHI_DONE);
+    for (rj = find_jobs(s, record); rj; rj = rj->by_hash_next) {
 
-        if (avahi_record_equal_no_ttl(rj->record, record)) {
+        if (rj->state == AVAHI_DONE && avahi_record_equal_no_ttl(rj->record, record)) {
             /* Check whether this entry is outdated */
 
 /*             avahi_log_debug("history age: %u", (unsigned) (avahi_age(&rj->delivery)/1000)); */
@@ -323,8 +372,11 @@ static AvahiResponseJob* find_suppressed_job(AvahiResponseScheduler *s, AvahiRec
     assert(record);
     assert(querier);
 
-    for (rj = s->suppressed; rj; rj = rj->jobs_next) {
-        assert(rj->state == AVAHI_SUPPRESSED);
+    for (rj = find_jobs(s, record); rj; rj = rj->by_hash_next) {
+
+        if (rj->state != AVAHI_SUPPRESSED)
+            continue;
+
         assert(rj->querier_valid);
 
         if (avahi_record_equal_no_ttl(rj->record, record) &&
@@ -365,6 +417,7 @@ int avahi_response_scheduler_post(AvahiResponseScheduler *s, AvahiRecord *record
         rj->record->ttl >= record->ttl/2) {
 
 /*         avahi_log_debug("Response suppressed by known answer suppression.");  */
+        s->interface->statistics.responses_suppressed_total++;
         return 0;
     }
 
@@ -375,6 +428,7 @@ int avahi_response_scheduler_post(AvahiResponseScheduler *s, AvahiRecord *record
             rj->record->ttl >= record->ttl/2 &&
             (rj->flush_cache || !flush_cache)) {
 /*             avahi_log_debug("Response suppressed by local duplicate suppression (history)");  */
+            s->interface->statistics.responses_suppressed_total++;
             return 0;
         }
 
@@ -442,6 +496,7 @@ void avahi_response_scheduler_incoming(AvahiResponseScheduler *s, AvahiRecord *r
 
             /* A matching entry was found, so let's mark it done */
 /*             avahi_log_debug("Response suppressed by distributed duplicate suppression"); */
+            s->interface->statistics.responses_suppressed_total++;
             job_mark_done(s, rj);
         }
 
@@ -479,6 +534,7 @@ void avahi_response_scheduler_suppress(AvahiResponseScheduler *s, AvahiRecord *r
 
             /* A matching entry was found, so let's drop it */
 /*             avahi_log_debug("Known answer suppression active!"); */
+            s->interface->statistics.responses_suppressed_total++;
             job_free(s, rj);
         }
     }
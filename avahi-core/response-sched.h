@@ -28,6 +28,7 @@ typedef struct AvahiResponseScheduler AvahiResponseScheduler;
 AvahiResponseScheduler *avahi_response_scheduler_new(AvahiInterface *i);
 void avahi_response_scheduler_free(AvahiResponseScheduler *s);
 void avahi_response_scheduler_clear(AvahiResponseScheduler *s);
+unsigned avahi_response_scheduler_count_jobs(AvahiResponseScheduler *s);
 void avahi_response_scheduler_force(AvahiResponseScheduler *s);
 
 int avahi_response_scheduler_post(AvahiResponseScheduler *s, AvahiRecord *record, int flush_cache, const AvahiAddress *querier, int immediately);
@@ -54,6 +54,10 @@ int avahi_record_lexicographical_compare(AvahiRecord *a, AvahiRecord *b);
 /** Return 1 if the specified record is an mDNS goodbye record. i.e. TTL is zero. */
 int avahi_record_is_goodbye(AvahiRecord *r);
 
+/** Return a hash value for the record, consistent with
+ * avahi_record_equal_no_ttl() */
+unsigned avahi_record_hash_no_ttl(const AvahiRecord *r);
+
 /** Make a deep copy of an AvahiRecord object */
 AvahiRecord *avahi_record_copy(AvahiRecord *r);
 
@@ -246,9 +246,8 @@ char *avahi_key_to_string(const AvahiKey *k) {
     return avahi_strdup_printf("%s\t%s\t%s", k->name, c, t);
 }
 
-char *avahi_record_to_string(const AvahiRecord *r) {
-    char *p, *s;
-    char buf[1024], *t = NULL, *d = NULL;
+char *avahi_record_data_to_string(const AvahiRecord *r) {
+    char buf[1024], *t = NULL;
 
     assert(r);
     assert(r->ref >= 1);
@@ -270,8 +269,7 @@ char *avahi_record_to_string(const AvahiRecord *r) {
             break;
 
         case AVAHI_DNS_TYPE_TXT:
-            t = d = avahi_string_list_to_string(r->data.txt.string_list);
-            break;
+            return avahi_string_list_to_string(r->data.txt.string_list);
 
         case AVAHI_DNS_TYPE_HINFO:
 
@@ -313,8 +311,20 @@ char *avahi_record_to_string(const AvahiRecord *r) {
         }
     }
 
+    return avahi_strdup(t);
+}
+
+char *avahi_record_to_string(const AvahiRecord *r) {
+    char *p, *d, *s;
+
+    assert(r);
+    assert(r->ref >= 1);
+
+    if (!(d = avahi_record_data_to_string(r)))
+        return NULL;
+
     p = avahi_key_to_string(r->key);
-    s = avahi_strdup_printf("%s %s ; ttl=%u", p, t, r->ttl);
+    s = avahi_strdup_printf("%s %s ; ttl=%u", p, d, r->ttl);
     avahi_free(p);
     avahi_free(d);
 
@@ -364,6 +374,47 @@ unsigned avahi_key_hash(const AvahiKey *k) {
         k->clazz;
 }
 
+unsigned avahi_record_hash_no_ttl(const AvahiRecord *r) {
+    unsigned hash;
+
+    assert(r);
+
+    /* Record types that don't usually share their key with many
+     * others are only hashed by the key */
+
+    hash = avahi_key_hash(r->key);
+
+    switch (r->key->type) {
+        case AVAHI_DNS_TYPE_PTR:
+        case AVAHI_DNS_TYPE_CNAME:
+        case AVAHI_DNS_TYPE_NS:
+            hash = hash * 31 + avahi_domain_hash(r->data.ptr.name);
+            break;
+
+        case AVAHI_DNS_TYPE_SRV:
+            hash = hash * 31 + avahi_domain_hash(r->data.srv.name) + r->data.srv.port;
+            break;
+
+        case AVAHI_DNS_TYPE_A: {
+            uint32_t a;
+
+            memcpy(&a, &r->data.a.address, sizeof(a));
+            hash = hash * 31 + a;
+            break;
+        }
+
+        case AVAHI_DNS_TYPE_AAAA: {
+            unsigned j;
+
+            for (j = 0; j < sizeof(r->data.aaaa.address.address); j++)
+                hash = hash * 31 + r->data.aaaa.address.address[j];
+            break;
+        }
+    }
+
+    return hash;
+}
+
 static int rdata_equal(const AvahiRecord *a, const AvahiRecord *b) {
     assert(a);
     assert(b);
@@ -152,6 +152,11 @@ char *avahi_key_to_string(const AvahiKey *k);
  * in style to BIND zone file data. avahi_free() the result! */
 char *avahi_record_to_string(const AvahiRecord *r);
 
+/** Create a textual representation of the data of the specified
+ * record only, as used by avahi_record_to_string(). avahi_free() the
+ * result! \since 0.9 */
+char *avahi_record_data_to_string(const AvahiRecord *r);
+
 /** Check whether two records are equal (regardless of the TTL */
 int avahi_record_equal_no_ttl(const AvahiRecord *a, const AvahiRecord *b);
 
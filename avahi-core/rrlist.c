@@ -28,6 +28,8 @@
 #include <avahi-common/malloc.h>
 
 #include "rrlist.h"
+#include "rr-util.h"
+#include "hashmap.h"
 #include "log.h"
 
 typedef struct AvahiRecordListItem AvahiRecordListItem;
@@ -38,13 +40,18 @@ struct AvahiRecordListItem {
     int unicast_response;
     int flush_cache;
     int auxiliary;
+    unsigned hash;
     AVAHI_LLIST_FIELDS(AvahiRecordListItem, items);
+    AVAHI_LLIST_FIELDS(AvahiRecordListItem, by_hash);
 };
 
 struct AvahiRecordList {
     AVAHI_LLIST_HEAD(AvahiRecordListItem, read);
     AVAHI_LLIST_HEAD(AvahiRecordListItem, unread);
 
+    /* Items chained by record hash, for finding duplicates quickly */
+    AvahiHashmap *items_by_hash;
+
     int all_flush_cache;
 };
 
@@ -59,6 +66,12 @@ AvahiRecordList *avahi_record_list_new(void) {
     AVAHI_LLIST_HEAD_INIT(AvahiRecordListItem, l->read);
     AVAHI_LLIST_HEAD_INIT(AvahiRecordListItem, l->unread);
 
+    if (!(l->items_by_hash = avahi_hashmap_new(avahi_int_hash, avahi_int_equal, NULL, NULL))) {
+        avahi_log_error("avahi_hashmap_new() failed.");
+        avahi_free(l);
+        return NULL;
+    }
+
     l->all_flush_cache = 1;
     return l;
 }
@@ -67,10 +80,13 @@ void avahi_record_list_free(AvahiRecordList *l) {
     assert(l);
 
     avahi_record_list_flush(l);
+    avahi_hashmap_free(l->items_by_hash);
     avahi_free(l);
 }
 
 static void item_free(AvahiRecordList *l, AvahiRecordListItem *i) {
+    AvahiRecordListItem *t;
+
     assert(l);
     assert(i);
 
@@ -79,6 +95,13 @@ static void item_free(AvahiRecordList *l, AvahiRecordListItem *i) {
     else
         AVAHI_LLIST_REMOVE(AvahiRecordListItem, items, l->unread, i);
 
+    t = avahi_hashmap_lookup(l->items_by_hash, &i->hash);
+    AVAHI_LLIST_REMOVE(AvahiRecordListItem, by_hash, t, i);
+    if (t)
+        avahi_hashmap_replace(l->items_by_hash, &t->hash, t);
+    else
+        avahi_hashmap_remove(l->items_by_hash, &i->hash);
+
     avahi_record_unref(i->record);
     avahi_free(i);
 }
@@ -119,17 +142,13 @@ AvahiRecord* avahi_record_list_next(AvahiRecordList *l, int *ret_flush_cache, in
     return r;
 }
 
-static AvahiRecordListItem *get(AvahiRecordList *l, AvahiRecord *r) {
+static AvahiRecordListItem *get(AvahiRecordList *l, AvahiRecord *r, unsigned hash) {
     AvahiRecordListItem *i;
 
     assert(l);
     assert(r);
 
-    for (i = l->read; i; i = i->items_next)
-        if (avahi_record_equal_no_ttl(i->record, r))
-            return i;
-
-    for (i = l->unread; i; i = i->items_next)
+    for (i = avahi_hashmap_lookup(l->items_by_hash, &hash); i; i = i->by_hash_next)
         if (avahi_record_equal_no_ttl(i->record, r))
             return i;
 
@@ -137,12 +156,15 @@ static AvahiRecordListItem *get(AvahiRecordList *l, AvahiRecord *r) {
 }
 
 void avahi_record_list_push(AvahiRecordList *l, AvahiRecord *r, int flush_cache, int unicast_response, int auxiliary) {
-    AvahiRecordListItem *i;
+    AvahiRecordListItem *i, *t;
+    unsigned hash;
 
     assert(l);
     assert(r);
 
-    if (get(l, r))
+    hash = avahi_record_hash_no_ttl(r);
+
+    if (get(l, r, hash))
         return;
 
     if (!(i = avahi_new(AvahiRecordListItem, 1))) {
@@ -155,10 +177,15 @@ void avahi_record_list_push(AvahiRecordList *l, AvahiRecord *r, int flush_cache,
     i->auxiliary = auxiliary;
     i->record = avahi_record_ref(r);
     i->read = 0;
+    i->hash = hash;
 
     l->all_flush_cache = l->all_flush_cache && flush_cache;
 
     AVAHI_LLIST_PREPEND(AvahiRecordListItem, items, l->unread, i);
+
+    t = avahi_hashmap_lookup(l->items_by_hash, &i->hash);
+    AVAHI_LLIST_PREPEND(AvahiRecordListItem, by_hash, t, i);
+    avahi_hashmap_replace(l->items_by_hash, &i->hash, t);
 }
 
 void avahi_record_list_drop(AvahiRecordList *l, AvahiRecord *r) {
@@ -167,7 +194,7 @@ void avahi_record_list_drop(AvahiRecordList *l, AvahiRecord *r) {
     assert(l);
     assert(r);
 
-    if (!(i = get(l, r)))
+    if (!(i = get(l, r, avahi_record_hash_no_ttl(r))))
         return;
 
     item_free(l, i);
@@ -943,12 +943,16 @@ static void dispatch_packet(AvahiServer *s, AvahiDnsPacket *p, const AvahiAddres
     if (!(i = avahi_interface_monitor_get_interface(s->monitor, iface, src_address->proto)) ||
         !i->announcing) {
         avahi_log_debug("Received packet from invalid interface.");
+        s->packets_unknown_interface++;
         return;
     }
 
+    i->statistics.packets_received_total++;
+
     if (port <= 0) {
         /* This fixes RHBZ #475394 */
         avahi_log_debug("Received packet from invalid source port %u.", (unsigned) port);
+        i->statistics.packets_invalid_total++;
         return;
     }
 
@@ -966,6 +970,7 @@ static void dispatch_packet(AvahiServer *s, AvahiDnsPacket *p, const AvahiAddres
 
     if (avahi_dns_packet_check_valid_multicast(p) < 0) {
         avahi_log_debug("Received invalid packet.");
+        i->statistics.packets_invalid_total++;
         return;
     }
 
@@ -983,6 +988,7 @@ static void dispatch_packet(AvahiServer *s, AvahiDnsPacket *p, const AvahiAddres
             if ((avahi_dns_packet_get_field(p, AVAHI_DNS_FIELD_ANCOUNT) != 0 ||
                  avahi_dns_packet_get_field(p, AVAHI_DNS_FIELD_NSCOUNT) != 0)) {
                 avahi_log_debug("Invalid legacy unicast query packet.");
+                i->statistics.packets_invalid_total++;
                 return;
             }
 
@@ -993,9 +999,12 @@ static void dispatch_packet(AvahiServer *s, AvahiDnsPacket *p, const AvahiAddres
             !avahi_interface_address_on_link(i, src_address)) {
 
             avahi_log_debug("Received non-local unicast query from host %s on interface '%s.%i'.", avahi_address_snprint(t, sizeof(t), src_address), i->hardware->name, i->protocol);
+            i->statistics.packets_invalid_total++;
             return;
         }
 
+        i->statistics.queries_received_total++;
+
         if (legacy_unicast)
             reflect_legacy_unicast_query_packet(s, p, i, src_address, port);
 
@@ -1006,11 +1015,13 @@ static void dispatch_packet(AvahiServer *s, AvahiDnsPacket *p, const AvahiAddres
 
         if (port != AVAHI_MDNS_PORT) {
             avahi_log_debug("Received response from host %s with invalid source port %u on interface '%s.%i'", avahi_address_snprint(t, sizeof(t), src_address), port, i->hardware->name, i->protocol);
+            i->statistics.packets_invalid_total++;
             return;
         }
 
         if (ttl != 255 && s->config.check_response_ttl) {
             avahi_log_debug("Received response from host %s with invalid TTL %u on interface '%s.%i'.", avahi_address_snprint(t, sizeof(t), src_address), ttl, i->hardware->name, i->protocol);
+            i->statistics.packets_invalid_total++;
             return;
         }
 
@@ -1018,6 +1029,7 @@ static void dispatch_packet(AvahiServer *s, AvahiDnsPacket *p, const AvahiAddres
             !avahi_interface_address_on_link(i, src_address)) {
 
             avahi_log_debug("Received non-local response from host %s on interface '%s.%i'.", avahi_address_snprint(t, sizeof(t), src_address), i->hardware->name, i->protocol);
+            i->statistics.packets_invalid_total++;
             return;
         }
 
@@ -1026,9 +1038,12 @@ static void dispatch_packet(AvahiServer *s, AvahiDnsPacket *p, const AvahiAddres
             avahi_dns_packet_get_field(p, AVAHI_DNS_FIELD_NSCOUNT) != 0) {
 
             avahi_log_debug("Invalid response packet from host %s.", avahi_address_snprint(t, sizeof(t), src_address));
+            i->statistics.packets_invalid_total++;
             return;
         }
 
+        i->statistics.responses_received_total++;
+
         handle_response_packet(s, p, i, src_address, from_local_iface);
     }
 }
@@ -1468,6 +1483,7 @@ AvahiServer *avahi_server_new(const AvahiPoll *poll_api, const AvahiServerConfig
     s->browse_domain_entry_group = NULL;
     s->error = AVAHI_OK;
     s->state = AVAHI_SERVER_INVALID;
+    s->packets_unknown_interface = 0;
 
     s->callback = callback;
     s->userdata = userdata;
@@ -1477,6 +1493,9 @@ AvahiServer *avahi_server_new(const AvahiPoll *poll_api, const AvahiServerConfig
     s->entries_by_key = avahi_hashmap_new((AvahiHashFunc) avahi_key_hash, (AvahiEqualFunc) avahi_key_equal, NULL, NULL);
     AVAHI_LLIST_HEAD_INIT(AvahiEntry, s->entries);
     AVAHI_LLIST_HEAD_INIT(AvahiGroup, s->groups);
+    AVAHI_LLIST_HEAD_INIT(AvahiAnnounceSlot, s->announce_slots);
+    s->announcer_hashmap = avahi_hashmap_new(avahi_announcer_hash, avahi_announcer_equal, NULL, NULL);
+    s->announce_start.tv_sec = s->announce_start.tv_usec = 0;
 
     s->record_browser_hashmap = avahi_hashmap_new((AvahiHashFunc) avahi_key_hash, (AvahiEqualFunc) avahi_key_equal, NULL, NULL);
     AVAHI_LLIST_HEAD_INIT(AvahiSRecordBrowser, s->record_browsers);
@@ -1556,6 +1575,7 @@ void avahi_server_free(AvahiServer* s) {
     free_slots(s);
 
     avahi_hashmap_free(s->entries_by_key);
+    avahi_hashmap_free(s->announcer_hashmap);
     avahi_record_list_free(s->record_list);
     avahi_hashmap_free(s->record_browser_hashmap);
 
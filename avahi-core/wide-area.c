@@ -687,6 +687,26 @@ void avahi_wide_area_cache_dump(AvahiWideAreaLookupEngine *e, AvahiDumpCallback
     }
 }
 
+int avahi_wide_area_cache_snapshot(AvahiWideAreaLookupEngine *e, AvahiSDump *d) {
+    AvahiWideAreaCacheEntry *c;
+    struct timeval now;
+
+    assert(e);
+    assert(d);
+
+    gettimeofday(&now, NULL);
+
+    for (c = e->cache; c; c = c->cache_next) {
+        AvahiUsec age = avahi_timeval_diff(&now, &c->timestamp)/1000000;
+        uint32_t ttl = age < c->record->ttl ? c->record->ttl - (uint32_t) age : 0;
+
+        if (avahi_s_dump_add(d, AVAHI_DUMP_WIDE_AREA, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, c->record, ttl) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
 unsigned avahi_wide_area_scan_cache(AvahiWideAreaLookupEngine *e, AvahiKey *key, AvahiWideAreaLookupCallback callback, void *userdata) {
     AvahiWideAreaCacheEntry *c;
     AvahiKey *cname_key;
@@ -0,0 +1,512 @@
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <assert.h>
+#include <sys/time.h>
+
+#include <avahi-common/llist.h>
+#include <avahi-common/malloc.h>
+#include <avahi-common/domain.h>
+#include <avahi-common/timeval.h>
+#include <avahi-core/core.h>
+#include <avahi-core/log.h>
+#include <avahi-core/hashmap.h>
+
+#include "browse-share.h"
+
+typedef struct Share Share;
+typedef struct Item Item;
+
+/* A service the shared browser currently knows about */
+struct Item {
+    AvahiIfIndex interface;
+    AvahiProtocol protocol;
+    char *name, *type, *domain;
+    AvahiLookupResultFlags flags;
+    int hashed;
+
+    AVAHI_LLIST_FIELDS(Item, items);
+};
+
+/* A non-item event (CACHE_EXHAUSTED, ALL_FOR_NOW, FAILURE) the shared
+ * browser reported already */
+typedef struct Event {
+    int seen;
+    AvahiIfIndex interface;
+    AvahiProtocol protocol;
+    AvahiLookupResultFlags flags;
+} Event;
+
+struct Share {
+    char *key;
+    int hashed;
+
+    AvahiServer *server;
+    AvahiSServiceBrowser *service_browser;
+    int started;
+
+    AVAHI_LLIST_HEAD(Item, items);
+
+    /* The items again, indexed by themselves, see item_hash() */
+    AvahiHashmap *items_by_key;
+
+    Event cache_exhausted, all_for_now, failure;
+    int error;
+
+    AVAHI_LLIST_HEAD(BrowseShareSubscription, subscriptions);
+};
+
+typedef enum {
+    SUBSCRIPTION_PREPARED,
+    SUBSCRIPTION_REPLAYING,
+    SUBSCRIPTION_LIVE
+} SubscriptionState;
+
+struct BrowseShareSubscription {
+    Share *share;
+    SubscriptionState state;
+
+    /* Replays the state of the share from the main loop */
+    AvahiTimeout *timeout;
+
+    BrowseShareCallback callback;
+    void *userdata;
+
+    AVAHI_LLIST_FIELDS(BrowseShareSubscription, subscriptions);
+};
+
+static const AvahiPoll *poll_api = NULL;
+static AvahiHashmap *shares = NULL;
+
+static unsigned n_shares = 0, n_subscriptions = 0;
+
+static char *make_key(AvahiIfIndex interface, AvahiProtocol protocol, const char *type, const char *domain, AvahiLookupFlags flags) {
+    char *t, *d = NULL, *k;
+
+    assert(type);
+
+    if (!(t = avahi_normalize_name_strdup(type)))
+        return NULL;
+
+    if (domain && *domain && !(d = avahi_normalize_name_strdup(domain))) {
+        avahi_free(t);
+        return NULL;
+    }
+
+    k = avahi_strdup_printf("%i %i %u %s %s", (int) interface, (int) protocol, (unsigned) flags, t, d ? d : "");
+
+    avahi_free(t);
+    avahi_free(d);
+
+    return k;
+}
+
+static unsigned item_hash(const void *data) {
+    const Item *i = data;
+
+    assert(i);
+
+    return
+        (unsigned) i->interface * 31 * 31 +
+        (unsigned) i->protocol * 31 +
+        avahi_string_hash(i->name) +
+        avahi_domain_hash(i->type) +
+        avahi_domain_hash(i->domain);
+}
+
+static int item_equal(const void *a, const void *b) {
+    const Item *x = a, *y = b;
+
+    assert(x);
+    assert(y);
+
+    return
+        x->interface == y->interface &&
+        x->protocol == y->protocol &&
+        strcmp(x->name, y->name) == 0 &&
+        avahi_domain_equal(x->type, y->type) &&
+        avahi_domain_equal(x->domain, y->domain);
+}
+
+static void item_free(Share *sh, Item *i) {
+    assert(sh);
+    assert(i);
+
+    if (i->hashed)
+        avahi_hashmap_remove(sh->items_by_key, i);
+
+    AVAHI_LLIST_REMOVE(Item, items, sh->items, i);
+
+    avahi_free(i->name);
+    avahi_free(i->type);
+    avahi_free(i->domain);
+    avahi_free(i);
+}
+
+static Item *item_find(Share *sh, AvahiIfIndex interface, AvahiProtocol protocol, const char *name, const char *type, const char *domain) {
+    Item k;
+
+    assert(sh);
+    assert(name);
+    assert(type);
+    assert(domain);
+
+    k.interface = interface;
+    k.protocol = protocol;
+    k.name = (char*) name;
+    k.type = (char*) type;
+    k.domain = (char*) domain;
+
+    return avahi_hashmap_lookup(sh->items_by_key, &k);
+}
+
+static void share_unhash(Share *sh) {
+    assert(sh);
+
+    if (!sh->hashed)
+        return;
+
+    avahi_hashmap_remove(shares, sh->key);
+    sh->hashed = 0;
+}
+
+static void share_free(Share *sh) {
+    assert(sh);
+    assert(!sh->subscriptions);
+
+    share_unhash(sh);
+
+    if (sh->service_browser)
+        avahi_s_service_browser_free(sh->service_browser);
+
+    while (sh->items)
+        item_free(sh, sh->items);
+
+    if (sh->items_by_key)
+        avahi_hashmap_free(sh->items_by_key);
+
+    assert(n_shares >= 1);
+    n_shares--;
+
+    avahi_free(sh->key);
+    avahi_free(sh);
+}
+
+static void event_store(Event *e, AvahiIfIndex interface, AvahiProtocol protocol, AvahiLookupResultFlags flags) {
+    assert(e);
+
+    e->seen = 1;
+    e->interface = interface;
+    e->protocol = protocol;
+    e->flags = flags;
+}
+
+static void store(Share *sh, AvahiIfIndex interface, AvahiProtocol protocol, AvahiBrowserEvent event, const char *name, const char *type, const char *domain, AvahiLookupResultFlags flags) {
+    Item *i;
+
+    assert(sh);
+
+    switch (event) {
+        case AVAHI_BROWSER_NEW:
+
+            /* A browser restart reports the same services again */
+            if ((i = item_find(sh, interface, protocol, name, type, domain))) {
+                i->flags = flags;
+                break;
+            }
+
+            if (!(i = avahi_new(Item, 1))) {
+                avahi_log_error("Out of memory");
+                break;
+            }
+
+            i->interface = interface;
+            i->protocol = protocol;
+            i->name = avahi_strdup(name);
+            i->type = avahi_strdup(type);
+            i->domain = avahi_strdup(domain);
+            i->flags = flags;
+            i->hashed = 0;
+
+            AVAHI_LLIST_PREPEND(Item, items, sh->items, i);
+
+            if (!i->name || !i->type || !i->domain ||
+                avahi_hashmap_insert(sh->items_by_key, i, i) < 0) {
+                avahi_log_error("Out of memory");
+                item_free(sh, i);
+                break;
+            }
+
+            i->hashed = 1;
+
+            break;
+
+        case AVAHI_BROWSER_REMOVE:
+
+            if ((i = item_find(sh, interface, protocol, name, type, domain)))
+                item_free(sh, i);
+
+            break;
+
+        case AVAHI_BROWSER_CACHE_EXHAUSTED:
+            event_store(&sh->cache_exhausted, interface, protocol, flags);
+            break;
+
+        case AVAHI_BROWSER_ALL_FOR_NOW:
+            event_store(&sh->all_for_now, interface, protocol, flags);
+            break;
+
+        case AVAHI_BROWSER_FAILURE:
+            event_store(&sh->failure, interface, protocol, flags);
+            sh->error = avahi_server_errno(sh->server);
+
+            /* Subscriptions made from now on get a fresh browser */
+            share_unhash(sh);
+            break;
+    }
+}
+
+static void service_browser_callback(
+    AvahiSServiceBrowser *b,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    AvahiBrowserEvent event,
+    const char *name,
+    const char *type,
+    const char *domain,
+    AvahiLookupResultFlags flags,
+    void* userdata) {
+
+    Share *sh = userdata;
+    BrowseShareSubscription *s, *next;
+
+    assert(b);
+    assert(sh);
+
+    store(sh, interface, protocol, event, name, type, domain, flags);
+
+    for (s = sh->subscriptions; s; s = next) {
+        next = s->subscriptions_next;
+
+        if (s->state == SUBSCRIPTION_LIVE)
+            s->callback(s, interface, protocol, event, name, type, domain, flags, s->userdata);
+    }
+}
+
+static void replay_event(BrowseShareSubscription *s, const Event *e, AvahiBrowserEvent event) {
+    assert(s);
+    assert(e);
+
+    if (e->seen)
+        s->callback(s, e->interface, e->protocol, event, NULL, NULL, NULL, e->flags, s->userdata);
+}
+
+static void timeout_callback(AvahiTimeout *t, void *userdata) {
+    BrowseShareSubscription *s = userdata;
+    Share *sh;
+    Item *i;
+
+    assert(t);
+    assert(s);
+    assert(s->state == SUBSCRIPTION_REPLAYING);
+
+    poll_api->timeout_free(s->timeout);
+    s->timeout = NULL;
+
+    /* Events arriving from now on are delivered directly. The
+     * callbacks below must not free the subscription. */
+    s->state = SUBSCRIPTION_LIVE;
+    sh = s->share;
+
+    for (i = sh->items; i; i = i->items_next)
+        s->callback(s, i->interface, i->protocol, AVAHI_BROWSER_NEW, i->name, i->type, i->domain, i->flags, s->userdata);
+
+    replay_event(s, &sh->cache_exhausted, AVAHI_BROWSER_CACHE_EXHAUSTED);
+    replay_event(s, &sh->all_for_now, AVAHI_BROWSER_ALL_FOR_NOW);
+    replay_event(s, &sh->failure, AVAHI_BROWSER_FAILURE);
+}
+
+static Share *share_get(AvahiServer *server, AvahiIfIndex interface, AvahiProtocol protocol, const char *type, const char *domain, AvahiLookupFlags flags) {
+    Share *sh;
+    char *key;
+
+    /* If the type or domain are invalid we get no key, and let
+     * avahi_s_service_browser_prepare() report the error */
+    if ((key = make_key(interface, protocol, type, domain, flags)) &&
+        (sh = avahi_hashmap_lookup(shares, key))) {
+        avahi_free(key);
+        return sh;
+    }
+
+    if (!(sh = avahi_new(Share, 1))) {
+        avahi_free(key);
+        return NULL;
+    }
+
+    memset(sh, 0, sizeof(Share));
+    sh->key = key;
+    sh->server = server;
+    AVAHI_LLIST_HEAD_INIT(Item, sh->items);
+    AVAHI_LLIST_HEAD_INIT(BrowseShareSubscription, sh->subscriptions);
+    n_shares++;
+
+    if (!(sh->items_by_key = avahi_hashmap_new(item_hash, item_equal, NULL, NULL))) {
+        share_free(sh);
+        return NULL;
+    }
+
+    if (!(sh->service_browser = avahi_s_service_browser_prepare(server, interface, protocol, type, domain, flags, service_browser_callback, sh))) {
+        share_free(sh);
+        return NULL;
+    }
+
+    if (sh->key) {
+        avahi_hashmap_insert(shares, sh->key, sh);
+        sh->hashed = 1;
+    }
+
+    return sh;
+}
+
+BrowseShareSubscription *browse_share_service_browser_prepare(
+    AvahiServer *server,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *type,
+    const char *domain,
+    AvahiLookupFlags flags,
+    BrowseShareCallback callback,
+    void *userdata) {
+
+    BrowseShareSubscription *s;
+    Share *sh;
+
+    assert(poll_api);
+    assert(server);
+    assert(type);
+    assert(callback);
+
+    if (!(s = avahi_new(BrowseShareSubscription, 1)))
+        return NULL;
+
+    if (!(sh = share_get(server, interface, protocol, type, domain, flags))) {
+        avahi_free(s);
+        return NULL;
+    }
+
+    s->share = sh;
+    s->state = SUBSCRIPTION_PREPARED;
+    s->timeout = NULL;
+    s->callback = callback;
+    s->userdata = userdata;
+
+    AVAHI_LLIST_PREPEND(BrowseShareSubscription, subscriptions, sh->subscriptions, s);
+    n_subscriptions++;
+
+    return s;
+}
+
+void browse_share_subscription_start(BrowseShareSubscription *s) {
+    struct timeval tv;
+    Share *sh;
+
+    assert(s);
+
+    if (s->state != SUBSCRIPTION_PREPARED)
+        return;
+
+    sh = s->share;
+
+    if (!sh->started) {
+        /* The first one to start it gets all events from the core */
+        sh->started = 1;
+        s->state = SUBSCRIPTION_LIVE;
+        avahi_s_service_browser_start(sh->service_browser);
+        return;
+    }
+
+    s->state = SUBSCRIPTION_REPLAYING;
+    s->timeout = poll_api->timeout_new(poll_api, avahi_elapse_time(&tv, 0, 0), timeout_callback, s);
+}
+
+void browse_share_subscription_free(BrowseShareSubscription *s) {
+    Share *sh;
+
+    assert(s);
+
+    sh = s->share;
+
+    if (s->timeout)
+        poll_api->timeout_free(s->timeout);
+
+    AVAHI_LLIST_REMOVE(BrowseShareSubscription, subscriptions, sh->subscriptions, s);
+
+    assert(n_subscriptions >= 1);
+    n_subscriptions--;
+
+    avahi_free(s);
+
+    if (!sh->subscriptions)
+        share_free(sh);
+}
+
+int browse_share_subscription_errno(BrowseShareSubscription *s) {
+    assert(s);
+
+    return s->share->error;
+}
+
+void browse_share_get_statistics(unsigned *ret_shares, unsigned *ret_subscriptions) {
+
+    if (ret_shares)
+        *ret_shares = n_shares;
+
+    if (ret_subscriptions)
+        *ret_subscriptions = n_subscriptions;
+}
+
+int browse_share_setup(const AvahiPoll *p) {
+    assert(p);
+    assert(!shares);
+
+    if (!(shares = avahi_hashmap_new(avahi_string_hash, avahi_string_equal, NULL, NULL)))
+        return -1;
+
+    poll_api = p;
+    return 0;
+}
+
+void browse_share_shutdown(void) {
+
+    /* All subscriptions must have been freed by now */
+    assert(n_subscriptions == 0);
+    assert(n_shares == 0);
+
+    if (shares) {
+        avahi_hashmap_free(shares);
+        shares = NULL;
+    }
+
+    poll_api = NULL;
+}
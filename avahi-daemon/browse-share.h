@@ -0,0 +1,71 @@
+#ifndef foobrowsesharehfoo
+#define foobrowsesharehfoo
+
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <avahi-common/watch.h>
+#include <avahi-core/lookup.h>
+
+/* Service browsers shared between subscribers. All subscriptions
+ * with the same interface, protocol, type, domain and flags are
+ * served by a single core browser. The services it found so far are
+ * kept, so that a subscription started later is told about them
+ * right away, followed by the CACHE_EXHAUSTED, ALL_FOR_NOW and
+ * FAILURE events the browser already reported. Like the core
+ * browsers, subscriptions deliver no events before they are
+ * started, and never from within browse_share_subscription_start(). */
+
+typedef struct BrowseShareSubscription BrowseShareSubscription;
+
+typedef void (*BrowseShareCallback)(
+    BrowseShareSubscription *s,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    AvahiBrowserEvent event,
+    const char *name,
+    const char *type,
+    const char *domain,
+    AvahiLookupResultFlags flags,
+    void *userdata);
+
+int browse_share_setup(const AvahiPoll *poll_api);
+void browse_share_shutdown(void);
+
+void browse_share_get_statistics(unsigned *n_shares, unsigned *n_subscriptions);
+
+BrowseShareSubscription *browse_share_service_browser_prepare(
+    AvahiServer *s,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *type,
+    const char *domain,
+    AvahiLookupFlags flags,
+    BrowseShareCallback callback,
+    void *userdata);
+
+void browse_share_subscription_start(BrowseShareSubscription *s);
+void browse_share_subscription_free(BrowseShareSubscription *s);
+
+/* The error code for an AVAHI_BROWSER_FAILURE event. Use this instead
+ * of avahi_server_errno(), since replayed failures are not reflected
+ * there. */
+int browse_share_subscription_errno(BrowseShareSubscription *s);
+
+#endif
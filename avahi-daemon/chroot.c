@@ -56,6 +56,9 @@ enum {
 #endif
     AVAHI_CHROOT_UNLINK_PID,
     AVAHI_CHROOT_UNLINK_SOCKET,
+#ifdef HAVE_DBUS
+    AVAHI_CHROOT_UNLINK_DBUS_SOCKET,
+#endif
     AVAHI_CHROOT_MAX
 };
 
@@ -75,7 +78,10 @@ static const char* const get_file_name_table[AVAHI_CHROOT_MAX] = {
     AVAHI_DBUS_INTROSPECTION_DIR"/org.freedesktop.Avahi.RecordBrowser.xml",
 #endif
     NULL,
-    NULL
+    NULL,
+#ifdef HAVE_DBUS
+    NULL,
+#endif
 };
 
 static const char *const unlink_file_name_table[AVAHI_CHROOT_MAX] = {
@@ -94,7 +100,10 @@ static const char *const unlink_file_name_table[AVAHI_CHROOT_MAX] = {
     NULL,
 #endif
     AVAHI_DAEMON_RUNTIME_DIR"/pid",
-    AVAHI_SOCKET
+    AVAHI_SOCKET,
+#ifdef HAVE_DBUS
+    AVAHI_DBUS_SOCKET,
+#endif
 };
 
 static int helper_fd = -1;
@@ -260,6 +269,9 @@ static int helper_main(int fd) {
                 break;
             }
 
+#ifdef HAVE_DBUS
+            case AVAHI_CHROOT_UNLINK_DBUS_SOCKET:
+#endif
             case AVAHI_CHROOT_UNLINK_SOCKET:
             case AVAHI_CHROOT_UNLINK_PID: {
                 uint8_t c = AVAHI_CHROOT_SUCCESS;
@@ -46,7 +46,7 @@ void avahi_dbus_async_address_resolver_free(AsyncAddressResolverInfo *i) {
         avahi_s_address_resolver_free(i->address_resolver);
 
     if (i->path) {
-        dbus_connection_unregister_object_path(server->bus, i->path);
+        avahi_dbus_object_unregister(i->path);
         avahi_free(i->path);
     }
 
@@ -108,8 +108,7 @@ void avahi_dbus_async_address_resolver_callback(AvahiSAddressResolver *r, AvahiI
         avahi_dbus_append_server_error(reply);
     }
 
-    dbus_message_set_destination(reply, i->client->name);
-    dbus_connection_send(server->bus, reply, NULL);
+    avahi_dbus_client_send(i->client, reply);
     dbus_message_unref(reply);
 }
 
@@ -133,7 +132,7 @@ DBusHandlerResult avahi_dbus_msg_async_address_resolver_impl(DBusConnection *c,
         return avahi_dbus_handle_introspect(c, m, "org.freedesktop.Avahi.AddressResolver.xml");
 
     /* Access control */
-    if (strcmp(dbus_message_get_sender(m), i->client->name))
+    if (!avahi_dbus_client_is_sender(i->client, c, m))
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_ACCESS_DENIED, NULL);
 
     if (dbus_message_is_method_call(m, AVAHI_DBUS_INTERFACE_ADDRESS_RESOLVER, "Free")) {
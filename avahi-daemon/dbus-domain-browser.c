@@ -46,7 +46,7 @@ void avahi_dbus_domain_browser_free(DomainBrowserInfo *i) {
         avahi_s_domain_browser_free(i->domain_browser);
 
     if (i->path) {
-        dbus_connection_unregister_object_path(server->bus, i->path);
+        avahi_dbus_object_unregister(i->path);
         avahi_free(i->path);
     }
 
@@ -85,7 +85,7 @@ DBusHandlerResult avahi_dbus_msg_domain_browser_impl(DBusConnection *c, DBusMess
         return avahi_dbus_handle_introspect(c, m, "org.freedesktop.Avahi.DomainBrowser.xml");
 
     /* Access control */
-    if (strcmp(dbus_message_get_sender(m), i->client->name))
+    if (!avahi_dbus_client_is_sender(i->client, c, m))
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_ACCESS_DENIED, NULL);
 
     if (dbus_message_is_method_call(m, AVAHI_DBUS_INTERFACE_DOMAIN_BROWSER, "Free")) {
@@ -155,7 +155,6 @@ void avahi_dbus_domain_browser_callback(AvahiSDomainBrowser *b, AvahiIfIndex int
     } else if (event == AVAHI_BROWSER_FAILURE)
         avahi_dbus_append_server_error(m);
 
-    dbus_message_set_destination(m, i->client->name);
-    dbus_connection_send(server->bus, m, NULL);
+    avahi_dbus_client_send(i->client, m);
     dbus_message_unref(m);
 }
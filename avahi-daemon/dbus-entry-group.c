@@ -22,6 +22,7 @@
 #endif
 
 #include <string.h>
+#include <stdio.h>
 
 #include <avahi-common/malloc.h>
 #include <avahi-common/dbus.h>
@@ -36,11 +37,13 @@
 void avahi_dbus_entry_group_free(EntryGroupInfo *i) {
     assert(i);
 
-    if (i->entry_group)
+    if (i->entry_group) {
+        avahi_hashmap_remove(server->entry_groups_by_group, i->entry_group);
         avahi_s_entry_group_free(i->entry_group);
+    }
 
     if (i->path) {
-        dbus_connection_unregister_object_path(server->bus, i->path);
+        avahi_dbus_object_unregister(i->path);
         avahi_free(i->path);
     }
     AVAHI_LLIST_REMOVE(EntryGroupInfo, entry_groups, i->client->entry_groups, i);
@@ -81,11 +84,198 @@ void avahi_dbus_entry_group_callback(AvahiServer *s, AvahiSEntryGroup *g, AvahiE
         DBUS_TYPE_INT32, &t,
         DBUS_TYPE_STRING, &e,
         DBUS_TYPE_INVALID);
-    dbus_message_set_destination(m, i->client->name);
-    dbus_connection_send(server->bus, m, NULL);
+    avahi_dbus_client_send(i->client, m);
     dbus_message_unref(m);
 }
 
+/* A service passed to AddServices() */
+typedef struct BulkService {
+    int32_t interface, protocol;
+    uint32_t flags;
+    const char *name, *type, *domain, *host;
+    uint16_t port;
+    AvahiStringList *txt, *subtypes;
+} BulkService;
+
+static void bulk_services_free(BulkService *services, unsigned n) {
+    unsigned j;
+
+    for (j = 0; j < n; j++) {
+        avahi_string_list_free(services[j].txt);
+        avahi_string_list_free(services[j].subtypes);
+    }
+
+    avahi_free(services);
+}
+
+static int bulk_service_parse(DBusMessageIter *iter, BulkService *s) {
+    DBusMessageIter sub, array;
+
+    assert(iter);
+    assert(s);
+
+    dbus_message_iter_recurse(iter, &sub);
+    dbus_message_iter_get_basic(&sub, &s->interface);
+    dbus_message_iter_next(&sub);
+    dbus_message_iter_get_basic(&sub, &s->protocol);
+    dbus_message_iter_next(&sub);
+    dbus_message_iter_get_basic(&sub, &s->flags);
+    dbus_message_iter_next(&sub);
+    dbus_message_iter_get_basic(&sub, &s->name);
+    dbus_message_iter_next(&sub);
+    dbus_message_iter_get_basic(&sub, &s->type);
+    dbus_message_iter_next(&sub);
+    dbus_message_iter_get_basic(&sub, &s->domain);
+    dbus_message_iter_next(&sub);
+    dbus_message_iter_get_basic(&sub, &s->host);
+    dbus_message_iter_next(&sub);
+    dbus_message_iter_get_basic(&sub, &s->port);
+    dbus_message_iter_next(&sub);
+
+    if (avahi_dbus_read_strlst_iter(&sub, &s->txt) < 0)
+        return -1;
+
+    dbus_message_iter_next(&sub);
+    dbus_message_iter_recurse(&sub, &array);
+
+    while (dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_STRING) {
+        const char *subtype;
+
+        dbus_message_iter_get_basic(&array, &subtype);
+        s->subtypes = avahi_string_list_add(s->subtypes, subtype);
+        dbus_message_iter_next(&array);
+    }
+
+    if (!*s->domain)
+        s->domain = NULL;
+
+    if (!*s->host)
+        s->host = NULL;
+
+    return 0;
+}
+
+/* The same checks avahi_server_add_service_strlst() and
+ * avahi_server_add_service_subtype() do, so that all services can be
+ * checked before the first one is added */
+static int bulk_service_check(const BulkService *s) {
+    AvahiStringList *l;
+
+    assert(s);
+
+    if (!AVAHI_IF_VALID(s->interface))
+        return AVAHI_ERR_INVALID_INTERFACE;
+
+    if (!AVAHI_PROTO_VALID(s->protocol))
+        return AVAHI_ERR_INVALID_PROTOCOL;
+
+    /* No AVAHI_PUBLISH_UPDATE, use UpdateServiceTxt() for that */
+    if (s->flags & ~(AVAHI_PUBLISH_NO_COOKIE|AVAHI_PUBLISH_USE_WIDE_AREA|AVAHI_PUBLISH_USE_MULTICAST))
+        return AVAHI_ERR_INVALID_FLAGS;
+
+    if (!avahi_is_valid_service_name(s->name))
+        return AVAHI_ERR_INVALID_SERVICE_NAME;
+
+    if (!avahi_is_valid_service_type_strict(s->type))
+        return AVAHI_ERR_INVALID_SERVICE_TYPE;
+
+    if (s->domain && !avahi_is_valid_domain_name(s->domain))
+        return AVAHI_ERR_INVALID_DOMAIN_NAME;
+
+    if (s->host && !avahi_is_valid_fqdn(s->host))
+        return AVAHI_ERR_INVALID_HOST_NAME;
+
+    for (l = s->subtypes; l; l = l->next)
+        if (!avahi_is_valid_service_subtype((const char*) l->text))
+            return AVAHI_ERR_INVALID_SERVICE_SUBTYPE;
+
+    return AVAHI_OK;
+}
+
+static DBusHandlerResult entry_group_add_services(DBusConnection *c, DBusMessage *m, EntryGroupInfo *i) {
+    DBusMessageIter iter, array;
+    BulkService *services;
+    unsigned n, n_entries = 0, j;
+    char text[256];
+    int r;
+
+    assert(c);
+    assert(m);
+    assert(i);
+
+    if (!dbus_message_has_signature(m, "a(iiussssqaayas)")) {
+        avahi_log_warn("Error parsing EntryGroup::AddServices message");
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+    dbus_message_iter_init(m, &iter);
+    dbus_message_iter_recurse(&iter, &array);
+
+    for (n = 0; dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_STRUCT; n++)
+        dbus_message_iter_next(&array);
+
+    if (n == 0)
+        return avahi_dbus_respond_ok(c, m);
+
+    if (!(services = avahi_new0(BulkService, n)))
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_NO_MEMORY, NULL);
+
+    dbus_message_iter_recurse(&iter, &array);
+
+    for (j = 0; j < n; j++) {
+
+        if (bulk_service_parse(&array, services + j) < 0) {
+            bulk_services_free(services, n);
+            avahi_log_warn("Error parsing EntryGroup::AddServices message");
+            return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+        }
+
+        n_entries += 1 + avahi_string_list_length(services[j].subtypes);
+        dbus_message_iter_next(&array);
+    }
+
+    /* Refuse the whole call rather than adding only part of it */
+    if (n_entries > server->n_entries_per_entry_group_max - i->n_entries) {
+        bulk_services_free(services, n);
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_ENTRIES, NULL);
+    }
+
+    for (j = 0; j < n; j++)
+        if ((r = bulk_service_check(services + j)) < 0) {
+            snprintf(text, sizeof(text), "Service %u: %s", j, avahi_strerror(r));
+            bulk_services_free(services, n);
+            return avahi_dbus_respond_error(c, m, r, text);
+        }
+
+    for (j = 0; j < n; j++) {
+        BulkService *s = services + j;
+        AvahiStringList *l;
+
+        if (avahi_server_add_service_strlst(avahi_server, i->entry_group, (AvahiIfIndex) s->interface, (AvahiProtocol) s->protocol, (AvahiPublishFlags) s->flags, s->name, s->type, s->domain, s->host, s->port, s->txt) < 0)
+            goto fail;
+
+        i->n_entries++;
+
+        for (l = s->subtypes; l; l = l->next) {
+
+            if (avahi_server_add_service_subtype(avahi_server, i->entry_group, (AvahiIfIndex) s->interface, (AvahiProtocol) s->protocol, (AvahiPublishFlags) s->flags & (AVAHI_PUBLISH_USE_WIDE_AREA|AVAHI_PUBLISH_USE_MULTICAST), s->name, s->type, s->domain, (const char*) l->text) < 0)
+                goto fail;
+
+            i->n_entries++;
+        }
+    }
+
+    bulk_services_free(services, n);
+    return avahi_dbus_respond_ok(c, m);
+
+fail:
+    /* Services added before stay in the group, like with separate AddService() calls */
+    r = avahi_server_errno(avahi_server);
+    snprintf(text, sizeof(text), "Service %u: %s", j, avahi_strerror(r));
+    bulk_services_free(services, n);
+    return avahi_dbus_respond_error(c, m, r, text);
+}
+
 DBusHandlerResult avahi_dbus_msg_entry_group_impl(DBusConnection *c, DBusMessage *m, void *userdata) {
     DBusError error;
     EntryGroupInfo *i = userdata;
@@ -106,7 +296,7 @@ DBusHandlerResult avahi_dbus_msg_entry_group_impl(DBusConnection *c, DBusMessage
         return avahi_dbus_handle_introspect(c, m, "org.freedesktop.Avahi.EntryGroup.xml");
 
     /* Access control */
-    if (strcmp(dbus_message_get_sender(m), i->client->name))
+    if (!avahi_dbus_client_is_sender(i->client, c, m))
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_ACCESS_DENIED, NULL);
 
     if (dbus_message_is_method_call(m, AVAHI_DBUS_INTERFACE_ENTRY_GROUP, "Free")) {
@@ -210,6 +400,10 @@ DBusHandlerResult avahi_dbus_msg_entry_group_impl(DBusConnection *c, DBusMessage
 
         return avahi_dbus_respond_ok(c, m);
 
+    } else if (dbus_message_is_method_call(m, AVAHI_DBUS_INTERFACE_ENTRY_GROUP, "AddServices")) {
+
+        return entry_group_add_services(c, m, i);
+
     } else if (dbus_message_is_method_call(m, AVAHI_DBUS_INTERFACE_ENTRY_GROUP, "AddServiceSubtype")) {
 
         int32_t interface, protocol;
@@ -20,17 +20,23 @@
   USA.
 ***/
 
+#include <sys/types.h>
 
 #include <dbus/dbus.h>
 
 #include <avahi-core/core.h>
 #include <avahi-core/publish.h>
 #include <avahi-core/lookup.h>
+#include <avahi-core/hashmap.h>
 
 #include <avahi-common/llist.h>
 
+#include "resolve-cache.h"
+#include "browse-share.h"
+
 typedef struct Server Server;
 typedef struct Client Client;
+typedef struct SocketConnection SocketConnection;
 typedef struct EntryGroupInfo EntryGroupInfo;
 typedef struct SyncHostNameResolverInfo SyncHostNameResolverInfo;
 typedef struct AsyncHostNameResolverInfo AsyncHostNameResolverInfo;
@@ -42,12 +48,30 @@ typedef struct ServiceBrowserInfo ServiceBrowserInfo;
 typedef struct SyncServiceResolverInfo SyncServiceResolverInfo;
 typedef struct AsyncServiceResolverInfo AsyncServiceResolverInfo;
 typedef struct RecordBrowserInfo RecordBrowserInfo;
+typedef struct ServiceBatchResolverItem ServiceBatchResolverItem;
+typedef struct ServiceBatchResolverInfo ServiceBatchResolverInfo;
 
 #define DEFAULT_CLIENTS_MAX 4096
 #define DEFAULT_OBJECTS_PER_CLIENT_MAX 1024
 #define DEFAULT_ENTRIES_PER_ENTRY_GROUP_MAX 32
 #define DEFAULT_START_DELAY_MS 10
 
+/* Limits for connections on the D-Bus socket: connections of a single
+ * user, as the system bus enforces them, and how long a connection
+ * may take to authenticate */
+#define SOCKET_CONNECTIONS_PER_USER_MAX 256
+#define SOCKET_AUTH_TIMEOUT_MSEC 5000
+
+/* Browse events are collected for this long in a single ItemsChanged
+ * signal, if the client asked for batching */
+#define BATCH_DELAY_MSEC 20
+#define BATCH_ITEMS_MAX 256
+
+/* Services accepted by a single ServiceBatchResolverNew() call, and
+ * how many of them are resolved at the same time */
+#define BATCH_RESOLVER_ITEMS_MAX 8192
+#define BATCH_RESOLVER_RUNNING_MAX 256
+
 struct EntryGroupInfo {
     unsigned id;
     Client *client;
@@ -61,7 +85,7 @@ struct EntryGroupInfo {
 
 struct SyncHostNameResolverInfo {
     Client *client;
-    AvahiSHostNameResolver *host_name_resolver;
+    ResolveCacheLookup *lookup;
     DBusMessage *message;
 
     AVAHI_LLIST_FIELDS(SyncHostNameResolverInfo, sync_host_name_resolvers);
@@ -79,7 +103,7 @@ struct AsyncHostNameResolverInfo {
 
 struct SyncAddressResolverInfo {
     Client *client;
-    AvahiSAddressResolver *address_resolver;
+    ResolveCacheLookup *lookup;
     DBusMessage *message;
 
     AVAHI_LLIST_FIELDS(SyncAddressResolverInfo, sync_address_resolvers);
@@ -118,10 +142,16 @@ struct ServiceTypeBrowserInfo {
 struct ServiceBrowserInfo {
     unsigned id;
     Client *client;
-    AvahiSServiceBrowser *service_browser;
+    BrowseShareSubscription *subscription;
     char *path;
     AvahiTimeout *delay_timeout;
 
+    int batching;
+    DBusMessage *batch;
+    DBusMessageIter batch_iter, batch_array;
+    unsigned n_batched;
+    AvahiTimeout *batch_timeout;
+
     AVAHI_LLIST_FIELDS(ServiceBrowserInfo, service_browsers);
 };
 
@@ -153,9 +183,59 @@ struct RecordBrowserInfo {
     AVAHI_LLIST_FIELDS(RecordBrowserInfo, record_browsers);
 };
 
+struct ServiceBatchResolverItem {
+    ServiceBatchResolverInfo *info;
+    uint32_t index;
+
+    AvahiIfIndex interface;
+    AvahiProtocol protocol;
+    char *name, *type, *domain;
+
+    AvahiSServiceResolver *service_resolver;
+
+    /* The result, kept until it has been sent in an ItemsResolved
+     * signal. The fields above are replaced by what the resolver
+     * reported. */
+    AvahiResolverEvent event;
+    char *host_name;
+    AvahiAddress address;
+    uint16_t port;
+    AvahiStringList *txt;
+    AvahiLookupResultFlags result_flags;
+    int error;
+};
+
+struct ServiceBatchResolverInfo {
+    unsigned id;
+    Client *client;
+    char *path;
+    AvahiTimeout *delay_timeout;
+
+    AvahiProtocol aprotocol;
+    AvahiLookupFlags flags;
+
+    ServiceBatchResolverItem *items;
+    unsigned n_items, n_started, n_running;
+
+    /* Each running resolver counts as an object of the client */
+    unsigned n_running_max;
+
+    /* Indexes of the resolved items in the order they finished. The
+     * first n_sent of them have been reported to the client. */
+    uint32_t *resolved;
+    unsigned n_resolved, n_sent;
+    AvahiTimeout *batch_timeout;
+
+    AVAHI_LLIST_FIELDS(ServiceBatchResolverInfo, service_batch_resolvers);
+};
+
 struct Client {
     unsigned id;
     char *name;
+
+    /* server->bus, or the client's own connection if it came in
+     * through the D-Bus socket */
+    DBusConnection *connection;
     unsigned current_id;
     unsigned n_objects;
 
@@ -171,15 +251,37 @@ struct Client {
     AVAHI_LLIST_HEAD(SyncServiceResolverInfo, sync_service_resolvers);
     AVAHI_LLIST_HEAD(AsyncServiceResolverInfo, async_service_resolvers);
     AVAHI_LLIST_HEAD(RecordBrowserInfo, record_browsers);
+    AVAHI_LLIST_HEAD(ServiceBatchResolverInfo, service_batch_resolvers);
+};
+
+/* A connection on the D-Bus socket. Its Client is created when it
+ * first asks for one, like for senders on the bus. */
+struct SocketConnection {
+    DBusConnection *connection;
+
+    int authenticated;
+    unsigned long uid;
+    AvahiTimeout *auth_timeout;
+
+    AVAHI_LLIST_FIELDS(SocketConnection, socket_connections);
 };
 
 struct Server {
     const AvahiPoll *poll_api;
     DBusConnection *bus;
+    DBusServer *socket_server;
+    AVAHI_LLIST_HEAD(SocketConnection, socket_connections);
+    unsigned n_socket_connections;
+    int remove_socket;
     AVAHI_LLIST_HEAD(Client, clients);
     unsigned n_clients;
     unsigned current_id;
 
+    AvahiHashmap *clients_by_name;
+    AvahiHashmap *clients_by_connection;
+    AvahiHashmap *objects_by_path;
+    AvahiHashmap *entry_groups_by_group;
+
     AvahiTimeout *reconnect_timeout;
     int reconnect;
 
@@ -188,16 +290,28 @@ struct Server {
     unsigned n_entries_per_entry_group_max;
 
     int disable_user_service_publishing;
+
+    /* Members of this group may call SetHostName() on the socket */
+    gid_t priv_access_gid;
+    int have_priv_access_gid;
 };
 
 extern Server *server;
 
+int avahi_dbus_object_register(const char *path, DBusObjectPathMessageFunction function, void *userdata);
+void avahi_dbus_object_unregister(const char *path);
+
+EntryGroupInfo *avahi_dbus_entry_group_lookup(AvahiSEntryGroup *g);
+
+int avahi_dbus_client_is_sender(Client *client, DBusConnection *c, DBusMessage *m);
+void avahi_dbus_client_send(Client *client, DBusMessage *m);
+
 void avahi_dbus_entry_group_free(EntryGroupInfo *i);
 void avahi_dbus_entry_group_callback(AvahiServer *s, AvahiSEntryGroup *g, AvahiEntryGroupState state, void* userdata);
 DBusHandlerResult avahi_dbus_msg_entry_group_impl(DBusConnection *c, DBusMessage *m, void *userdata);
 
 void avahi_dbus_sync_host_name_resolver_free(SyncHostNameResolverInfo *i);
-void avahi_dbus_sync_host_name_resolver_callback(AvahiSHostNameResolver *r, AvahiIfIndex interface, AvahiProtocol protocol, AvahiResolverEvent event, const char *host_name, const AvahiAddress *a, AvahiLookupResultFlags flags, void* userdata);
+void avahi_dbus_sync_host_name_resolver_callback(ResolveCacheLookup *l, AvahiIfIndex interface, AvahiProtocol protocol, AvahiResolverEvent event, const char *host_name, const AvahiAddress *a, AvahiLookupResultFlags flags, void* userdata);
 
 void avahi_dbus_async_host_name_resolver_free(AsyncHostNameResolverInfo *i);
 void avahi_dbus_async_host_name_resolver_start(AsyncHostNameResolverInfo *i);
@@ -205,7 +319,7 @@ void avahi_dbus_async_host_name_resolver_callback(AvahiSHostNameResolver *r, Ava
 DBusHandlerResult avahi_dbus_msg_async_host_name_resolver_impl(DBusConnection *c, DBusMessage *m, void *userdata);
 
 void avahi_dbus_sync_address_resolver_free(SyncAddressResolverInfo *i);
-void avahi_dbus_sync_address_resolver_callback(AvahiSAddressResolver *r, AvahiIfIndex interface, AvahiProtocol protocol, AvahiResolverEvent event, const AvahiAddress *address, const char *host_name, AvahiLookupResultFlags flags, void* userdata);
+void avahi_dbus_sync_address_resolver_callback(ResolveCacheLookup *l, AvahiIfIndex interface, AvahiProtocol protocol, AvahiResolverEvent event, const AvahiAddress *address, const char *host_name, AvahiLookupResultFlags flags, void* userdata);
 
 void avahi_dbus_async_address_resolver_free(AsyncAddressResolverInfo *i);
 void avahi_dbus_async_address_resolver_start(AsyncAddressResolverInfo *i);
@@ -225,7 +339,7 @@ void avahi_dbus_service_type_browser_callback(AvahiSServiceTypeBrowser *b, Avahi
 void avahi_dbus_service_browser_free(ServiceBrowserInfo *i);
 void avahi_dbus_service_browser_start(ServiceBrowserInfo *i);
 DBusHandlerResult avahi_dbus_msg_service_browser_impl(DBusConnection *c, DBusMessage *m, void *userdata);
-void avahi_dbus_service_browser_callback(AvahiSServiceBrowser *b, AvahiIfIndex interface, AvahiProtocol protocol, AvahiBrowserEvent event, const char *name, const char *type, const char *domain, AvahiLookupResultFlags flags, void* userdata);
+void avahi_dbus_service_browser_callback(BrowseShareSubscription *s, AvahiIfIndex interface, AvahiProtocol protocol, AvahiBrowserEvent event, const char *name, const char *type, const char *domain, AvahiLookupResultFlags flags, void* userdata);
 
 void avahi_dbus_sync_service_resolver_free(SyncServiceResolverInfo *i);
 
@@ -268,6 +382,10 @@ void avahi_dbus_record_browser_start(RecordBrowserInfo *i);
 DBusHandlerResult avahi_dbus_msg_record_browser_impl(DBusConnection *c, DBusMessage *m, void *userdata);
 void avahi_dbus_record_browser_callback(AvahiSRecordBrowser *b, AvahiIfIndex interface, AvahiProtocol protocol, AvahiBrowserEvent event, AvahiRecord *record, AvahiLookupResultFlags flags, void* userdata);
 
+void avahi_dbus_service_batch_resolver_free(ServiceBatchResolverInfo *i);
+void avahi_dbus_service_batch_resolver_start(ServiceBatchResolverInfo *i);
+DBusHandlerResult avahi_dbus_msg_service_batch_resolver_impl(DBusConnection *c, DBusMessage *m, void *userdata);
+
 
 #define GET_DBUS_DELAY_FUNC(object_type, object_name) dbus_delay_##object_type##_##object_name##_start
 
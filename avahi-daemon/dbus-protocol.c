@@ -35,6 +35,8 @@
 #include <stdio.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <grp.h>
 
 #include <dbus/dbus.h>
 
@@ -51,19 +53,117 @@
 #include <avahi-core/core.h>
 #include <avahi-core/lookup.h>
 #include <avahi-core/publish.h>
+#include <avahi-core/hashmap.h>
 
 #include "dbus-protocol.h"
 #include "dbus-util.h"
 #include "dbus-internal.h"
 #include "main.h"
+#include "statistics.h"
+#include "dump.h"
+
+#ifdef ENABLE_CHROOT
+#include "chroot.h"
+#endif
 
 #define RECONNECT_MSEC 3000
 
 Server *server = NULL;
 
+/* Objects exported on the bus. Instead of registering each of them
+ * with libdbus they are kept in a hash table indexed by path and
+ * dispatched from msg_server_impl(), which handles the whole tree. */
+typedef struct ObjectInfo {
+    char *path;
+    DBusObjectPathMessageFunction function;
+    void *userdata;
+} ObjectInfo;
+
 static int dbus_connect(void);
 static void dbus_disconnect(void);
 
+static unsigned pointer_hash(const void *data) {
+    return (unsigned) ((uintptr_t) data >> 4);
+}
+
+static int pointer_equal(const void *a, const void *b) {
+    return a == b;
+}
+
+static void object_info_free(void *p) {
+    ObjectInfo *o = p;
+
+    assert(o);
+
+    avahi_free(o->path);
+    avahi_free(o);
+}
+
+int avahi_dbus_object_register(const char *path, DBusObjectPathMessageFunction function, void *userdata) {
+    ObjectInfo *o;
+
+    assert(server);
+    assert(path);
+    assert(function);
+
+    if (!(o = avahi_new(ObjectInfo, 1)))
+        return -1;
+
+    if (!(o->path = avahi_strdup(path))) {
+        avahi_free(o);
+        return -1;
+    }
+
+    o->function = function;
+    o->userdata = userdata;
+
+    avahi_hashmap_replace(server->objects_by_path, o->path, o);
+    return 0;
+}
+
+void avahi_dbus_object_unregister(const char *path) {
+    assert(server);
+    assert(path);
+
+    avahi_hashmap_remove(server->objects_by_path, path);
+}
+
+EntryGroupInfo *avahi_dbus_entry_group_lookup(AvahiSEntryGroup *g) {
+    assert(server);
+    assert(g);
+
+    return avahi_hashmap_lookup(server->entry_groups_by_group, g);
+}
+
+int avahi_dbus_client_is_sender(Client *client, DBusConnection *c, DBusMessage *m) {
+    const char *sender;
+
+    assert(server);
+    assert(client);
+    assert(c);
+    assert(m);
+
+    if (c != client->connection)
+        return 0;
+
+    /* Nobody else can talk on a connection of the socket */
+    if (c != server->bus)
+        return 1;
+
+    return (sender = dbus_message_get_sender(m)) && strcmp(sender, client->name) == 0;
+}
+
+void avahi_dbus_client_send(Client *client, DBusMessage *m) {
+    assert(server);
+    assert(client);
+    assert(m);
+
+    if (client->connection == server->bus)
+        dbus_message_set_destination(m, client->name);
+
+    dbus_connection_send(client->connection, m, NULL);
+}
+
 static void client_free(Client *c) {
 
     assert(server);
@@ -102,8 +202,19 @@ static void client_free(Client *c) {
     while (c->record_browsers)
         avahi_dbus_record_browser_free(c->record_browsers);
 
+    while (c->service_batch_resolvers)
+        avahi_dbus_service_batch_resolver_free(c->service_batch_resolvers);
+
+    dump_cancel(c);
+
     assert(c->n_objects == 0);
 
+    /* Connections on the socket are owned by their SocketConnection */
+    if (c->connection == server->bus)
+        avahi_hashmap_remove(server->clients_by_name, c->name);
+    else
+        avahi_hashmap_remove(server->clients_by_connection, c->connection);
+
     avahi_free(c->name);
     AVAHI_LLIST_REMOVE(Client, clients, server->clients, c);
     avahi_free(c);
@@ -112,26 +223,20 @@ static void client_free(Client *c) {
     server->n_clients --;
 }
 
-static Client *client_get(const char *name, int create) {
+static Client *client_new(const char *name, DBusConnection *connection) {
     Client *client;
 
     assert(server);
     assert(name);
-
-    for (client = server->clients; client; client = client->clients_next)
-        if (!strcmp(name, client->name))
-            return client;
-
-    if (!create)
-        return NULL;
+    assert(connection);
 
     if (server->n_clients >= server->n_clients_max)
         return NULL;
 
-    /* If not existent yet, create a new entry */
     client = avahi_new(Client, 1);
     client->id = server->current_id++;
     client->name = avahi_strdup(name);
+    client->connection = connection;
     client->current_id = 0;
     client->n_objects = 0;
 
@@ -146,15 +251,57 @@ static Client *client_get(const char *name, int create) {
     AVAHI_LLIST_HEAD_INIT(SyncServiceResolverInfo, client->sync_service_resolvers);
     AVAHI_LLIST_HEAD_INIT(AsyncServiceResolverInfo, client->async_service_resolvers);
     AVAHI_LLIST_HEAD_INIT(RecordBrowserInfo, client->record_browsers);
+    AVAHI_LLIST_HEAD_INIT(ServiceBatchResolverInfo, client->service_batch_resolvers);
 
     AVAHI_LLIST_PREPEND(Client, clients, server->clients, client);
 
+    if (connection == server->bus)
+        avahi_hashmap_insert(server->clients_by_name, client->name, client);
+    else
+        avahi_hashmap_insert(server->clients_by_connection, connection, client);
+
     server->n_clients++;
     assert(server->n_clients > 0);
 
     return client;
 }
 
+static Client *client_get(DBusConnection *c, DBusMessage *m, int create) {
+    Client *client;
+    const char *sender;
+
+    assert(server);
+    assert(c);
+    assert(m);
+
+    if (c != server->bus) {
+        char name[32];
+
+        if ((client = avahi_hashmap_lookup(server->clients_by_connection, c)))
+            return client;
+
+        if (!create)
+            return NULL;
+
+        /* There's no unique name without a bus, make one up for the logs */
+        snprintf(name, sizeof(name), "socket-%u", server->current_id);
+
+        return client_new(name, c);
+    }
+
+    if (!(sender = dbus_message_get_sender(m)))
+        return NULL;
+
+    if ((client = avahi_hashmap_lookup(server->clients_by_name, sender)))
+        return client;
+
+    if (!create)
+        return NULL;
+
+    /* If not existent yet, create a new entry */
+    return client_new(sender, c);
+}
+
 static void reconnect_callback(AvahiTimeout *t, AVAHI_GCC_UNUSED void *userdata) {
     assert(!server->bus);
 
@@ -228,7 +375,7 @@ static DBusHandlerResult msg_signal_filter_impl(AVAHI_GCC_UNUSED DBusConnection
         if (!*new) {
             Client *client;
 
-            if ((client = client_get(name, FALSE))) {
+            if ((client = avahi_hashmap_lookup(server->clients_by_name, name))) {
                 avahi_log_debug(__FILE__": client %s vanished.", name);
                 client_free(client);
             }
@@ -249,6 +396,71 @@ static DBusHandlerResult dbus_get_host_name(DBusConnection *c, DBusMessage *m, D
     return avahi_dbus_respond_string(c, m, avahi_server_get_host_name(avahi_server));
 }
 
+static int socket_peer_in_group(DBusConnection *c, gid_t gid) {
+    int fd;
+
+    assert(c);
+
+    if (!dbus_connection_get_socket(c, &fd))
+        return 0;
+
+#ifdef SO_PEERCRED
+    {
+        struct ucred cred;
+        socklen_t l = sizeof(cred);
+
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &l) == 0 && cred.gid == gid)
+            return 1;
+    }
+#endif
+
+#ifdef SO_PEERGROUPS
+    {
+        gid_t buf[64], *groups = buf;
+        socklen_t l = sizeof(buf);
+        int r, found = 0;
+
+        if ((r = getsockopt(fd, SOL_SOCKET, SO_PEERGROUPS, groups, &l)) < 0 && errno == ERANGE) {
+            if (!(groups = avahi_new(gid_t, l / sizeof(gid_t) + 1)))
+                return 0;
+
+            r = getsockopt(fd, SOL_SOCKET, SO_PEERGROUPS, groups, &l);
+        }
+
+        if (r == 0) {
+            unsigned j;
+
+            for (j = 0; j < l / sizeof(gid_t); j++)
+                if (groups[j] == gid) {
+                    found = 1;
+                    break;
+                }
+        }
+
+        if (groups != buf)
+            avahi_free(groups);
+
+        if (found)
+            return 1;
+    }
+#endif
+
+    return 0;
+}
+
+/* Whether the peer may do what avahi-dbus.conf allows to root and the
+ * privileged access group only */
+static int socket_is_privileged(DBusConnection *c) {
+    unsigned long uid;
+
+    assert(c);
+
+    if (dbus_connection_get_unix_user(c, &uid) && uid == 0)
+        return 1;
+
+    return server->have_priv_access_gid && socket_peer_in_group(c, server->priv_access_gid);
+}
+
 static DBusHandlerResult dbus_set_host_name(DBusConnection *c, DBusMessage *m, DBusError *error) {
     char *name;
 
@@ -256,6 +468,12 @@ static DBusHandlerResult dbus_set_host_name(DBusConnection *c, DBusMessage *m, D
         return dbus_parsing_error("Error parsing Server::SetHostName message", error);
     }
 
+    /* On the bus, avahi-dbus.conf leaves this to privileged users. The
+     * socket has no policy of its own, so we apply the same rules
+     * there. */
+    if (c != server->bus && !socket_is_privileged(c))
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_ACCESS_DENIED, NULL);
+
     if (avahi_server_set_host_name(avahi_server, name) < 0)
         return avahi_dbus_respond_error(c, m, avahi_server_errno(avahi_server), NULL);
 
@@ -393,17 +611,227 @@ static DBusHandlerResult dbus_get_alternative_service_name(DBusConnection *c, DB
     }
 }
 
+typedef struct ServiceSnapshot {
+    Client *client;
+    DBusMessageIter array;
+    int oom;
+} ServiceSnapshot;
+
+static void service_snapshot_callback(AvahiServer *s, AvahiIfIndex interface, AvahiProtocol protocol, const char *name, const char *type, const char *domain, AvahiLookupResultFlags flags, void *userdata) {
+    ServiceSnapshot *snapshot = userdata;
+    DBusMessageIter sub;
+    int32_t i_interface, i_protocol;
+    uint32_t u_flags;
+
+    assert(s);
+    assert(snapshot);
+
+    if (snapshot->oom)
+        return;
+
+    if (snapshot->client && avahi_dbus_is_our_own_service(snapshot->client, interface, protocol, name, type, domain) > 0)
+        flags |= AVAHI_LOOKUP_RESULT_OUR_OWN;
+
+    i_interface = (int32_t) interface;
+    i_protocol = (int32_t) protocol;
+    u_flags = (uint32_t) flags;
+
+    if (!dbus_message_iter_open_container(&snapshot->array, DBUS_TYPE_STRUCT, NULL, &sub) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &i_interface) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &i_protocol) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &name) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &type) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &domain) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT32, &u_flags) ||
+        !dbus_message_iter_close_container(&snapshot->array, &sub))
+        snapshot->oom = 1;
+}
+
+static DBusHandlerResult dbus_get_services(DBusConnection *c, DBusMessage *m, DBusError *error) {
+    ServiceSnapshot snapshot;
+    DBusMessage *reply;
+    DBusMessageIter iter;
+    int32_t interface, protocol;
+    uint32_t flags;
+    dbus_bool_t refresh;
+    char *type, *domain;
+
+    if (!dbus_message_get_args(
+            m, error,
+            DBUS_TYPE_INT32, &interface,
+            DBUS_TYPE_INT32, &protocol,
+            DBUS_TYPE_STRING, &type,
+            DBUS_TYPE_STRING, &domain,
+            DBUS_TYPE_UINT32, &flags,
+            DBUS_TYPE_BOOLEAN, &refresh,
+            DBUS_TYPE_INVALID) || !type) {
+        return dbus_parsing_error("Error parsing Server::GetServices message", error);
+    }
+
+    if (!*domain)
+        domain = NULL;
+
+    /* Only needed for flagging our own services, hence don't create one */
+    snapshot.client = client_get(c, m, FALSE);
+    snapshot.oom = 0;
+
+    if (!(reply = dbus_message_new_method_return(m)))
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_NO_MEMORY, NULL);
+
+    dbus_message_iter_init_append(reply, &iter);
+
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(iisssu)", &snapshot.array)) {
+        dbus_message_unref(reply);
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_NO_MEMORY, NULL);
+    }
+
+    if (avahi_s_service_browser_scan_cache(avahi_server, (AvahiIfIndex) interface, (AvahiProtocol) protocol, type, domain, (AvahiLookupFlags) flags, refresh, service_snapshot_callback, &snapshot) < 0) {
+        /* libdbus leaks the signature of containers left open */
+        dbus_message_iter_close_container(&iter, &snapshot.array);
+        dbus_message_unref(reply);
+        return avahi_dbus_respond_error(c, m, avahi_server_errno(avahi_server), NULL);
+    }
+
+    if (!dbus_message_iter_close_container(&iter, &snapshot.array) || snapshot.oom) {
+        dbus_message_unref(reply);
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_NO_MEMORY, NULL);
+    }
+
+    dbus_connection_send(c, reply, NULL);
+    dbus_message_unref(reply);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+typedef struct StatisticsReply {
+    DBusMessageIter array;
+    int oom;
+} StatisticsReply;
+
+static void statistics_reply_callback(const StatisticsValue *v, void *userdata) {
+    StatisticsReply *reply = userdata;
+    DBusMessageIter sub;
+    int32_t i_interface, i_protocol;
+    uint64_t value;
+
+    assert(v);
+    assert(reply);
+
+    if (reply->oom)
+        return;
+
+    i_interface = (int32_t) v->interface;
+    i_protocol = (int32_t) v->protocol;
+    value = v->value;
+
+    if (!dbus_message_iter_open_container(&reply->array, DBUS_TYPE_STRUCT, NULL, &sub) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &v->name) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &i_interface) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &i_protocol) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT64, &value) ||
+        !dbus_message_iter_close_container(&reply->array, &sub))
+        reply->oom = 1;
+}
+
+static DBusHandlerResult dbus_get_statistics(DBusConnection *c, DBusMessage *m, DBusError *error) {
+    StatisticsReply statistics;
+    DBusMessage *reply;
+    DBusMessageIter iter;
+
+    if (!dbus_message_get_args(m, error, DBUS_TYPE_INVALID))
+        return dbus_parsing_error("Error parsing Server::GetStatistics message", error);
+
+    statistics.oom = 0;
+
+    if (!(reply = dbus_message_new_method_return(m)))
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_NO_MEMORY, NULL);
+
+    dbus_message_iter_init_append(reply, &iter);
+
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(siit)", &statistics.array)) {
+        dbus_message_unref(reply);
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_NO_MEMORY, NULL);
+    }
+
+    if (statistics_collect(statistics_reply_callback, &statistics) < 0)
+        statistics.oom = 1;
+
+    if (!dbus_message_iter_close_container(&iter, &statistics.array) || statistics.oom) {
+        dbus_message_unref(reply);
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_NO_MEMORY, NULL);
+    }
+
+    dbus_connection_send(c, reply, NULL);
+    dbus_message_unref(reply);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static DBusHandlerResult dbus_get_server_info(DBusConnection *c, DBusMessage *m, DBusError *error) {
+    DBusMessage *reply;
+    uint32_t api_version, cookie;
+    int32_t state;
+    const char *version, *host_name, *host_name_fqdn, *domain_name;
+
+    if (!dbus_message_get_args(m, error, DBUS_TYPE_INVALID))
+        return dbus_parsing_error("Error parsing Server::GetServerInfo message", error);
+
+    api_version = AVAHI_DBUS_API_VERSION;
+    version = PACKAGE_STRING;
+    state = (int32_t) avahi_server_get_state(avahi_server);
+    host_name = avahi_server_get_host_name(avahi_server);
+    host_name_fqdn = avahi_server_get_host_name_fqdn(avahi_server);
+    domain_name = avahi_server_get_domain_name(avahi_server);
+    cookie = avahi_server_get_local_service_cookie(avahi_server);
+
+    if (!(reply = dbus_message_new_method_return(m)))
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_NO_MEMORY, NULL);
+
+    if (!dbus_message_append_args(
+            reply,
+            DBUS_TYPE_UINT32, &api_version,
+            DBUS_TYPE_STRING, &version,
+            DBUS_TYPE_INT32, &state,
+            DBUS_TYPE_STRING, &host_name,
+            DBUS_TYPE_STRING, &host_name_fqdn,
+            DBUS_TYPE_STRING, &domain_name,
+            DBUS_TYPE_UINT32, &cookie,
+            DBUS_TYPE_INVALID)) {
+        dbus_message_unref(reply);
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_NO_MEMORY, NULL);
+    }
+
+    dbus_connection_send(c, reply, NULL);
+    dbus_message_unref(reply);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+#ifdef DBUS_TYPE_UNIX_FD
+static DBusHandlerResult dbus_dump_records(DBusConnection *c, DBusMessage *m, DBusError *error) {
+    Client *client;
+    int fd, r;
+
+    if (!dbus_message_get_args(m, error, DBUS_TYPE_UNIX_FD, &fd, DBUS_TYPE_INVALID))
+        return dbus_parsing_error("Error parsing Server::DumpRecords message", error);
+
+    if (!(client = client_get(c, m, TRUE))) {
+        close(fd);
+        avahi_log_warn("Too many clients, client request failed.");
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_CLIENTS, NULL);
+    }
+
+    /* The dump goes away with the client */
+    if ((r = dump_start(avahi_server, DUMP_FORMAT_JSON, fd, client)) < 0)
+        return avahi_dbus_respond_error(c, m, r, NULL);
+
+    return avahi_dbus_respond_ok(c, m);
+}
+#endif
+
 static DBusHandlerResult dbus_create_new_entry_group(DBusConnection *c, DBusMessage *m, DBusError *error) {
     Client *client;
     EntryGroupInfo *i;
-    static const DBusObjectPathVTable vtable = {
-        NULL,
-        avahi_dbus_msg_entry_group_impl,
-        NULL,
-        NULL,
-        NULL,
-        NULL
-    };
 
     if (!dbus_message_get_args(m, error, DBUS_TYPE_INVALID)) {
         return dbus_parsing_error("Error parsing Server::EntryGroupNew message", error);
@@ -412,7 +840,7 @@ static DBusHandlerResult dbus_create_new_entry_group(DBusConnection *c, DBusMess
     if (server->disable_user_service_publishing)
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_NOT_PERMITTED, NULL);
 
-    if (!(client = client_get(dbus_message_get_sender(m), TRUE))) {
+    if (!(client = client_get(c, m, TRUE))) {
         avahi_log_warn("Too many clients, client request failed.");
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_CLIENTS, NULL);
     }
@@ -435,22 +863,16 @@ static DBusHandlerResult dbus_create_new_entry_group(DBusConnection *c, DBusMess
         return avahi_dbus_respond_error(c, m, avahi_server_errno(avahi_server), NULL);
     }
 
+    avahi_hashmap_insert(server->entry_groups_by_group, i->entry_group, i);
+
     i->path = avahi_strdup_printf("/Client%u/EntryGroup%u", client->id, i->id);
-    dbus_connection_register_object_path(c, i->path, &vtable, i);
+    avahi_dbus_object_register(i->path, avahi_dbus_msg_entry_group_impl, i);
     return avahi_dbus_respond_path(c, m, i->path);
 }
 
 static DBusHandlerResult dbus_prepare_domain_browser_object(DomainBrowserInfo **dbi, DBusConnection *c, DBusMessage *m, DBusError *error) {
     Client *client;
     DomainBrowserInfo *i;
-    static const DBusObjectPathVTable vtable = {
-        NULL,
-        avahi_dbus_msg_domain_browser_impl,
-        NULL,
-        NULL,
-        NULL,
-        NULL
-    };
     int32_t interface, protocol, type;
     uint32_t flags;
     char *domain;
@@ -466,7 +888,7 @@ static DBusHandlerResult dbus_prepare_domain_browser_object(DomainBrowserInfo **
         return dbus_parsing_error("Error parsing Server::DomainBrowserNew message", error);
     }
 
-    if (!(client = client_get(dbus_message_get_sender(m), TRUE))) {
+    if (!(client = client_get(c, m, TRUE))) {
         avahi_log_warn("Too many clients, client request failed.");
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_CLIENTS, NULL);
     }
@@ -493,7 +915,7 @@ static DBusHandlerResult dbus_prepare_domain_browser_object(DomainBrowserInfo **
     }
 
     i->path = avahi_strdup_printf("/Client%u/DomainBrowser%u", client->id, i->id);
-    dbus_connection_register_object_path(c, i->path, &vtable, i);
+    avahi_dbus_object_register(i->path, avahi_dbus_msg_domain_browser_impl, i);
     *dbi = i;
     return avahi_dbus_respond_path(c, m, i->path);
 }
@@ -502,14 +924,6 @@ static DBusHandlerResult dbus_prepare_domain_browser_object(DomainBrowserInfo **
 static DBusHandlerResult dbus_prepare_service_type_browser_object(ServiceTypeBrowserInfo **stbi, DBusConnection *c, DBusMessage *m, DBusError *error) {
     Client *client;
     ServiceTypeBrowserInfo *i;
-    static const DBusObjectPathVTable vtable = {
-        NULL,
-        avahi_dbus_msg_service_type_browser_impl,
-        NULL,
-        NULL,
-        NULL,
-        NULL
-    };
     int32_t interface, protocol;
     uint32_t flags;
     char *domain;
@@ -524,7 +938,7 @@ static DBusHandlerResult dbus_prepare_service_type_browser_object(ServiceTypeBro
         return dbus_parsing_error("Error parsing Server::ServiceTypeBrowserNew message", error);
     }
 
-    if (!(client = client_get(dbus_message_get_sender(m), TRUE))) {
+    if (!(client = client_get(c, m, TRUE))) {
         avahi_log_warn("Too many clients, client request failed.");
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_CLIENTS, NULL);
     }
@@ -551,7 +965,7 @@ static DBusHandlerResult dbus_prepare_service_type_browser_object(ServiceTypeBro
     }
 
     i->path = avahi_strdup_printf("/Client%u/ServiceTypeBrowser%u", client->id, i->id);
-    dbus_connection_register_object_path(c, i->path, &vtable, i);
+    avahi_dbus_object_register(i->path, avahi_dbus_msg_service_type_browser_impl, i);
     *stbi = i;
     return avahi_dbus_respond_path(c, m, i->path);
 }
@@ -560,14 +974,6 @@ static DBusHandlerResult dbus_prepare_service_type_browser_object(ServiceTypeBro
 static DBusHandlerResult dbus_prepare_service_browser_object(ServiceBrowserInfo **sbi, DBusConnection *c, DBusMessage *m, DBusError *error) {
     Client *client;
     ServiceBrowserInfo *i;
-    static const DBusObjectPathVTable vtable = {
-        NULL,
-        avahi_dbus_msg_service_browser_impl,
-        NULL,
-        NULL,
-        NULL,
-        NULL
-    };
     int32_t interface, protocol;
     uint32_t flags;
     char *domain, *type;
@@ -583,7 +989,7 @@ static DBusHandlerResult dbus_prepare_service_browser_object(ServiceBrowserInfo
         return dbus_parsing_error("Error parsing Server::ServiceBrowserNew message", error);
     }
 
-    if (!(client = client_get(dbus_message_get_sender(m), TRUE))) {
+    if (!(client = client_get(c, m, TRUE))) {
         avahi_log_warn("Too many clients, client request failed.");
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_CLIENTS, NULL);
     }
@@ -601,16 +1007,20 @@ static DBusHandlerResult dbus_prepare_service_browser_object(ServiceBrowserInfo
     i->client = client;
     i->path = NULL;
     i->delay_timeout = NULL;
+    i->batching = 0;
+    i->batch = NULL;
+    i->n_batched = 0;
+    i->batch_timeout = NULL;
     AVAHI_LLIST_PREPEND(ServiceBrowserInfo, service_browsers, client->service_browsers, i);
     client->n_objects++;
 
-    if (!(i->service_browser = avahi_s_service_browser_prepare(avahi_server, (AvahiIfIndex) interface, (AvahiProtocol) protocol, type, domain, (AvahiLookupFlags) flags, avahi_dbus_service_browser_callback, i))) {
+    if (!(i->subscription = browse_share_service_browser_prepare(avahi_server, (AvahiIfIndex) interface, (AvahiProtocol) protocol, type, domain, (AvahiLookupFlags) flags, avahi_dbus_service_browser_callback, i))) {
         avahi_dbus_service_browser_free(i);
         return avahi_dbus_respond_error(c, m, avahi_server_errno(avahi_server), NULL);
     }
 
     i->path = avahi_strdup_printf("/Client%u/ServiceBrowser%u", client->id, i->id);
-    dbus_connection_register_object_path(c, i->path, &vtable, i);
+    avahi_dbus_object_register(i->path, avahi_dbus_msg_service_browser_impl, i);
     *sbi = i;
     return avahi_dbus_respond_path(c, m, i->path);
 }
@@ -635,7 +1045,7 @@ static DBusHandlerResult dbus_create_sync_service_resolver_object(DBusConnection
         return dbus_parsing_error("Error parsing Server::ResolveService message", error);
     }
 
-    if (!(client = client_get(dbus_message_get_sender(m), TRUE))) {
+    if (!(client = client_get(c, m, TRUE))) {
         avahi_log_warn("Too many clients, client request failed.");
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_CLIENTS, NULL);
     }
@@ -671,14 +1081,6 @@ static DBusHandlerResult dbus_prepare_async_service_resolver_object(AsyncService
     uint32_t flags;
     char *name, *type, *domain;
     AsyncServiceResolverInfo *i;
-    static const DBusObjectPathVTable vtable = {
-        NULL,
-        avahi_dbus_msg_async_service_resolver_impl,
-        NULL,
-        NULL,
-        NULL,
-        NULL
-    };
 
     if (!dbus_message_get_args(
             m, error,
@@ -693,7 +1095,7 @@ static DBusHandlerResult dbus_prepare_async_service_resolver_object(AsyncService
         return dbus_parsing_error("Error parsing Server::ServiceResolverNew message", error);
     }
 
-    if (!(client = client_get(dbus_message_get_sender(m), TRUE))) {
+    if (!(client = client_get(c, m, TRUE))) {
         avahi_log_warn(__FILE__": Too many clients, client request failed.");
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_CLIENTS, NULL);
     }
@@ -725,11 +1127,135 @@ static DBusHandlerResult dbus_prepare_async_service_resolver_object(AsyncService
 /* avahi_log_debug(__FILE__": [%s], new service resolver for <%s.%s.%s>", i->path, name, type, domain); */
 
     i->path = avahi_strdup_printf("/Client%u/ServiceResolver%u", client->id, i->id);
-    dbus_connection_register_object_path(c, i->path, &vtable, i);
+    avahi_dbus_object_register(i->path, avahi_dbus_msg_async_service_resolver_impl, i);
     *sri = i;
     return avahi_dbus_respond_path(c, m, i->path);
 }
 
+static void service_batch_resolver_delay_callback(AVAHI_GCC_UNUSED AvahiTimeout *t, void *userdata) {
+    avahi_dbus_service_batch_resolver_start(userdata);
+}
+
+static DBusHandlerResult dbus_create_service_batch_resolver_object(DBusConnection *c, DBusMessage *m, DBusError *error) {
+    Client *client;
+    int32_t aprotocol;
+    uint32_t flags;
+    DBusMessageIter iter, array;
+    ServiceBatchResolverInfo *i;
+    unsigned n;
+    struct timeval tv;
+
+    if (!dbus_message_has_signature(m, "a(iisss)iu"))
+        return dbus_parsing_error("Error parsing Server::ServiceBatchResolverNew message", error);
+
+    dbus_message_iter_init(m, &iter);
+    dbus_message_iter_recurse(&iter, &array);
+
+    for (n = 0; dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_STRUCT; n++)
+        dbus_message_iter_next(&array);
+
+    dbus_message_iter_next(&iter);
+    dbus_message_iter_get_basic(&iter, &aprotocol);
+    dbus_message_iter_next(&iter);
+    dbus_message_iter_get_basic(&iter, &flags);
+
+    if (n <= 0 || n > BATCH_RESOLVER_ITEMS_MAX)
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_INVALID_ARGUMENT, NULL);
+
+    if (!(client = client_get(c, m, TRUE))) {
+        avahi_log_warn(__FILE__": Too many clients, client request failed.");
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_CLIENTS, NULL);
+    }
+
+    if (client->n_objects >= server->n_objects_per_client_max) {
+        avahi_log_warn(__FILE__": Too many objects for client '%s', client request failed.", client->name);
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_OBJECTS, NULL);
+    }
+
+    if (!(i = avahi_new(ServiceBatchResolverInfo, 1)))
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_NO_MEMORY, NULL);
+
+    i->id = ++client->current_id;
+    i->client = client;
+    i->path = NULL;
+    i->delay_timeout = NULL;
+    i->aprotocol = (AvahiProtocol) aprotocol;
+    i->flags = (AvahiLookupFlags) flags;
+    i->items = avahi_new0(ServiceBatchResolverItem, n);
+    i->n_items = i->n_started = i->n_running = 0;
+    i->resolved = avahi_new(uint32_t, n);
+    i->n_resolved = i->n_sent = 0;
+    i->batch_timeout = NULL;
+
+    /* Every running core resolver counts as an object of the client,
+     * so resolve as many services at a time as the client has
+     * objects left, but at least one */
+    i->n_running_max = server->n_objects_per_client_max - client->n_objects;
+    if (i->n_running_max > BATCH_RESOLVER_RUNNING_MAX)
+        i->n_running_max = BATCH_RESOLVER_RUNNING_MAX;
+    if (i->n_running_max > n)
+        i->n_running_max = n;
+
+    AVAHI_LLIST_PREPEND(ServiceBatchResolverInfo, service_batch_resolvers, client->service_batch_resolvers, i);
+    client->n_objects += i->n_running_max;
+
+    if (!i->items || !i->resolved)
+        goto fail;
+
+    dbus_message_iter_init(m, &iter);
+    dbus_message_iter_recurse(&iter, &array);
+
+    for (; i->n_items < n; i->n_items++) {
+        ServiceBatchResolverItem *item = i->items + i->n_items;
+        DBusMessageIter sub;
+        int32_t interface, protocol;
+        const char *name, *type, *domain;
+
+        dbus_message_iter_recurse(&array, &sub);
+        dbus_message_iter_get_basic(&sub, &interface);
+        dbus_message_iter_next(&sub);
+        dbus_message_iter_get_basic(&sub, &protocol);
+        dbus_message_iter_next(&sub);
+        dbus_message_iter_get_basic(&sub, &name);
+        dbus_message_iter_next(&sub);
+        dbus_message_iter_get_basic(&sub, &type);
+        dbus_message_iter_next(&sub);
+        dbus_message_iter_get_basic(&sub, &domain);
+        dbus_message_iter_next(&array);
+
+        item->info = i;
+        item->index = i->n_items;
+        item->interface = (AvahiIfIndex) interface;
+        item->protocol = (AvahiProtocol) protocol;
+        item->name = *name ? avahi_strdup(name) : NULL;
+        item->type = avahi_strdup(type);
+        item->domain = *domain ? avahi_strdup(domain) : NULL;
+        item->service_resolver = NULL;
+
+        if ((*name && !item->name) || !item->type || (*domain && !item->domain)) {
+            /* Let the free function take care of this item too */
+            i->n_items++;
+            goto fail;
+        }
+    }
+
+    if (!(i->path = avahi_strdup_printf("/Client%u/ServiceBatchResolver%u", client->id, i->id)))
+        goto fail;
+
+    avahi_dbus_object_register(i->path, avahi_dbus_msg_service_batch_resolver_impl, i);
+
+    /* Like the other lookup objects, give the client time to install
+     * its signal matches before the first results arrive */
+    avahi_elapse_time(&tv, DEFAULT_START_DELAY_MS, 0);
+    i->delay_timeout = server->poll_api->timeout_new(server->poll_api, &tv, service_batch_resolver_delay_callback, i);
+
+    return avahi_dbus_respond_path(c, m, i->path);
+
+fail:
+    avahi_dbus_service_batch_resolver_free(i);
+    return avahi_dbus_respond_error(c, m, AVAHI_ERR_NO_MEMORY, NULL);
+}
+
 static DBusHandlerResult dbus_create_sync_host_name_resolver_object(DBusConnection *c, DBusMessage *m, DBusError *error) {
     Client *client;
     int32_t interface, protocol, aprotocol;
@@ -748,7 +1274,7 @@ static DBusHandlerResult dbus_create_sync_host_name_resolver_object(DBusConnecti
         return dbus_parsing_error("Error parsing Server::ResolveHostName message", error);
     }
 
-    if (!(client = client_get(dbus_message_get_sender(m), TRUE))) {
+    if (!(client = client_get(c, m, TRUE))) {
         avahi_log_warn("Too many clients, client request failed.");
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_CLIENTS, NULL);
     }
@@ -764,7 +1290,7 @@ static DBusHandlerResult dbus_create_sync_host_name_resolver_object(DBusConnecti
     AVAHI_LLIST_PREPEND(SyncHostNameResolverInfo, sync_host_name_resolvers, client->sync_host_name_resolvers, i);
     client->n_objects++;
 
-    if (!(i->host_name_resolver = avahi_s_host_name_resolver_new(avahi_server, (AvahiIfIndex) interface, (AvahiProtocol) protocol, name, (AvahiProtocol) aprotocol, (AvahiLookupFlags) flags, avahi_dbus_sync_host_name_resolver_callback, i))) {
+    if (!(i->lookup = resolve_cache_host_name_lookup_new(avahi_server, (AvahiIfIndex) interface, (AvahiProtocol) protocol, name, (AvahiProtocol) aprotocol, (AvahiLookupFlags) flags, avahi_dbus_sync_host_name_resolver_callback, i))) {
         avahi_dbus_sync_host_name_resolver_free(i);
         return avahi_dbus_respond_error(c, m, avahi_server_errno(avahi_server), NULL);
     }
@@ -778,14 +1304,6 @@ static DBusHandlerResult dbus_prepare_async_host_name_resolver_object(AsyncHostN
     uint32_t flags;
     char *name;
     AsyncHostNameResolverInfo *i;
-    static const DBusObjectPathVTable vtable = {
-        NULL,
-        avahi_dbus_msg_async_host_name_resolver_impl,
-        NULL,
-        NULL,
-        NULL,
-        NULL
-    };
 
     if (!dbus_message_get_args(
             m, error,
@@ -798,7 +1316,7 @@ static DBusHandlerResult dbus_prepare_async_host_name_resolver_object(AsyncHostN
         return dbus_parsing_error("Error parsing Server::HostNameResolverNew message", error);
     }
 
-    if (!(client = client_get(dbus_message_get_sender(m), TRUE))) {
+    if (!(client = client_get(c, m, TRUE))) {
         avahi_log_warn(__FILE__": Too many clients, client request failed.");
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_CLIENTS, NULL);
     }
@@ -822,7 +1340,7 @@ static DBusHandlerResult dbus_prepare_async_host_name_resolver_object(AsyncHostN
     }
 
     i->path = avahi_strdup_printf("/Client%u/HostNameResolver%u", client->id, i->id);
-    dbus_connection_register_object_path(c, i->path, &vtable, i);
+    avahi_dbus_object_register(i->path, avahi_dbus_msg_async_host_name_resolver_impl, i);
     *hri = i;
     return avahi_dbus_respond_path(c, m, i->path);
 }
@@ -848,7 +1366,7 @@ static DBusHandlerResult dbus_create_sync_address_resolver_object(DBusConnection
     if (!avahi_address_parse(address, AVAHI_PROTO_UNSPEC, &a))
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_INVALID_ADDRESS, NULL);
 
-    if (!(client = client_get(dbus_message_get_sender(m), TRUE))) {
+    if (!(client = client_get(c, m, TRUE))) {
         avahi_log_warn("Too many clients, client request failed.");
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_CLIENTS, NULL);
     }
@@ -864,7 +1382,7 @@ static DBusHandlerResult dbus_create_sync_address_resolver_object(DBusConnection
     AVAHI_LLIST_PREPEND(SyncAddressResolverInfo, sync_address_resolvers, client->sync_address_resolvers, i);
     client->n_objects++;
 
-    if (!(i->address_resolver = avahi_s_address_resolver_new(avahi_server, (AvahiIfIndex) interface, (AvahiProtocol) protocol, &a, (AvahiLookupFlags) flags, avahi_dbus_sync_address_resolver_callback, i))) {
+    if (!(i->lookup = resolve_cache_address_lookup_new(avahi_server, (AvahiIfIndex) interface, (AvahiProtocol) protocol, &a, (AvahiLookupFlags) flags, avahi_dbus_sync_address_resolver_callback, i))) {
         avahi_dbus_sync_address_resolver_free(i);
         return avahi_dbus_respond_error(c, m, avahi_server_errno(avahi_server), NULL);
     }
@@ -879,14 +1397,6 @@ static DBusHandlerResult dbus_prepare_async_address_resolver_object(AsyncAddress
     char *address;
     AsyncAddressResolverInfo *i;
     AvahiAddress a;
-    static const DBusObjectPathVTable vtable = {
-        NULL,
-        avahi_dbus_msg_async_address_resolver_impl,
-        NULL,
-        NULL,
-        NULL,
-        NULL
-    };
 
     if (!dbus_message_get_args(
             m, error,
@@ -901,7 +1411,7 @@ static DBusHandlerResult dbus_prepare_async_address_resolver_object(AsyncAddress
     if (!avahi_address_parse(address, AVAHI_PROTO_UNSPEC, &a))
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_INVALID_ADDRESS, NULL);
 
-    if (!(client = client_get(dbus_message_get_sender(m), TRUE))) {
+    if (!(client = client_get(c, m, TRUE))) {
         avahi_log_warn(__FILE__": Too many clients, client request failed.");
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_CLIENTS, NULL);
     }
@@ -925,7 +1435,7 @@ static DBusHandlerResult dbus_prepare_async_address_resolver_object(AsyncAddress
     }
 
     i->path = avahi_strdup_printf("/Client%u/AddressResolver%u", client->id, i->id);
-    dbus_connection_register_object_path(c, i->path, &vtable, i);
+    avahi_dbus_object_register(i->path, avahi_dbus_msg_async_address_resolver_impl, i);
     *ari = i;
     return avahi_dbus_respond_path(c, m, i->path);
 }
@@ -933,14 +1443,6 @@ static DBusHandlerResult dbus_prepare_async_address_resolver_object(AsyncAddress
 static DBusHandlerResult dbus_prepare_record_browser_object(RecordBrowserInfo **rbi, DBusConnection *c, DBusMessage *m, DBusError *error) {
     Client *client;
     RecordBrowserInfo *i;
-    static const DBusObjectPathVTable vtable = {
-        NULL,
-        avahi_dbus_msg_record_browser_impl,
-        NULL,
-        NULL,
-        NULL,
-        NULL
-    };
     int32_t interface, protocol;
     uint32_t flags;
     char *name;
@@ -962,7 +1464,7 @@ static DBusHandlerResult dbus_prepare_record_browser_object(RecordBrowserInfo **
     if (!avahi_is_valid_domain_name(name))
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_INVALID_DOMAIN_NAME, NULL);
 
-    if (!(client = client_get(dbus_message_get_sender(m), TRUE))) {
+    if (!(client = client_get(c, m, TRUE))) {
         avahi_log_warn("Too many clients, client request failed.");
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_TOO_MANY_CLIENTS, NULL);
     }
@@ -992,7 +1494,7 @@ static DBusHandlerResult dbus_prepare_record_browser_object(RecordBrowserInfo **
     avahi_key_unref(key);
 
     i->path = avahi_strdup_printf("/Client%u/RecordBrowser%u", client->id, i->id);
-    dbus_connection_register_object_path(c, i->path, &vtable, i);
+    avahi_dbus_object_register(i->path, avahi_dbus_msg_record_browser_impl, i);
     *rbi = i;
     return avahi_dbus_respond_path(c, m, i->path);
 }
@@ -1058,7 +1560,7 @@ static DBusHandlerResult dbus_select_common_methods(DBusConnection *c, DBusMessa
 
 CREATE_DBUS_DELAY_FUNC(DomainBrowserInfo, domain_browser, avahi_s_domain_browser_start)
 CREATE_DBUS_DELAY_FUNC(ServiceTypeBrowserInfo, service_type_browser, avahi_s_service_type_browser_start)
-CREATE_DBUS_DELAY_FUNC(ServiceBrowserInfo, service_browser, avahi_s_service_browser_start)
+CREATE_DBUS_DELAY_FUNC(ServiceBrowserInfo, subscription, browse_share_subscription_start)
 CREATE_DBUS_DELAY_FUNC(AsyncServiceResolverInfo, service_resolver, avahi_s_service_resolver_start)
 CREATE_DBUS_DELAY_FUNC(AsyncHostNameResolverInfo, host_name_resolver, avahi_s_host_name_resolver_start)
 CREATE_DBUS_DELAY_FUNC(AsyncAddressResolverInfo, address_resolver, avahi_s_address_resolver_start)
@@ -1090,7 +1592,7 @@ static DBusHandlerResult dbus_select_browser(DBusConnection *c, DBusMessage *m,
         ServiceBrowserInfo *sbi = NULL;
         r = dbus_prepare_service_browser_object(&sbi, c, m, error);
         if (sbi)
-            sbi->delay_timeout = poll_api->timeout_new(poll_api, &tv, GET_DBUS_DELAY_FUNC(ServiceBrowserInfo, service_browser), sbi);
+            sbi->delay_timeout = poll_api->timeout_new(poll_api, &tv, GET_DBUS_DELAY_FUNC(ServiceBrowserInfo, subscription), sbi);
         return r;
 
     } else if (dbus_message_is_method_call(m, iface, "ServiceResolverNew")) {
@@ -1167,9 +1669,42 @@ static DBusHandlerResult dbus_select_prepare_browser(DBusConnection *c, DBusMess
     return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
+static DBusHandlerResult dbus_select_server2_methods(DBusConnection *c, DBusMessage *m, AVAHI_GCC_UNUSED void *userdata, const char *iface, DBusError *error) {
+
+    if (dbus_message_is_method_call(m, iface, "GetServices"))
+        return dbus_get_services(c, m, error);
+
+    if (dbus_message_is_method_call(m, iface, "ServiceBatchResolverNew"))
+        return dbus_create_service_batch_resolver_object(c, m, error);
+
+    if (dbus_message_is_method_call(m, iface, "GetStatistics"))
+        return dbus_get_statistics(c, m, error);
+
+    if (dbus_message_is_method_call(m, iface, "GetServerInfo"))
+        return dbus_get_server_info(c, m, error);
+
+#ifdef DBUS_TYPE_UNIX_FD
+    if (dbus_message_is_method_call(m, iface, "DumpRecords"))
+        return dbus_dump_records(c, m, error);
+#endif
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
 static DBusHandlerResult msg_server_impl(DBusConnection *c, DBusMessage *m, AVAHI_GCC_UNUSED void *userdata) {
     DBusHandlerResult r;
     DBusError error;
+    const char *path;
+
+    /* Messages for the objects we exported below the server object */
+    if ((path = dbus_message_get_path(m)) && strcmp(path, AVAHI_DBUS_PATH_SERVER)) {
+        ObjectInfo *o;
+
+        if (!(o = avahi_hashmap_lookup(server->objects_by_path, path)))
+            return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+        return o->function(c, m, o->userdata);
+    }
 
     dbus_error_init(&error);
 
@@ -1198,6 +1733,10 @@ static DBusHandlerResult msg_server_impl(DBusConnection *c, DBusMessage *m, AVAH
     if( r != DBUS_HANDLER_RESULT_NOT_YET_HANDLED)
         return r;
 
+    r = dbus_select_server2_methods(c,m,userdata, AVAHI_DBUS_INTERFACE_SERVER2, &error);
+    if( r != DBUS_HANDLER_RESULT_NOT_YET_HANDLED)
+        return r;
+
 
     avahi_log_warn("Missed message %s::%s()", dbus_message_get_interface(m), dbus_message_get_member(m));
     if (dbus_error_is_set(&error))
@@ -1206,12 +1745,28 @@ static DBusHandlerResult msg_server_impl(DBusConnection *c, DBusMessage *m, AVAH
     return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
+void dbus_protocol_get_statistics(unsigned *n_clients, unsigned *n_objects) {
+    Client *c;
+    unsigned n = 0;
+
+    if (server)
+        for (c = server->clients; c; c = c->clients_next)
+            n += c->n_objects;
+
+    if (n_clients)
+        *n_clients = server ? server->n_clients : 0;
+
+    if (n_objects)
+        *n_objects = n;
+}
+
 void dbus_protocol_server_state_changed(AvahiServerState state) {
     DBusMessage *m;
     int32_t t;
     const char *e;
+    SocketConnection *sc;
 
-    if (!server || !server->bus)
+    if (!server)
         return;
 
     m = dbus_message_new_signal(AVAHI_DBUS_PATH_SERVER, AVAHI_DBUS_INTERFACE_SERVER, "StateChanged");
@@ -1231,22 +1786,29 @@ void dbus_protocol_server_state_changed(AvahiServerState state) {
         e = AVAHI_DBUS_ERR_OK;
 
     dbus_message_append_args(m, DBUS_TYPE_INT32, &t, DBUS_TYPE_STRING, &e, DBUS_TYPE_INVALID);
-    dbus_connection_send(server->bus, m, NULL);
+
+    if (server->bus)
+        dbus_connection_send(server->bus, m, NULL);
+
+    /* There's no bus to broadcast to connections on the socket */
+    for (sc = server->socket_connections; sc; sc = sc->socket_connections_next)
+        dbus_connection_send(sc->connection, m, NULL);
+
     dbus_message_unref(m);
 }
 
+static const DBusObjectPathVTable server_vtable = {
+    NULL,
+    msg_server_impl,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
 static int dbus_connect(void) {
     DBusError error;
 
-    static const DBusObjectPathVTable server_vtable = {
-        NULL,
-        msg_server_impl,
-        NULL,
-        NULL,
-        NULL,
-        NULL
-    };
-
     assert(server);
     assert(!server->bus);
 
@@ -1316,8 +1878,8 @@ static int dbus_connect(void) {
         goto fail;
     }
 
-    if (!(dbus_connection_register_object_path(server->bus, AVAHI_DBUS_PATH_SERVER, &server_vtable, NULL))) {
-        avahi_log_error("dbus_connection_register_object_path() failed");
+    if (!(dbus_connection_register_fallback(server->bus, AVAHI_DBUS_PATH_SERVER, &server_vtable, NULL))) {
+        avahi_log_error("dbus_connection_register_fallback() failed");
         goto fail;
     }
 
@@ -1341,12 +1903,17 @@ fail:
 }
 
 static void dbus_disconnect(void) {
+    Client *c, *n;
+
     assert(server);
 
-    while (server->clients)
-        client_free(server->clients);
+    /* Clients on the socket don't depend on the bus */
+    for (c = server->clients; c; c = n) {
+        n = c->clients_next;
 
-    assert(server->n_clients == 0);
+        if (c->connection == server->bus)
+            client_free(c);
+    }
 
     if (server->bus) {
 #ifdef HAVE_DBUS_CONNECTION_CLOSE
@@ -1359,19 +1926,215 @@ static void dbus_disconnect(void) {
     }
 }
 
+static void socket_connection_free(SocketConnection *sc) {
+    Client *client;
+
+    assert(server);
+    assert(sc);
+
+    if ((client = avahi_hashmap_lookup(server->clients_by_connection, sc->connection))) {
+        avahi_log_debug(__FILE__": client %s vanished.", client->name);
+        client_free(client);
+    }
+
+    if (sc->auth_timeout)
+        server->poll_api->timeout_free(sc->auth_timeout);
+
+    AVAHI_LLIST_REMOVE(SocketConnection, socket_connections, server->socket_connections, sc);
+
+    assert(server->n_socket_connections >= 1);
+    server->n_socket_connections--;
+
+#ifdef HAVE_DBUS_CONNECTION_CLOSE
+    dbus_connection_close(sc->connection);
+#else
+    dbus_connection_disconnect(sc->connection);
+#endif
+    dbus_connection_unref(sc->connection);
+
+    avahi_free(sc);
+}
+
+static dbus_bool_t allow_unix_user(AVAHI_GCC_UNUSED DBusConnection *c, unsigned long uid, void *userdata) {
+    SocketConnection *sc = userdata, *i;
+    unsigned n = 0;
+
+    assert(sc);
+
+    if (sc->authenticated)
+        return sc->uid == uid;
+
+    /* Everyone may connect, as on the bus, but only so often */
+    for (i = server->socket_connections; i; i = i->socket_connections_next)
+        if (i->authenticated && i->uid == uid)
+            n++;
+
+    if (n >= SOCKET_CONNECTIONS_PER_USER_MAX) {
+        avahi_log_warn("Too many connections of user %lu on D-Bus socket, refusing.", uid);
+        return FALSE;
+    }
+
+    sc->authenticated = 1;
+    sc->uid = uid;
+
+    if (sc->auth_timeout) {
+        server->poll_api->timeout_free(sc->auth_timeout);
+        sc->auth_timeout = NULL;
+    }
+
+    return TRUE;
+}
+
+static void auth_timeout_callback(AVAHI_GCC_UNUSED AvahiTimeout *t, void *userdata) {
+    SocketConnection *sc = userdata;
+
+    assert(sc);
+
+    avahi_log_debug(__FILE__": Connection on D-Bus socket didn't authenticate in time.");
+    socket_connection_free(sc);
+}
+
+static DBusHandlerResult msg_socket_filter_impl(AVAHI_GCC_UNUSED DBusConnection *c, DBusMessage *m, void *userdata) {
+    SocketConnection *sc = userdata;
+
+    assert(sc);
+
+    if (dbus_message_is_signal(m, DBUS_INTERFACE_LOCAL, "Disconnected")) {
+        socket_connection_free(sc);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static void socket_new_connection(AVAHI_GCC_UNUSED DBusServer *s, DBusConnection *c, AVAHI_GCC_UNUSED void *userdata) {
+    SocketConnection *sc;
+    struct timeval tv;
+
+    assert(server);
+    assert(c);
+
+    /* Connections don't take a Client before they use one, but the
+     * file descriptors are still worth limiting */
+    if (server->n_socket_connections >= server->n_clients_max) {
+        avahi_log_warn("Too many connections, refusing connection on D-Bus socket.");
+#ifdef HAVE_DBUS_CONNECTION_CLOSE
+        dbus_connection_close(c);
+#else
+        dbus_connection_disconnect(c);
+#endif
+        return;
+    }
+
+    if (!(sc = avahi_new(SocketConnection, 1))) {
+        avahi_log_error("Out of memory");
+#ifdef HAVE_DBUS_CONNECTION_CLOSE
+        dbus_connection_close(c);
+#else
+        dbus_connection_disconnect(c);
+#endif
+        return;
+    }
+
+    sc->connection = dbus_connection_ref(c);
+    sc->authenticated = 0;
+    sc->uid = 0;
+    sc->auth_timeout = server->poll_api->timeout_new(server->poll_api, avahi_elapse_time(&tv, SOCKET_AUTH_TIMEOUT_MSEC, 0), auth_timeout_callback, sc);
+
+    AVAHI_LLIST_PREPEND(SocketConnection, socket_connections, server->socket_connections, sc);
+    server->n_socket_connections++;
+
+    dbus_connection_set_unix_user_function(c, allow_unix_user, sc, NULL);
+
+    if (!sc->auth_timeout ||
+        avahi_dbus_connection_glue(c, server->poll_api) < 0 ||
+        !dbus_connection_add_filter(c, msg_socket_filter_impl, sc, NULL) ||
+        !dbus_connection_register_fallback(c, AVAHI_DBUS_PATH_SERVER, &server_vtable, NULL)) {
+        avahi_log_warn("Failed to set up connection on D-Bus socket.");
+        socket_connection_free(sc);
+    }
+}
+
+static int socket_listen(void) {
+    DBusError error;
+    mode_t u;
+
+    assert(server);
+    assert(!server->socket_server);
+
+    dbus_error_init(&error);
+
+    /* Like the simple protocol socket: the daemon runs only once on
+     * a host, so an existing socket is stale */
+    unlink(AVAHI_DBUS_SOCKET);
+
+    u = umask(0000);
+    server->socket_server = dbus_server_listen("unix:path=" AVAHI_DBUS_SOCKET, &error);
+    umask(u);
+
+    if (!server->socket_server) {
+        avahi_log_warn("dbus_server_listen(): %s", error.message);
+        dbus_error_free(&error);
+        return -1;
+    }
+
+    server->remove_socket = 1;
+
+    dbus_server_set_new_connection_function(server->socket_server, socket_new_connection, NULL, NULL);
+
+    if (avahi_dbus_server_glue(server->socket_server, server->poll_api) < 0) {
+        avahi_log_warn("avahi_dbus_server_glue() failed");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void socket_close(void) {
+    assert(server);
+
+    while (server->socket_connections)
+        socket_connection_free(server->socket_connections);
+
+    if (server->socket_server) {
+        dbus_server_disconnect(server->socket_server);
+        dbus_server_unref(server->socket_server);
+        server->socket_server = NULL;
+    }
+
+    /* libdbus cannot remove the socket itself once we are chroot()ed */
+    if (server->remove_socket) {
+#ifdef ENABLE_CHROOT
+        avahi_chroot_helper_unlink(AVAHI_DBUS_SOCKET);
+#else
+        unlink(AVAHI_DBUS_SOCKET);
+#endif
+        server->remove_socket = 0;
+    }
+}
+
 int dbus_protocol_setup(const AvahiPoll *poll_api,
                         int _disable_user_service_publishing,
                         int _n_clients_max,
                         int _n_objects_per_client_max,
                         int _n_entries_per_entry_group_max,
+                        int enable_socket,
                         int force) {
 
 
     server = avahi_new(Server, 1);
     AVAHI_LLIST_HEAD_INIT(Clients, server->clients);
+    server->clients_by_name = avahi_hashmap_new(avahi_string_hash, avahi_string_equal, NULL, NULL);
+    server->clients_by_connection = avahi_hashmap_new(pointer_hash, pointer_equal, NULL, NULL);
+    server->objects_by_path = avahi_hashmap_new(avahi_string_hash, avahi_string_equal, NULL, object_info_free);
+    server->entry_groups_by_group = avahi_hashmap_new(pointer_hash, pointer_equal, NULL, NULL);
     server->current_id = 0;
     server->n_clients = 0;
     server->bus = NULL;
+    server->socket_server = NULL;
+    AVAHI_LLIST_HEAD_INIT(SocketConnection, server->socket_connections);
+    server->n_socket_connections = 0;
+    server->remove_socket = 0;
     server->poll_api = poll_api;
     server->reconnect_timeout = NULL;
     server->reconnect = force;
@@ -1379,6 +2142,26 @@ int dbus_protocol_setup(const AvahiPoll *poll_api,
     server->n_clients_max = _n_clients_max > 0 ? _n_clients_max : DEFAULT_CLIENTS_MAX;
     server->n_objects_per_client_max = _n_objects_per_client_max > 0 ? _n_objects_per_client_max : DEFAULT_OBJECTS_PER_CLIENT_MAX;
     server->n_entries_per_entry_group_max = _n_entries_per_entry_group_max > 0 ? _n_entries_per_entry_group_max : DEFAULT_ENTRIES_PER_ENTRY_GROUP_MAX;
+    server->have_priv_access_gid = 0;
+
+    if (enable_socket) {
+        struct group *gr;
+
+        /* Look the group up while we still can, i.e. before chroot() */
+        if ((gr = getgrnam(AVAHI_PRIV_ACCESS_GROUP))) {
+            server->priv_access_gid = gr->gr_gid;
+            server->have_priv_access_gid = 1;
+        }
+    }
+
+    if (browse_share_setup(poll_api) < 0)
+        goto fail;
+
+    /* Clients can do without the socket, they fall back to the bus */
+    if (enable_socket && socket_listen() < 0) {
+        avahi_log_warn("WARNING: Failed to listen on D-Bus socket "AVAHI_DBUS_SOCKET".");
+        socket_close();
+    }
 
     if (dbus_connect() < 0) {
         struct timeval tv;
@@ -1405,6 +2188,13 @@ fail:
         dbus_connection_unref(server->bus);
     }
 
+    socket_close();
+    browse_share_shutdown();
+
+    avahi_hashmap_free(server->clients_by_name);
+    avahi_hashmap_free(server->clients_by_connection);
+    avahi_hashmap_free(server->objects_by_path);
+    avahi_hashmap_free(server->entry_groups_by_group);
     avahi_free(server);
     server = NULL;
     return -1;
@@ -1414,10 +2204,19 @@ void dbus_protocol_shutdown(void) {
 
     if (server) {
         dbus_disconnect();
+        socket_close();
+
+        assert(server->n_clients == 0);
 
         if (server->reconnect_timeout)
             server->poll_api->timeout_free(server->reconnect_timeout);
 
+        browse_share_shutdown();
+
+        avahi_hashmap_free(server->clients_by_name);
+        avahi_hashmap_free(server->clients_by_connection);
+        avahi_hashmap_free(server->objects_by_path);
+        avahi_hashmap_free(server->entry_groups_by_group);
         avahi_free(server);
         server = NULL;
     }
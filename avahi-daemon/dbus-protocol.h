@@ -25,8 +25,11 @@ int dbus_protocol_setup(const AvahiPoll *poll_api,
                         int _n_clients_max,
                         int _n_objects_per_client_max,
                         int _n_entries_per_entry_group_max,
+                        int enable_socket,
                         int force);
 void dbus_protocol_shutdown(void);
 void dbus_protocol_server_state_changed(AvahiServerState state);
 
+void dbus_protocol_get_statistics(unsigned *n_clients, unsigned *n_objects);
+
 #endif
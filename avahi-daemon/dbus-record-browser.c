@@ -45,7 +45,7 @@ void avahi_dbus_record_browser_free(RecordBrowserInfo *i) {
         avahi_s_record_browser_free(i->record_browser);
 
     if (i->path) {
-        dbus_connection_unregister_object_path(server->bus, i->path);
+        avahi_dbus_object_unregister(i->path);
         avahi_free(i->path);
     }
     AVAHI_LLIST_REMOVE(RecordBrowserInfo, record_browsers, i->client->record_browsers, i);
@@ -83,7 +83,7 @@ DBusHandlerResult avahi_dbus_msg_record_browser_impl(DBusConnection *c, DBusMess
         return avahi_dbus_handle_introspect(c, m, "org.freedesktop.Avahi.RecordBrowser.xml");
 
     /* Access control */
-    if (strcmp(dbus_message_get_sender(m), i->client->name))
+    if (!avahi_dbus_client_is_sender(i->client, c, m))
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_ACCESS_DENIED, NULL);
 
     if (dbus_message_is_method_call(m, AVAHI_DBUS_INTERFACE_RECORD_BROWSER, "Free")) {
@@ -178,8 +178,7 @@ void avahi_dbus_record_browser_callback(
     } else if (event == AVAHI_BROWSER_FAILURE)
         avahi_dbus_append_server_error(m);
 
-    dbus_message_set_destination(m, i->client->name);
-    dbus_connection_send(server->bus, m, NULL);
+    avahi_dbus_client_send(i->client, m);
     dbus_message_unref(m);
 
     return;
@@ -0,0 +1,462 @@
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <avahi-common/malloc.h>
+#include <avahi-common/dbus.h>
+#include <avahi-common/error.h>
+#include <avahi-common/timeval.h>
+#include <avahi-core/log.h>
+
+#include "dbus-util.h"
+#include "dbus-internal.h"
+#include "main.h"
+
+static void item_stop(ServiceBatchResolverItem *item) {
+    assert(item);
+
+    if (!item->service_resolver)
+        return;
+
+    avahi_s_service_resolver_free(item->service_resolver);
+    item->service_resolver = NULL;
+
+    assert(item->info->n_running >= 1);
+    item->info->n_running--;
+}
+
+static void item_free(ServiceBatchResolverItem *item) {
+    assert(item);
+
+    item_stop(item);
+
+    avahi_free(item->name);
+    avahi_free(item->type);
+    avahi_free(item->domain);
+    avahi_free(item->host_name);
+    avahi_string_list_free(item->txt);
+}
+
+void avahi_dbus_service_batch_resolver_free(ServiceBatchResolverInfo *i) {
+    unsigned j;
+
+    assert(i);
+
+    if (i->delay_timeout)
+        server->poll_api->timeout_free(i->delay_timeout);
+
+    if (i->batch_timeout)
+        server->poll_api->timeout_free(i->batch_timeout);
+
+    for (j = 0; j < i->n_items; j++)
+        item_free(i->items + j);
+
+    avahi_free(i->items);
+    avahi_free(i->resolved);
+
+    if (i->path) {
+        avahi_dbus_object_unregister(i->path);
+        avahi_free(i->path);
+    }
+
+    AVAHI_LLIST_REMOVE(ServiceBatchResolverInfo, service_batch_resolvers, i->client->service_batch_resolvers, i);
+
+    assert(i->client->n_objects >= i->n_running_max);
+    i->client->n_objects -= i->n_running_max;
+
+    avahi_free(i);
+}
+
+static int append_item(DBusMessageIter *array, ServiceBatchResolverItem *item) {
+    char t[AVAHI_ADDRESS_STR_MAX], *pt = t;
+    const char *name, *domain, *host_name, *e;
+    int32_t i_event, i_interface, i_protocol, i_aprotocol;
+    uint32_t u_flags;
+    DBusMessageIter sub;
+
+    assert(array);
+    assert(item);
+
+    if (item->event == AVAHI_RESOLVER_FOUND) {
+        avahi_address_snprint(t, sizeof(t), &item->address);
+        i_aprotocol = (int32_t) item->address.proto;
+        e = "";
+    } else {
+        t[0] = 0;
+        i_aprotocol = AVAHI_PROTO_UNSPEC;
+        e = avahi_error_number_to_dbus(item->error);
+    }
+
+    name = item->name ? item->name : "";
+    domain = item->domain ? item->domain : "";
+    host_name = item->host_name ? item->host_name : "";
+
+    i_event = (int32_t) item->event;
+    i_interface = (int32_t) item->interface;
+    i_protocol = (int32_t) item->protocol;
+    u_flags = (uint32_t) item->result_flags;
+
+    if (!dbus_message_iter_open_container(array, DBUS_TYPE_STRUCT, NULL, &sub))
+        return -1;
+
+    if (!dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT32, &item->index) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &i_event) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &i_interface) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &i_protocol) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &name) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &item->type) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &domain) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &host_name) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &i_aprotocol) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &pt) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT16, &item->port) ||
+        avahi_dbus_append_string_list_iter(&sub, item->txt) < 0 ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT32, &u_flags) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &e)) {
+        avahi_dbus_abandon_container(array, &sub);
+        return -1;
+    }
+
+    if (!dbus_message_iter_close_container(array, &sub))
+        return -1;
+
+    return 0;
+}
+
+static DBusMessage *batch_build(ServiceBatchResolverInfo *i, unsigned n) {
+    DBusMessage *m;
+    DBusMessageIter iter, array;
+    unsigned j;
+
+    assert(i);
+    assert(n > 0);
+    assert(i->n_sent + n <= i->n_resolved);
+
+    if (!(m = dbus_message_new_signal(i->path, AVAHI_DBUS_INTERFACE_SERVICE_BATCH_RESOLVER, "ItemsResolved")))
+        return NULL;
+
+    dbus_message_iter_init_append(m, &iter);
+
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(uiiissssisqaayus)", &array)) {
+        dbus_message_unref(m);
+        return NULL;
+    }
+
+    for (j = 0; j < n; j++)
+        if (append_item(&array, i->items + i->resolved[i->n_sent + j]) < 0) {
+            avahi_dbus_abandon_container(&iter, &array);
+            dbus_message_unref(m);
+            return NULL;
+        }
+
+    if (!dbus_message_iter_close_container(&iter, &array)) {
+        dbus_message_unref(m);
+        return NULL;
+    }
+
+    return m;
+}
+
+static void batch_timeout_callback(AvahiTimeout *t, void *userdata);
+
+static void batch_schedule(ServiceBatchResolverInfo *i) {
+    struct timeval tv;
+
+    assert(i);
+
+    avahi_elapse_time(&tv, BATCH_DELAY_MSEC, 0);
+
+    if (i->batch_timeout)
+        server->poll_api->timeout_update(i->batch_timeout, &tv);
+    else
+        i->batch_timeout = server->poll_api->timeout_new(server->poll_api, &tv, batch_timeout_callback, i);
+}
+
+static void batch_flush(ServiceBatchResolverInfo *i) {
+    DBusMessage *m;
+    unsigned n;
+
+    assert(i);
+
+    if (i->batch_timeout)
+        server->poll_api->timeout_update(i->batch_timeout, NULL);
+
+    n = BATCH_ITEMS_MAX;
+
+    while (i->n_sent < i->n_resolved) {
+        unsigned j;
+
+        if (n > i->n_resolved - i->n_sent)
+            n = i->n_resolved - i->n_sent;
+
+        if (!(m = batch_build(i, n))) {
+
+            /* Keep the results, so that every item is still reported
+             * exactly once. Smaller signals might still fit, otherwise
+             * try again a bit later. */
+            if (n > 1) {
+                n /= 2;
+                continue;
+            }
+
+            avahi_log_error("Failed allocate message");
+            batch_schedule(i);
+            return;
+        }
+
+        avahi_dbus_client_send(i->client, m);
+        dbus_message_unref(m);
+
+        /* The results aren't needed anymore */
+        for (j = 0; j < n; j++) {
+            ServiceBatchResolverItem *item = i->items + i->resolved[i->n_sent + j];
+
+            avahi_free(item->host_name);
+            item->host_name = NULL;
+            avahi_string_list_free(item->txt);
+            item->txt = NULL;
+        }
+
+        i->n_sent += n;
+    }
+
+    if (i->n_sent < i->n_items)
+        return;
+
+    if (!(m = dbus_message_new_signal(i->path, AVAHI_DBUS_INTERFACE_SERVICE_BATCH_RESOLVER, "Done"))) {
+        avahi_log_error("Failed allocate message");
+        return;
+    }
+
+    avahi_dbus_client_send(i->client, m);
+    dbus_message_unref(m);
+}
+
+static void batch_timeout_callback(AvahiTimeout *t, void *userdata) {
+    ServiceBatchResolverInfo *i = userdata;
+
+    assert(t);
+    assert(i);
+
+    batch_flush(i);
+}
+
+static int replace_string(char **s, const char *n) {
+    char *c = NULL;
+
+    assert(s);
+
+    if (n && !(c = avahi_strdup(n)))
+        return -1;
+
+    avahi_free(*s);
+    *s = c;
+    return 0;
+}
+
+static void item_resolved(
+    ServiceBatchResolverItem *item,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    AvahiResolverEvent event,
+    const char *name,
+    const char *type,
+    const char *domain,
+    const char *host_name,
+    const AvahiAddress *a,
+    uint16_t port,
+    AvahiStringList *txt,
+    AvahiLookupResultFlags flags,
+    int error) {
+
+    ServiceBatchResolverInfo *i;
+
+    assert(item);
+
+    i = item->info;
+    assert(i->n_resolved < i->n_items);
+
+    item->event = event;
+    item->result_flags = flags;
+    item->error = error;
+
+    if (event == AVAHI_RESOLVER_FOUND) {
+        AvahiStringList *l = NULL;
+
+        assert(a);
+
+        if (replace_string(&item->name, name) < 0 ||
+            replace_string(&item->type, type) < 0 ||
+            replace_string(&item->domain, domain) < 0 ||
+            replace_string(&item->host_name, host_name) < 0 ||
+            (txt && !(l = avahi_string_list_copy(txt)))) {
+
+            /* The request itself is still there, so report it as
+             * failed rather than not at all */
+            avahi_log_error("Failed to allocate result");
+            item->event = AVAHI_RESOLVER_FAILURE;
+            item->result_flags = 0;
+            item->error = AVAHI_ERR_NO_MEMORY;
+        } else {
+            item->interface = interface;
+            item->protocol = protocol;
+            item->address = *a;
+            item->port = port;
+            item->txt = l;
+
+            if (avahi_dbus_is_our_own_service(i->client, interface, protocol, name, type, domain) > 0)
+                item->result_flags |= AVAHI_LOOKUP_RESULT_OUR_OWN;
+        }
+    }
+
+    i->resolved[i->n_resolved++] = item->index;
+
+    /* Report the last items right away, to keep them in order with
+     * the Done signal */
+    if (i->n_resolved - i->n_sent >= BATCH_ITEMS_MAX || i->n_resolved >= i->n_items)
+        batch_flush(i);
+    else if (i->n_resolved - i->n_sent == 1)
+        batch_schedule(i);
+}
+
+static void service_resolver_callback(
+    AvahiSServiceResolver *r,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    AvahiResolverEvent event,
+    const char *name,
+    const char *type,
+    const char *domain,
+    const char *host_name,
+    const AvahiAddress *a,
+    uint16_t port,
+    AvahiStringList *txt,
+    AvahiLookupResultFlags flags,
+    void* userdata);
+
+static void start_next(ServiceBatchResolverInfo *i) {
+    assert(i);
+
+    while (i->n_started < i->n_items && i->n_running < i->n_running_max) {
+        ServiceBatchResolverItem *item = i->items + i->n_started++;
+
+        /* The core resolvers answer right away if everything is in
+         * the cache, hence cached services don't have to wait long
+         * for a free slot. */
+        if (!(item->service_resolver = avahi_s_service_resolver_new(avahi_server, item->interface, item->protocol, item->name, item->type, item->domain, i->aprotocol, i->flags, service_resolver_callback, item))) {
+            item_resolved(item, item->interface, item->protocol, AVAHI_RESOLVER_FAILURE, NULL, NULL, NULL, NULL, NULL, 0, NULL, 0, avahi_server_errno(avahi_server));
+            continue;
+        }
+
+        i->n_running++;
+    }
+}
+
+static void service_resolver_callback(
+    AvahiSServiceResolver *r,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    AvahiResolverEvent event,
+    const char *name,
+    const char *type,
+    const char *domain,
+    const char *host_name,
+    const AvahiAddress *a,
+    uint16_t port,
+    AvahiStringList *txt,
+    AvahiLookupResultFlags flags,
+    void* userdata) {
+
+    ServiceBatchResolverItem *item = userdata;
+    ServiceBatchResolverInfo *i;
+
+    assert(r);
+    assert(item);
+
+    i = item->info;
+
+    if (event == AVAHI_RESOLVER_FOUND)
+        item_resolved(item, interface, protocol, event, name, type, domain, host_name, a, port, txt, flags, AVAHI_OK);
+    else {
+        assert(event == AVAHI_RESOLVER_FAILURE);
+        item_resolved(item, item->interface, item->protocol, event, NULL, NULL, NULL, NULL, NULL, 0, NULL, flags, avahi_server_errno(avahi_server));
+    }
+
+    /* We only report the first result of each service */
+    item_stop(item);
+
+    start_next(i);
+}
+
+void avahi_dbus_service_batch_resolver_start(ServiceBatchResolverInfo *i) {
+    assert(i);
+
+    if (i->n_started > 0)
+        return;
+
+    start_next(i);
+}
+
+DBusHandlerResult avahi_dbus_msg_service_batch_resolver_impl(DBusConnection *c, DBusMessage *m, void *userdata) {
+    DBusError error;
+    ServiceBatchResolverInfo *i = userdata;
+
+    assert(c);
+    assert(m);
+    assert(i);
+
+    dbus_error_init(&error);
+
+    avahi_log_debug(__FILE__": interface=%s, path=%s, member=%s",
+                    dbus_message_get_interface(m),
+                    dbus_message_get_path(m),
+                    dbus_message_get_member(m));
+
+    /* Introspection */
+    if (dbus_message_is_method_call(m, DBUS_INTERFACE_INTROSPECTABLE, "Introspect"))
+        return avahi_dbus_handle_introspect(c, m, "org.freedesktop.Avahi.ServiceBatchResolver.xml");
+
+    /* Access control */
+    if (!avahi_dbus_client_is_sender(i->client, c, m))
+        return avahi_dbus_respond_error(c, m, AVAHI_ERR_ACCESS_DENIED, NULL);
+
+    if (dbus_message_is_method_call(m, AVAHI_DBUS_INTERFACE_SERVICE_BATCH_RESOLVER, "Free")) {
+
+        if (!dbus_message_get_args(m, &error, DBUS_TYPE_INVALID)) {
+            avahi_log_warn("Error parsing ServiceBatchResolver::Free message");
+            goto fail;
+        }
+
+        avahi_dbus_service_batch_resolver_free(i);
+        return avahi_dbus_respond_ok(c, m);
+    }
+
+    avahi_log_warn("Missed message %s::%s()", dbus_message_get_interface(m), dbus_message_get_member(m));
+
+fail:
+    if (dbus_error_is_set(&error))
+        dbus_error_free(&error);
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
@@ -32,6 +32,16 @@
 #include "dbus-internal.h"
 #include "main.h"
 
+static void batch_discard(ServiceBrowserInfo *i) {
+    assert(i);
+    assert(i->batch);
+
+    avahi_dbus_abandon_container(&i->batch_iter, &i->batch_array);
+    dbus_message_unref(i->batch);
+    i->batch = NULL;
+    i->n_batched = 0;
+}
+
 void avahi_dbus_service_browser_free(ServiceBrowserInfo *i) {
     const AvahiPoll *poll_api = NULL;
 
@@ -42,11 +52,17 @@ void avahi_dbus_service_browser_free(ServiceBrowserInfo *i) {
     if (i->delay_timeout)
         poll_api->timeout_free(i->delay_timeout);
 
-    if (i->service_browser)
-        avahi_s_service_browser_free(i->service_browser);
+    if (i->batch_timeout)
+        poll_api->timeout_free(i->batch_timeout);
+
+    if (i->batch)
+        batch_discard(i);
+
+    if (i->subscription)
+        browse_share_subscription_free(i->subscription);
 
     if (i->path) {
-        dbus_connection_unregister_object_path(server->bus, i->path);
+        avahi_dbus_object_unregister(i->path);
         avahi_free(i->path);
     }
 
@@ -58,11 +74,103 @@ void avahi_dbus_service_browser_free(ServiceBrowserInfo *i) {
     avahi_free(i);
 }
 
+static void batch_flush(ServiceBrowserInfo *i) {
+    assert(i);
+
+    if (i->batch_timeout)
+        server->poll_api->timeout_update(i->batch_timeout, NULL);
+
+    if (!i->batch)
+        return;
+
+    if (dbus_message_iter_close_container(&i->batch_iter, &i->batch_array)) {
+        avahi_dbus_client_send(i->client, i->batch);
+    } else
+        avahi_log_error("Failed allocate message");
+
+    dbus_message_unref(i->batch);
+    i->batch = NULL;
+    i->n_batched = 0;
+}
+
+static void batch_timeout_callback(AvahiTimeout *t, void *userdata) {
+    ServiceBrowserInfo *i = userdata;
+
+    assert(t);
+    assert(i);
+
+    batch_flush(i);
+}
+
+static void batch_append(ServiceBrowserInfo *i, int32_t event, int32_t interface, int32_t protocol, const char *name, const char *type, const char *domain, uint32_t flags) {
+    DBusMessageIter sub;
+
+    assert(i);
+
+    if (!i->batch) {
+        if (!(i->batch = dbus_message_new_signal(i->path, AVAHI_DBUS_INTERFACE_SERVICE_BROWSER, "ItemsChanged"))) {
+            avahi_log_error("Failed allocate message");
+            return;
+        }
+
+        dbus_message_iter_init_append(i->batch, &i->batch_iter);
+
+        if (!dbus_message_iter_open_container(&i->batch_iter, DBUS_TYPE_ARRAY, "(iiisssu)", &i->batch_array)) {
+            /* The array has not been opened, so there's nothing to close */
+            avahi_log_error("Failed allocate message");
+            dbus_message_unref(i->batch);
+            i->batch = NULL;
+            return;
+        }
+    }
+
+    if (!dbus_message_iter_open_container(&i->batch_array, DBUS_TYPE_STRUCT, NULL, &sub)) {
+        avahi_log_error("Failed allocate message");
+        batch_discard(i);
+        return;
+    }
+
+    if (!dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &event) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &interface) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_INT32, &protocol) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &name) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &type) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &domain) ||
+        !dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT32, &flags)) {
+        avahi_log_error("Failed allocate message");
+        avahi_dbus_abandon_container(&i->batch_array, &sub);
+        batch_discard(i);
+        return;
+    }
+
+    if (!dbus_message_iter_close_container(&i->batch_array, &sub)) {
+        avahi_log_error("Failed allocate message");
+        batch_discard(i);
+        return;
+    }
+
+    if (++i->n_batched >= BATCH_ITEMS_MAX) {
+        batch_flush(i);
+        return;
+    }
+
+    if (i->n_batched == 1) {
+        struct timeval tv;
+
+        avahi_elapse_time(&tv, BATCH_DELAY_MSEC, 0);
+
+        if (i->batch_timeout)
+            server->poll_api->timeout_update(i->batch_timeout, &tv);
+        else
+            i->batch_timeout = server->poll_api->timeout_new(server->poll_api, &tv, batch_timeout_callback, i);
+    }
+}
+
 void avahi_dbus_service_browser_start(ServiceBrowserInfo *i) {
     assert(i);
 
-    if(i->service_browser)
-        avahi_s_service_browser_start(i->service_browser);
+    if (i->subscription)
+        browse_share_subscription_start(i->subscription);
 }
 
 DBusHandlerResult avahi_dbus_msg_service_browser_impl(DBusConnection *c, DBusMessage *m, void *userdata) {
@@ -85,7 +193,7 @@ DBusHandlerResult avahi_dbus_msg_service_browser_impl(DBusConnection *c, DBusMes
         return avahi_dbus_handle_introspect(c, m, "org.freedesktop.Avahi.ServiceBrowser.xml");
 
     /* Access control */
-    if (strcmp(dbus_message_get_sender(m), i->client->name))
+    if (!avahi_dbus_client_is_sender(i->client, c, m))
         return avahi_dbus_respond_error(c, m, AVAHI_ERR_ACCESS_DENIED, NULL);
 
     if (dbus_message_is_method_call(m, AVAHI_DBUS_INTERFACE_SERVICE_BROWSER, "Free")) {
@@ -112,6 +220,18 @@ DBusHandlerResult avahi_dbus_msg_service_browser_impl(DBusConnection *c, DBusMes
 
     }
 
+    if (dbus_message_is_method_call(m, AVAHI_DBUS_INTERFACE_SERVICE_BROWSER, "EnableBatching")) {
+
+        if (!dbus_message_get_args(m, &error, DBUS_TYPE_INVALID)) {
+            avahi_log_warn("Error parsing ServiceBrowser::EnableBatching message");
+            goto fail;
+        }
+
+        i->batching = 1;
+        return avahi_dbus_respond_ok(c, m);
+
+    }
+
     avahi_log_warn("Missed message %s::%s()", dbus_message_get_interface(m), dbus_message_get_member(m));
 
 fail:
@@ -121,15 +241,30 @@ fail:
     return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
-void avahi_dbus_service_browser_callback(AvahiSServiceBrowser *b, AvahiIfIndex interface, AvahiProtocol protocol, AvahiBrowserEvent event, const char *name, const char *type, const char *domain, AvahiLookupResultFlags flags, void* userdata) {
+void avahi_dbus_service_browser_callback(BrowseShareSubscription *s, AvahiIfIndex interface, AvahiProtocol protocol, AvahiBrowserEvent event, const char *name, const char *type, const char *domain, AvahiLookupResultFlags flags, void* userdata) {
     ServiceBrowserInfo *i = userdata;
     DBusMessage *m;
     int32_t i_interface, i_protocol;
     uint32_t u_flags;
 
-    assert(b);
+    assert(s);
     assert(i);
 
+    if (i->batching && (event == AVAHI_BROWSER_NEW || event == AVAHI_BROWSER_REMOVE)) {
+        assert(name);
+        assert(type);
+        assert(domain);
+
+        if (event == AVAHI_BROWSER_NEW && avahi_dbus_is_our_own_service(i->client, interface, protocol, name, type, domain) > 0)
+            flags |= AVAHI_LOOKUP_RESULT_OUR_OWN;
+
+        batch_append(i, (int32_t) event, (int32_t) interface, (int32_t) protocol, name, type, domain, (uint32_t) flags);
+        return;
+    }
+
+    /* Keep the order of events */
+    batch_flush(i);
+
     m = dbus_message_new_signal(i->path, AVAHI_DBUS_INTERFACE_SERVICE_BROWSER, avahi_dbus_map_browse_signal_name(event));
 
     if (!m) {
@@ -162,10 +297,15 @@ void avahi_dbus_service_browser_callback(AvahiSServiceBrowser *b, AvahiIfIndex i
             DBUS_TYPE_STRING, &domain,
             DBUS_TYPE_UINT32, &u_flags,
             DBUS_TYPE_INVALID);
-    } else if (event == AVAHI_BROWSER_FAILURE)
-        avahi_dbus_append_server_error(m);
+    } else if (event == AVAHI_BROWSER_FAILURE) {
+        const char *t = avahi_error_number_to_dbus(browse_share_subscription_errno(s));
+
+        dbus_message_append_args(
+            m,
+            DBUS_TYPE_STRING, &t,
+            DBUS_TYPE_INVALID);
+    }
 
-    dbus_message_set_destination(m, i->client->name);
-    dbus_connection_send(server->bus, m, NULL);
+    avahi_dbus_client_send(i->client, m);
     dbus_message_unref(m);
 }
@@ -35,8 +35,8 @@
 void avahi_dbus_sync_address_resolver_free(SyncAddressResolverInfo *i) {
     assert(i);
 
-    if (i->address_resolver)
-        avahi_s_address_resolver_free(i->address_resolver);
+    if (i->lookup)
+        resolve_cache_lookup_free(i->lookup);
     dbus_message_unref(i->message);
     AVAHI_LLIST_REMOVE(SyncAddressResolverInfo, sync_address_resolvers, i->client->sync_address_resolvers, i);
 
@@ -46,10 +46,10 @@ void avahi_dbus_sync_address_resolver_free(SyncAddressResolverInfo *i) {
     avahi_free(i);
 }
 
-void avahi_dbus_sync_address_resolver_callback(AvahiSAddressResolver *r, AvahiIfIndex interface, AvahiProtocol protocol, AvahiResolverEvent event, const AvahiAddress *address, const char *host_name, AvahiLookupResultFlags flags, void* userdata) {
+void avahi_dbus_sync_address_resolver_callback(ResolveCacheLookup *l, AvahiIfIndex interface, AvahiProtocol protocol, AvahiResolverEvent event, const AvahiAddress *address, const char *host_name, AvahiLookupResultFlags flags, void* userdata) {
     SyncAddressResolverInfo *i = userdata;
 
-    assert(r);
+    assert(l);
     assert(address);
     assert(i);
 
@@ -84,11 +84,11 @@ void avahi_dbus_sync_address_resolver_callback(AvahiSAddressResolver *r, AvahiIf
             DBUS_TYPE_UINT32, &u_flags,
             DBUS_TYPE_INVALID);
 
-        dbus_connection_send(server->bus, reply, NULL);
+        dbus_connection_send(i->client->connection, reply, NULL);
         dbus_message_unref(reply);
     } else {
         assert(event == AVAHI_RESOLVER_FAILURE);
-        avahi_dbus_respond_error(server->bus, i->message, avahi_server_errno(avahi_server), NULL);
+        avahi_dbus_respond_error(i->client->connection, i->message, resolve_cache_lookup_errno(l), NULL);
     }
 
 finish:
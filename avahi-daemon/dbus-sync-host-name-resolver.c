@@ -35,8 +35,8 @@
 void avahi_dbus_sync_host_name_resolver_free(SyncHostNameResolverInfo *i) {
     assert(i);
 
-    if (i->host_name_resolver)
-        avahi_s_host_name_resolver_free(i->host_name_resolver);
+    if (i->lookup)
+        resolve_cache_lookup_free(i->lookup);
     dbus_message_unref(i->message);
     AVAHI_LLIST_REMOVE(SyncHostNameResolverInfo, sync_host_name_resolvers, i->client->sync_host_name_resolvers, i);
 
@@ -46,10 +46,10 @@ void avahi_dbus_sync_host_name_resolver_free(SyncHostNameResolverInfo *i) {
     avahi_free(i);
 }
 
-void avahi_dbus_sync_host_name_resolver_callback(AvahiSHostNameResolver *r, AvahiIfIndex interface, AvahiProtocol protocol, AvahiResolverEvent event, const char *host_name, const AvahiAddress *a, AvahiLookupResultFlags flags, void* userdata) {
+void avahi_dbus_sync_host_name_resolver_callback(ResolveCacheLookup *l, AvahiIfIndex interface, AvahiProtocol protocol, AvahiResolverEvent event, const char *host_name, const AvahiAddress *a, AvahiLookupResultFlags flags, void* userdata) {
     SyncHostNameResolverInfo *i = userdata;
 
-    assert(r);
+    assert(l);
     assert(host_name);
     assert(i);
 
@@ -84,11 +84,11 @@ void avahi_dbus_sync_host_name_resolver_callback(AvahiSHostNameResolver *r, Avah
             DBUS_TYPE_UINT32, &u_flags,
             DBUS_TYPE_INVALID);
 
-        dbus_connection_send(server->bus, reply, NULL);
+        dbus_connection_send(i->client->connection, reply, NULL);
         dbus_message_unref(reply);
     } else {
         assert(event == AVAHI_RESOLVER_FAILURE);
-        avahi_dbus_respond_error(server->bus, i->message, avahi_server_errno(avahi_server), NULL);
+        avahi_dbus_respond_error(i->client->connection, i->message, resolve_cache_lookup_errno(l), NULL);
     }
 
 finish:
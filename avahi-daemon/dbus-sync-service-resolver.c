@@ -122,12 +122,12 @@ void avahi_dbus_sync_service_resolver_callback(
             DBUS_TYPE_UINT32, &u_flags,
             DBUS_TYPE_INVALID);
 
-        dbus_connection_send(server->bus, reply, NULL);
+        dbus_connection_send(i->client->connection, reply, NULL);
         dbus_message_unref(reply);
     } else {
         assert(event == AVAHI_RESOLVER_FAILURE);
 
-        avahi_dbus_respond_error(server->bus, i->message, avahi_server_errno(avahi_server), NULL);
+        avahi_dbus_respond_error(i->client->connection, i->message, avahi_server_errno(avahi_server), NULL);
     }
 
 finish:
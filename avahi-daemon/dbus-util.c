@@ -297,25 +297,63 @@ fail:
 
 }
 
-void avahi_dbus_append_string_list(DBusMessage *reply, AvahiStringList *txt) {
+void avahi_dbus_abandon_container(DBusMessageIter *iter, DBusMessageIter *sub) {
+    assert(iter);
+    assert(sub);
+
+    /* After this the message is unusable and has to be dropped by
+     * the caller. Containers still open at that point would leak
+     * the message signature. */
+
+#ifdef HAVE_DBUS_MESSAGE_ITER_ABANDON_CONTAINER_IF_OPEN
+    dbus_message_iter_abandon_container_if_open(iter, sub);
+#else
+    dbus_message_iter_close_container(iter, sub);
+#endif
+}
+
+int avahi_dbus_append_string_list_iter(DBusMessageIter *iter, AvahiStringList *txt) {
     AvahiStringList *p;
-    DBusMessageIter iter, sub;
+    DBusMessageIter sub;
 
-    assert(reply);
+    assert(iter);
 
-    dbus_message_iter_init_append(reply, &iter);
-    dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "ay", &sub);
+    if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "ay", &sub))
+        return -1;
 
     for (p = txt; p; p = p->next) {
         DBusMessageIter sub2;
         const uint8_t *data = p->text;
 
-        dbus_message_iter_open_container(&sub, DBUS_TYPE_ARRAY, "y", &sub2);
-        dbus_message_iter_append_fixed_array(&sub2, DBUS_TYPE_BYTE, &data, p->size);
-        dbus_message_iter_close_container(&sub, &sub2);
+        if (!dbus_message_iter_open_container(&sub, DBUS_TYPE_ARRAY, "y", &sub2))
+            goto fail;
 
+        if (!dbus_message_iter_append_fixed_array(&sub2, DBUS_TYPE_BYTE, &data, p->size)) {
+            avahi_dbus_abandon_container(&sub, &sub2);
+            goto fail;
+        }
+
+        if (!dbus_message_iter_close_container(&sub, &sub2))
+            goto fail;
     }
-    dbus_message_iter_close_container(&iter, &sub);
+
+    if (!dbus_message_iter_close_container(iter, &sub))
+        return -1;
+
+    return 0;
+
+fail:
+    avahi_dbus_abandon_container(iter, &sub);
+    return -1;
+}
+
+void avahi_dbus_append_string_list(DBusMessage *reply, AvahiStringList *txt) {
+    DBusMessageIter iter;
+
+    assert(reply);
+
+    dbus_message_iter_init_append(reply, &iter);
+    avahi_dbus_append_string_list_iter(&iter, txt);
 }
 
 int avahi_dbus_read_rdata(DBusMessage *m, int idx, void **rdata, uint32_t *size) {
@@ -351,9 +389,8 @@ fail:
 }
 
 int avahi_dbus_read_strlst(DBusMessage *m, int idx, AvahiStringList **l) {
-    DBusMessageIter iter, sub;
+    DBusMessageIter iter;
     int j;
-    AvahiStringList *strlst = NULL;
 
     assert(m);
     assert(l);
@@ -363,11 +400,21 @@ int avahi_dbus_read_strlst(DBusMessage *m, int idx, AvahiStringList **l) {
     for (j = 0; j < idx; j++)
         dbus_message_iter_next(&iter);
 
-    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY ||
-        dbus_message_iter_get_element_type(&iter) != DBUS_TYPE_ARRAY)
+    return avahi_dbus_read_strlst_iter(&iter, l);
+}
+
+int avahi_dbus_read_strlst_iter(DBusMessageIter *iter, AvahiStringList **l) {
+    DBusMessageIter sub;
+    AvahiStringList *strlst = NULL;
+
+    assert(iter);
+    assert(l);
+
+    if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY ||
+        dbus_message_iter_get_element_type(iter) != DBUS_TYPE_ARRAY)
         goto fail;
 
-    dbus_message_iter_recurse(&iter, &sub);
+    dbus_message_iter_recurse(iter, &sub);
 
     for (;;) {
         int at, n;
@@ -414,9 +461,8 @@ int avahi_dbus_is_our_own_service(Client *c, AvahiIfIndex interface, AvahiProtoc
     if (avahi_server_get_group_of_service(avahi_server, interface, protocol, name, type, domain, &g) == AVAHI_OK) {
         EntryGroupInfo *egi;
 
-        for (egi = c->entry_groups; egi; egi = egi->entry_groups_next)
-            if (egi->entry_group == g)
-                return 1;
+        if ((egi = avahi_dbus_entry_group_lookup(g)) && egi->client == c)
+            return 1;
     }
 
     return 0;
@@ -46,9 +46,13 @@ const char *avahi_dbus_map_resolve_signal_name(AvahiResolverEvent e);
 DBusHandlerResult avahi_dbus_handle_introspect(DBusConnection *c, DBusMessage *m, const char *fname);
 
 void avahi_dbus_append_string_list(DBusMessage *reply, AvahiStringList *txt);
+int avahi_dbus_append_string_list_iter(DBusMessageIter *iter, AvahiStringList *txt);
+
+void avahi_dbus_abandon_container(DBusMessageIter *iter, DBusMessageIter *sub);
 
 int avahi_dbus_read_rdata(DBusMessage *m, int idx, void **rdata, uint32_t *size);
 int avahi_dbus_read_strlst(DBusMessage *m, int idx, AvahiStringList **l);
+int avahi_dbus_read_strlst_iter(DBusMessageIter *iter, AvahiStringList **l);
 
 int avahi_dbus_is_our_own_service(Client *c, AvahiIfIndex interface, AvahiProtocol protocol, const char *name, const char *type, const char *domain);
 
@@ -0,0 +1,442 @@
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+#include <avahi-common/llist.h>
+#include <avahi-common/malloc.h>
+#include <avahi-common/error.h>
+#include <avahi-common/utf8.h>
+#include <avahi-common/timeval.h>
+#include <avahi-common/gccmacro.h>
+#include <avahi-core/log.h>
+
+#include "dump.h"
+
+/* How many records are formatted in one go, and how long other
+ * events get before the next chunk. A zero delay would starve all I/O,
+ * since the main loop always dispatches expired timeouts first. */
+#define RECORDS_PER_CHUNK 100
+#define CHUNK_DELAY_MSEC 1
+
+/* Dumps to file descriptors running at the same time, overall and
+ * per owner. Log dumps are limited separately, so that clients can't
+ * hold off SIGUSR1. */
+#define DUMPS_MAX 8
+#define DUMPS_PER_OWNER_MAX 2
+
+/* How long a dump waits for its file descriptor to become writable
+ * before it is given up, since it pins a snapshot of the cache */
+#define STALL_TIMEOUT_MSEC 30000
+
+typedef struct Dump Dump;
+
+struct Dump {
+    AvahiSDump *snapshot;
+    DumpFormat format;
+    unsigned n_records, left;
+    const void *owner;
+
+    /* The file descriptor is shared with the caller, so we never make
+     * it non-blocking. Sockets are written with MSG_DONTWAIT, anything
+     * else only as much as fits when poll() says it's writable. */
+    int fd, is_socket;
+    AvahiWatch *watch;
+    AvahiTimeout *timeout;
+    int stalled;
+
+    /* The formatted chunk, written from buffer + index */
+    char *buffer;
+    size_t length, allocated, index;
+    int oom;
+
+    AVAHI_LLIST_FIELDS(Dump, dumps);
+};
+
+static const AvahiPoll *poll_api = NULL;
+static AVAHI_LLIST_HEAD(Dump, dumps) = NULL;
+
+static void dump_free(Dump *d) {
+    assert(d);
+
+    AVAHI_LLIST_REMOVE(Dump, dumps, dumps, d);
+
+    if (d->snapshot)
+        avahi_s_dump_free(d->snapshot);
+
+    if (d->watch)
+        poll_api->watch_free(d->watch);
+
+    if (d->timeout)
+        poll_api->timeout_free(d->timeout);
+
+    if (d->fd >= 0)
+        close(d->fd);
+
+    avahi_free(d->buffer);
+    avahi_free(d);
+}
+
+static void append(Dump *d, const char *s, size_t l) {
+    assert(d);
+    assert(s);
+
+    if (d->oom)
+        return;
+
+    if (d->length + l > d->allocated) {
+        size_t n = d->allocated ? d->allocated : 4096;
+        char *b;
+
+        while (d->length + l > n)
+            n *= 2;
+
+        if (!(b = avahi_realloc(d->buffer, n))) {
+            d->oom = 1;
+            return;
+        }
+
+        d->buffer = b;
+        d->allocated = n;
+    }
+
+    memcpy(d->buffer + d->length, s, l);
+    d->length += l;
+}
+
+static void append_json_string(Dump *d, const char *s) {
+    int valid;
+
+    assert(d);
+    assert(s);
+
+    /* TXT data need not be UTF-8, pass such bytes on as Latin-1 */
+    valid = !!avahi_utf8_valid(s);
+
+    append(d, "\"", 1);
+
+    for (; *s; s++) {
+        unsigned char c = (unsigned char) *s;
+        char t[8];
+
+        if (c == '"' || c == '\\') {
+            t[0] = '\\';
+            t[1] = (char) c;
+            append(d, t, 2);
+        } else if (c < 0x20 || c == 0x7f || (c >= 0x80 && !valid)) {
+            snprintf(t, sizeof(t), "\\u%04x", c);
+            append(d, t, 6);
+        } else
+            append(d, s, 1);
+    }
+
+    append(d, "\"", 1);
+}
+
+static const char *source_to_string(AvahiDumpSource source) {
+
+    switch (source) {
+        case AVAHI_DUMP_LOCAL:
+            return "local";
+        case AVAHI_DUMP_CACHE:
+            return "cache";
+        case AVAHI_DUMP_WIDE_AREA:
+            return "wide-area";
+    }
+
+    return "unknown";
+}
+
+static void record_callback(AvahiDumpSource source, AvahiIfIndex interface, AvahiProtocol protocol, AvahiRecord *r, uint32_t ttl, void *userdata) {
+    Dump *d = userdata;
+    char *t;
+
+    assert(r);
+    assert(d);
+
+    if (d->format == DUMP_FORMAT_LOG) {
+
+        if (!(t = avahi_record_to_string(r))) {
+            d->oom = 1;
+            return;
+        }
+
+        avahi_log_info("%s ; source=%s iface=%i proto=%i left=%u", t, source_to_string(source), interface, protocol, ttl);
+
+    } else {
+        char ln[256], class[16], type[16];
+        const char *c, *y;
+
+        if (!(t = avahi_record_data_to_string(r))) {
+            d->oom = 1;
+            return;
+        }
+
+        if (!(c = avahi_dns_class_to_string(r->key->clazz))) {
+            snprintf(class, sizeof(class), "CLASS%u", r->key->clazz);
+            c = class;
+        }
+
+        if (!(y = avahi_dns_type_to_string(r->key->type))) {
+            snprintf(type, sizeof(type), "TYPE%u", r->key->type);
+            y = type;
+        }
+
+        snprintf(ln, sizeof(ln), "{\"source\":\"%s\",\"interface\":%i,\"protocol\":%i,\"name\":", source_to_string(source), interface, protocol);
+        append(d, ln, strlen(ln));
+        append_json_string(d, r->key->name);
+
+        snprintf(ln, sizeof(ln), ",\"class\":\"%s\",\"type\":\"%s\",\"ttl\":%u,\"data\":", c, y, ttl);
+        append(d, ln, strlen(ln));
+        append_json_string(d, t);
+        append(d, "}\n", 2);
+    }
+
+    avahi_free(t);
+}
+
+/* Returns 1 if the chunk has been written completely, 0 if the fd
+ * isn't writable right now and -1 on failure */
+static int flush(Dump *d) {
+    assert(d);
+
+    while (d->index < d->length) {
+        size_t l = d->length - d->index;
+        ssize_t r;
+
+        if (d->is_socket)
+            r = send(d->fd, d->buffer + d->index, l, MSG_DONTWAIT|MSG_NOSIGNAL);
+        else {
+            struct pollfd p;
+
+            p.fd = d->fd;
+            p.events = POLLOUT;
+            p.revents = 0;
+
+            /* A writable pipe takes PIPE_BUF bytes without blocking */
+            if ((r = poll(&p, 1, 0)) == 0) {
+                errno = EAGAIN;
+                r = -1;
+            } else if (r > 0)
+                r = write(d->fd, d->buffer + d->index, l < PIPE_BUF ? l : PIPE_BUF);
+        }
+
+        if (r < 0) {
+
+            if (errno == EINTR)
+                continue;
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct timeval tv;
+
+                poll_api->watch_update(d->watch, AVAHI_WATCH_OUT);
+                poll_api->timeout_update(d->timeout, avahi_elapse_time(&tv, STALL_TIMEOUT_MSEC, 0));
+                d->stalled = 1;
+                return 0;
+            }
+
+            avahi_log_warn("Failed to write record dump: %s", strerror(errno));
+            return -1;
+        }
+
+        d->index += (size_t) r;
+    }
+
+    d->index = d->length = 0;
+    return 1;
+}
+
+static void work(Dump *d) {
+    struct timeval tv;
+    int r;
+
+    assert(d);
+
+    /* First get rid of what's left of the previous chunk */
+    if ((r = flush(d)) <= 0)
+        goto finish;
+
+    if (d->left > 0) {
+        d->left = avahi_s_dump_next(d->snapshot, RECORDS_PER_CHUNK, record_callback, d);
+
+        if (d->oom) {
+            avahi_log_warn("Failed to dump records: out of memory");
+            r = -1;
+            goto finish;
+        }
+
+        if ((r = flush(d)) <= 0)
+            goto finish;
+    }
+
+    if (d->left > 0) {
+        poll_api->timeout_update(d->timeout, avahi_elapse_time(&tv, CHUNK_DELAY_MSEC, 0));
+        return;
+    }
+
+    if (d->format == DUMP_FORMAT_LOG)
+        avahi_log_info(";;; END OF DUMP ;;;");
+    else
+        avahi_log_debug("Dumped %u records.", d->n_records);
+
+    dump_free(d);
+    return;
+
+finish:
+    if (r < 0)
+        dump_free(d);
+}
+
+static void timeout_callback(AvahiTimeout *t, void *userdata) {
+    Dump *d = userdata;
+
+    assert(t);
+    assert(d);
+
+    if (d->stalled) {
+        avahi_log_warn("Record dump not read for %u seconds, giving up.", STALL_TIMEOUT_MSEC / 1000);
+        dump_free(d);
+        return;
+    }
+
+    poll_api->timeout_update(d->timeout, NULL);
+    work(d);
+}
+
+static void watch_callback(AvahiWatch *w, AVAHI_GCC_UNUSED int fd, AVAHI_GCC_UNUSED AvahiWatchEvent events, void *userdata) {
+    Dump *d = userdata;
+
+    assert(w);
+    assert(d);
+
+    poll_api->watch_update(d->watch, 0);
+    poll_api->timeout_update(d->timeout, NULL);
+    d->stalled = 0;
+    work(d);
+}
+
+int dump_start(AvahiServer *s, DumpFormat format, int fd, const void *owner) {
+    Dump *d = NULL, *i;
+    struct timeval tv;
+    struct stat st;
+    unsigned n = 0, n_owner = 0;
+    int error = AVAHI_ERR_NO_MEMORY;
+
+    assert(s);
+    assert(poll_api);
+    assert((format == DUMP_FORMAT_LOG) == (fd < 0));
+    assert(fd >= 0 || !owner);
+
+    for (i = dumps; i; i = i->dumps_next) {
+        if ((i->fd >= 0) == (fd >= 0))
+            n++;
+
+        if (owner && i->owner == owner)
+            n_owner++;
+    }
+
+    if (n >= DUMPS_MAX || n_owner >= DUMPS_PER_OWNER_MAX) {
+        error = AVAHI_ERR_TOO_MANY_OBJECTS;
+        goto fail;
+    }
+
+    if (fd >= 0 && fstat(fd, &st) < 0) {
+        error = AVAHI_ERR_OS;
+        goto fail;
+    }
+
+    if (!(d = avahi_new0(Dump, 1)))
+        goto fail;
+
+    d->format = format;
+    d->owner = owner;
+    d->fd = fd;
+    d->is_socket = fd >= 0 && S_ISSOCK(st.st_mode);
+    fd = -1;
+
+    AVAHI_LLIST_PREPEND(Dump, dumps, dumps, d);
+
+    if (!(d->snapshot = avahi_s_dump_new(s))) {
+        error = avahi_server_errno(s);
+        goto fail;
+    }
+
+    if (d->fd >= 0 && !(d->watch = poll_api->watch_new(poll_api, d->fd, 0, watch_callback, d)))
+        goto fail;
+
+    if (!(d->timeout = poll_api->timeout_new(poll_api, avahi_elapse_time(&tv, 0, 0), timeout_callback, d)))
+        goto fail;
+
+    d->n_records = d->left = avahi_s_dump_next(d->snapshot, 0, record_callback, d);
+
+    if (format == DUMP_FORMAT_LOG)
+        avahi_log_info(";;; DUMP OF %u RECORDS FOLLOWS ;;;", d->n_records);
+
+    return AVAHI_OK;
+
+fail:
+    if (d)
+        dump_free(d);
+
+    if (fd >= 0)
+        close(fd);
+
+    return error;
+}
+
+void dump_cancel(const void *owner) {
+    Dump *d, *n;
+
+    assert(owner);
+
+    for (d = dumps; d; d = n) {
+        n = d->dumps_next;
+
+        if (d->owner == owner)
+            dump_free(d);
+    }
+}
+
+int dump_setup(const AvahiPoll *p) {
+    assert(p);
+
+    poll_api = p;
+    return 0;
+}
+
+void dump_shutdown(void) {
+
+    while (dumps)
+        dump_free(dumps);
+
+    poll_api = NULL;
+}
@@ -0,0 +1,49 @@
+#ifndef foodumphfoo
+#define foodumphfoo
+
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <avahi-common/watch.h>
+#include <avahi-core/core.h>
+
+/* Dumps of the local and cached records of the server. A snapshot of
+ * the records is taken right away, they are then formatted and
+ * written a chunk at a time from the main loop, so that dumping a
+ * large cache doesn't hold up packet processing. */
+
+typedef enum {
+    DUMP_FORMAT_LOG,    /* Zone file style lines, to the log */
+    DUMP_FORMAT_JSON    /* One JSON object per record and line, to a file descriptor */
+} DumpFormat;
+
+int dump_setup(const AvahiPoll *poll_api);
+void dump_shutdown(void);
+
+/* Start a dump, fd must be -1 for DUMP_FORMAT_LOG. The fd is owned by
+ * the dump from now on, even if this fails, and is closed when all
+ * records have been written. Dumps to a file descriptor may be tied to
+ * an owner, which limits how many it can run at the same time.
+ * Returns an AVAHI_ERR_xxx code. */
+int dump_start(AvahiServer *s, DumpFormat format, int fd, const void *owner);
+
+/* Abort all dumps of the given owner, e.g. when it goes away */
+void dump_cancel(const void *owner);
+
+#endif
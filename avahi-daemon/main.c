@@ -82,6 +82,9 @@
 #include "setproctitle.h"
 #include "main.h"
 #include "simple-protocol.h"
+#include "resolve-cache.h"
+#include "statistics.h"
+#include "dump.h"
 #include "static-services.h"
 #include "static-hosts.h"
 #include "ini-file-parser.h"
@@ -112,11 +115,16 @@ typedef struct {
     char *config_file;
 #ifdef HAVE_DBUS
     int enable_dbus;
+    int enable_dbus_socket;
     int fail_on_missing_dbus;
     unsigned n_clients_max;
     unsigned n_objects_per_client_max;
     unsigned n_entries_per_entry_group_max;
 #endif
+    unsigned n_simple_clients_max;
+    unsigned n_simple_requests_per_client_max;
+    unsigned n_resolve_cache_entries_max;
+    char *statistics_file;
     int drop_root;
     int set_rlimits;
 #ifdef ENABLE_CHROOT
@@ -377,12 +385,15 @@ static void server_callback(AvahiServer *s, AvahiServerState state, void *userda
             if (c->publish_dns_servers && c->publish_dns_servers[0])
                 dns_servers_entry_group = add_dns_servers(s, dns_servers_entry_group, c->publish_dns_servers);
 
+            resolve_cache_flush();
             simple_protocol_restart_queries();
             break;
 
         case AVAHI_SERVER_COLLISION: {
             char *n;
 
+            resolve_cache_flush();
+
             static_service_remove_from_server();
             static_hosts_remove_from_server();
             remove_dns_server_entry_groups();
@@ -693,7 +704,8 @@ static int load_config_file(DaemonConfig *c) {
                     } else {
                         c->enable_dbus = 0;
                     }
-                }
+                } else if (strcasecmp(p->key, "enable-dbus-socket") == 0)
+                    c->enable_dbus_socket = is_yes(p->value);
 #endif
                 else if (strcasecmp(p->key, "allow-interfaces") == 0) {
                     char **e, **t;
@@ -775,6 +787,36 @@ static int load_config_file(DaemonConfig *c) {
 
                     c->n_entries_per_entry_group_max = k;
 #endif
+                } else if (strcasecmp(p->key, "simple-clients-max") == 0) {
+                    unsigned k;
+
+                    if (parse_unsigned(p->value, &k) < 0) {
+                        avahi_log_error("Invalid simple-clients-max setting %s", p->value);
+                        goto finish;
+                    }
+
+                    c->n_simple_clients_max = k;
+                } else if (strcasecmp(p->key, "simple-requests-per-client-max") == 0) {
+                    unsigned k;
+
+                    if (parse_unsigned(p->value, &k) < 0) {
+                        avahi_log_error("Invalid simple-requests-per-client-max setting %s", p->value);
+                        goto finish;
+                    }
+
+                    c->n_simple_requests_per_client_max = k;
+                } else if (strcasecmp(p->key, "resolve-cache-entries-max") == 0) {
+                    unsigned k;
+
+                    if (parse_unsigned(p->value, &k) < 0) {
+                        avahi_log_error("Invalid resolve-cache-entries-max setting %s", p->value);
+                        goto finish;
+                    }
+
+                    c->n_resolve_cache_entries_max = k;
+                } else if (strcasecmp(p->key, "statistics-file") == 0) {
+                    avahi_free(c->statistics_file);
+                    c->statistics_file = *p->value ? avahi_strdup(p->value) : NULL;
                 } else {
                     avahi_log_error("Invalid configuration key \"%s\" in group \"%s\"\n", p->key, g->name);
                     goto finish;
@@ -927,8 +969,12 @@ static void log_function(AvahiLogLevel level, const char *txt) {
     daemon_log(log_level_map[level], "%s", txt);
 }
 
-static void dump(const char *text, AVAHI_GCC_UNUSED void* userdata) {
-    avahi_log_info("%s", text);
+static void dump_statistics(const StatisticsValue *v, AVAHI_GCC_UNUSED void* userdata) {
+
+    if (v->ifname)
+        avahi_log_info("%s{%s.%s} %llu", v->name, v->ifname, avahi_proto_to_string(v->protocol), (unsigned long long) v->value);
+    else
+        avahi_log_info("%s %llu", v->name, (unsigned long long) v->value);
 }
 
 #ifdef HAVE_INOTIFY
@@ -1092,7 +1138,7 @@ static void kqueue_callback(AvahiWatch *watch, int fd, AVAHI_GCC_UNUSED AvahiWat
 #endif
 
 static void signal_callback(AvahiWatch *watch, AVAHI_GCC_UNUSED int fd, AVAHI_GCC_UNUSED AvahiWatchEvent event, AVAHI_GCC_UNUSED void *userdata) {
-    int sig;
+    int sig, error;
     const AvahiPoll *poll_api;
 
     assert(watch);
@@ -1123,7 +1169,11 @@ static void signal_callback(AvahiWatch *watch, AVAHI_GCC_UNUSED int fd, AVAHI_GC
 
         case SIGUSR1:
             avahi_log_info("Got SIGUSR1, dumping record data.");
-            avahi_server_dump(avahi_server, dump, NULL);
+
+            if ((error = dump_start(avahi_server, DUMP_FORMAT_LOG, -1, NULL)) < 0)
+                avahi_log_warn("Failed to dump record data: %s", avahi_strerror(error));
+
+            statistics_collect(dump_statistics, NULL);
             break;
 
         default:
@@ -1183,7 +1233,18 @@ static int run_server(DaemonConfig *c) {
         goto finish;
     }
 
-    if (simple_protocol_setup(poll_api) < 0)
+    if (resolve_cache_setup(poll_api, config.n_resolve_cache_entries_max) < 0)
+        goto finish;
+
+    if (statistics_setup(poll_api, config.statistics_file) < 0)
+        goto finish;
+
+    if (dump_setup(poll_api) < 0)
+        goto finish;
+
+    if (simple_protocol_setup(poll_api,
+                              config.n_simple_clients_max,
+                              config.n_simple_requests_per_client_max) < 0)
         goto finish;
 
 #ifdef HAVE_DBUS
@@ -1193,6 +1254,7 @@ static int run_server(DaemonConfig *c) {
                                 config.n_clients_max,
                                 config.n_objects_per_client_max,
                                 config.n_entries_per_entry_group_max,
+                                config.enable_dbus_socket,
                                 !c->fail_on_missing_dbus
 #ifdef ENABLE_CHROOT
                                 && !config.use_chroot
@@ -1308,6 +1370,10 @@ finish:
         dbus_protocol_shutdown();
 #endif
 
+    dump_shutdown();
+    statistics_shutdown();
+    resolve_cache_shutdown();
+
     if (avahi_server) {
         avahi_server_free(avahi_server);
         avahi_server = NULL;
@@ -1531,11 +1597,16 @@ int main(int argc, char *argv[]) {
     config.config_file = NULL;
 #ifdef HAVE_DBUS
     config.enable_dbus = 1;
+    config.enable_dbus_socket = 0;
     config.fail_on_missing_dbus = 1;
     config.n_clients_max = 0;
     config.n_objects_per_client_max = 0;
     config.n_entries_per_entry_group_max = 0;
 #endif
+    config.n_simple_clients_max = 0;
+    config.n_simple_requests_per_client_max = 0;
+    config.n_resolve_cache_entries_max = 256;
+    config.statistics_file = NULL;
 
     config.drop_root = 1;
     config.set_rlimits = 1;
@@ -1721,6 +1792,7 @@ finish:
 
     avahi_server_config_free(&config.server_config);
     avahi_free(config.config_file);
+    avahi_free(config.statistics_file);
     avahi_strfreev(config.publish_dns_servers);
     avahi_strfreev(resolv_conf_name_servers);
     avahi_strfreev(resolv_conf_search_domains);
@@ -0,0 +1,559 @@
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <assert.h>
+#include <sys/time.h>
+
+#include <avahi-common/llist.h>
+#include <avahi-common/malloc.h>
+#include <avahi-common/error.h>
+#include <avahi-common/domain.h>
+#include <avahi-common/timeval.h>
+#include <avahi-core/core.h>
+#include <avahi-core/log.h>
+
+#include "resolve-cache.h"
+
+/* How long found answers are reused. This is well below the TTL of
+ * address and PTR records (120s), so that a host which went away
+ * isn't reported for much longer than it would be by the core. */
+#define POSITIVE_TTL_MSEC 10000
+
+/* How long lookups that timed out are remembered */
+#define NEGATIVE_TTL_MSEC 5000
+
+#define N_BUCKETS 127
+
+typedef enum {
+    LOOKUP_HOST_NAME,
+    LOOKUP_ADDRESS
+} LookupType;
+
+typedef struct Key {
+    LookupType type;
+    AvahiIfIndex interface;
+    AvahiProtocol protocol;
+    AvahiLookupFlags flags;
+
+    /* LOOKUP_HOST_NAME */
+    char *host_name;
+    AvahiProtocol aprotocol;
+
+    /* LOOKUP_ADDRESS */
+    AvahiAddress address;
+} Key;
+
+typedef struct Answer {
+    int error; /* 0 if the lookup succeeded */
+
+    AvahiIfIndex interface;
+    AvahiProtocol protocol;
+    char *host_name;
+    AvahiAddress address;
+    AvahiLookupResultFlags flags;
+} Answer;
+
+typedef struct Entry Entry;
+
+struct Entry {
+    Key key;
+    unsigned hash;
+
+    Answer answer;
+    struct timeval expiry;
+
+    AVAHI_LLIST_FIELDS(Entry, bucket);
+
+    /* Most recently used first */
+    AVAHI_LLIST_FIELDS(Entry, lru);
+};
+
+struct ResolveCacheLookup {
+    AvahiServer *server;
+    Key key;
+
+    AvahiSHostNameResolver *host_name_resolver;
+    AvahiSAddressResolver *address_resolver;
+
+    /* Delivers a cached answer from the main loop */
+    AvahiTimeout *timeout;
+    Answer answer;
+
+    int error;
+
+    ResolveCacheHostNameCallback host_name_callback;
+    ResolveCacheAddressCallback address_callback;
+    void *userdata;
+};
+
+static const AvahiPoll *poll_api = NULL;
+
+static Entry *buckets[N_BUCKETS];
+static AVAHI_LLIST_HEAD(Entry, lru) = NULL;
+static Entry *lru_tail = NULL;
+
+static unsigned n_entries = 0, n_entries_max = 0;
+static unsigned n_hits = 0, n_misses = 0;
+
+static unsigned key_hash(const Key *k) {
+    unsigned hash;
+
+    assert(k);
+
+    if (k->type == LOOKUP_HOST_NAME)
+        hash = avahi_domain_hash(k->host_name) + (unsigned) k->aprotocol;
+    else {
+        const uint8_t *p = (const uint8_t*) &k->address.data;
+        size_t i, l;
+
+        l = k->address.proto == AVAHI_PROTO_INET6 ? sizeof(AvahiIPv6Address) : sizeof(AvahiIPv4Address);
+
+        for (hash = 0, i = 0; i < l; i++)
+            hash = 31 * hash + p[i];
+    }
+
+    return hash + 31 * (unsigned) k->interface;
+}
+
+static int key_equal(const Key *a, const Key *b) {
+    assert(a);
+    assert(b);
+
+    if (a->type != b->type ||
+        a->interface != b->interface ||
+        a->protocol != b->protocol ||
+        a->flags != b->flags)
+        return 0;
+
+    if (a->type == LOOKUP_HOST_NAME)
+        return a->aprotocol == b->aprotocol && avahi_domain_equal(a->host_name, b->host_name);
+
+    return avahi_address_cmp(&a->address, &b->address) == 0;
+}
+
+static int key_copy(Key *dest, const Key *src) {
+    assert(dest);
+    assert(src);
+
+    *dest = *src;
+
+    if (src->host_name && !(dest->host_name = avahi_strdup(src->host_name)))
+        return -1;
+
+    return 0;
+}
+
+static int answer_copy(Answer *dest, const Answer *src) {
+    assert(dest);
+    assert(src);
+
+    *dest = *src;
+
+    if (src->host_name && !(dest->host_name = avahi_strdup(src->host_name)))
+        return -1;
+
+    return 0;
+}
+
+static void entry_free(Entry *e) {
+    assert(e);
+
+    AVAHI_LLIST_REMOVE(Entry, bucket, buckets[e->hash % N_BUCKETS], e);
+
+    if (lru_tail == e)
+        lru_tail = e->lru_prev;
+    AVAHI_LLIST_REMOVE(Entry, lru, lru, e);
+
+    assert(n_entries >= 1);
+    n_entries--;
+
+    avahi_free(e->key.host_name);
+    avahi_free(e->answer.host_name);
+    avahi_free(e);
+}
+
+static void entry_touch(Entry *e) {
+    assert(e);
+
+    if (lru == e)
+        return;
+
+    if (lru_tail == e)
+        lru_tail = e->lru_prev;
+    AVAHI_LLIST_REMOVE(Entry, lru, lru, e);
+    AVAHI_LLIST_PREPEND(Entry, lru, lru, e);
+}
+
+static Entry *entry_find(const Key *k, unsigned hash) {
+    Entry *e;
+
+    assert(k);
+
+    for (e = buckets[hash % N_BUCKETS]; e; e = e->bucket_next)
+        if (e->hash == hash && key_equal(&e->key, k))
+            return e;
+
+    return NULL;
+}
+
+static void cache_store(const Key *k, const Answer *a) {
+    Entry *e;
+    unsigned hash;
+
+    assert(k);
+    assert(a);
+
+    if (!poll_api || n_entries_max <= 0)
+        return;
+
+    /* Only remember definite answers, not failures caused by bad
+     * arguments or a lack of resources */
+    if (a->error != 0 && a->error != AVAHI_ERR_TIMEOUT && a->error != AVAHI_ERR_NOT_FOUND)
+        return;
+
+    hash = key_hash(k);
+
+    if ((e = entry_find(k, hash)))
+        entry_free(e);
+
+    if (n_entries >= n_entries_max) {
+        assert(lru_tail);
+        entry_free(lru_tail);
+    }
+
+    if (!(e = avahi_new0(Entry, 1)))
+        return;
+
+    if (key_copy(&e->key, k) < 0 || answer_copy(&e->answer, a) < 0) {
+        avahi_free(e->key.host_name);
+        avahi_free(e);
+        return;
+    }
+
+    e->hash = hash;
+    avahi_elapse_time(&e->expiry, a->error ? NEGATIVE_TTL_MSEC : POSITIVE_TTL_MSEC, 0);
+
+    AVAHI_LLIST_PREPEND(Entry, bucket, buckets[hash % N_BUCKETS], e);
+    AVAHI_LLIST_PREPEND(Entry, lru, lru, e);
+    if (!lru_tail)
+        lru_tail = e;
+
+    n_entries++;
+}
+
+static void deliver(ResolveCacheLookup *l, const Answer *a) {
+    assert(l);
+    assert(a);
+
+    l->error = a->error;
+
+    if (l->key.type == LOOKUP_HOST_NAME)
+        l->host_name_callback(
+            l, a->interface, a->protocol,
+            a->error ? AVAHI_RESOLVER_FAILURE : AVAHI_RESOLVER_FOUND,
+            a->error ? l->key.host_name : a->host_name,
+            a->error ? NULL : &a->address,
+            a->flags, l->userdata);
+    else
+        l->address_callback(
+            l, a->interface, a->protocol,
+            a->error ? AVAHI_RESOLVER_FAILURE : AVAHI_RESOLVER_FOUND,
+            &l->key.address,
+            a->error ? NULL : a->host_name,
+            a->flags, l->userdata);
+}
+
+static void timeout_callback(AvahiTimeout *t, void *userdata) {
+    ResolveCacheLookup *l = userdata;
+
+    assert(t);
+    assert(l);
+
+    poll_api->timeout_update(t, NULL);
+
+    /* The callback might free the lookup */
+    deliver(l, &l->answer);
+}
+
+/* Returns 1 if the lookup will be answered from the cache */
+static int lookup_from_cache(ResolveCacheLookup *l) {
+    Entry *e;
+    struct timeval tv;
+    unsigned hash;
+
+    assert(l);
+
+    if (!poll_api || n_entries_max <= 0)
+        return 0;
+
+    hash = key_hash(&l->key);
+
+    if (!(e = entry_find(&l->key, hash))) {
+        n_misses++;
+        return 0;
+    }
+
+    if (avahi_age(&e->expiry) >= 0) {
+        entry_free(e);
+        n_misses++;
+        return 0;
+    }
+
+    if (answer_copy(&l->answer, &e->answer) < 0)
+        return 0;
+
+    l->answer.flags |= AVAHI_LOOKUP_RESULT_CACHED;
+
+    if (!(l->timeout = poll_api->timeout_new(poll_api, avahi_elapse_time(&tv, 0, 0), timeout_callback, l))) {
+        avahi_free(l->answer.host_name);
+        l->answer.host_name = NULL;
+        return 0;
+    }
+
+    entry_touch(e);
+    n_hits++;
+
+    return 1;
+}
+
+static void host_name_resolver_callback(
+    AVAHI_GCC_UNUSED AvahiSHostNameResolver *r,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    AvahiResolverEvent event,
+    const char *host_name,
+    const AvahiAddress *a,
+    AvahiLookupResultFlags flags,
+    void *userdata) {
+
+    ResolveCacheLookup *l = userdata;
+    Answer answer;
+
+    assert(l);
+
+    memset(&answer, 0, sizeof(answer));
+    answer.error = event == AVAHI_RESOLVER_FOUND ? 0 : avahi_server_errno(l->server);
+    answer.interface = interface;
+    answer.protocol = protocol;
+    answer.host_name = (char*) host_name;
+    if (a)
+        answer.address = *a;
+    answer.flags = flags;
+
+    cache_store(&l->key, &answer);
+
+    l->error = answer.error;
+    l->host_name_callback(l, interface, protocol, event, host_name, a, flags, l->userdata);
+}
+
+static void address_resolver_callback(
+    AVAHI_GCC_UNUSED AvahiSAddressResolver *r,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    AvahiResolverEvent event,
+    const AvahiAddress *a,
+    const char *host_name,
+    AvahiLookupResultFlags flags,
+    void *userdata) {
+
+    ResolveCacheLookup *l = userdata;
+    Answer answer;
+
+    assert(l);
+
+    memset(&answer, 0, sizeof(answer));
+    answer.error = event == AVAHI_RESOLVER_FOUND ? 0 : avahi_server_errno(l->server);
+    answer.interface = interface;
+    answer.protocol = protocol;
+    answer.host_name = (char*) host_name;
+    answer.flags = flags;
+
+    cache_store(&l->key, &answer);
+
+    l->error = answer.error;
+    l->address_callback(l, interface, protocol, event, a, host_name, flags, l->userdata);
+}
+
+static ResolveCacheLookup *lookup_new(AvahiServer *s, const Key *k, void *userdata) {
+    ResolveCacheLookup *l;
+
+    assert(s);
+    assert(k);
+
+    if (!(l = avahi_new0(ResolveCacheLookup, 1)))
+        return NULL;
+
+    if (key_copy(&l->key, k) < 0) {
+        avahi_free(l);
+        return NULL;
+    }
+
+    l->server = s;
+    l->userdata = userdata;
+
+    return l;
+}
+
+ResolveCacheLookup *resolve_cache_host_name_lookup_new(
+    AvahiServer *s,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *host_name,
+    AvahiProtocol aprotocol,
+    AvahiLookupFlags flags,
+    ResolveCacheHostNameCallback callback,
+    void *userdata) {
+
+    ResolveCacheLookup *l;
+    Key k;
+
+    assert(s);
+    assert(host_name);
+    assert(callback);
+
+    memset(&k, 0, sizeof(k));
+    k.type = LOOKUP_HOST_NAME;
+    k.interface = interface;
+    k.protocol = protocol;
+    k.flags = flags;
+    k.host_name = (char*) host_name;
+    k.aprotocol = aprotocol;
+
+    if (!(l = lookup_new(s, &k, userdata)))
+        return NULL;
+
+    l->host_name_callback = callback;
+
+    if (lookup_from_cache(l))
+        return l;
+
+    if (!(l->host_name_resolver = avahi_s_host_name_resolver_new(s, interface, protocol, host_name, aprotocol, flags, host_name_resolver_callback, l))) {
+        resolve_cache_lookup_free(l);
+        return NULL;
+    }
+
+    return l;
+}
+
+ResolveCacheLookup *resolve_cache_address_lookup_new(
+    AvahiServer *s,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const AvahiAddress *address,
+    AvahiLookupFlags flags,
+    ResolveCacheAddressCallback callback,
+    void *userdata) {
+
+    ResolveCacheLookup *l;
+    Key k;
+
+    assert(s);
+    assert(address);
+    assert(callback);
+
+    memset(&k, 0, sizeof(k));
+    k.type = LOOKUP_ADDRESS;
+    k.interface = interface;
+    k.protocol = protocol;
+    k.flags = flags;
+    k.address = *address;
+
+    if (!(l = lookup_new(s, &k, userdata)))
+        return NULL;
+
+    l->address_callback = callback;
+
+    if (lookup_from_cache(l))
+        return l;
+
+    if (!(l->address_resolver = avahi_s_address_resolver_new(s, interface, protocol, address, flags, address_resolver_callback, l))) {
+        resolve_cache_lookup_free(l);
+        return NULL;
+    }
+
+    return l;
+}
+
+void resolve_cache_lookup_free(ResolveCacheLookup *l) {
+    assert(l);
+
+    if (l->host_name_resolver)
+        avahi_s_host_name_resolver_free(l->host_name_resolver);
+
+    if (l->address_resolver)
+        avahi_s_address_resolver_free(l->address_resolver);
+
+    if (l->timeout)
+        poll_api->timeout_free(l->timeout);
+
+    avahi_free(l->key.host_name);
+    avahi_free(l->answer.host_name);
+    avahi_free(l);
+}
+
+int resolve_cache_lookup_errno(ResolveCacheLookup *l) {
+    assert(l);
+
+    return l->error;
+}
+
+void resolve_cache_flush(void) {
+
+    while (lru)
+        entry_free(lru);
+
+    assert(n_entries == 0);
+    assert(!lru_tail);
+}
+
+void resolve_cache_get_statistics(unsigned *hits, unsigned *misses) {
+
+    if (hits)
+        *hits = n_hits;
+
+    if (misses)
+        *misses = n_misses;
+}
+
+int resolve_cache_setup(const AvahiPoll *p, unsigned entries_max) {
+    assert(p);
+    assert(!poll_api);
+
+    poll_api = p;
+    n_entries_max = entries_max;
+    n_hits = n_misses = 0;
+
+    memset(buckets, 0, sizeof(buckets));
+
+    return 0;
+}
+
+void resolve_cache_shutdown(void) {
+
+    if (!poll_api)
+        return;
+
+    resolve_cache_flush();
+    poll_api = NULL;
+}
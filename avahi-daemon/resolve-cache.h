@@ -0,0 +1,92 @@
+#ifndef fooresolvecachehfoo
+#define fooresolvecachehfoo
+
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <avahi-common/watch.h>
+#include <avahi-core/lookup.h>
+
+/* A cache for the results of one-shot host name and address
+ * resolving, shared by the simple protocol and the D-Bus
+ * ResolveHostName()/ResolveAddress() methods. Found answers are
+ * reused for a few seconds, lookups that timed out are remembered
+ * for a little less, so that repeated lookups of nonexistent names
+ * (e.g. from NSS) don't each have to wait for the full resolver
+ * timeout. Cached answers are delivered from the main loop, never
+ * from within the *_new() call. */
+
+typedef struct ResolveCacheLookup ResolveCacheLookup;
+
+typedef void (*ResolveCacheHostNameCallback)(
+    ResolveCacheLookup *l,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    AvahiResolverEvent event,
+    const char *host_name,
+    const AvahiAddress *a,
+    AvahiLookupResultFlags flags,
+    void *userdata);
+
+typedef void (*ResolveCacheAddressCallback)(
+    ResolveCacheLookup *l,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    AvahiResolverEvent event,
+    const AvahiAddress *a,
+    const char *host_name,
+    AvahiLookupResultFlags flags,
+    void *userdata);
+
+int resolve_cache_setup(const AvahiPoll *poll_api, unsigned n_entries_max);
+void resolve_cache_shutdown(void);
+
+/* Drop all cached answers, e.g. after the host name or the network
+ * configuration changed */
+void resolve_cache_flush(void);
+
+void resolve_cache_get_statistics(unsigned *hits, unsigned *misses);
+
+ResolveCacheLookup *resolve_cache_host_name_lookup_new(
+    AvahiServer *s,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const char *host_name,
+    AvahiProtocol aprotocol,
+    AvahiLookupFlags flags,
+    ResolveCacheHostNameCallback callback,
+    void *userdata);
+
+ResolveCacheLookup *resolve_cache_address_lookup_new(
+    AvahiServer *s,
+    AvahiIfIndex interface,
+    AvahiProtocol protocol,
+    const AvahiAddress *address,
+    AvahiLookupFlags flags,
+    ResolveCacheAddressCallback callback,
+    void *userdata);
+
+void resolve_cache_lookup_free(ResolveCacheLookup *l);
+
+/* The error code of a lookup that failed. Use this instead of
+ * avahi_server_errno() in callbacks, since cached failures are not
+ * reflected there. */
+int resolve_cache_lookup_errno(ResolveCacheLookup *l);
+
+#endif
@@ -22,6 +22,7 @@
 #endif
 
 #include <assert.h>
+#include <ctype.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -46,6 +47,7 @@
 #include <avahi-core/dns-srv-rr.h>
 
 #include "simple-protocol.h"
+#include "resolve-cache.h"
 #include "main.h"
 
 #ifdef ENABLE_CHROOT
@@ -59,12 +61,22 @@
 #define PF_LOCAL PF_UNIX
 #endif
 
-#define BUFFER_SIZE (20*1024)
+/* Requests are single lines, hence the input buffer needs to hold at
+ * most one command with its tag and a full domain name */
+#define INBUF_SIZE (2*1024)
 
-#define CLIENTS_MAX 50
+/* The output buffer grows on demand, but a client which doesn't
+ * read its answers is disconnected when it hits this limit */
+#define OUTBUF_MAX (256*1024)
+
+#define DEFAULT_CLIENTS_MAX 256
+#define DEFAULT_REQUESTS_PER_CLIENT_MAX 128
+
+#define TAG_MAX 32
 
 typedef struct Client Client;
 typedef struct Server Server;
+typedef struct Request Request;
 
 typedef enum {
     CLIENT_IDLE,
@@ -74,6 +86,21 @@ typedef enum {
     CLIENT_DEAD
 } ClientState;
 
+/* A single host name or address lookup. Lookups that are issued
+ * with a tag ("@tag RESOLVE-HOSTNAME foo.local") may be pipelined:
+ * many of them may be pending on the same connection, their answers
+ * are prefixed with the same tag and are sent in the order they
+ * complete. After an untagged lookup the connection is closed, as
+ * before. */
+struct Request {
+    Client *client;
+    char *tag;
+
+    ResolveCacheLookup *lookup;
+
+    AVAHI_LLIST_FIELDS(Request, requests);
+};
+
 struct Client {
     Server *server;
 
@@ -82,11 +109,15 @@ struct Client {
     int fd;
     AvahiWatch *watch;
 
-    char inbuf[BUFFER_SIZE], outbuf[BUFFER_SIZE];
-    size_t inbuf_length, outbuf_length;
+    char inbuf[INBUF_SIZE];
+    size_t inbuf_length;
+
+    char *outbuf;
+    size_t outbuf_length, outbuf_size;
+
+    AVAHI_LLIST_HEAD(Request, requests);
+    unsigned n_requests;
 
-    AvahiSHostNameResolver *host_name_resolver;
-    AvahiSAddressResolver *address_resolver;
     AvahiSDNSServerBrowser *dns_server_browser;
 
     AvahiProtocol afquery;
@@ -102,23 +133,64 @@ struct Server {
 
     unsigned n_clients;
     int remove_socket;
+
+    unsigned n_clients_max;
+    unsigned n_requests_per_client_max;
 };
 
 static Server *server = NULL;
 
 static void client_work(AvahiWatch *watch, int fd, AvahiWatchEvent events, void *userdata);
 
+static void request_free(Request *r) {
+    Client *c;
+
+    assert(r);
+    c = r->client;
+
+    if (r->lookup)
+        resolve_cache_lookup_free(r->lookup);
+
+    assert(c->n_requests >= 1);
+    c->n_requests--;
+
+    AVAHI_LLIST_REMOVE(Request, requests, c->requests, r);
+    avahi_free(r->tag);
+    avahi_free(r);
+}
+
+static Request *request_new(Client *c, const char *tag) {
+    Request *r;
+
+    assert(c);
+
+    if (!(r = avahi_new(Request, 1)))
+        return NULL;
+
+    r->client = c;
+    r->lookup = NULL;
+
+    if (!tag)
+        r->tag = NULL;
+    else if (!(r->tag = avahi_strdup(tag))) {
+        avahi_free(r);
+        return NULL;
+    }
+
+    AVAHI_LLIST_PREPEND(Request, requests, c->requests, r);
+    c->n_requests++;
+
+    return r;
+}
+
 static void client_free(Client *c) {
     assert(c);
 
     assert(c->server->n_clients >= 1);
     c->server->n_clients--;
 
-    if (c->host_name_resolver)
-        avahi_s_host_name_resolver_free(c->host_name_resolver);
-
-    if (c->address_resolver)
-        avahi_s_address_resolver_free(c->address_resolver);
+    while (c->requests)
+        request_free(c->requests);
 
     if (c->dns_server_browser)
         avahi_s_dns_server_browser_free(c->dns_server_browser);
@@ -127,6 +199,7 @@ static void client_free(Client *c) {
     close(c->fd);
 
     AVAHI_LLIST_REMOVE(Client, clients, c->server->clients, c);
+    avahi_free(c->outbuf);
     avahi_free(c);
 }
 
@@ -140,10 +213,14 @@ static void client_new(Server *s, int fd) {
     c->fd = fd;
     c->state = CLIENT_IDLE;
 
-    c->inbuf_length = c->outbuf_length = 0;
+    c->inbuf_length = 0;
+
+    c->outbuf = NULL;
+    c->outbuf_length = c->outbuf_size = 0;
+
+    AVAHI_LLIST_HEAD_INIT(Request, c->requests);
+    c->n_requests = 0;
 
-    c->host_name_resolver = NULL;
-    c->address_resolver = NULL;
     c->dns_server_browser = NULL;
 
     c->watch = s->poll_api->watch_new(s->poll_api, fd, AVAHI_WATCH_IN, client_work, c);
@@ -153,19 +230,35 @@ static void client_new(Server *s, int fd) {
 }
 
 static void client_output(Client *c, const uint8_t*data, size_t size) {
-    size_t k, m;
-
     assert(c);
     assert(data);
 
-    if (!size)
+    if (!size || c->state == CLIENT_DEAD)
         return;
 
-    k = sizeof(c->outbuf) - c->outbuf_length;
-    m = size > k ? k : size;
+    if (c->outbuf_length + size > c->outbuf_size) {
+        size_t n;
+        char *b;
+
+        n = c->outbuf_size ? c->outbuf_size : 1024;
+        while (n < c->outbuf_length + size)
+            n *= 2;
 
-    memcpy(c->outbuf + c->outbuf_length, data, m);
-    c->outbuf_length += m;
+        if (n > OUTBUF_MAX || !(b = avahi_realloc(c->outbuf, n))) {
+            avahi_log_warn(__FILE__": Client doesn't read its answers, dropping.");
+
+            /* Flush what we have and close the connection
+             * afterwards */
+            c->state = CLIENT_DEAD;
+            return;
+        }
+
+        c->outbuf = b;
+        c->outbuf_size = n;
+    }
+
+    memcpy(c->outbuf + c->outbuf_length, data, size);
+    c->outbuf_length += size;
 
     server->poll_api->watch_update(c->watch, AVAHI_WATCH_OUT);
 }
@@ -182,8 +275,53 @@ static void client_output_printf(Client *c, const char *format, ...) {
     avahi_free(t);
 }
 
+/* Like client_output_printf(), but prefixes the answer with the tag
+ * of the request, if there is one */
+static void client_reply_printf(Client *c, const char *tag, const char *format, ...) {
+    char *t;
+    va_list ap;
+
+    assert(c);
+
+    va_start(ap, format);
+    t = avahi_strdup_vprintf(format, ap);
+    va_end(ap);
+
+    if (!tag)
+        client_output(c, (uint8_t*) t, strlen(t));
+    else {
+        char *l, *e;
+
+        /* Tag every line of the answer */
+        for (l = t; *l; l = e) {
+            if ((e = strchr(l, '\n')))
+                e++;
+            else
+                e = l + strlen(l);
+
+            client_output_printf(c, "@%s ", tag);
+            client_output(c, (uint8_t*) l, e - l);
+        }
+    }
+
+    avahi_free(t);
+}
+
+static void request_finish(Request *r) {
+    Client *c;
+
+    assert(r);
+    c = r->client;
+
+    /* Untagged requests are answered only once per connection */
+    if (!r->tag)
+        c->state = CLIENT_DEAD;
+
+    request_free(r);
+}
+
 static void host_name_resolver_callback(
-    AVAHI_GCC_UNUSED AvahiSHostNameResolver *r,
+    ResolveCacheLookup *l,
     AvahiIfIndex iface,
     AvahiProtocol protocol,
     AvahiResolverEvent event,
@@ -192,23 +330,23 @@ static void host_name_resolver_callback(
     AVAHI_GCC_UNUSED AvahiLookupResultFlags flags,
     void* userdata) {
 
-    Client *c = userdata;
+    Request *req = userdata;
 
-    assert(c);
+    assert(req);
 
     if (event == AVAHI_RESOLVER_FAILURE)
-        client_output_printf(c, "%+i %s\n", avahi_server_errno(avahi_server), avahi_strerror(avahi_server_errno(avahi_server)));
+        client_reply_printf(req->client, req->tag, "%+i %s\n", resolve_cache_lookup_errno(l), avahi_strerror(resolve_cache_lookup_errno(l)));
     else if (event == AVAHI_RESOLVER_FOUND) {
         char t[AVAHI_ADDRESS_STR_MAX];
         avahi_address_snprint(t, sizeof(t), a);
-        client_output_printf(c, "+ %i %u %s %s\n", iface, protocol, hostname, t);
+        client_reply_printf(req->client, req->tag, "+ %i %u %s %s\n", iface, protocol, hostname, t);
     }
 
-    c->state = CLIENT_DEAD;
+    request_finish(req);
 }
 
 static void address_resolver_callback(
-    AVAHI_GCC_UNUSED AvahiSAddressResolver *r,
+    ResolveCacheLookup *l,
     AvahiIfIndex iface,
     AvahiProtocol protocol,
     AvahiResolverEvent event,
@@ -217,16 +355,16 @@ static void address_resolver_callback(
     AVAHI_GCC_UNUSED AvahiLookupResultFlags flags,
     void* userdata) {
 
-    Client *c = userdata;
+    Request *req = userdata;
 
-    assert(c);
+    assert(req);
 
     if (event == AVAHI_RESOLVER_FAILURE)
-        client_output_printf(c, "%+i %s\n", avahi_server_errno(avahi_server), avahi_strerror(avahi_server_errno(avahi_server)));
+        client_reply_printf(req->client, req->tag, "%+i %s\n", resolve_cache_lookup_errno(l), avahi_strerror(resolve_cache_lookup_errno(l)));
     else if (event == AVAHI_RESOLVER_FOUND)
-        client_output_printf(c, "+ %i %u %s\n", iface, protocol, hostname);
+        client_reply_printf(req->client, req->tag, "+ %i %u %s\n", iface, protocol, hostname);
 
-    c->state = CLIENT_DEAD;
+    request_finish(req);
 }
 
 static void dns_server_browser_callback(
@@ -267,9 +405,40 @@ static void dns_server_browser_callback(
     }
 }
 
+static Request *request_start(Client *c, const char *tag, ClientState state) {
+    Request *r;
+
+    assert(c);
+
+    if (c->n_requests >= c->server->n_requests_per_client_max) {
+        client_reply_printf(c, tag, "%+i Too many pending requests.\n", AVAHI_ERR_TOO_MANY_OBJECTS);
+
+        if (!tag)
+            c->state = CLIENT_DEAD;
+
+        return NULL;
+    }
+
+    if (!(r = request_new(c, tag))) {
+        client_reply_printf(c, tag, "%+i %s\n", AVAHI_ERR_NO_MEMORY, avahi_strerror(AVAHI_ERR_NO_MEMORY));
+
+        if (!tag)
+            c->state = CLIENT_DEAD;
+
+        return NULL;
+    }
+
+    if (!tag)
+        c->state = state;
+
+    return r;
+}
+
 static void handle_line(Client *c, const char *s) {
-    char cmd[64], arg[AVAHI_DOMAIN_NAME_MAX];
+    char tag_buf[TAG_MAX], cmd[64], arg[AVAHI_DOMAIN_NAME_MAX];
+    const char *tag = NULL;
     int n_args;
+    Request *r = NULL;
 
     assert(c);
     assert(s);
@@ -277,41 +446,74 @@ static void handle_line(Client *c, const char *s) {
     if (c->state != CLIENT_IDLE)
         return;
 
-    if ((n_args = sscanf(s, "%63s %1013s", cmd, arg)) < 1 ) {
+    if (*s == '@') {
+        int l = 0;
+
+        /* If the tag is not followed by whitespace it has been
+         * truncated, and the rest of it would be taken for the
+         * command */
+        if (isspace((unsigned char) s[1]) ||
+            sscanf(s, "@%31s%n", tag_buf, &l) < 1 ||
+            (s[l] && !isspace((unsigned char) s[l]))) {
+            client_output_printf(c, "%+i Invalid tag, tags directly follow \"@\" and are at most %u characters long.\n", AVAHI_ERR_INVALID_OPERATION, TAG_MAX-1);
+            c->state = CLIENT_DEAD;
+            return;
+        }
+
+        if ((n_args = sscanf(s + l, "%63s %1013s", cmd, arg)) < 1) {
+            client_output_printf(c, "%+i Failed to parse command, try \"HELP\".\n", AVAHI_ERR_INVALID_OPERATION);
+            c->state = CLIENT_DEAD;
+            return;
+        }
+
+        tag = tag_buf;
+    } else if ((n_args = sscanf(s, "%63s %1013s", cmd, arg)) < 1 ) {
         client_output_printf(c, "%+i Failed to parse command, try \"HELP\".\n", AVAHI_ERR_INVALID_OPERATION);
         c->state = CLIENT_DEAD;
         return;
     }
 
     if (strcmp(cmd, "HELP") == 0) {
-        client_output_printf(c,
-                             "+ Available commands are:\n"
-                             "+      RESOLVE-HOSTNAME <hostname>\n"
-                             "+      RESOLVE-HOSTNAME-IPV6 <hostname>\n"
-                             "+      RESOLVE-HOSTNAME-IPV4 <hostname>\n"
-                             "+      RESOLVE-ADDRESS <address>\n"
-                             "+      BROWSE-DNS-SERVERS\n"
-                             "+      BROWSE-DNS-SERVERS-IPV4\n"
-                             "+      BROWSE-DNS-SERVERS-IPV6\n");
-        c->state = CLIENT_DEAD; }
-    else if (strcmp(cmd, "FUCK") == 0 && n_args == 1) {
-        client_output_printf(c, "+ FUCK: Go fuck yourself!\n");
-        c->state = CLIENT_DEAD;
+        client_reply_printf(c, tag,
+                            "+ Available commands are:\n"
+                            "+      RESOLVE-HOSTNAME <hostname>\n"
+                            "+      RESOLVE-HOSTNAME-IPV6 <hostname>\n"
+                            "+      RESOLVE-HOSTNAME-IPV4 <hostname>\n"
+                            "+      RESOLVE-ADDRESS <address>\n"
+                            "+      BROWSE-DNS-SERVERS\n"
+                            "+      BROWSE-DNS-SERVERS-IPV4\n"
+                            "+      BROWSE-DNS-SERVERS-IPV6\n"
+                            "+ Prefix a RESOLVE command with \"@<tag> \" to keep the connection\n"
+                            "+ open and pipeline further requests; answers carry the same tag.\n");
+
+        if (!tag)
+            c->state = CLIENT_DEAD;
+    } else if (strcmp(cmd, "FUCK") == 0 && n_args == 1) {
+        client_reply_printf(c, tag, "+ FUCK: Go fuck yourself!\n");
+
+        if (!tag)
+            c->state = CLIENT_DEAD;
     } else if (strcmp(cmd, "RESOLVE-HOSTNAME-IPV4") == 0 && n_args == 2) {
-        c->state = CLIENT_RESOLVE_HOSTNAME;
-        if (!(c->host_name_resolver = avahi_s_host_name_resolver_new(avahi_server, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, arg, c->afquery = AVAHI_PROTO_INET, AVAHI_LOOKUP_USE_MULTICAST, host_name_resolver_callback, c)))
+        if (!(r = request_start(c, tag, CLIENT_RESOLVE_HOSTNAME)))
+            return;
+
+        if (!(r->lookup = resolve_cache_host_name_lookup_new(avahi_server, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, arg, AVAHI_PROTO_INET, AVAHI_LOOKUP_USE_MULTICAST, host_name_resolver_callback, r)))
             goto fail;
 
         avahi_log_debug(__FILE__": Got %s request for '%s'.", cmd, arg);
     } else if (strcmp(cmd, "RESOLVE-HOSTNAME-IPV6") == 0 && n_args == 2) {
-        c->state = CLIENT_RESOLVE_HOSTNAME;
-        if (!(c->host_name_resolver = avahi_s_host_name_resolver_new(avahi_server, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, arg, c->afquery = AVAHI_PROTO_INET6, AVAHI_LOOKUP_USE_MULTICAST, host_name_resolver_callback, c)))
+        if (!(r = request_start(c, tag, CLIENT_RESOLVE_HOSTNAME)))
+            return;
+
+        if (!(r->lookup = resolve_cache_host_name_lookup_new(avahi_server, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, arg, AVAHI_PROTO_INET6, AVAHI_LOOKUP_USE_MULTICAST, host_name_resolver_callback, r)))
             goto fail;
 
         avahi_log_debug(__FILE__": Got %s request for '%s'.", cmd, arg);
     } else if (strcmp(cmd, "RESOLVE-HOSTNAME") == 0 && n_args == 2) {
-        c->state = CLIENT_RESOLVE_HOSTNAME;
-        if (!(c->host_name_resolver = avahi_s_host_name_resolver_new(avahi_server, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, arg, c->afquery = AVAHI_PROTO_UNSPEC, AVAHI_LOOKUP_USE_MULTICAST, host_name_resolver_callback, c)))
+        if (!(r = request_start(c, tag, CLIENT_RESOLVE_HOSTNAME)))
+            return;
+
+        if (!(r->lookup = resolve_cache_host_name_lookup_new(avahi_server, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, arg, AVAHI_PROTO_UNSPEC, AVAHI_LOOKUP_USE_MULTICAST, host_name_resolver_callback, r)))
             goto fail;
 
         avahi_log_debug(__FILE__": Got %s request for '%s'.", cmd, arg);
@@ -319,16 +521,24 @@ static void handle_line(Client *c, const char *s) {
         AvahiAddress addr;
 
         if (!(avahi_address_parse(arg, AVAHI_PROTO_UNSPEC, &addr))) {
-            client_output_printf(c, "%+i Failed to parse address \"%s\".\n", AVAHI_ERR_INVALID_ADDRESS, arg);
-            c->state = CLIENT_DEAD;
+            client_reply_printf(c, tag, "%+i Failed to parse address \"%s\".\n", AVAHI_ERR_INVALID_ADDRESS, arg);
+
+            if (!tag)
+                c->state = CLIENT_DEAD;
         } else {
-            c->state = CLIENT_RESOLVE_ADDRESS;
-            if (!(c->address_resolver = avahi_s_address_resolver_new(avahi_server, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, &addr, AVAHI_LOOKUP_USE_MULTICAST, address_resolver_callback, c)))
+            if (!(r = request_start(c, tag, CLIENT_RESOLVE_ADDRESS)))
+                return;
+
+            if (!(r->lookup = resolve_cache_address_lookup_new(avahi_server, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, &addr, AVAHI_LOOKUP_USE_MULTICAST, address_resolver_callback, r)))
                 goto fail;
         }
 
         avahi_log_debug(__FILE__": Got %s request for '%s'.", cmd, arg);
 
+    } else if (tag && strncmp(cmd, "BROWSE-DNS-SERVERS", 18) == 0) {
+        /* Browsing never finishes, hence it cannot be pipelined */
+        client_reply_printf(c, tag, "%+i Command \"%s\" cannot be tagged.\n", AVAHI_ERR_INVALID_OPERATION, cmd);
+
     } else if (strcmp(cmd, "BROWSE-DNS-SERVERS-IPV4") == 0 && n_args == 1) {
         c->state = CLIENT_BROWSE_DNS_SERVERS;
         if (!(c->dns_server_browser = avahi_s_dns_server_browser_new(avahi_server, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, NULL, AVAHI_DNS_SERVER_RESOLVE, c->afquery = AVAHI_PROTO_INET, AVAHI_LOOKUP_USE_MULTICAST, dns_server_browser_callback, c)))
@@ -354,8 +564,10 @@ static void handle_line(Client *c, const char *s) {
         avahi_log_debug(__FILE__": Got %s request.", cmd);
 
     } else {
-        client_output_printf(c, "%+i Invalid command \"%s\", try \"HELP\".\n", AVAHI_ERR_INVALID_OPERATION, cmd);
-        c->state = CLIENT_DEAD;
+        client_reply_printf(c, tag, "%+i Invalid command \"%s\", try \"HELP\".\n", AVAHI_ERR_INVALID_OPERATION, cmd);
+
+        if (!tag)
+            c->state = CLIENT_DEAD;
 
         avahi_log_debug(__FILE__": Got invalid request '%s'.", cmd);
     }
@@ -363,8 +575,13 @@ static void handle_line(Client *c, const char *s) {
     return;
 
 fail:
-    client_output_printf(c, "%+i %s\n", avahi_server_errno(avahi_server), avahi_strerror(avahi_server_errno(avahi_server)));
-    c->state = CLIENT_DEAD;
+    client_reply_printf(c, tag, "%+i %s\n", avahi_server_errno(avahi_server), avahi_strerror(avahi_server_errno(avahi_server)));
+
+    if (r)
+        request_free(r);
+
+    if (!tag)
+        c->state = CLIENT_DEAD;
 }
 
 static void handle_input(Client *c) {
@@ -405,6 +622,12 @@ static void client_work(AvahiWatch *watch, AVAHI_GCC_UNUSED int fd, AvahiWatchEv
         assert(c->inbuf_length <= sizeof(c->inbuf));
 
         handle_input(c);
+
+        if (c->inbuf_length >= sizeof(c->inbuf)) {
+            avahi_log_warn(__FILE__": Client sent overly long line, dropping.");
+            client_free(c);
+            return;
+        }
     }
 
     if ((events & AVAHI_WATCH_OUT) && c->outbuf_length > 0) {
@@ -420,12 +643,12 @@ static void client_work(AvahiWatch *watch, AVAHI_GCC_UNUSED int fd, AvahiWatchEv
         c->outbuf_length -= r;
 
         if (c->outbuf_length)
-            memmove(c->outbuf, c->outbuf + r, c->outbuf_length - r);
+            memmove(c->outbuf, c->outbuf + r, c->outbuf_length);
+    }
 
-        if (c->outbuf_length == 0 && c->state == CLIENT_DEAD) {
-            client_free(c);
-            return;
-        }
+    if (c->outbuf_length == 0 && c->state == CLIENT_DEAD) {
+        client_free(c);
+        return;
     }
 
     if (events & AVAHI_WATCH_HUP) {
@@ -433,10 +656,12 @@ static void client_work(AvahiWatch *watch, AVAHI_GCC_UNUSED int fd, AvahiWatchEv
         return;
     }
 
+    /* Stop reading new requests while the client is not picking up
+     * the answers to its previous ones */
     c->server->poll_api->watch_update(
         watch,
         (c->outbuf_length > 0 ? AVAHI_WATCH_OUT : 0) |
-        (c->inbuf_length < sizeof(c->inbuf) ? AVAHI_WATCH_IN : 0));
+        (c->state != CLIENT_DEAD && c->outbuf_length < OUTBUF_MAX/2 ? AVAHI_WATCH_IN : 0));
 }
 
 static void server_work(AVAHI_GCC_UNUSED AvahiWatch *watch, int fd, AvahiWatchEvent events, void *userdata) {
@@ -449,12 +674,15 @@ static void server_work(AVAHI_GCC_UNUSED AvahiWatch *watch, int fd, AvahiWatchEv
 
         if ((cfd = accept(fd, NULL, NULL)) < 0)
             avahi_log_error("accept(): %s", strerror(errno));
-        else
+        else if (s->n_clients >= s->n_clients_max) {
+            avahi_log_warn(__FILE__": Too many clients, client request failed.");
+            close(cfd);
+        } else
             client_new(s, cfd);
     }
 }
 
-int simple_protocol_setup(const AvahiPoll *poll_api) {
+int simple_protocol_setup(const AvahiPoll *poll_api, unsigned n_clients_max, unsigned n_requests_per_client_max) {
     struct sockaddr_un sa;
     mode_t u;
 #ifdef HAVE_LIBSYSTEMD
@@ -468,6 +696,8 @@ int simple_protocol_setup(const AvahiPoll *poll_api) {
     server->remove_socket = 0;
     server->fd = -1;
     server->n_clients = 0;
+    server->n_clients_max = n_clients_max > 0 ? n_clients_max : DEFAULT_CLIENTS_MAX;
+    server->n_requests_per_client_max = n_requests_per_client_max > 0 ? n_requests_per_client_max : DEFAULT_REQUESTS_PER_CLIENT_MAX;
     AVAHI_LLIST_HEAD_INIT(Client, server->clients);
     server->watch = NULL;
 
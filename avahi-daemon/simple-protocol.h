@@ -22,7 +22,7 @@
 
 #include <avahi-common/watch.h>
 
-int simple_protocol_setup(const AvahiPoll *poll_api);
+int simple_protocol_setup(const AvahiPoll *poll_api, unsigned n_clients_max, unsigned n_requests_per_client_max);
 void simple_protocol_shutdown(void);
 void simple_protocol_restart_queries(void);
 
@@ -0,0 +1,346 @@
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include <avahi-common/malloc.h>
+#include <avahi-common/gccmacro.h>
+#include <avahi-common/timeval.h>
+#include <avahi-core/core.h>
+#include <avahi-core/log.h>
+
+#include "main.h"
+#include "statistics.h"
+#include "resolve-cache.h"
+
+#ifdef HAVE_DBUS
+#include "dbus-protocol.h"
+#include "browse-share.h"
+#endif
+
+/* How often the statistics file is rewritten */
+#define WRITE_INTERVAL_MSEC 10000
+
+#define INTERFACE_COUNTER(field, help) { "avahi_" #field, help, 1, offsetof(AvahiInterfaceStatistics, field) }
+#define INTERFACE_GAUGE(field, help) { "avahi_" #field, help, 0, offsetof(AvahiInterfaceStatistics, field) }
+
+/* Counters are uint64_t, gauges unsigned */
+static const struct {
+    const char *name;
+    const char *help;
+    int counter;
+    size_t offset;
+} interface_metrics[] = {
+    INTERFACE_COUNTER(packets_received_total, "mDNS packets received, including invalid ones"),
+    INTERFACE_COUNTER(packets_invalid_total, "mDNS packets dropped as malformed or failing a sanity check"),
+    INTERFACE_COUNTER(queries_received_total, "mDNS queries processed"),
+    INTERFACE_COUNTER(responses_received_total, "mDNS responses processed"),
+    INTERFACE_COUNTER(packets_sent_total, "mDNS packets sent"),
+    INTERFACE_COUNTER(packets_rate_limited_total, "mDNS packets not sent due to rate limiting"),
+    INTERFACE_COUNTER(queries_suppressed_total, "Questions not sent due to duplicate question suppression"),
+    INTERFACE_COUNTER(responses_suppressed_total, "Answers not sent due to known or duplicate answer suppression"),
+    INTERFACE_COUNTER(cache_lookups_total, "Lookups started"),
+    INTERFACE_COUNTER(cache_hits_total, "Lookups the cache already had an answer for"),
+    INTERFACE_GAUGE(cache_entries, "Records in the cache"),
+    INTERFACE_GAUGE(queries_scheduled, "Questions waiting to be sent"),
+    INTERFACE_GAUGE(responses_scheduled, "Answers waiting to be sent"),
+    INTERFACE_GAUGE(probes_scheduled, "Probes waiting to be sent"),
+};
+
+typedef struct InterfaceList {
+    AvahiInterfaceStatistics *items;
+    unsigned n_items, n_allocated;
+    int oom;
+} InterfaceList;
+
+static const AvahiPoll *poll_api = NULL;
+static AvahiTimeout *write_timeout = NULL;
+static char *file_name = NULL;
+static int write_failed = 0;
+
+static void interface_callback(const AvahiInterfaceStatistics *st, void *userdata) {
+    InterfaceList *l = userdata;
+    AvahiInterfaceStatistics *t;
+
+    assert(st);
+    assert(l);
+
+    if (l->oom)
+        return;
+
+    if (l->n_items >= l->n_allocated) {
+        unsigned n = l->n_allocated ? l->n_allocated * 2 : 8;
+
+        if (!(t = avahi_realloc(l->items, sizeof(AvahiInterfaceStatistics) * n))) {
+            l->oom = 1;
+            return;
+        }
+
+        l->items = t;
+        l->n_allocated = n;
+    }
+
+    t = &l->items[l->n_items];
+    *t = *st;
+
+    /* The name is only valid during the callback */
+    if (!(t->name = avahi_strdup(st->name))) {
+        l->oom = 1;
+        return;
+    }
+
+    l->n_items++;
+}
+
+static void interface_list_free(InterfaceList *l) {
+    unsigned j;
+
+    assert(l);
+
+    for (j = 0; j < l->n_items; j++)
+        avahi_free((char*) l->items[j].name);
+
+    avahi_free(l->items);
+}
+
+static void report(StatisticsCallback callback, void *userdata, const char *name, const char *help, int counter, uint64_t value) {
+    StatisticsValue v;
+
+    v.name = name;
+    v.help = help;
+    v.counter = counter;
+    v.interface = AVAHI_IF_UNSPEC;
+    v.protocol = AVAHI_PROTO_UNSPEC;
+    v.ifname = NULL;
+    v.value = value;
+
+    callback(&v, userdata);
+}
+
+int statistics_collect(StatisticsCallback callback, void *userdata) {
+    AvahiServerStatistics st;
+    InterfaceList l;
+    unsigned hits, misses, k, j;
+
+    assert(callback);
+
+    memset(&st, 0, sizeof(st));
+    memset(&l, 0, sizeof(l));
+
+    if (avahi_server) {
+        avahi_server_get_statistics(avahi_server, &st, interface_callback, &l);
+
+        if (l.oom) {
+            interface_list_free(&l);
+            return -1;
+        }
+    }
+
+    for (k = 0; k < sizeof(interface_metrics)/sizeof(interface_metrics[0]); k++)
+        for (j = 0; j < l.n_items; j++) {
+            const uint8_t *p = (const uint8_t*) &l.items[j] + interface_metrics[k].offset;
+            StatisticsValue v;
+
+            v.name = interface_metrics[k].name;
+            v.help = interface_metrics[k].help;
+            v.counter = interface_metrics[k].counter;
+            v.interface = l.items[j].interface;
+            v.protocol = l.items[j].protocol;
+            v.ifname = l.items[j].name;
+            v.value = v.counter ? *(const uint64_t*) p : *(const unsigned*) p;
+
+            callback(&v, userdata);
+        }
+
+    interface_list_free(&l);
+
+    report(callback, userdata, "avahi_packets_unknown_interface_total", "mDNS packets received on interfaces not in use", 1, st.packets_unknown_interface_total);
+    report(callback, userdata, "avahi_entries", "Locally registered records", 0, st.entries);
+    report(callback, userdata, "avahi_entry_groups", "Entry groups", 0, st.entry_groups);
+    report(callback, userdata, "avahi_record_browsers", "Record browsers, including those of other browsers and resolvers", 0, st.record_browsers);
+
+    resolve_cache_get_statistics(&hits, &misses);
+    report(callback, userdata, "avahi_resolve_cache_hits_total", "Host name and address lookups answered from the resolve cache", 1, hits);
+    report(callback, userdata, "avahi_resolve_cache_misses_total", "Host name and address lookups not found in the resolve cache", 1, misses);
+
+#ifdef HAVE_DBUS
+    {
+        unsigned n_shares, n_subscriptions, n_clients, n_objects;
+
+        browse_share_get_statistics(&n_shares, &n_subscriptions);
+        report(callback, userdata, "avahi_browse_shares", "Service browsers shared between D-Bus subscribers", 0, n_shares);
+        report(callback, userdata, "avahi_browse_share_subscriptions", "Subscriptions to shared service browsers", 0, n_subscriptions);
+
+        dbus_protocol_get_statistics(&n_clients, &n_objects);
+        report(callback, userdata, "avahi_dbus_clients", "Connected D-Bus clients", 0, n_clients);
+        report(callback, userdata, "avahi_dbus_objects", "Objects created by D-Bus clients", 0, n_objects);
+    }
+#endif
+
+    return 0;
+}
+
+typedef struct WriteContext {
+    FILE *f;
+    const char *last_name;
+} WriteContext;
+
+static void write_label_value(FILE *f, const char *s) {
+
+    for (; *s; s++) {
+        if (*s == '\\' || *s == '"')
+            fprintf(f, "\\%c", *s);
+        else if (*s == '\n')
+            fputs("\\n", f);
+        else
+            fputc(*s, f);
+    }
+}
+
+static void write_callback(const StatisticsValue *v, void *userdata) {
+    WriteContext *w = userdata;
+
+    assert(v);
+    assert(w);
+
+    if (!w->last_name || strcmp(w->last_name, v->name)) {
+        fprintf(w->f,
+                "# HELP %s %s\n"
+                "# TYPE %s %s\n",
+                v->name, v->help,
+                v->name, v->counter ? "counter" : "gauge");
+        w->last_name = v->name;
+    }
+
+    fputs(v->name, w->f);
+
+    if (v->ifname) {
+        fputs("{interface=\"", w->f);
+        write_label_value(w->f, v->ifname);
+        fprintf(w->f, "\",protocol=\"%s\"}", avahi_proto_to_string(v->protocol));
+    }
+
+    fprintf(w->f, " %llu\n", (unsigned long long) v->value);
+}
+
+static int write_file(void) {
+    WriteContext w;
+    char *t;
+    int r = -1;
+
+    assert(file_name);
+
+    if (!(t = avahi_strdup_printf("%s.tmp", file_name)))
+        return -1;
+
+    if (!(w.f = fopen(t, "w")))
+        goto finish;
+
+    w.last_name = NULL;
+
+    if (statistics_collect(write_callback, &w) < 0) {
+        fclose(w.f);
+        errno = ENOMEM;
+        goto fail;
+    }
+
+    if (fclose(w.f) != 0)
+        goto fail;
+
+    /* Readers never see a partially written file */
+    if (rename(t, file_name) < 0)
+        goto fail;
+
+    r = 0;
+    goto finish;
+
+fail:
+    unlink(t);
+
+finish:
+    if (r < 0 && !write_failed)
+        avahi_log_warn("Failed to write statistics to %s: %s", file_name, strerror(errno));
+
+    write_failed = r < 0;
+
+    avahi_free(t);
+    return r;
+}
+
+static void write_timeout_callback(AvahiTimeout *t, AVAHI_GCC_UNUSED void *userdata) {
+    struct timeval tv;
+
+    assert(t == write_timeout);
+
+    write_file();
+
+    avahi_elapse_time(&tv, WRITE_INTERVAL_MSEC, 0);
+    poll_api->timeout_update(write_timeout, &tv);
+}
+
+int statistics_setup(const AvahiPoll *p, const char *file) {
+    struct timeval tv;
+
+    assert(p);
+
+    if (!file)
+        return 0;
+
+    poll_api = p;
+
+    if (!(file_name = avahi_strdup(file)))
+        goto fail;
+
+    /* Write the first file as soon as the main loop runs */
+    if (!(write_timeout = poll_api->timeout_new(poll_api, avahi_elapse_time(&tv, 0, 0), write_timeout_callback, NULL)))
+        goto fail;
+
+    return 0;
+
+fail:
+    avahi_log_error("Failed to set up statistics file: out of memory");
+    statistics_shutdown();
+    return -1;
+}
+
+void statistics_shutdown(void) {
+
+    if (write_timeout) {
+        poll_api->timeout_free(write_timeout);
+        write_timeout = NULL;
+    }
+
+    if (file_name) {
+        /* Don't leave stale numbers behind */
+        unlink(file_name);
+        avahi_free(file_name);
+        file_name = NULL;
+    }
+
+    write_failed = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef foostatisticshfoo
+#define foostatisticshfoo
+
+/***
+  This file is part of avahi.
+
+  avahi is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  avahi is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+  Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with avahi; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+
+#include <avahi-common/watch.h>
+#include <avahi-common/address.h>
+
+/* Runtime counters of the server and the daemon, as exported by the
+ * D-Bus GetStatistics() method, the statistics file and SIGUSR1.
+ * Values are reported grouped by metric name, per interface values
+ * first in the order of the interfaces. */
+
+typedef struct StatisticsValue {
+    const char *name;
+    const char *help;
+    int counter;                /* Only ever grows, otherwise a gauge */
+
+    /* AVAHI_IF_UNSPEC/AVAHI_PROTO_UNSPEC and NULL for server wide values */
+    AvahiIfIndex interface;
+    AvahiProtocol protocol;
+    const char *ifname;
+
+    uint64_t value;
+} StatisticsValue;
+
+typedef void (*StatisticsCallback)(const StatisticsValue *v, void *userdata);
+
+/* Returns -1 when running out of memory, in which case no value has
+ * been reported */
+int statistics_collect(StatisticsCallback callback, void *userdata);
+
+/* Write the statistics to file in the Prometheus text format every
+ * few seconds. A NULL file disables this. */
+int statistics_setup(const AvahiPoll *poll_api, const char *file);
+void statistics_shutdown(void);
+
+#endif